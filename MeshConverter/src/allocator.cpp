@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include "util/profiler.h"
+
+// The command line tool's allocations all go through here so the profiler
+// can count them. Only the tool is built with this file, the library
+// leaves the global allocator to whatever program embeds it. Every form
+// of operator new and delete is replaced together, so none of them ends
+// up freeing a block another allocator handed out. With profiling off
+// each costs a single test
+
+static void* Allocate(size_t size)
+{
+	void *block = malloc(size > 0 ? size : 1);
+	if (block != NULL && IsProfiling())
+		ProfileAllocation(block, size);
+	return block;
+}
+
+static void Deallocate(void *block)
+{
+	if (block != NULL && IsProfiling())
+		ProfileDeallocation(block);
+	free(block);
+}
+
+void* operator new(size_t size)
+{
+	void *block = Allocate(size);
+	if (block == NULL)
+		throw std::bad_alloc();
+	return block;
+}
+
+void* operator new[](size_t size)
+{
+	void *block = Allocate(size);
+	if (block == NULL)
+		throw std::bad_alloc();
+	return block;
+}
+
+void* operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	return Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return Allocate(size);
+}
+
+void operator delete(void *block) noexcept
+{
+	Deallocate(block);
+}
+
+void operator delete[](void *block) noexcept
+{
+	Deallocate(block);
+}
+
+void operator delete(void *block, const std::nothrow_t &) noexcept
+{
+	Deallocate(block);
+}
+
+void operator delete[](void *block, const std::nothrow_t &) noexcept
+{
+	Deallocate(block);
+}
+
+void operator delete(void *block, size_t) noexcept
+{
+	Deallocate(block);
+}
+
+void operator delete[](void *block, size_t) noexcept
+{
+	Deallocate(block);
+}
+
+#ifdef __cpp_aligned_new
+
+// Over-aligned types are rare here and aren't counted. They only need
+// replacing so their blocks are freed by the allocator that made them
+static void* AllocateAligned(size_t size, std::align_val_t alignment)
+{
+	if (size == 0)
+		size = 1;
+#ifdef _WIN32
+	return _aligned_malloc(size, (size_t)alignment);
+#else
+	void *block;
+	return (posix_memalign(&block, (size_t)alignment, size) == 0 ? block : NULL);
+#endif
+}
+
+static void DeallocateAligned(void *block)
+{
+#ifdef _WIN32
+	_aligned_free(block);
+#else
+	free(block);
+#endif
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void *block = AllocateAligned(size, alignment);
+	if (block == NULL)
+		throw std::bad_alloc();
+	return block;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	void *block = AllocateAligned(size, alignment);
+	if (block == NULL)
+		throw std::bad_alloc();
+	return block;
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+	return AllocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+	return AllocateAligned(size, alignment);
+}
+
+void operator delete(void *block, std::align_val_t) noexcept
+{
+	DeallocateAligned(block);
+}
+
+void operator delete[](void *block, std::align_val_t) noexcept
+{
+	DeallocateAligned(block);
+}
+
+void operator delete(void *block, std::align_val_t, const std::nothrow_t &) noexcept
+{
+	DeallocateAligned(block);
+}
+
+void operator delete[](void *block, std::align_val_t, const std::nothrow_t &) noexcept
+{
+	DeallocateAligned(block);
+}
+
+void operator delete(void *block, size_t, std::align_val_t) noexcept
+{
+	DeallocateAligned(block);
+}
+
+void operator delete[](void *block, size_t, std::align_val_t) noexcept
+{
+	DeallocateAligned(block);
+}
+
+#endif
@@ -0,0 +1,403 @@
+#include "entropy.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <queue>
+
+#define ENTROPY_BLOCK_RAW 0
+#define ENTROPY_BLOCK_RUN 1
+#define ENTROPY_BLOCK_HUFFMAN 2
+
+#define ENTROPY_NUM_STREAMS 4
+
+// Huffman coding has to save at least 1/this of a block to be used
+#define ENTROPY_MIN_SAVING 16
+#define ENTROPY_TABLE_SIZE (1 << ENTROPY_MAX_CODE_LENGTH)
+
+// Mode byte, 4 bit code length per symbol, byte size of each stream
+#define ENTROPY_HUFFMAN_HEADER_SIZE (1 + 128 + ENTROPY_NUM_STREAMS * 4)
+
+// Zero bytes after the last stream, so the decoder can always load 8
+// bytes at a time without checking for the end of the block
+#define ENTROPY_PADDING 8
+
+static void WriteU32(std::vector<unsigned char> &output, uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+		output.push_back((unsigned char)(value >> (i * 8)));
+}
+
+static uint32_t ReadU32(const unsigned char *data)
+{
+	return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static unsigned int ReverseBits(unsigned int code, unsigned int length)
+{
+	unsigned int result = 0;
+	for (unsigned int i = 0; i < length; ++i)
+	{
+		result = (result << 1) | (code & 1);
+		code >>= 1;
+	}
+	return result;
+}
+
+// Huffman code lengths for the given symbol counts. Counts are halved and
+// the tree rebuilt until no code is longer than ENTROPY_MAX_CODE_LENGTH
+static void BuildCodeLengths(const uint32_t *counts, unsigned char *lengths)
+{
+	uint32_t scaled[256];
+	memcpy(scaled, counts, sizeof(scaled));
+
+	for (;;)
+	{
+		typedef std::pair<uint64_t, int> HeapEntry;
+		std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry> > heap;
+		std::vector<int> parents;
+		for (int i = 0; i < 256; ++i)
+		{
+			lengths[i] = 0;
+			if (scaled[i] > 0)
+			{
+				heap.push(HeapEntry(scaled[i], (int)parents.size()));
+				parents.push_back(-1);
+			}
+		}
+
+		std::vector<int> symbols;
+		for (int i = 0; i < 256; ++i)
+		{
+			if (scaled[i] > 0)
+				symbols.push_back(i);
+		}
+
+		while (heap.size() > 1)
+		{
+			HeapEntry a = heap.top();
+			heap.pop();
+			HeapEntry b = heap.top();
+			heap.pop();
+			int node = (int)parents.size();
+			parents.push_back(-1);
+			parents[a.second] = node;
+			parents[b.second] = node;
+			heap.push(HeapEntry(a.first + b.first, node));
+		}
+
+		// Nodes are created after their children, so depths can be filled
+		// in walking backwards from the root
+		std::vector<unsigned char> depths(parents.size(), 0);
+		for (int i = (int)parents.size() - 2; i >= 0; --i)
+			depths[i] = depths[parents[i]] + 1;
+
+		unsigned int maxLength = 0;
+		for (unsigned int i = 0; i < symbols.size(); ++i)
+		{
+			lengths[symbols[i]] = depths[i];
+			maxLength = std::max(maxLength, (unsigned int)depths[i]);
+		}
+		if (maxLength <= ENTROPY_MAX_CODE_LENGTH)
+			return;
+
+		for (int i = 0; i < 256; ++i)
+		{
+			if (scaled[i] > 0)
+				scaled[i] = (scaled[i] >> 1) | 1;
+		}
+	}
+}
+
+// Canonical codes, bit reversed since streams are read least significant
+// bit first
+static bool BuildCodes(const unsigned char *lengths, uint16_t *codes)
+{
+	unsigned int lengthCounts[ENTROPY_MAX_CODE_LENGTH + 1] = { 0 };
+	for (int i = 0; i < 256; ++i)
+		++lengthCounts[lengths[i]];
+	lengthCounts[0] = 0;
+
+	// The code has to be complete, which also guarantees every decoding
+	// table entry gets filled in
+	unsigned int kraft = 0;
+	for (int i = 1; i <= ENTROPY_MAX_CODE_LENGTH; ++i)
+		kraft += lengthCounts[i] << (ENTROPY_MAX_CODE_LENGTH - i);
+	if (kraft != ENTROPY_TABLE_SIZE)
+		return false;
+
+	unsigned int nextCode[ENTROPY_MAX_CODE_LENGTH + 1];
+	unsigned int code = 0;
+	nextCode[0] = 0;
+	for (int i = 1; i <= ENTROPY_MAX_CODE_LENGTH; ++i)
+	{
+		code = (code + lengthCounts[i - 1]) << 1;
+		nextCode[i] = code;
+	}
+	for (int i = 0; i < 256; ++i)
+	{
+		if (lengths[i] > 0)
+			codes[i] = (uint16_t)ReverseBits(nextCode[lengths[i]]++, lengths[i]);
+	}
+	return true;
+}
+
+// Codes every ENTROPY_NUM_STREAMS'th byte starting at first
+static void EncodeHuffmanStream(const unsigned char *data, size_t size, size_t first, const uint16_t *codes, const unsigned char *lengths, std::vector<unsigned char> &output)
+{
+	uint64_t buffer = 0;
+	unsigned int bits = 0;
+	for (size_t i = first; i < size; i += ENTROPY_NUM_STREAMS)
+	{
+		buffer |= (uint64_t)codes[data[i]] << bits;
+		bits += lengths[data[i]];
+		while (bits >= 8)
+		{
+			output.push_back((unsigned char)buffer);
+			buffer >>= 8;
+			bits -= 8;
+		}
+	}
+	if (bits > 0)
+		output.push_back((unsigned char)buffer);
+}
+
+static void EncodeBlock(const unsigned char *data, size_t size, std::vector<unsigned char> &output)
+{
+	uint32_t counts[256] = { 0 };
+	for (size_t i = 0; i < size; ++i)
+		++counts[data[i]];
+
+	unsigned int numSymbols = 0;
+	for (int i = 0; i < 256; ++i)
+		numSymbols += (counts[i] > 0 ? 1 : 0);
+
+	if (numSymbols == 1)
+	{
+		output.push_back(ENTROPY_BLOCK_RUN);
+		output.push_back(data[0]);
+		return;
+	}
+
+	unsigned char lengths[256];
+	uint16_t codes[256];
+	BuildCodeLengths(counts, lengths);
+	BuildCodes(lengths, codes);
+
+	uint64_t codedBits = 0;
+	for (int i = 0; i < 256; ++i)
+		codedBits += (uint64_t)counts[i] * lengths[i];
+	// Blocks that barely shrink are stored raw, copying them decodes many
+	// times faster than Huffman decoding them would
+	size_t codedSize = codedBits / 8 + ENTROPY_NUM_STREAMS + ENTROPY_HUFFMAN_HEADER_SIZE + ENTROPY_PADDING;
+	if (codedSize >= size - size / ENTROPY_MIN_SAVING)
+	{
+		output.push_back(ENTROPY_BLOCK_RAW);
+		output.insert(output.end(), data, data + size);
+		return;
+	}
+
+	output.push_back(ENTROPY_BLOCK_HUFFMAN);
+	for (int i = 0; i < 256; i += 2)
+		output.push_back((unsigned char)(lengths[i] | (lengths[i + 1] << 4)));
+
+	size_t sizesOffset = output.size();
+	for (int i = 0; i < ENTROPY_NUM_STREAMS; ++i)
+		WriteU32(output, 0);
+
+	// Bytes are dealt out to the streams in turn, so the decoder fills
+	// the output in order with one symbol from each stream
+	for (int i = 0; i < ENTROPY_NUM_STREAMS; ++i)
+	{
+		size_t before = output.size();
+		EncodeHuffmanStream(data, size, i, codes, lengths, output);
+
+		uint32_t streamSize = (uint32_t)(output.size() - before);
+		for (int j = 0; j < 4; ++j)
+			output[sizesOffset + i * 4 + j] = (unsigned char)(streamSize >> (j * 8));
+	}
+
+	output.insert(output.end(), ENTROPY_PADDING, 0);
+}
+
+void EntropyEncode(const unsigned char *data, size_t size, std::vector<unsigned char> &output)
+{
+	for (size_t offset = 0; offset < size; offset += ENTROPY_BLOCK_SIZE)
+		EncodeBlock(data + offset, std::min((size_t)ENTROPY_BLOCK_SIZE, size - offset), output);
+}
+
+// A stream is just its bit position within the block, the buffer is
+// reloaded from there on every refill. Keeping so little state per
+// stream lets all 4 live in registers
+struct BitStream
+{
+	uint64_t buffer;
+	size_t position;
+};
+
+// Leaves at least 57 valid bits in the buffer
+static inline void Refill(BitStream &stream, const unsigned char *data)
+{
+	uint64_t value;
+	memcpy(&value, data + (stream.position >> 3), sizeof(value));
+	stream.buffer = value >> (stream.position & 7);
+}
+
+// Table entries hold the symbol in the high byte and the code length in
+// the low one
+static inline unsigned char DecodeSymbol(BitStream &stream, const uint16_t *table)
+{
+	uint16_t entry = table[stream.buffer & (ENTROPY_TABLE_SIZE - 1)];
+	unsigned int length = entry & 0xff;
+	stream.buffer >>= length;
+	stream.position += length;
+	return (unsigned char)(entry >> 8);
+}
+
+// 5 symbols from one stream, which go to every ENTROPY_NUM_STREAMS'th
+// byte of the output. The streams are independent of each other, so the
+// CPU overlaps the calls for all 4
+static inline void DecodeSymbols(BitStream &stream, const unsigned char *data, const uint16_t *table, unsigned char *output)
+{
+	Refill(stream, data);
+	output[0] = DecodeSymbol(stream, table);
+	output[4] = DecodeSymbol(stream, table);
+	output[8] = DecodeSymbol(stream, table);
+	output[12] = DecodeSymbol(stream, table);
+	output[16] = DecodeSymbol(stream, table);
+}
+
+static bool DecodeHuffmanBlock(const unsigned char *&input, const unsigned char *end, unsigned char *output, size_t size)
+{
+	if ((size_t)(end - input) < ENTROPY_HUFFMAN_HEADER_SIZE - 1)
+		return false;
+
+	unsigned char lengths[256];
+	for (int i = 0; i < 128; ++i)
+	{
+		lengths[i * 2] = input[i] & 15;
+		lengths[i * 2 + 1] = input[i] >> 4;
+	}
+	for (int i = 0; i < 256; ++i)
+	{
+		if (lengths[i] > ENTROPY_MAX_CODE_LENGTH)
+			return false;
+	}
+	uint16_t codes[256];
+	if (!BuildCodes(lengths, codes))
+		return false;
+
+	uint16_t table[ENTROPY_TABLE_SIZE];
+	for (int i = 0; i < 256; ++i)
+	{
+		if (lengths[i] == 0)
+			continue;
+		for (unsigned int j = codes[i]; j < ENTROPY_TABLE_SIZE; j += 1 << lengths[i])
+			table[j] = (uint16_t)((i << 8) | lengths[i]);
+	}
+
+	size_t streamSizes[ENTROPY_NUM_STREAMS];
+	size_t total = 0;
+	for (int i = 0; i < ENTROPY_NUM_STREAMS; ++i)
+	{
+		streamSizes[i] = ReadU32(input + 128 + i * 4);
+		total += streamSizes[i];
+	}
+	input += ENTROPY_HUFFMAN_HEADER_SIZE - 1;
+	if ((size_t)(end - input) < total + ENTROPY_PADDING)
+		return false;
+
+	// A malformed stream could run on past its own data, refills are only
+	// allowed while they stay within the block's padding
+	const unsigned char *data = input;
+	const size_t limit = total * 8;
+
+	BitStream streams[ENTROPY_NUM_STREAMS];
+	size_t streamEnds[ENTROPY_NUM_STREAMS];
+	size_t streamStart = 0;
+	for (int i = 0; i < ENTROPY_NUM_STREAMS; ++i)
+	{
+		streams[i].buffer = 0;
+		streams[i].position = streamStart * 8;
+		streamStart += streamSizes[i];
+		streamEnds[i] = streamStart * 8;
+	}
+
+	// 57 bits after a refill always cover 5 of the longest codes, so the
+	// main loop only refills once per 5 symbols of each stream
+	const size_t fastStep = ENTROPY_NUM_STREAMS * 5;
+	unsigned char *fastEnd = output + (size - size % fastStep);
+
+	// Working on local copies lets the compiler keep all 4 streams in
+	// registers, stores to the output could alias the array otherwise
+	BitStream stream0 = streams[0], stream1 = streams[1], stream2 = streams[2], stream3 = streams[3];
+	unsigned char *current = output;
+	for (; current < fastEnd; current += fastStep)
+	{
+		if (stream0.position > limit || stream1.position > limit || stream2.position > limit || stream3.position > limit)
+			return false;
+		DecodeSymbols(stream0, data, table, current);
+		DecodeSymbols(stream1, data, table, current + 1);
+		DecodeSymbols(stream2, data, table, current + 2);
+		DecodeSymbols(stream3, data, table, current + 3);
+	}
+	streams[0] = stream0;
+	streams[1] = stream1;
+	streams[2] = stream2;
+	streams[3] = stream3;
+
+	for (size_t i = current - output; i < size; ++i)
+	{
+		BitStream &stream = streams[i % ENTROPY_NUM_STREAMS];
+		if (stream.position > limit)
+			return false;
+		Refill(stream, data);
+		output[i] = DecodeSymbol(stream, table);
+	}
+
+	// Everything decoded has to have come out of each stream's own bytes
+	for (int i = 0; i < ENTROPY_NUM_STREAMS; ++i)
+	{
+		if (streams[i].position > streamEnds[i])
+			return false;
+	}
+
+	input += total + ENTROPY_PADDING;
+	return true;
+}
+
+bool EntropyDecode(const unsigned char *&input, const unsigned char *end, unsigned char *output, size_t size)
+{
+	const unsigned char *current = input;
+	for (size_t offset = 0; offset < size; offset += ENTROPY_BLOCK_SIZE)
+	{
+		size_t blockSize = std::min((size_t)ENTROPY_BLOCK_SIZE, size - offset);
+		if (current >= end)
+			return false;
+
+		unsigned char mode = *current++;
+		if (mode == ENTROPY_BLOCK_RAW)
+		{
+			if ((size_t)(end - current) < blockSize)
+				return false;
+			memcpy(output + offset, current, blockSize);
+			current += blockSize;
+		}
+		else if (mode == ENTROPY_BLOCK_RUN)
+		{
+			if (current >= end)
+				return false;
+			memset(output + offset, *current++, blockSize);
+		}
+		else if (mode == ENTROPY_BLOCK_HUFFMAN)
+		{
+			if (!DecodeHuffmanBlock(current, end, output + offset, blockSize))
+				return false;
+		}
+		else
+			return false;
+	}
+
+	input = current;
+	return true;
+}
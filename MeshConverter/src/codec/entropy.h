@@ -0,0 +1,37 @@
+#ifndef __CODEC_ENTROPY_H_INCLUDED__
+#define __CODEC_ENTROPY_H_INCLUDED__
+
+#include <stddef.h>
+#include <vector>
+
+// Input is coded in independent blocks of this many bytes, each with its
+// own code table
+#define ENTROPY_BLOCK_SIZE (128 * 1024)
+
+// Longest Huffman code, which is also the number of bits used to index the
+// decoding table
+#define ENTROPY_MAX_CODE_LENGTH 11
+
+/**
+ * Order-0 Huffman codes a byte stream. Each block is stored as a single
+ * repeated byte, as 4 interleaved bit streams sharing one canonical code
+ * table, or raw when Huffman coding would barely make it smaller. The
+ * size is not stored, the decoder has to be told it
+ * @param data bytes to code
+ * @param size number of bytes
+ * @param output the coded stream is appended to this
+ */
+void EntropyEncode(const unsigned char *data, size_t size, std::vector<unsigned char> &output);
+
+/**
+ * Decodes a stream written by EntropyEncode
+ * @param input start of the coded stream, advanced past it on success
+ * @param end end of the available input
+ * @param output receives size bytes
+ * @param size number of bytes that were coded
+ *
+ * @return bool false if the stream is malformed or truncated
+ */
+bool EntropyDecode(const unsigned char *&input, const unsigned char *end, unsigned char *output, size_t size);
+
+#endif
@@ -0,0 +1,203 @@
+#include "lz.h"
+
+#include <string.h>
+#include <stdint.h>
+
+#define LZ_HASH_BITS 14
+
+// The last few bytes are always literals, and no match starts this close
+// to the end, so the decoder can copy 8 bytes at a time for most of the
+// block without running off the end of it
+#define LZ_LAST_LITERALS 5
+#define LZ_MATCH_START_LIMIT 12
+
+// Literal and match lengths of 15 continue in bytes of up to 255
+#define LZ_LENGTH_MASK 15
+
+// Every 32 misses in a row the search starts skipping ahead further, so
+// data that doesn't compress goes by quickly
+#define LZ_SKIP_SHIFT 5
+
+static inline uint32_t Load32(const unsigned char *data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static inline uint64_t Load64(const unsigned char *data)
+{
+	uint64_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static inline unsigned int Hash(uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static void WriteLength(std::vector<unsigned char> &output, size_t length)
+{
+	while (length >= 255)
+	{
+		output.push_back(255);
+		length -= 255;
+	}
+	output.push_back((unsigned char)length);
+}
+
+// A match length of 0 writes the final, literals only, sequence
+static void WriteSequence(std::vector<unsigned char> &output, const unsigned char *literals, size_t numLiterals, size_t matchLength, size_t offset)
+{
+	size_t literalCode = (numLiterals < LZ_LENGTH_MASK ? numLiterals : LZ_LENGTH_MASK);
+	size_t matchCode = 0;
+	if (matchLength > 0)
+		matchCode = (matchLength - LZ_MIN_MATCH < LZ_LENGTH_MASK ? matchLength - LZ_MIN_MATCH : LZ_LENGTH_MASK);
+
+	output.push_back((unsigned char)((literalCode << 4) | matchCode));
+	if (literalCode == LZ_LENGTH_MASK)
+		WriteLength(output, numLiterals - LZ_LENGTH_MASK);
+	output.insert(output.end(), literals, literals + numLiterals);
+
+	if (matchLength > 0)
+	{
+		output.push_back((unsigned char)offset);
+		output.push_back((unsigned char)(offset >> 8));
+		if (matchCode == LZ_LENGTH_MASK)
+			WriteLength(output, matchLength - LZ_MIN_MATCH - LZ_LENGTH_MASK);
+	}
+}
+
+void LzCompress(const unsigned char *data, size_t size, std::vector<unsigned char> &output)
+{
+	size_t anchor = 0;
+	if (size > LZ_MATCH_START_LIMIT)
+	{
+		// Positions are only candidates, every hit is checked against the
+		// data, so the table doesn't need an empty marker
+		std::vector<uint32_t> table(1 << LZ_HASH_BITS, 0);
+		const size_t matchStartLimit = size - LZ_MATCH_START_LIMIT;
+		const size_t matchEndLimit = size - LZ_LAST_LITERALS;
+
+		size_t position = 0;
+		unsigned int misses = 0;
+		while (position < matchStartLimit)
+		{
+			uint32_t sequence = Load32(data + position);
+			unsigned int hash = Hash(sequence);
+			size_t candidate = table[hash];
+			table[hash] = (uint32_t)position;
+
+			if (candidate >= position || position - candidate > LZ_MAX_OFFSET || Load32(data + candidate) != sequence)
+			{
+				position += 1 + (misses++ >> LZ_SKIP_SHIFT);
+				continue;
+			}
+
+			// Matches can often be stretched back over pending literals
+			while (position > anchor && candidate > 0 && data[position - 1] == data[candidate - 1])
+			{
+				--position;
+				--candidate;
+			}
+
+			size_t length = LZ_MIN_MATCH;
+			while (position + length + 8 <= matchEndLimit && Load64(data + position + length) == Load64(data + candidate + length))
+				length += 8;
+			while (position + length < matchEndLimit && data[position + length] == data[candidate + length])
+				++length;
+
+			WriteSequence(output, data + anchor, position - anchor, length, position - candidate);
+			position += length;
+			anchor = position;
+			misses = 0;
+
+			// Gives the bytes just before the next search a chance to match
+			if (position < matchStartLimit)
+				table[Hash(Load32(data + position - 2))] = (uint32_t)(position - 2);
+		}
+	}
+
+	WriteSequence(output, data + anchor, size - anchor, 0, 0);
+}
+
+static bool ReadLength(const unsigned char *&input, const unsigned char *end, size_t &length)
+{
+	unsigned char value;
+	do
+	{
+		if (input >= end)
+			return false;
+		value = *input++;
+		length += value;
+	} while (value == 255);
+	return true;
+}
+
+bool LzDecompress(const unsigned char *input, size_t inputSize, unsigned char *output, size_t outputSize)
+{
+	const unsigned char *end = input + inputSize;
+	unsigned char *current = output;
+	unsigned char *outputEnd = output + outputSize;
+
+	for (;;)
+	{
+		if (input >= end)
+			return false;
+		unsigned char token = *input++;
+
+		size_t numLiterals = token >> 4;
+		if (numLiterals == LZ_LENGTH_MASK && !ReadLength(input, end, numLiterals))
+			return false;
+		if ((size_t)(end - input) < numLiterals || (size_t)(outputEnd - current) < numLiterals)
+			return false;
+
+		// Copying whole words may write past the literals, which is fine
+		// as long as it stays inside both buffers
+		if ((size_t)(end - input) >= numLiterals + 8 && (size_t)(outputEnd - current) >= numLiterals + 8)
+		{
+			for (size_t i = 0; i < numLiterals; i += 8)
+				memcpy(current + i, input + i, 8);
+		}
+		else if (numLiterals > 0)
+			memcpy(current, input, numLiterals);
+		input += numLiterals;
+		current += numLiterals;
+
+		// Only the last sequence has no match
+		if (input == end)
+			break;
+
+		if (end - input < 2)
+			return false;
+		size_t offset = input[0] | (input[1] << 8);
+		input += 2;
+		if (offset == 0 || offset > (size_t)(current - output))
+			return false;
+
+		size_t length = token & LZ_LENGTH_MASK;
+		if (length == LZ_LENGTH_MASK && !ReadLength(input, end, length))
+			return false;
+		length += LZ_MIN_MATCH;
+		if ((size_t)(outputEnd - current) < length)
+			return false;
+
+		// Matches at least 8 bytes back can be copied a word at a time
+		// even when they overlap the bytes being written
+		const unsigned char *match = current - offset;
+		if (offset >= 8 && (size_t)(outputEnd - current) >= length + 8)
+		{
+			for (size_t i = 0; i < length; i += 8)
+				memcpy(current + i, match + i, 8);
+		}
+		else
+		{
+			for (size_t i = 0; i < length; ++i)
+				current[i] = match[i];
+		}
+		current += length;
+	}
+
+	return current == outputEnd;
+}
@@ -0,0 +1,37 @@
+#ifndef __CODEC_LZ_H_INCLUDED__
+#define __CODEC_LZ_H_INCLUDED__
+
+#include <stddef.h>
+#include <vector>
+
+// Matches can reach at most this far back
+#define LZ_MAX_OFFSET 65535
+
+// Shortest match worth coding
+#define LZ_MIN_MATCH 4
+
+/**
+ * Compresses a block in the LZ4 block layout. Each sequence is a token
+ * with 4 bit literal and match lengths (15 continues in following bytes),
+ * the literals, then a 2 byte offset. The block ends with a sequence of
+ * literals only. Matches are found greedily through a hash of the next 4
+ * bytes, which keeps compression fast enough to run on every chunk
+ * @param data bytes to compress
+ * @param size number of bytes
+ * @param output the compressed block is appended to this
+ */
+void LzCompress(const unsigned char *data, size_t size, std::vector<unsigned char> &output);
+
+/**
+ * Decompresses a block written by LzCompress
+ * @param input compressed block
+ * @param inputSize size of the compressed block
+ * @param output receives the original bytes
+ * @param outputSize size of the original data
+ *
+ * @return bool false if the block is malformed or doesn't decompress to
+ *              exactly outputSize bytes
+ */
+bool LzDecompress(const unsigned char *input, size_t inputSize, unsigned char *output, size_t outputSize);
+
+#endif
@@ -0,0 +1,517 @@
+#include "meshcodec.h"
+#include "entropy.h"
+
+#include <string.h>
+#include <stdint.h>
+
+// Code bytes of the index codec. The high nibble is the edge FIFO slot the
+// triangle was found through, or this value when no edge matched and all
+// 3 vertices follow in the extra stream
+#define INDEX_CODE_NO_EDGE 15
+
+// Low nibble, how the vertex completing a triangle was coded. Values in
+// between are vertex FIFO slots plus one
+#define VERTEX_CODE_NEXT 0
+#define VERTEX_CODE_EXPLICIT 15
+
+// Index streams: code per triangle, rotation per edge match, vertex codes
+// of unmatched triangles, varint deltas of explicit vertices
+#define INDEX_STREAM_CODES 0
+#define INDEX_STREAM_ROTATIONS 1
+#define INDEX_STREAM_EXTRA 2
+#define INDEX_STREAM_EXPLICIT 3
+#define INDEX_NUM_STREAMS 4
+
+static void WriteU32(std::vector<unsigned char> &output, uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+		output.push_back((unsigned char)(value >> (i * 8)));
+}
+
+static bool ReadU32(const unsigned char *&input, const unsigned char *end, uint32_t &value)
+{
+	if (end - input < 4)
+		return false;
+	value = (uint32_t)input[0] | ((uint32_t)input[1] << 8) | ((uint32_t)input[2] << 16) | ((uint32_t)input[3] << 24);
+	input += 4;
+	return true;
+}
+
+// Shared by the encoder and decoder, which make exactly the same updates
+// after every triangle
+struct IndexCoderState
+{
+	unsigned int edges[MESH_CODEC_EDGE_FIFO_SIZE][2];
+	unsigned int edgeOffset;
+	unsigned int vertices[MESH_CODEC_VERTEX_FIFO_SIZE];
+	unsigned int vertexOffset;
+	unsigned int next;
+	unsigned int last;
+
+	IndexCoderState()
+	{
+		memset(edges, 0, sizeof(edges));
+		memset(vertices, 0, sizeof(vertices));
+		edgeOffset = 0;
+		vertexOffset = 0;
+		next = 0;
+		last = 0;
+	}
+
+	// Slot 0 is the most recently pushed entry
+	const unsigned int* GetEdge(unsigned int slot)    { return edges[(edgeOffset - 1 - slot) & (MESH_CODEC_EDGE_FIFO_SIZE - 1)]; }
+	unsigned int GetVertex(unsigned int slot)         { return vertices[(vertexOffset - 1 - slot) & (MESH_CODEC_VERTEX_FIFO_SIZE - 1)]; }
+
+	void PushEdge(unsigned int a, unsigned int b)
+	{
+		edges[edgeOffset][0] = a;
+		edges[edgeOffset][1] = b;
+		edgeOffset = (edgeOffset + 1) & (MESH_CODEC_EDGE_FIFO_SIZE - 1);
+	}
+
+	// Vertices not coded through the FIFO are new to it, and usually new
+	// to the mesh as well
+	void AddVertex(unsigned int vertex)
+	{
+		vertices[vertexOffset] = vertex;
+		vertexOffset = (vertexOffset + 1) & (MESH_CODEC_VERTEX_FIFO_SIZE - 1);
+		if (vertex >= next && vertex != 0xffffffff)
+			next = vertex + 1;
+	}
+
+	// Edges are pushed reversed, which is how a neighbouring triangle with
+	// the same winding uses them
+	void PushTriangleEdges(unsigned int a, unsigned int b, unsigned int c)
+	{
+		PushEdge(b, a);
+		PushEdge(c, b);
+		PushEdge(a, c);
+	}
+};
+
+static unsigned int EncodeVertex(IndexCoderState &state, unsigned int vertex, std::vector<unsigned char> &explicitData)
+{
+	if (vertex == state.next)
+	{
+		state.AddVertex(vertex);
+		return VERTEX_CODE_NEXT;
+	}
+
+	for (unsigned int i = 0; i < VERTEX_CODE_EXPLICIT - 1; ++i)
+	{
+		if (state.GetVertex(i) == vertex)
+			return i + 1;
+	}
+
+	// Zigzag varint of the difference to the last explicit vertex
+	int32_t delta = (int32_t)(vertex - state.last);
+	uint32_t value = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+	while (value >= 0x80)
+	{
+		explicitData.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	explicitData.push_back((unsigned char)value);
+
+	state.last = vertex;
+	state.AddVertex(vertex);
+	return VERTEX_CODE_EXPLICIT;
+}
+
+static bool DecodeVertex(IndexCoderState &state, unsigned int code, const unsigned char *&explicitData, const unsigned char *explicitEnd, unsigned int &vertex)
+{
+	if (code == VERTEX_CODE_NEXT)
+		vertex = state.next;
+	else if (code == VERTEX_CODE_EXPLICIT)
+	{
+		uint32_t value = 0;
+		for (int shift = 0;; shift += 7)
+		{
+			if (explicitData >= explicitEnd || shift > 28)
+				return false;
+			unsigned char byte = *explicitData++;
+			value |= (uint32_t)(byte & 0x7f) << shift;
+			if (byte < 0x80)
+				break;
+		}
+		vertex = state.last + ((value >> 1) ^ (0 - (value & 1)));
+		state.last = vertex;
+	}
+	else
+	{
+		vertex = state.GetVertex(code - 1);
+		return true;
+	}
+
+	state.AddVertex(vertex);
+	return true;
+}
+
+void EncodeIndexBuffer(const unsigned int *indices, size_t count, std::vector<unsigned char> &output)
+{
+	std::vector<unsigned char> streams[INDEX_NUM_STREAMS];
+	IndexCoderState state;
+
+	for (size_t i = 0; i + 3 <= count; i += 3)
+	{
+		const unsigned int *triangle = indices + i;
+
+		unsigned int edge = INDEX_CODE_NO_EDGE;
+		unsigned int rotation = 0;
+		for (unsigned int j = 0; j < INDEX_CODE_NO_EDGE && edge == INDEX_CODE_NO_EDGE; ++j)
+		{
+			const unsigned int *fifoEdge = state.GetEdge(j);
+			for (unsigned int k = 0; k < 3; ++k)
+			{
+				if (triangle[k] == fifoEdge[0] && triangle[(k + 1) % 3] == fifoEdge[1])
+				{
+					edge = j;
+					rotation = k;
+					break;
+				}
+			}
+		}
+
+		if (edge != INDEX_CODE_NO_EDGE)
+		{
+			unsigned int a = triangle[rotation];
+			unsigned int b = triangle[(rotation + 1) % 3];
+			unsigned int c = triangle[(rotation + 2) % 3];
+			unsigned int code = EncodeVertex(state, c, streams[INDEX_STREAM_EXPLICIT]);
+			streams[INDEX_STREAM_CODES].push_back((unsigned char)((edge << 4) | code));
+			streams[INDEX_STREAM_ROTATIONS].push_back((unsigned char)rotation);
+
+			// The matched edge has been used up by this triangle
+			state.PushEdge(c, b);
+			state.PushEdge(a, c);
+		}
+		else
+		{
+			streams[INDEX_STREAM_CODES].push_back(INDEX_CODE_NO_EDGE << 4);
+			for (int k = 0; k < 3; ++k)
+				streams[INDEX_STREAM_EXTRA].push_back((unsigned char)EncodeVertex(state, triangle[k], streams[INDEX_STREAM_EXPLICIT]));
+			state.PushTriangleEdges(triangle[0], triangle[1], triangle[2]);
+		}
+	}
+
+	for (int i = 0; i < INDEX_NUM_STREAMS; ++i)
+	{
+		WriteU32(output, (uint32_t)streams[i].size());
+		EntropyEncode(streams[i].data(), streams[i].size(), output);
+	}
+}
+
+bool DecodeIndexBuffer(const unsigned char *&input, const unsigned char *end, unsigned int *indices, size_t count)
+{
+	if (count % 3 != 0)
+		return false;
+	size_t numTriangles = count / 3;
+
+	// Upper bounds of each stream's size, a varint is at most 5 bytes
+	const size_t maxSizes[INDEX_NUM_STREAMS] = { numTriangles, numTriangles, numTriangles * 3, numTriangles * 3 * 5 };
+
+	std::vector<unsigned char> streams[INDEX_NUM_STREAMS];
+	const unsigned char *current = input;
+	for (int i = 0; i < INDEX_NUM_STREAMS; ++i)
+	{
+		uint32_t size;
+		if (!ReadU32(current, end, size) || size > maxSizes[i])
+			return false;
+		streams[i].resize(size);
+		if (!EntropyDecode(current, end, streams[i].data(), size))
+			return false;
+	}
+	if (streams[INDEX_STREAM_CODES].size() != numTriangles)
+		return false;
+
+	const unsigned char *codes = streams[INDEX_STREAM_CODES].data();
+	const unsigned char *rotations = streams[INDEX_STREAM_ROTATIONS].data();
+	const unsigned char *rotationsEnd = rotations + streams[INDEX_STREAM_ROTATIONS].size();
+	const unsigned char *extra = streams[INDEX_STREAM_EXTRA].data();
+	const unsigned char *extraEnd = extra + streams[INDEX_STREAM_EXTRA].size();
+	const unsigned char *explicitData = streams[INDEX_STREAM_EXPLICIT].data();
+	const unsigned char *explicitEnd = explicitData + streams[INDEX_STREAM_EXPLICIT].size();
+
+	IndexCoderState state;
+	for (size_t i = 0; i < numTriangles; ++i)
+	{
+		unsigned int *triangle = indices + i * 3;
+		unsigned int edge = codes[i] >> 4;
+
+		if (edge != INDEX_CODE_NO_EDGE)
+		{
+			if (rotations >= rotationsEnd || *rotations > 2)
+				return false;
+			unsigned int rotation = *rotations++;
+
+			const unsigned int *fifoEdge = state.GetEdge(edge);
+			unsigned int a = fifoEdge[0];
+			unsigned int b = fifoEdge[1];
+			unsigned int c;
+			if (!DecodeVertex(state, codes[i] & 15, explicitData, explicitEnd, c))
+				return false;
+
+			triangle[rotation] = a;
+			triangle[(rotation + 1) % 3] = b;
+			triangle[(rotation + 2) % 3] = c;
+			state.PushEdge(c, b);
+			state.PushEdge(a, c);
+		}
+		else
+		{
+			if (extraEnd - extra < 3)
+				return false;
+			for (int k = 0; k < 3; ++k)
+			{
+				if (*extra > VERTEX_CODE_EXPLICIT || !DecodeVertex(state, *extra++, explicitData, explicitEnd, triangle[k]))
+					return false;
+			}
+			state.PushTriangleEdges(triangle[0], triangle[1], triangle[2]);
+		}
+	}
+
+	input = current;
+	return true;
+}
+
+static inline unsigned char ZigzagByte(unsigned char delta)
+{
+	return (unsigned char)((delta << 1) ^ ((signed char)delta >> 7));
+}
+
+static inline unsigned char UnzigzagByte(unsigned char value)
+{
+	return (unsigned char)((value >> 1) ^ (0 - (value & 1)));
+}
+
+void EncodeVertexBuffer(const unsigned char *data, size_t count, size_t stride, size_t distance, std::vector<unsigned char> &output)
+{
+	std::vector<unsigned char> planes(count * stride);
+	for (size_t k = 0; k < stride && count > 0; ++k)
+		planes[k * count] = ZigzagByte(data[k]);
+	for (size_t i = 1; i < count; ++i)
+	{
+		const unsigned char *element = data + i * stride;
+		const unsigned char *prediction = element - (i >= distance ? distance : 1) * stride;
+		for (size_t k = 0; k < stride; ++k)
+			planes[k * count + i] = ZigzagByte((unsigned char)(element[k] - prediction[k]));
+	}
+
+	for (size_t k = 0; k < stride; ++k)
+		EntropyEncode(planes.data() + k * count, count, output);
+}
+
+bool DecodeVertexBuffer(const unsigned char *&input, const unsigned char *end, unsigned char *data, size_t count, size_t stride, size_t distance)
+{
+	std::vector<unsigned char> planes(count * stride);
+	const unsigned char *current = input;
+	for (size_t k = 0; k < stride; ++k)
+	{
+		if (!EntropyDecode(current, end, planes.data() + k * count, count))
+			return false;
+	}
+
+	// Predicting from the previous element is a running sum down each
+	// plane, which can stay in a register
+	if (distance == 1)
+	{
+		for (size_t k = 0; k < stride; ++k)
+		{
+			const unsigned char *deltas = planes.data() + k * count;
+			unsigned char *element = data + k;
+			unsigned char value = 0;
+			for (size_t i = 0; i < count; ++i)
+			{
+				value += UnzigzagByte(deltas[i]);
+				element[i * stride] = value;
+			}
+		}
+
+		input = current;
+		return true;
+	}
+
+	if (count > 0)
+	{
+		for (size_t k = 0; k < stride; ++k)
+			data[k] = UnzigzagByte(planes[k * count]);
+	}
+	for (size_t i = 1; i < count; ++i)
+	{
+		unsigned char *element = data + i * stride;
+		const unsigned char *prediction = element - (i >= distance ? distance : 1) * stride;
+		const unsigned char *deltas = planes.data() + i;
+		for (size_t k = 0; k < stride; ++k)
+			element[k] = prediction[k] + UnzigzagByte(deltas[k * count]);
+	}
+
+	input = current;
+	return true;
+}
+
+static unsigned int GetIndexBytes(const MeshCodecLayout &layout)
+{
+	return layout.indexWidth * 3 * layout.numIndexStreams;
+}
+
+static bool IsValidLayout(const MeshCodecLayout &layout, size_t size)
+{
+	if (layout.indexWidth != 0 && layout.indexWidth != 2 && layout.indexWidth != 4 && layout.indexWidth != 8)
+		return false;
+	if (layout.numIndexStreams > MESH_CODEC_MAX_INDEX_STREAMS || (layout.indexWidth == 0) != (layout.numIndexStreams == 0))
+		return false;
+	if (layout.distance == 0 || layout.stride == 0 || GetIndexBytes(layout) > layout.stride)
+		return false;
+	return size >= layout.prefixSize && (size - layout.prefixSize) / layout.stride == layout.count && (size - layout.prefixSize) % layout.stride == 0;
+}
+
+// Indices are stored in whatever width the chunk uses, in the byte order
+// of the machine that wrote it
+static unsigned int LoadIndex(const unsigned char *data, unsigned int width, bool &fits)
+{
+	if (width == 2)
+	{
+		uint16_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+	if (width == 4)
+	{
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	uint64_t value;
+	memcpy(&value, data, sizeof(value));
+	if (value > 0xffffffff)
+		fits = false;
+	return (unsigned int)value;
+}
+
+static void StoreIndex(unsigned char *data, unsigned int width, unsigned int index)
+{
+	if (width == 2)
+	{
+		uint16_t value = (uint16_t)index;
+		memcpy(data, &value, sizeof(value));
+	}
+	else if (width == 4)
+	{
+		uint32_t value = index;
+		memcpy(data, &value, sizeof(value));
+	}
+	else
+	{
+		uint64_t value = index;
+		memcpy(data, &value, sizeof(value));
+	}
+}
+
+bool EncodeMeshChunk(const unsigned char *data, size_t size, const MeshCodecLayout &layout, std::vector<unsigned char> &output)
+{
+	if (!IsValidLayout(layout, size))
+		return false;
+
+	const unsigned char *records = data + layout.prefixSize;
+	unsigned int indexBytes = GetIndexBytes(layout);
+
+	std::vector<unsigned int> indexStreams[MESH_CODEC_MAX_INDEX_STREAMS];
+	bool fits = true;
+	for (unsigned int i = 0; i < layout.numIndexStreams; ++i)
+	{
+		indexStreams[i].resize((size_t)layout.count * 3);
+		for (size_t j = 0; j < layout.count; ++j)
+		{
+			for (int k = 0; k < 3; ++k)
+				indexStreams[i][j * 3 + k] = LoadIndex(records + j * layout.stride + (i * 3 + k) * layout.indexWidth, layout.indexWidth, fits);
+		}
+	}
+	if (!fits)
+		return false;
+
+	size_t start = output.size();
+	WriteU32(output, layout.prefixSize);
+	WriteU32(output, layout.count);
+	WriteU32(output, layout.stride);
+	WriteU32(output, layout.distance);
+	output.push_back((unsigned char)layout.indexWidth);
+	output.push_back((unsigned char)layout.numIndexStreams);
+	output.insert(output.end(), data, records);
+
+	for (unsigned int i = 0; i < layout.numIndexStreams; ++i)
+		EncodeIndexBuffer(indexStreams[i].data(), indexStreams[i].size(), output);
+
+	if (indexBytes == 0)
+		EncodeVertexBuffer(records, layout.count, layout.stride, layout.distance, output);
+	else if (indexBytes < layout.stride)
+	{
+		size_t remainder = layout.stride - indexBytes;
+		std::vector<unsigned char> rest(layout.count * remainder);
+		for (size_t j = 0; j < layout.count; ++j)
+			memcpy(&rest[j * remainder], records + j * layout.stride + indexBytes, remainder);
+		EncodeVertexBuffer(rest.data(), layout.count, remainder, layout.distance, output);
+	}
+
+	return output.size() > start;
+}
+
+bool DecodeMeshChunk(const unsigned char *input, size_t inputSize, unsigned char *output, size_t outputSize)
+{
+	const unsigned char *current = input;
+	const unsigned char *end = input + inputSize;
+
+	MeshCodecLayout layout;
+	uint32_t values[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		if (!ReadU32(current, end, values[i]))
+			return false;
+	}
+	if (end - current < 2)
+		return false;
+	layout.prefixSize = values[0];
+	layout.count = values[1];
+	layout.stride = values[2];
+	layout.distance = values[3];
+	layout.indexWidth = *current++;
+	layout.numIndexStreams = *current++;
+	if (!IsValidLayout(layout, outputSize) || (size_t)(end - current) < layout.prefixSize)
+		return false;
+
+	memcpy(output, current, layout.prefixSize);
+	current += layout.prefixSize;
+	unsigned char *records = output + layout.prefixSize;
+	unsigned int indexBytes = GetIndexBytes(layout);
+
+	std::vector<unsigned int> indices;
+	for (unsigned int i = 0; i < layout.numIndexStreams; ++i)
+	{
+		indices.resize((size_t)layout.count * 3);
+		if (!DecodeIndexBuffer(current, end, indices.data(), indices.size()))
+			return false;
+		for (size_t j = 0; j < layout.count; ++j)
+		{
+			for (int k = 0; k < 3; ++k)
+				StoreIndex(records + j * layout.stride + (i * 3 + k) * layout.indexWidth, layout.indexWidth, indices[j * 3 + k]);
+		}
+	}
+
+	// Plain vertex data decodes straight into place
+	if (indexBytes == 0)
+	{
+		if (!DecodeVertexBuffer(current, end, records, layout.count, layout.stride, layout.distance))
+			return false;
+	}
+	else if (indexBytes < layout.stride)
+	{
+		size_t remainder = layout.stride - indexBytes;
+		std::vector<unsigned char> rest(layout.count * remainder);
+		if (!DecodeVertexBuffer(current, end, rest.data(), layout.count, remainder, layout.distance))
+			return false;
+		for (size_t j = 0; j < layout.count; ++j)
+			memcpy(records + j * layout.stride + indexBytes, &rest[j * remainder], remainder);
+	}
+
+	return current == end;
+}
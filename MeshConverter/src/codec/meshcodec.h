@@ -0,0 +1,106 @@
+#ifndef __CODEC_MESHCODEC_H_INCLUDED__
+#define __CODEC_MESHCODEC_H_INCLUDED__
+
+#include <stddef.h>
+#include <vector>
+
+// Recently seen edges and vertices the index codec can refer back to
+#define MESH_CODEC_EDGE_FIFO_SIZE 16
+#define MESH_CODEC_VERTEX_FIFO_SIZE 16
+
+// Most index streams one chunk's records can hold (TRI has vertex, normal
+// and texcoord indices)
+#define MESH_CODEC_MAX_INDEX_STREAMS 3
+
+// How a chunk's bytes split into an untouched prefix followed by count
+// fixed size records. Records may start with triangle indices, 3 per index
+// stream, which go through the index codec. Whatever else is in a record
+// is delta coded against the record distance records back
+struct MeshCodecLayout
+{
+	unsigned int prefixSize;                     // Bytes stored as is before the first record
+	unsigned int count;                          // Number of records
+	unsigned int stride;                         // Bytes per record
+	unsigned int distance;                       // Records between a record and its prediction
+	unsigned int indexWidth;                     // Bytes per index (2, 4 or 8), 0 if records have no indices
+	unsigned int numIndexStreams;                // Number of index triples at the start of each record
+};
+
+/**
+ * Codes a triangle list. Each triangle is matched against a FIFO of
+ * recently seen edges, so usually only its third vertex is coded, as the
+ * next unused index, a slot in a FIFO of recent vertices, or an explicit
+ * delta. Triangle and corner order are kept exactly
+ * @param indices 3 indices per triangle
+ * @param count number of indices, a multiple of 3
+ * @param output the coded stream is appended to this
+ */
+void EncodeIndexBuffer(const unsigned int *indices, size_t count, std::vector<unsigned char> &output);
+
+/**
+ * Decodes a stream written by EncodeIndexBuffer
+ * @param input start of the coded stream, advanced past it on success
+ * @param end end of the available input
+ * @param indices receives count indices
+ * @param count number of indices that were coded
+ *
+ * @return bool false if the stream is malformed or truncated
+ */
+bool DecodeIndexBuffer(const unsigned char *&input, const unsigned char *end, unsigned int *indices, size_t count);
+
+/**
+ * Codes an array of fixed size elements. Each byte is replaced by its
+ * difference to the same byte of the element distance elements back (or
+ * the previous element for the first few), then the differences are
+ * transposed so byte k of every element forms one plane, and each plane
+ * is entropy coded
+ * @param data count * stride bytes
+ * @param count number of elements
+ * @param stride bytes per element
+ * @param distance elements between an element and its prediction, at
+ *                 least 1
+ * @param output the coded stream is appended to this
+ */
+void EncodeVertexBuffer(const unsigned char *data, size_t count, size_t stride, size_t distance, std::vector<unsigned char> &output);
+
+/**
+ * Decodes a stream written by EncodeVertexBuffer
+ * @param input start of the coded stream, advanced past it on success
+ * @param end end of the available input
+ * @param data receives count * stride bytes
+ * @param count number of elements
+ * @param stride bytes per element
+ * @param distance prediction distance the stream was coded with
+ *
+ * @return bool false if the stream is malformed or truncated
+ */
+bool DecodeVertexBuffer(const unsigned char *&input, const unsigned char *end, unsigned char *data, size_t count, size_t stride, size_t distance);
+
+/**
+ * Codes a whole chunk's data. The layout is stored along with the coded
+ * streams, so DecodeMeshChunk needs nothing but the output size. Fails
+ * if the layout doesn't add up to size, or if 8 byte indices don't fit
+ * in 32 bits
+ * @param data chunk data
+ * @param size size of the chunk data
+ * @param layout how the data splits into records
+ * @param output the coded chunk is appended to this
+ *
+ * @return bool whether the chunk could be coded with this layout
+ */
+bool EncodeMeshChunk(const unsigned char *data, size_t size, const MeshCodecLayout &layout, std::vector<unsigned char> &output);
+
+/**
+ * Decodes a chunk written by EncodeMeshChunk. Standalone, this is all a
+ * loader needs to get back the original chunk data
+ * @param input coded chunk
+ * @param inputSize size of the coded chunk
+ * @param output receives the chunk data
+ * @param outputSize size of the original chunk data
+ *
+ * @return bool false if the coded chunk is malformed or doesn't decode to
+ *              exactly outputSize bytes
+ */
+bool DecodeMeshChunk(const unsigned char *input, size_t inputSize, unsigned char *output, size_t outputSize);
+
+#endif
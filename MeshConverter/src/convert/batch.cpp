@@ -0,0 +1,340 @@
+#include "batch.h"
+#include "convert.h"
+#include "../util/files.h"
+#include "../util/parallel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+#define BYTES_PER_MEGABYTE (1024.0 * 1024.0)
+
+// Conversions timed per input and method by --batch=memory, the fastest
+// is reported
+#define BATCH_MEMORY_BENCHMARK_RUNS 5
+
+bool ParseBatchOption(const std::string &option, BatchOptions &options)
+{
+	if (option == "--batch")
+		options.enabled = true;
+	else if (option == "--batch=benchmark")
+	{
+		options.enabled = true;
+		options.benchmark = true;
+	}
+	else if (option == "--batch=memory")
+	{
+		options.enabled = true;
+		options.benchmarkMemory = true;
+	}
+	else if (option.compare(0, 7, "--jobs=") == 0)
+	{
+		int jobs = atoi(option.substr(7).c_str());
+		if (jobs < 1)
+			return false;
+		options.numJobs = (unsigned int)jobs;
+	}
+	else if (option.compare(0, 7, "--list=") == 0 && option.length() > 7)
+		options.listFiles.push_back(option.substr(7));
+	else if (option == "--cache")
+		options.cacheDirectory = CACHE_DEFAULT_DIRECTORY;
+	else if (option.compare(0, 8, "--cache=") == 0 && option.length() > 8)
+		options.cacheDirectory = option.substr(8);
+	else
+		return false;
+
+	return true;
+}
+
+void PrintBatchOptionUsage()
+{
+	printf("Batch options, used when given several inputs, a directory or a list:\n");
+	printf("  --list=file            Convert every file or directory named in file, one per line\n");
+	printf("  --jobs=count           Convert at most count files at once (default one per hardware thread)\n");
+	printf("  --batch[=mode]         Report per file even for a single input. benchmark mode converts\n");
+	printf("                         everything on 1, 2, 4... threads and compares the throughput,\n");
+	printf("                         memory mode compares converting files with converting in memory\n");
+	printf("  --cache[=directory]    Reuse earlier conversions of files whose contents, sidecar files\n");
+	printf("                         and options haven't changed (default %s, single files too)\n", CACHE_DEFAULT_DIRECTORY);
+}
+
+static void AddInput(const std::string &path, std::vector<std::string> &files)
+{
+	// Inputs found in directories have to be something that can be
+	// converted, which also keeps earlier .mesh output out of the batch
+	if (IsDirectory(path))
+	{
+		std::vector<std::string> found;
+		if (!ListFiles(path, true, found))
+			printf("Error reading directory %s.\n", path.c_str());
+		for (unsigned int i = 0; i < found.size(); ++i)
+		{
+			if (IsConvertibleFile(found[i]))
+				files.push_back(found[i]);
+		}
+	}
+	else
+		files.push_back(path);
+}
+
+static bool CompareInputs(const BatchInput &a, const BatchInput &b)
+{
+	if (a.size != b.size)
+		return a.size > b.size;
+	return a.file < b.file;
+}
+
+bool GatherBatchInputs(const std::vector<std::string> &paths, const std::vector<std::string> &listFiles, std::vector<BatchInput> &inputs)
+{
+	std::vector<std::string> files;
+	for (unsigned int i = 0; i < paths.size(); ++i)
+		AddInput(paths[i], files);
+
+	for (unsigned int i = 0; i < listFiles.size(); ++i)
+	{
+		std::ifstream list(listFiles[i].c_str());
+		if (list.fail())
+		{
+			printf("Error reading list file %s.\n", listFiles[i].c_str());
+			return false;
+		}
+
+		std::string line;
+		while (std::getline(list, line))
+		{
+			while (line.length() > 0 && (line[line.length() - 1] == '\r' || line[line.length() - 1] == ' ' || line[line.length() - 1] == '\t'))
+				line.erase(line.length() - 1);
+			if (line.length() == 0 || line[0] == '#')
+				continue;
+			AddInput(line, files);
+		}
+	}
+
+	std::sort(files.begin(), files.end());
+	files.erase(std::unique(files.begin(), files.end()), files.end());
+
+	// Starting the largest files first leaves the small ones to fill in
+	// around them at the end, instead of one big file running on its own
+	inputs.resize(files.size());
+	for (unsigned int i = 0; i < files.size(); ++i)
+	{
+		inputs[i].file = files[i];
+		if (!GetFileLength(files[i], inputs[i].size))
+			inputs[i].size = 0;
+	}
+	std::stable_sort(inputs.begin(), inputs.end(), CompareInputs);
+	return true;
+}
+
+static CacheStats SubtractStats(const CacheStats &after, const CacheStats &before)
+{
+	CacheStats stats;
+	stats.hits = after.hits - before.hits;
+	stats.misses = after.misses - before.misses;
+	stats.upToDate = after.upToDate - before.upToDate;
+	stats.stored = after.stored - before.stored;
+	stats.hashTime = after.hashTime - before.hashTime;
+	stats.savedTime = after.savedTime - before.savedTime;
+	return stats;
+}
+
+BatchResult ConvertBatch(const std::vector<BatchInput> &inputs, const ConvertOptions &options, unsigned int numThreads, ConversionCache *cache)
+{
+	BatchResult result;
+	result.numConverted = 0;
+	result.numFailed = 0;
+	result.numThreads = (numThreads > 0 ? numThreads : GetNumWorkerThreads());
+	result.numThreads = std::max(1u, std::min(result.numThreads, (unsigned int)inputs.size()));
+	result.bytes = 0;
+	result.busy = 0.0;
+	result.cached = (cache != NULL && cache->IsOpen());
+	for (unsigned int i = 0; i < inputs.size(); ++i)
+		result.bytes += inputs[i].size;
+
+	CacheStats before;
+	if (result.cached)
+		before = cache->GetStats();
+
+	std::mutex lock;
+	unsigned int numFinished = 0;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	ParallelForStealing((unsigned int)inputs.size(), result.numThreads, [&](unsigned int item)
+	{
+		const BatchInput &input = inputs[item];
+		std::chrono::high_resolution_clock::time_point fileStart = std::chrono::high_resolution_clock::now();
+		std::string meshFile = GetMeshFileName(input.file);
+		bool hit = false;
+		bool converted = false;
+		std::string error;
+
+		// A model that runs the converter out of memory fails on its own
+		// rather than taking the rest of the batch down with it
+		try
+		{
+			converted = (result.cached ? cache->Convert(input.file, meshFile, options, hit) : ConvertFileTo(input.file, meshFile, options));
+		}
+		catch (const std::exception &e)
+		{
+			error = e.what();
+		}
+		catch (...)
+		{
+			error = "unknown error";
+		}
+		if (error.length() > 0)
+			remove(meshFile.c_str());
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - fileStart).count();
+
+		std::lock_guard<std::mutex> guard(lock);
+		++numFinished;
+		result.busy += elapsed;
+		if (converted)
+		{
+			++result.numConverted;
+			printf("[%u/%u] %s %s -> %s (%.2f MB, %.2f ms)\n", numFinished, (unsigned int)inputs.size(), (hit ? "CACHED" : "OK    "), input.file.c_str(), meshFile.c_str(), input.size / BYTES_PER_MEGABYTE, elapsed);
+		}
+		else
+		{
+			++result.numFailed;
+			result.failed.push_back(input.file);
+			if (error.length() > 0)
+				printf("[%u/%u] FAILED %s: %s (%.2f ms)\n", numFinished, (unsigned int)inputs.size(), input.file.c_str(), error.c_str(), elapsed);
+			else
+				printf("[%u/%u] FAILED %s (%.2f ms)\n", numFinished, (unsigned int)inputs.size(), input.file.c_str(), elapsed);
+		}
+	});
+	result.elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	if (result.cached)
+		result.cache = SubtractStats(cache->GetStats(), before);
+
+	std::sort(result.failed.begin(), result.failed.end());
+	return result;
+}
+
+void PrintBatchSummary(const BatchResult &result)
+{
+	unsigned int numFiles = result.numConverted + result.numFailed;
+	double seconds = result.elapsed / 1000.0;
+	printf("Converted %u of %u files (%u failed) on %u thread%s in %.2f s: %.1f files/s, %.2f MB/s, %.2fx concurrency\n", result.numConverted, numFiles, result.numFailed, result.numThreads, (result.numThreads > 1 ? "s" : ""),
+		seconds, (seconds > 0.0 ? numFiles / seconds : 0.0), (seconds > 0.0 ? result.bytes / BYTES_PER_MEGABYTE / seconds : 0.0), (result.elapsed > 0.0 ? result.busy / result.elapsed : 0.0));
+	if (result.cached)
+	{
+		unsigned int numLookups = result.cache.hits + result.cache.misses;
+		printf("Cache: %u of %u hits (%.1f%%), %u already up to date, %u added, %.2f s hashing, %.2f s of conversion saved\n", result.cache.hits, numLookups, (numLookups > 0 ? result.cache.hits * 100.0 / numLookups : 0.0),
+			result.cache.upToDate, result.cache.stored, result.cache.hashTime / 1000.0, result.cache.savedTime / 1000.0);
+	}
+	for (unsigned int i = 0; i < result.failed.size(); ++i)
+		printf("Failed: %s\n", result.failed[i].c_str());
+}
+
+unsigned int BenchmarkBatch(const std::vector<BatchInput> &inputs, const ConvertOptions &options, ConversionCache *cache)
+{
+	std::vector<BatchResult> results;
+	unsigned int maxThreads = GetNumWorkerThreads();
+	for (unsigned int threads = 1; ; threads *= 2)
+	{
+		threads = std::min(threads, maxThreads);
+		results.push_back(ConvertBatch(inputs, options, threads, cache));
+		if (threads >= maxThreads)
+			break;
+	}
+
+	unsigned int numFailed = 0;
+	printf("Batch throughput over %u files (%.2f MB):\n", (unsigned int)inputs.size(), (results.size() > 0 ? results[0].bytes / BYTES_PER_MEGABYTE : 0.0));
+	for (unsigned int i = 0; i < results.size(); ++i)
+	{
+		double seconds = results[i].elapsed / 1000.0;
+		printf("  %u thread%s %.2f s, %.1f files/s, %.2f MB/s, %.2fx speedup, %u failed", results[i].numThreads, (results[i].numThreads > 1 ? "s" : ""), seconds,
+			(seconds > 0.0 ? inputs.size() / seconds : 0.0), (seconds > 0.0 ? results[i].bytes / BYTES_PER_MEGABYTE / seconds : 0.0), (results[i].elapsed > 0.0 ? results[0].elapsed / results[i].elapsed : 0.0), results[i].numFailed);
+		if (results[i].cached)
+			printf(", %u cache hits", results[i].cache.hits);
+		printf("\n");
+		numFailed = std::max(numFailed, results[i].numFailed);
+	}
+	return numFailed;
+}
+
+unsigned int BenchmarkInMemory(const std::vector<BatchInput> &inputs, const ConvertOptions &options)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	std::vector<double> fileTimes(inputs.size(), 0.0);
+	std::vector<double> memoryTimes(inputs.size(), 0.0);
+	std::vector<bool> converted(inputs.size(), false);
+	for (unsigned int i = 0; i < inputs.size(); ++i)
+	{
+		const std::string &file = inputs[i].file;
+		std::string meshFile = GetMeshFileName(file);
+
+		// The first conversion from memory reads the sidecar files and
+		// keeps them, every run after that is served from memory alone
+		std::vector<unsigned char> data;
+		if (!ReadFileContents(file, data))
+			continue;
+		unsigned int format = GetModelFormat(file, data.data(), data.size());
+		SidecarResolver fileSidecars = GetFileSidecarResolver(file, format);
+		std::map<std::string, std::vector<unsigned char> > sidecarData;
+		SidecarResolver memorySidecars = [&](unsigned int type, const std::string &name, std::vector<unsigned char> &contents)
+		{
+			std::string key = std::string(1, (char)('0' + type)) + name;
+			std::map<std::string, std::vector<unsigned char> >::const_iterator found = sidecarData.find(key);
+			if (found == sidecarData.end())
+			{
+				if (!fileSidecars(type, name, contents))
+					return false;
+				sidecarData[key] = contents;
+				return true;
+			}
+			contents = found->second;
+			return true;
+		};
+		std::vector<unsigned char> mesh;
+		if (!ConvertModel(data.data(), data.size(), format, options, memorySidecars, mesh))
+			continue;
+
+		bool failed = false;
+		for (unsigned int run = 0; run < BATCH_MEMORY_BENCHMARK_RUNS && !failed; ++run)
+		{
+			Clock::time_point start = Clock::now();
+			failed = !ConvertFileTo(file, meshFile, options);
+			double fileTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+			start = Clock::now();
+			failed = failed || !ConvertModel(data.data(), data.size(), format, options, memorySidecars, mesh);
+			double memoryTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+			fileTimes[i] = (run == 0 || fileTime < fileTimes[i] ? fileTime : fileTimes[i]);
+			memoryTimes[i] = (run == 0 || memoryTime < memoryTimes[i] ? memoryTime : memoryTimes[i]);
+		}
+		converted[i] = !failed;
+	}
+
+	unsigned int numFailed = 0;
+	double totalFile = 0.0;
+	double totalMemory = 0.0;
+	unsigned long long bytes = 0;
+	printf("Files against memory, fastest of %u runs:\n", BATCH_MEMORY_BENCHMARK_RUNS);
+	for (unsigned int i = 0; i < inputs.size(); ++i)
+	{
+		if (!converted[i])
+		{
+			++numFailed;
+			printf("  FAILED %s\n", inputs[i].file.c_str());
+			continue;
+		}
+		totalFile += fileTimes[i];
+		totalMemory += memoryTimes[i];
+		bytes += inputs[i].size;
+		printf("  %s (%.2f MB): file %.3f ms, memory %.3f ms, %.3f ms (%.1f%%) spent on files\n", inputs[i].file.c_str(), inputs[i].size / BYTES_PER_MEGABYTE,
+			fileTimes[i], memoryTimes[i], fileTimes[i] - memoryTimes[i], (fileTimes[i] > 0.0 ? (fileTimes[i] - memoryTimes[i]) * 100.0 / fileTimes[i] : 0.0));
+	}
+	printf("  Total %.2f MB: file %.2f ms, memory %.2f ms, %.2fx faster in memory, %u failed\n", bytes / BYTES_PER_MEGABYTE, totalFile, totalMemory,
+		(totalMemory > 0.0 ? totalFile / totalMemory : 0.0), numFailed);
+	return numFailed;
+}
@@ -0,0 +1,111 @@
+#ifndef __CONVERT_BATCH_H_INCLUDED__
+#define __CONVERT_BATCH_H_INCLUDED__
+
+#include <string>
+#include <vector>
+
+#include "options.h"
+#include "cache.h"
+
+// How a run over many files is set up, separate from the processing
+// applied to each of them
+struct BatchOptions
+{
+	bool enabled;                                // Report per file even for a single input
+	bool benchmark;
+	bool benchmarkMemory;                        // Compare converting from files with converting in memory
+	unsigned int numJobs;                        // Files converted at once, 0 for one per hardware thread
+	std::vector<std::string> listFiles;
+	std::string cacheDirectory;                  // Also used for a single file, empty for no cache
+
+	BatchOptions()
+	{
+		enabled = false;
+		benchmark = false;
+		benchmarkMemory = false;
+		numJobs = 0;
+	}
+};
+
+struct BatchInput
+{
+	std::string file;
+	unsigned long long size;                     // Bytes, 0 if the file couldn't be looked at
+};
+
+struct BatchResult
+{
+	unsigned int numConverted;
+	unsigned int numFailed;
+	unsigned int numThreads;
+	unsigned long long bytes;                    // Size of all inputs
+	double elapsed;                              // Milliseconds, wall clock
+	double busy;                                 // Milliseconds, summed over the files
+	bool cached;                                 // True if a cache was used, and cache holds its counts for this run
+	CacheStats cache;
+	std::vector<std::string> failed;
+};
+
+bool ParseBatchOption(const std::string &option, BatchOptions &options);
+void PrintBatchOptionUsage();
+
+/**
+ * Expands the inputs of a batch into the files to convert. Directories
+ * are searched recursively for files of a format that can be converted,
+ * list files name one input per line, which may itself be a directory.
+ * Blank lines and lines starting with '#' are skipped. Files named
+ * directly are kept whatever their extension, so a typo shows up as a
+ * failure rather than being left out quietly. The result holds every
+ * file once, largest first
+ * @param paths files and directories from the command line
+ * @param listFiles files listing more inputs
+ * @param inputs receives the files to convert
+ *
+ * @return bool false if a list file couldn't be read
+ */
+bool GatherBatchInputs(const std::vector<std::string> &paths, const std::vector<std::string> &listFiles, std::vector<BatchInput> &inputs);
+
+/**
+ * Converts every input on a pool of threads, one file per thread at a
+ * time in the order given, printing a status line as each one finishes
+ * @param inputs files to convert, largest first
+ * @param options processing applied to every file
+ * @param numThreads files converted at once, 0 for one per hardware thread
+ * @param cache cache to look conversions up in and add them to, or NULL
+ *
+ * @return BatchResult counts and timings
+ */
+BatchResult ConvertBatch(const std::vector<BatchInput> &inputs, const ConvertOptions &options, unsigned int numThreads, ConversionCache *cache = NULL);
+
+/**
+ * Prints the totals of a batch, how well the cache did if there was one,
+ * and the files that failed
+ * @param result what ConvertBatch returned
+ */
+void PrintBatchSummary(const BatchResult &result);
+
+/**
+ * Converts the inputs with 1, 2, 4... threads up to all of them and
+ * prints the throughput of each run. With a cache every run after the
+ * first is served from it, which measures how fast a warm cache is
+ * @param inputs files to convert, largest first
+ * @param options processing applied to every file
+ * @param cache cache to look conversions up in and add them to, or NULL
+ *
+ * @return unsigned int most files that failed in any one run
+ */
+unsigned int BenchmarkBatch(const std::vector<BatchInput> &inputs, const ConvertOptions &options, ConversionCache *cache = NULL);
+
+/**
+ * Times converting each input from its file to its MESH file, and
+ * converting the same model with ConvertModel once it and its sidecar
+ * files are already in memory, and prints the fastest run of each. The
+ * difference is what reading and writing files costs
+ * @param inputs files to convert
+ * @param options processing applied to every file
+ *
+ * @return unsigned int number of files that failed to convert
+ */
+unsigned int BenchmarkInMemory(const std::vector<BatchInput> &inputs, const ConvertOptions &options);
+
+#endif
@@ -0,0 +1,191 @@
+#include "cache.h"
+#include "convert.h"
+#include "../util/files.h"
+#include "../util/hash.h"
+
+#include <stdio.h>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Written in front of everything else that goes into a key, so keys
+// can't collide with hashes of anything else
+#define CACHE_KEY_TAG "MESH conversion"
+
+// Each entry is the MESH file and a line describing it
+#define CACHE_MESH_EXTENSION ".mesh"
+#define CACHE_INFO_EXTENSION ".info"
+
+static double GetElapsed(const std::chrono::high_resolution_clock::time_point &start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Name to write a file under before renaming it into place, different for
+// every writer so two of them never write to the same file
+static std::string GetTemporaryName(const std::string &file)
+{
+	Hasher hasher;
+	hasher.Update(file);
+	hasher.Update((uint64_t)std::hash<std::thread::id>()(std::this_thread::get_id()));
+	hasher.Update((uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count());
+	return file + ".tmp" + FormatHash(hasher.Digest());
+}
+
+static bool CopyIntoPlace(const std::string &source, const std::string &destination)
+{
+	std::string temporary = GetTemporaryName(destination);
+	if (CopyFileContents(source, temporary) && RenameFile(temporary, destination))
+		return true;
+
+	remove(temporary.c_str());
+	return false;
+}
+
+// The info line holds the hash and size of the MESH file, so a damaged or
+// partly deleted entry is noticed, and how long the conversion took
+static bool ReadEntry(const std::string &entry, uint64_t &hash, unsigned long long &size, double &elapsed)
+{
+	FILE *fp = fopen((entry + CACHE_INFO_EXTENSION).c_str(), "r");
+	if (fp == NULL)
+		return false;
+
+	unsigned long long storedHash;
+	bool valid = (fscanf(fp, "%llx %llu %lf", &storedHash, &size, &elapsed) == 3);
+	fclose(fp);
+	hash = storedHash;
+
+	unsigned long long meshSize;
+	return (valid && GetFileLength(entry + CACHE_MESH_EXTENSION, meshSize) && meshSize == size);
+}
+
+// The MESH file goes in before the info line, so an entry is never found
+// before it is complete
+static bool WriteEntry(const std::string &entry, const std::string &meshFile, double elapsed)
+{
+	uint64_t hash;
+	unsigned long long size;
+	if (!HashFile(meshFile, hash) || !GetFileLength(meshFile, size))
+		return false;
+	if (!CopyIntoPlace(meshFile, entry + CACHE_MESH_EXTENSION))
+		return false;
+
+	std::string info = GetTemporaryName(entry + CACHE_INFO_EXTENSION);
+	FILE *fp = fopen(info.c_str(), "w");
+	if (fp == NULL)
+		return false;
+	fprintf(fp, "%s %llu %.3f\n", FormatHash(hash).c_str(), size, elapsed);
+	if (fclose(fp) != 0 || !RenameFile(info, entry + CACHE_INFO_EXTENSION))
+	{
+		remove(info.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool ConversionCache::Open(const std::string &directory)
+{
+	m_directory = "";
+	if (directory.length() == 0 || !MakeDirectory(directory))
+		return false;
+
+	m_directory = directory;
+	if (m_directory[m_directory.length() - 1] != '/' && m_directory[m_directory.length() - 1] != '\\')
+		m_directory += '/';
+	return true;
+}
+
+bool ConversionCache::GetKey(const std::string &file, const ConvertOptions &options, uint64_t &key)
+{
+	Hasher hasher;
+	hasher.Update(std::string(CACHE_KEY_TAG));
+	hasher.Update((uint64_t)CONVERTER_VERSION);
+	hasher.Update(GetOptionKey(options));
+	hasher.Update(GetFileExtension(file));
+
+	uint64_t hash;
+	if (!HashFile(file, hash))
+		return false;
+	hasher.Update(hash);
+
+	// Sidecars are told apart by their position in the list rather than by
+	// name, so renaming a model along with its sidecars still hits
+	std::vector<std::string> sidecars;
+	if (!GetSidecarFiles(file, sidecars))
+		return false;
+	for (unsigned int i = 0; i < sidecars.size(); ++i)
+	{
+		unsigned long long size;
+		if (!GetFileLength(sidecars[i], size))
+		{
+			hasher.Update((uint64_t)0);
+			continue;
+		}
+		if (!HashFile(sidecars[i], hash))
+			return false;
+		hasher.Update((uint64_t)1);
+		hasher.Update(hash);
+	}
+
+	key = hasher.Digest();
+	return true;
+}
+
+bool ConversionCache::Convert(const std::string &file, const std::string &meshFile, const ConvertOptions &options, bool &hit, ObjMaterialCache *materialCache)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	hit = false;
+
+	// Anything that can't be keyed is converted as usual, which reports
+	// the problem if there is one
+	uint64_t key = 0;
+	bool keyed = (IsOpen() && IsConvertibleFile(file) && GetKey(file, options, key));
+	double hashTime = GetElapsed(start);
+	std::string entry = m_directory + FormatHash(key);
+
+	uint64_t hash;
+	unsigned long long size;
+	double elapsed;
+	if (keyed && ReadEntry(entry, hash, size, elapsed))
+	{
+		uint64_t existingHash;
+		unsigned long long existingSize;
+		bool upToDate = (GetFileLength(meshFile, existingSize) && existingSize == size && HashFile(meshFile, existingHash) && existingHash == hash);
+		if (upToDate || CopyIntoPlace(entry + CACHE_MESH_EXTENSION, meshFile))
+		{
+			printf("Using cached conversion %s%s.\n", FormatHash(key).c_str(), (upToDate ? ", output is up to date" : ""));
+			hit = true;
+
+			double served = GetElapsed(start);
+			std::lock_guard<std::mutex> guard(m_lock);
+			++m_stats.hits;
+			if (upToDate)
+				++m_stats.upToDate;
+			m_stats.hashTime += hashTime;
+			m_stats.savedTime += elapsed - served;
+			return true;
+		}
+	}
+
+	std::chrono::high_resolution_clock::time_point convertStart = std::chrono::high_resolution_clock::now();
+	bool converted = ConvertFileTo(file, meshFile, options, materialCache);
+	elapsed = GetElapsed(convertStart);
+
+	bool stored = (converted && keyed && WriteEntry(entry, meshFile, elapsed));
+	if (converted && keyed && !stored)
+		printf("Error adding %s to the cache.\n", meshFile.c_str());
+
+	std::lock_guard<std::mutex> guard(m_lock);
+	++m_stats.misses;
+	if (stored)
+		++m_stats.stored;
+	m_stats.hashTime += hashTime;
+	return converted;
+}
+
+CacheStats ConversionCache::GetStats()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_stats;
+}
@@ -0,0 +1,96 @@
+#ifndef __CONVERT_CACHE_H_INCLUDED__
+#define __CONVERT_CACHE_H_INCLUDED__
+
+#include <stdint.h>
+#include <string>
+#include <mutex>
+
+#include "options.h"
+
+class ObjMaterialCache;
+
+// Used by --cache when no directory is given, relative to where the
+// converter runs
+#define CACHE_DEFAULT_DIRECTORY ".meshcache"
+
+struct CacheStats
+{
+	unsigned int hits;
+	unsigned int misses;
+	unsigned int upToDate;                       // Hits whose output already matched, so nothing was copied
+	unsigned int stored;                         // Misses whose output was added to the cache
+	double hashTime;                             // Milliseconds spent hashing inputs to look them up
+	double savedTime;                            // Milliseconds the hits took to convert, less the time taken to serve them
+
+	CacheStats()
+	{
+		hits = 0;
+		misses = 0;
+		upToDate = 0;
+		stored = 0;
+		hashTime = 0.0;
+		savedTime = 0.0;
+	}
+};
+
+/**
+ * Persistent cache of converted MESH files. Each conversion is keyed on
+ * an XXH64 hash of the model's contents, the contents of every sidecar
+ * file its converter reads, CONVERTER_VERSION and the options, so an
+ * entry is only used when converting again would write the same file.
+ * Names and timestamps don't come into it, so touched or moved files
+ * still hit. Entries are written under a temporary name and renamed
+ * into place, so several threads or processes can share one directory
+ */
+class ConversionCache
+{
+public:
+	ConversionCache()                                      {}
+
+	/**
+	 * @param directory where entries are kept, created if it doesn't exist
+	 *
+	 * @return bool false if the directory couldn't be created
+	 */
+	bool Open(const std::string &directory);
+	bool IsOpen() const                                    { return m_directory.length() > 0; }
+	const std::string& GetDirectory() const                { return m_directory; }
+
+	/**
+	 * Does what ConvertFileTo does, unless an entry for the same inputs
+	 * exists. Then the output is left alone if it already holds the
+	 * entry, or the entry is copied over it. Conversions that succeed
+	 * are added to the cache
+	 * @param file model to convert
+	 * @param meshFile MESH file to write
+	 * @param options processing to apply
+	 * @param hit receives true if the output came from the cache
+	 * @param materialCache where OBJ material libraries are kept between
+	 *                      conversions, or NULL to read them every time
+	 *
+	 * @return bool false if the file couldn't be converted
+	 */
+	bool Convert(const std::string &file, const std::string &meshFile, const ConvertOptions &options, bool &hit, ObjMaterialCache *materialCache = NULL);
+
+	/**
+	 * @param file model file
+	 * @param options processing to apply
+	 * @param key receives the key a conversion of the file is cached under
+	 *
+	 * @return bool false if the model or a sidecar that exists couldn't
+	 *              be read
+	 */
+	static bool GetKey(const std::string &file, const ConvertOptions &options, uint64_t &key);
+
+	CacheStats GetStats();
+
+private:
+	ConversionCache(const ConversionCache &);
+	ConversionCache& operator=(const ConversionCache &);
+
+	std::string m_directory;
+	std::mutex m_lock;                           // Guards m_stats
+	CacheStats m_stats;
+};
+
+#endif
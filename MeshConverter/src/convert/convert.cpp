@@ -0,0 +1,131 @@
+#include "convert.h"
+
+#include <stdio.h>
+#include <ctype.h>
+
+#include "../util/files.h"
+#include "../util/profiler.h"
+
+std::string GetFileExtension(const std::string &file)
+{
+	size_t dot = file.find_last_of('.');
+	size_t slash = file.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return "";
+
+	std::string extension = file.substr(dot);
+	for (unsigned int i = 0; i < extension.size(); ++i)
+		extension[i] = (char)tolower(extension[i]);
+	return extension;
+}
+
+unsigned int GetModelFormat(const std::string &file)
+{
+	std::vector<unsigned char> header;
+	if (!ReadFileHeader(file, MODEL_FORMAT_PROBE_SIZE, header))
+		return MODEL_FORMAT_UNKNOWN;
+	return GetModelFormat(file, header.data(), header.size());
+}
+
+unsigned int GetModelFormat(const std::string &file, const void *data, size_t size)
+{
+	unsigned int format = DetectModelFormat(data, size);
+	if (format == MODEL_FORMAT_UNKNOWN)
+		format = GetModelFormatByExtension(GetFileExtension(file));
+	return format;
+}
+
+bool IsConvertibleFile(const std::string &file)
+{
+	std::string extension = GetFileExtension(file);
+	if (extension.length() == 0)
+		return (GetModelFormat(file) != MODEL_FORMAT_UNKNOWN);
+	return (GetModelFormatByExtension(extension) != MODEL_FORMAT_UNKNOWN);
+}
+
+std::string GetMeshFileName(const std::string &file)
+{
+	std::string meshFile = file;
+	if (GetFileExtension(file).length() > 0)
+		meshFile.erase(meshFile.find_last_of('.'), std::string::npos);
+	meshFile.append(".mesh");
+	return meshFile;
+}
+
+bool GetSidecarFiles(const std::string &file, std::vector<std::string> &sidecars)
+{
+	sidecars.clear();
+	const ModelFormat *format = FindModelFormat(GetModelFormat(file));
+	if (format == NULL)
+		return true;
+
+	if (format->findMaterialLibrary != NULL)
+	{
+		std::string library;
+		if (!format->findMaterialLibrary(file, library))
+			return false;
+		if (library.length() > 0)
+			sidecars.push_back(library);
+	}
+	if (format->getAnimationFile != NULL)
+		sidecars.push_back(format->getAnimationFile(file));
+
+	return true;
+}
+
+SidecarResolver GetFileSidecarResolver(const std::string &file, unsigned int format)
+{
+	// Material libraries are named relative to the model's directory
+	std::string path;
+	if (file.find_last_of('/') != std::string::npos)
+		path = file.substr(0, file.find_last_of('/') + 1);
+
+	std::string animations;
+	const ModelFormat *modelFormat = FindModelFormat(format);
+	if (modelFormat != NULL && modelFormat->getAnimationFile != NULL)
+		animations = modelFormat->getAnimationFile(file);
+
+	return [path, animations](unsigned int type, const std::string &name, std::vector<unsigned char> &data)
+	{
+		if (type == SIDECAR_MATERIAL_LIBRARY)
+			return ReadFileContents(path + name, data);
+		else if (type == SIDECAR_ANIMATIONS && animations.length() > 0)
+			return ReadFileContents(animations, data);
+		return false;
+	};
+}
+
+bool ConvertFile(const std::string &file, const ConvertOptions &options, std::string &meshFile)
+{
+	meshFile = GetMeshFileName(file);
+	return ConvertFileTo(file, meshFile, options);
+}
+
+bool ConvertFileTo(const std::string &file, const std::string &meshFile, const ConvertOptions &options, ObjMaterialCache *materialCache)
+{
+	ProfileFileScope profile(file);
+
+	std::vector<unsigned char> data;
+	bool read;
+	{
+		ProfileScope scope(PROFILE_STAGE_READ);
+		read = ReadFileContents(file, data);
+	}
+	ProfileCount(PROFILE_STAGE_READ, PROFILE_COUNTER_BYTES_READ, data.size());
+	if (!read)
+	{
+		printf("Error reading %s.\n\n", file.c_str());
+		return false;
+	}
+
+	unsigned int format = GetModelFormat(file, data.data(), data.size());
+	if (format == MODEL_FORMAT_UNKNOWN)
+	{
+		printf("Unrecognized file type.\n\n");
+		return false;
+	}
+
+	bool converted = ConvertModelToFile(data.data(), data.size(), format, options, GetFileSidecarResolver(file, format), meshFile, materialCache);
+	profile.SetConverted(converted);
+	return converted;
+}
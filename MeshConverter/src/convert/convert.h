@@ -0,0 +1,115 @@
+#ifndef __CONVERT_CONVERT_H_INCLUDED__
+#define __CONVERT_CONVERT_H_INCLUDED__
+
+#include <string>
+#include <vector>
+
+#include "options.h"
+#include "library.h"
+
+// Identifies what the converters write for a given input and set of
+// options. Bump it whenever a change alters the output, so results
+// cached by older builds aren't handed out again
+#define CONVERTER_VERSION 1
+
+/**
+ * @param file path to a file
+ *
+ * @return std::string the file's extension in lower case, including the
+ *                     '.', or an empty string if it has none
+ */
+std::string GetFileExtension(const std::string &file);
+
+/**
+ * Works out a model file's format from its first bytes, so files with a
+ * missing or wrong extension are still converted with the right
+ * converter. Only the header is read. Files that no format's probe
+ * recognizes go by their extension
+ * @param file path to a model file
+ *
+ * @return unsigned int the MODEL_FORMAT_* value, MODEL_FORMAT_UNKNOWN if
+ *                      the file can't be read or isn't one that can be
+ *                      converted
+ */
+unsigned int GetModelFormat(const std::string &file);
+
+/**
+ * Does what GetModelFormat does for a model that has already been read
+ * @param file path to the model file, for its extension
+ * @param data contents of the model, or just its first bytes
+ * @param size size of data in bytes
+ *
+ * @return unsigned int the MODEL_FORMAT_* value, MODEL_FORMAT_UNKNOWN if
+ *                      it isn't one that can be converted
+ */
+unsigned int GetModelFormat(const std::string &file, const void *data, size_t size);
+
+/**
+ * Tells whether a file found in a directory should be converted. Files
+ * with the extension of a format are, without being opened. Files with
+ * no extension, such as blobs from a content store, are if their header
+ * is that of a format. Anything else isn't, which keeps MESH files and
+ * sidecars out
+ * @param file path to a file
+ *
+ * @return bool true if file is a model ConvertFile knows how to convert
+ */
+bool IsConvertibleFile(const std::string &file);
+
+/**
+ * @param file model file
+ *
+ * @return std::string the MESH file ConvertFile writes for it, the same
+ *                     name with a .mesh extension in place of its own, or
+ *                     added if it has none
+ */
+std::string GetMeshFileName(const std::string &file);
+
+/**
+ * Lists the files besides the model itself that its converter reads: the
+ * material library of an OBJ file and the animation definitions of MD2
+ * and MS3D models. Files are listed whether they exist or not, since one
+ * appearing changes the output as much as one changing
+ * @param file model file
+ * @param sidecars receives the paths of the other files
+ *
+ * @return bool false if the model had to be read to find them and
+ *              couldn't be
+ */
+bool GetSidecarFiles(const std::string &file, std::vector<std::string> &sidecars);
+
+/**
+ * @param file model file
+ * @param format the model's MODEL_FORMAT_* value
+ *
+ * @return SidecarResolver reads the files a model asks for from beside
+ *                         the model file, the ones GetSidecarFiles lists
+ */
+SidecarResolver GetFileSidecarResolver(const std::string &file, unsigned int format);
+
+/**
+ * Picks a converter from the file's header, reads the model and
+ * converts it with ConvertModelToFile into a MESH file with the same name
+ * and a .mesh extension. Everything the converters need lives in their
+ * own objects, so several files can be converted at the same time
+ * @param file model to convert
+ * @param options processing to apply
+ * @param meshFile receives the name of the MESH file written
+ *
+ * @return bool false if the file couldn't be loaded or written
+ */
+bool ConvertFile(const std::string &file, const ConvertOptions &options, std::string &meshFile);
+
+/**
+ * Does what ConvertFile does, writing to the given MESH file instead
+ * @param file model to convert
+ * @param meshFile MESH file to write
+ * @param options processing to apply
+ * @param materialCache where OBJ material libraries are kept between
+ *                      conversions, or NULL to read them every time
+ *
+ * @return bool false if the file couldn't be loaded or written
+ */
+bool ConvertFileTo(const std::string &file, const std::string &meshFile, const ConvertOptions &options, ObjMaterialCache *materialCache = NULL);
+
+#endif
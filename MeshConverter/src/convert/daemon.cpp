@@ -0,0 +1,554 @@
+#include "daemon.h"
+#include "convert.h"
+#include "options.h"
+#include "../obj/materialcache.h"
+#include "../util/files.h"
+#include "../util/parallel.h"
+#include "../util/socket.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char **environ;
+#endif
+
+// Milliseconds between checks for a shutdown while waiting on sockets
+#define DAEMON_POLL_INTERVAL 250
+
+static volatile sig_atomic_t s_interrupted = 0;
+
+static void OnInterrupt(int)
+{
+	s_interrupted = 1;
+}
+
+struct DaemonState
+{
+	ConversionCache *cache;                      // NULL when not caching
+	ObjMaterialCache materials;
+	std::atomic<bool> stopping;
+	std::mutex lock;                             // Guards everything below, and stopping being set
+	std::condition_variable waiting;
+	std::deque<LocalSocket*> pending;            // Connections with a request, waiting for a worker
+	std::vector<LocalSocket*> served;            // Connections whose request is done, to wait on again
+	LocalSocket wake;                            // Sent a line when a connection is served, to stop the wait
+	std::set<std::string> writing;               // MESH files being written
+	std::condition_variable written;
+	unsigned int numRequests;
+	unsigned int numFailed;
+	unsigned int numCached;
+	double busy;                                 // Milliseconds spent converting
+};
+
+bool ParseDaemonOption(const std::string &option, DaemonOptions &options)
+{
+	if (option == "--serve")
+		options.serve = true;
+	else if (option.compare(0, 8, "--serve=") == 0 && option.length() > 8)
+	{
+		options.serve = true;
+		options.socketPath = option.substr(8);
+	}
+	else if (option == "--connect")
+		options.connect = true;
+	else if (option.compare(0, 10, "--connect=") == 0 && option.length() > 10)
+	{
+		options.connect = true;
+		options.socketPath = option.substr(10);
+	}
+	else if (option == "--shutdown")
+		options.shutdown = true;
+	else if (option.compare(0, 11, "--shutdown=") == 0 && option.length() > 11)
+	{
+		options.shutdown = true;
+		options.socketPath = option.substr(11);
+	}
+	else if (option.compare(0, 10, "--workers=") == 0)
+	{
+		int workers = atoi(option.substr(10).c_str());
+		if (workers < 1)
+			return false;
+		options.numWorkers = (unsigned int)workers;
+	}
+	else if (option == "--latency")
+		options.latencyRuns = DAEMON_DEFAULT_LATENCY_RUNS;
+	else if (option.compare(0, 10, "--latency=") == 0)
+	{
+		int runs = atoi(option.substr(10).c_str());
+		if (runs < 1)
+			return false;
+		options.latencyRuns = (unsigned int)runs;
+	}
+	else
+		return false;
+
+	return true;
+}
+
+void PrintDaemonOptionUsage()
+{
+	printf("Daemon options, for converting without starting a new process each time:\n");
+	printf("  --serve[=socket]       Serve conversion requests on a Unix domain socket until shut down\n");
+	printf("                         (default %s). --cache applies to every request\n", DAEMON_DEFAULT_SOCKET);
+	printf("  --workers=count        Serve at most count requests at once (default one per hardware thread)\n");
+	printf("  --connect[=socket]     Have the daemon on socket convert the given files\n");
+	printf("  --latency[=runs]       With --connect, time converting the first file in a new process, through\n");
+	printf("                         a client process and straight over the socket (default %d runs)\n", DAEMON_DEFAULT_LATENCY_RUNS);
+	printf("  --shutdown[=socket]    Ask the daemon on socket to finish its requests and exit\n");
+}
+
+static void SplitFields(const std::string &line, std::vector<std::string> &fields)
+{
+	fields.clear();
+	size_t start = 0;
+	while (true)
+	{
+		size_t end = line.find('\t', start);
+		fields.push_back(line.substr(start, end == std::string::npos ? std::string::npos : end - start));
+		if (end == std::string::npos)
+			break;
+		start = end + 1;
+	}
+}
+
+static double GetElapsed(const std::chrono::high_resolution_clock::time_point &start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static void StopDaemon(DaemonState &state)
+{
+	{
+		std::lock_guard<std::mutex> guard(state.lock);
+		state.stopping = true;
+	}
+	state.waiting.notify_all();
+}
+
+static std::string HandleRequest(DaemonState &state, const std::string &line)
+{
+	std::vector<std::string> fields;
+	SplitFields(line, fields);
+
+	char buffer[256];
+	if (fields[0] == DAEMON_REQUEST_SHUTDOWN)
+	{
+		StopDaemon(state);
+		return DAEMON_REPLY_OK;
+	}
+	if (fields[0] == DAEMON_REQUEST_STATS)
+	{
+		std::lock_guard<std::mutex> guard(state.lock);
+		snprintf(buffer, sizeof(buffer), "%s\trequests=%u\tfailed=%u\tcached=%u\tbusy=%.3f\tmaterialsRead=%u\tmaterialsReused=%u", DAEMON_REPLY_OK,
+			state.numRequests, state.numFailed, state.numCached, state.busy, state.materials.GetNumMisses(), state.materials.GetNumHits());
+		return buffer;
+	}
+	if (fields[0] != DAEMON_REQUEST_CONVERT || fields.size() < 3)
+		return std::string(DAEMON_REPLY_FAILED) + "\t0.000\tUnrecognized request";
+
+	ConvertOptions options;
+	for (unsigned int i = 3; i < fields.size(); ++i)
+	{
+		if (!ParseOption(fields[i], options))
+			return std::string(DAEMON_REPLY_FAILED) + "\t0.000\tUnrecognized option " + fields[i];
+	}
+
+	const std::string &file = fields[1];
+	std::string meshFile = (fields[2].length() > 0 ? fields[2] : GetMeshFileName(file));
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	// Two saves in a row can ask for the same file twice at once, and
+	// writing it from both would mix up the output, so the second waits
+	{
+		std::unique_lock<std::mutex> guard(state.lock);
+		state.written.wait(guard, [&state, &meshFile]() { return state.writing.count(meshFile) == 0; });
+		state.writing.insert(meshFile);
+	}
+
+	// A model that runs the converter out of memory fails its own request
+	// and leaves no partial MESH file, the file is still released below
+	bool hit = false;
+	bool converted = false;
+	std::string error;
+	try
+	{
+		converted = (state.cache != NULL ? state.cache->Convert(file, meshFile, options, hit, &state.materials) : ConvertFileTo(file, meshFile, options, &state.materials));
+	}
+	catch (const std::exception &e)
+	{
+		error = std::string(": ") + e.what();
+		remove(meshFile.c_str());
+	}
+	catch (...)
+	{
+		error = ": unknown error";
+		remove(meshFile.c_str());
+	}
+	double elapsed = GetElapsed(start);
+
+	{
+		std::lock_guard<std::mutex> guard(state.lock);
+		state.writing.erase(meshFile);
+		++state.numRequests;
+		if (!converted)
+			++state.numFailed;
+		if (hit)
+			++state.numCached;
+		state.busy += elapsed;
+	}
+	state.written.notify_all();
+
+	snprintf(buffer, sizeof(buffer), "\t%.3f\t", elapsed);
+	if (!converted)
+		return DAEMON_REPLY_FAILED + std::string(buffer) + "Error converting " + file + error;
+	return DAEMON_REPLY_OK + std::string(buffer) + meshFile + (hit ? "\tCACHED" : "\tCONVERTED");
+}
+
+// Workers serve a single request at a time and hand the connection back
+// to be waited on with the rest, so clients that stay connected between
+// requests don't hold on to a worker
+static void ServeConnections(DaemonState &state, bool pool)
+{
+	// The workers already keep every core busy, the passes of each
+	// conversion run on the worker itself
+	if (pool)
+		MarkPoolThread();
+
+	while (true)
+	{
+		LocalSocket *client;
+		{
+			std::unique_lock<std::mutex> guard(state.lock);
+			state.waiting.wait(guard, [&state]() { return state.stopping || state.pending.size() > 0; });
+			if (state.stopping)
+				break;
+			client = state.pending.front();
+			state.pending.pop_front();
+		}
+
+		// Whatever else goes wrong with a request is reported to its client
+		// rather than ending the daemon
+		std::string line;
+		std::string reply;
+		bool received = client->ReceiveLine(line);
+		if (received)
+		{
+			try
+			{
+				reply = HandleRequest(state, line);
+			}
+			catch (const std::exception &e)
+			{
+				reply = std::string(DAEMON_REPLY_FAILED) + "\t0.000\t" + e.what();
+			}
+			catch (...)
+			{
+				reply = std::string(DAEMON_REPLY_FAILED) + "\t0.000\tUnknown error";
+			}
+		}
+		if (!received || !client->SendLine(reply))
+		{
+			delete client;
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(state.lock);
+			state.served.push_back(client);
+		}
+		state.wake.SendLine("");
+	}
+}
+
+int RunDaemon(const DaemonOptions &options, ConversionCache *cache)
+{
+	LocalSocket listener;
+	if (!listener.Listen(options.socketPath))
+	{
+		printf("Error listening on %s, another daemon may be using it.\n\n", options.socketPath.c_str());
+		return 1;
+	}
+
+	signal(SIGINT, OnInterrupt);
+	signal(SIGTERM, OnInterrupt);
+#ifdef SIGPIPE
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	DaemonState state;
+	LocalSocket woken;
+	if (!state.wake.CreatePair(woken))
+	{
+		printf("Error creating a socket pair.\n\n");
+		return 1;
+	}
+	state.cache = (cache != NULL && cache->IsOpen() ? cache : NULL);
+	state.stopping = false;
+	state.numRequests = 0;
+	state.numFailed = 0;
+	state.numCached = 0;
+	state.busy = 0.0;
+
+	unsigned int numWorkers = (options.numWorkers > 0 ? options.numWorkers : GetNumWorkerThreads());
+	std::vector<std::thread> workers;
+	for (unsigned int i = 0; i < numWorkers; ++i)
+		workers.push_back(std::thread(ServeConnections, std::ref(state), numWorkers > 1));
+
+	printf("Listening on %s with %u worker%s", options.socketPath.c_str(), numWorkers, (numWorkers > 1 ? "s" : ""));
+	if (state.cache != NULL)
+		printf(", caching in %s", state.cache->GetDirectory().c_str());
+	printf(".\n");
+	fflush(stdout);
+
+	// Connections between requests are waited on here, together with the
+	// listener for new ones, and each that sends a request is queued for
+	// the next free worker
+	std::vector<LocalSocket*> idle;
+	std::vector<LocalSocket*> sockets;
+	std::vector<LocalSocket*> ready;
+	std::string line;
+	while (!state.stopping && !s_interrupted)
+	{
+		{
+			std::lock_guard<std::mutex> guard(state.lock);
+			idle.insert(idle.end(), state.served.begin(), state.served.end());
+			state.served.clear();
+		}
+
+		sockets.assign(1, &listener);
+		sockets.push_back(&woken);
+		sockets.insert(sockets.end(), idle.begin(), idle.end());
+		if (!LocalSocket::WaitForAny(sockets, DAEMON_POLL_INTERVAL, ready))
+			continue;
+
+		for (unsigned int i = 0; i < ready.size(); ++i)
+		{
+			if (ready[i] == &listener)
+			{
+				LocalSocket *client = new LocalSocket();
+				if (listener.Accept(*client, 0))
+					idle.push_back(client);
+				else
+					delete client;
+			}
+			else if (ready[i] == &woken)
+				woken.ReceiveLine(line);
+			else
+			{
+				idle.erase(std::find(idle.begin(), idle.end(), ready[i]));
+				{
+					std::lock_guard<std::mutex> guard(state.lock);
+					state.pending.push_back(ready[i]);
+				}
+				state.waiting.notify_one();
+			}
+		}
+	}
+
+	// Conversions already running are finished, connections still waiting
+	// for a worker or a request are dropped
+	StopDaemon(state);
+	listener.Close();
+	for (unsigned int i = 0; i < workers.size(); ++i)
+		workers[i].join();
+	for (unsigned int i = 0; i < state.pending.size(); ++i)
+		delete state.pending[i];
+	for (unsigned int i = 0; i < state.served.size(); ++i)
+		delete state.served[i];
+	for (unsigned int i = 0; i < idle.size(); ++i)
+		delete idle[i];
+
+	printf("Served %u requests (%u failed, %u from the cache) in %.2f s of conversion, read %u material libraries and reused them %u times.\n", state.numRequests, state.numFailed, state.numCached, state.busy / 1000.0,
+		state.materials.GetNumMisses(), state.materials.GetNumHits());
+	return 0;
+}
+
+// Paths go over the socket as they are, so they can't hold the characters
+// that separate fields and requests
+static bool FormatConvertRequest(const std::string &file, const std::vector<std::string> &convertArgs, std::string &request)
+{
+	std::string input = GetAbsolutePath(file);
+	std::string output = GetAbsolutePath(GetMeshFileName(file));
+	if (input.find_first_of("\t\n") != std::string::npos)
+		return false;
+
+	request = std::string(DAEMON_REQUEST_CONVERT) + '\t' + input + '\t' + output;
+	for (unsigned int i = 0; i < convertArgs.size(); ++i)
+		request += '\t' + convertArgs[i];
+	return true;
+}
+
+static bool SendRequest(LocalSocket &socket, const std::string &request, std::vector<std::string> &reply)
+{
+	std::string line;
+	if (!socket.SendLine(request) || !socket.ReceiveLine(line))
+		return false;
+
+	SplitFields(line, reply);
+	return true;
+}
+
+int RunDaemonClient(const DaemonOptions &options, const std::vector<std::string> &files, const std::vector<std::string> &convertArgs)
+{
+	LocalSocket socket;
+	if (!socket.Connect(options.socketPath))
+	{
+		printf("Error connecting to a daemon on %s.\n\n", options.socketPath.c_str());
+		return 1;
+	}
+
+	std::vector<std::string> reply;
+	unsigned int numFailed = 0;
+	for (unsigned int i = 0; i < files.size(); ++i)
+	{
+		std::string request;
+		if (!FormatConvertRequest(files[i], convertArgs, request))
+		{
+			printf("FAILED %s: the path can't be sent to the daemon\n", files[i].c_str());
+			++numFailed;
+			continue;
+		}
+		if (!SendRequest(socket, request, reply))
+		{
+			printf("Error talking to the daemon on %s.\n\n", options.socketPath.c_str());
+			return 1;
+		}
+
+		if (reply[0] == DAEMON_REPLY_OK && reply.size() >= 4)
+			printf("OK     %s -> %s (%s ms%s)\n", files[i].c_str(), reply[2].c_str(), reply[1].c_str(), (reply[3] == "CACHED" ? ", cached" : ""));
+		else
+		{
+			printf("FAILED %s (%s ms): %s\n", files[i].c_str(), (reply.size() > 1 ? reply[1].c_str() : "0"), (reply.size() > 2 ? reply[2].c_str() : "no reply"));
+			++numFailed;
+		}
+	}
+
+	if (options.shutdown)
+	{
+		if (!SendRequest(socket, DAEMON_REQUEST_SHUTDOWN, reply) || reply[0] != DAEMON_REPLY_OK)
+		{
+			printf("Error shutting down the daemon on %s.\n\n", options.socketPath.c_str());
+			return 1;
+		}
+		printf("Daemon on %s is shutting down.\n", options.socketPath.c_str());
+	}
+
+	return (numFailed > 0 ? 1 : 0);
+}
+
+// Starts a program with its output thrown away and waits for it to exit
+static bool RunProgram(const std::vector<std::string> &args)
+{
+#ifdef _WIN32
+	return false;
+#else
+	std::vector<char*> argv;
+	for (unsigned int i = 0; i < args.size(); ++i)
+		argv.push_back(const_cast<char*>(args[i].c_str()));
+	argv.push_back(NULL);
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+	posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+
+	pid_t process;
+	int status = 0;
+	bool started = (posix_spawnp(&process, argv[0], &actions, NULL, &argv[0], environ) == 0);
+	posix_spawn_file_actions_destroy(&actions);
+	if (!started || waitpid(process, &status, 0) != process)
+		return false;
+	return (WIFEXITED(status) && WEXITSTATUS(status) == 0);
+#endif
+}
+
+static void PrintLatency(const char *method, std::vector<double> &times)
+{
+	if (times.size() == 0)
+		return;
+
+	std::sort(times.begin(), times.end());
+	double total = 0.0;
+	for (unsigned int i = 0; i < times.size(); ++i)
+		total += times[i];
+	printf("  %-16s min %8.2f ms, median %8.2f ms, p90 %8.2f ms, mean %8.2f ms\n", method, times[0], times[times.size() / 2], times[std::min((unsigned int)times.size() - 1, (unsigned int)times.size() * 9 / 10)], total / times.size());
+}
+
+int BenchmarkDaemonLatency(const DaemonOptions &options, const std::string &file, const std::vector<std::string> &convertArgs, const std::string &program)
+{
+	std::string request;
+	if (!FormatConvertRequest(file, convertArgs, request))
+	{
+		printf("Error: %s can't be sent to the daemon.\n\n", file.c_str());
+		return 1;
+	}
+
+	std::vector<std::string> processArgs(1, program);
+	processArgs.insert(processArgs.end(), convertArgs.begin(), convertArgs.end());
+	processArgs.push_back(GetAbsolutePath(file));
+	std::vector<std::string> clientArgs = processArgs;
+	clientArgs.insert(clientArgs.begin() + 1, "--connect=" + options.socketPath);
+
+	// The runs are interleaved so anything else slowing the machine down
+	// hits every method alike. One untimed run of each comes first, the
+	// way an editor's first conversion warms everything up
+	std::vector<double> processTimes;
+	std::vector<double> clientTimes;
+	std::vector<double> socketTimes;
+	std::vector<std::string> reply;
+	unsigned int numFailed = 0;
+	unsigned int numCached = 0;
+	for (unsigned int i = 0; i <= options.latencyRuns; ++i)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		if (!RunProgram(processArgs))
+			++numFailed;
+		double processTime = GetElapsed(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		if (!RunProgram(clientArgs))
+			++numFailed;
+		double clientTime = GetElapsed(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		LocalSocket socket;
+		bool replied = (socket.Connect(options.socketPath) && SendRequest(socket, request, reply) && reply[0] == DAEMON_REPLY_OK);
+		double socketTime = GetElapsed(start);
+		if (!replied)
+			++numFailed;
+
+		if (i > 0)
+		{
+			if (replied && reply.size() >= 4 && reply[3] == "CACHED")
+				++numCached;
+			processTimes.push_back(processTime);
+			clientTimes.push_back(clientTime);
+			socketTimes.push_back(socketTime);
+		}
+	}
+
+	printf("Round trip latency converting %s, %u runs each:\n", file.c_str(), options.latencyRuns);
+	PrintLatency("new process", processTimes);
+	PrintLatency("client process", clientTimes);
+	PrintLatency("socket request", socketTimes);
+	if (numCached > 0)
+		printf("%u of the socket requests were served from the daemon's cache\n", numCached);
+	if (numFailed > 0)
+		printf("%u conversions failed\n", numFailed);
+	return (numFailed > 0 ? 1 : 0);
+}
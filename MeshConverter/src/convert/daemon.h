@@ -0,0 +1,89 @@
+#ifndef __CONVERT_DAEMON_H_INCLUDED__
+#define __CONVERT_DAEMON_H_INCLUDED__
+
+#include <string>
+#include <vector>
+
+#include "cache.h"
+
+// Where the daemon listens and clients connect when no socket is given
+#define DAEMON_DEFAULT_SOCKET "/tmp/meshconverter.sock"
+
+// Round trips timed per method by --latency when no count is given
+#define DAEMON_DEFAULT_LATENCY_RUNS 20
+
+// Requests are single lines of tab separated fields, answered by a
+// single line each:
+//   CONVERT <input> <output> [option...]  ->  OK <ms> <output> CONVERTED|CACHED
+//                                             FAILED <ms> <message>
+//   STATS                                 ->  OK <name>=<value>...
+//   SHUTDOWN                              ->  OK
+// An empty output writes next to the input, as the command line does.
+// Paths are used as given, so clients send them from the root
+#define DAEMON_REQUEST_CONVERT "CONVERT"
+#define DAEMON_REQUEST_STATS "STATS"
+#define DAEMON_REQUEST_SHUTDOWN "SHUTDOWN"
+#define DAEMON_REPLY_OK "OK"
+#define DAEMON_REPLY_FAILED "FAILED"
+
+struct DaemonOptions
+{
+	bool serve;
+	bool connect;
+	bool shutdown;
+	std::string socketPath;
+	unsigned int numWorkers;                     // Connections served at once, 0 for one per hardware thread
+	unsigned int latencyRuns;                    // Round trips per method to time, 0 to convert normally
+
+	DaemonOptions()
+	{
+		serve = false;
+		connect = false;
+		shutdown = false;
+		socketPath = DAEMON_DEFAULT_SOCKET;
+		numWorkers = 0;
+		latencyRuns = 0;
+	}
+};
+
+bool ParseDaemonOption(const std::string &option, DaemonOptions &options);
+void PrintDaemonOptionUsage();
+
+/**
+ * Listens on the socket and serves conversion requests until asked to
+ * shut down or interrupted. Each connection is served by one of a fixed
+ * set of worker threads, which stay up between requests and share the
+ * material libraries they have read and, if given, a conversion cache
+ * @param options socket and number of workers
+ * @param cache cache to look conversions up in and add them to, or NULL
+ *
+ * @return int exit code, non-zero if the socket couldn't be set up
+ */
+int RunDaemon(const DaemonOptions &options, ConversionCache *cache);
+
+/**
+ * Has a running daemon convert each file, printing its reply, or asks it
+ * to shut down
+ * @param options socket to connect to
+ * @param files models to convert
+ * @param convertArgs conversion options, as given on the command line
+ *
+ * @return int exit code, non-zero if the daemon couldn't be reached or
+ *             a file failed
+ */
+int RunDaemonClient(const DaemonOptions &options, const std::vector<std::string> &files, const std::vector<std::string> &convertArgs);
+
+/**
+ * Times converting a file by starting a new converter process, by
+ * starting a client process that hands it to the daemon, and by sending
+ * the daemon a request directly, and prints the spread of each
+ * @param options socket to connect to and number of runs
+ * @param file model to convert
+ * @param convertArgs conversion options, as given on the command line
+ * @param program path of the converter, to start new processes of
+ *
+ * @return int exit code, non-zero if any conversion failed
+ */
+int BenchmarkDaemonLatency(const DaemonOptions &options, const std::string &file, const std::vector<std::string> &convertArgs, const std::string &program);
+
+#endif
@@ -0,0 +1,264 @@
+#include "formats.h"
+
+#include <string.h>
+#include <ctype.h>
+
+#include "../md2/md2.h"
+#include "../obj/obj.h"
+#include "../sm/sm.h"
+#include "../ms3d/ms3d.h"
+#include "../util/profiler.h"
+
+// Statements that only appear in OBJ files, at least one of which has to
+// come before anything else can be taken as OBJ
+static const char *g_objStatements[] = { "v", "vt", "vn", "f", "o", "g", "mtllib", NULL };
+
+// Other statements an OBJ file can start with
+static const char *g_objKeywords[] = { "vp", "l", "p", "s", "usemtl", NULL };
+
+static bool IsKeyword(const std::string &keyword, const char **keywords)
+{
+	for (unsigned int i = 0; keywords[i] != NULL; ++i)
+	{
+		if (keyword == keywords[i])
+			return true;
+	}
+	return false;
+}
+
+static bool ProbeObj(const unsigned char *header, size_t size)
+{
+	size_t i = 0;
+	while (i < size)
+	{
+		if (header[i] == 0)
+			return false;
+		if (isspace(header[i]))
+		{
+			++i;
+			continue;
+		}
+
+		// Comments run to the end of the line
+		if (header[i] == '#')
+		{
+			while (i < size && header[i] != '\n')
+			{
+				if (header[i] == 0)
+					return false;
+				++i;
+			}
+			continue;
+		}
+
+		size_t start = i;
+		while (i < size && header[i] != 0 && !isspace(header[i]))
+			++i;
+		std::string keyword((const char*)&header[start], i - start);
+		if (IsKeyword(keyword, g_objStatements))
+			return true;
+		if (!IsKeyword(keyword, g_objKeywords))
+			return false;
+
+		// The rest of the line is the statement's arguments
+		while (i < size && header[i] != '\n')
+		{
+			if (header[i] == 0)
+				return false;
+			++i;
+		}
+	}
+
+	// Nothing but comments and whitespace could be any text file, the
+	// extension has to decide
+	return false;
+}
+
+static bool ProbeMd2(const unsigned char *header, size_t size)
+{
+	return (size >= 4 && memcmp(header, "IDP2", 4) == 0);
+}
+
+// "SM", then the number of materials, triangles, vertices, normals and
+// texture coordinates
+#define SM_HEADER_SIZE 20
+
+// Each material's four colours, before its texture name
+#define SM_MATERIAL_SIZE 16
+
+// Vertex, normal and texture coordinate indices, vertex colours and a
+// material index
+#define SM_TRIANGLE_SIZE 44
+
+static unsigned int ReadProbeInt(const unsigned char *data)
+{
+	unsigned int value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static bool ProbeSm(const unsigned char *header, size_t size)
+{
+	if (size < SM_HEADER_SIZE || header[0] != 'S' || header[1] != 'M')
+		return false;
+
+	// Two letters alone turn up in plenty of other files, so as much of the
+	// materials and triangles as the header holds have to fit the counts
+	unsigned short numMaterials;
+	memcpy(&numMaterials, &header[2], sizeof(numMaterials));
+	unsigned int numPolygons = ReadProbeInt(&header[4]);
+	unsigned int numVertices = ReadProbeInt(&header[8]);
+	unsigned int numNormals = ReadProbeInt(&header[12]);
+	unsigned int numTexCoords = ReadProbeInt(&header[16]);
+	if (numPolygons > 0 && numVertices == 0)
+		return false;
+
+	size_t offset = SM_HEADER_SIZE;
+	for (unsigned int i = 0; i < numMaterials; ++i)
+	{
+		offset += SM_MATERIAL_SIZE;
+		while (offset < size && header[offset] != 0)
+		{
+			if (header[offset] < 0x20)
+				return false;
+			++offset;
+		}
+		if (offset >= size)
+			return true;
+		++offset;
+	}
+
+	for (unsigned int i = 0; i < numPolygons && offset + SM_TRIANGLE_SIZE <= size; ++i, offset += SM_TRIANGLE_SIZE)
+	{
+		for (unsigned int j = 0; j < 3; ++j)
+		{
+			if (ReadProbeInt(&header[offset + j * 4]) >= numVertices
+				|| (numNormals > 0 && ReadProbeInt(&header[offset + 12 + j * 4]) >= numNormals)
+				|| (numTexCoords > 0 && ReadProbeInt(&header[offset + 24 + j * 4]) >= numTexCoords))
+				return false;
+		}
+
+		short material;
+		memcpy(&material, &header[offset + SM_TRIANGLE_SIZE - sizeof(material)], sizeof(material));
+		if (material < -1 || material >= (int)numMaterials)
+			return false;
+	}
+	return true;
+}
+
+static bool ProbeMs3d(const unsigned char *header, size_t size)
+{
+	return (size >= 10 && memcmp(header, "MS3D000000", 10) == 0);
+}
+
+// Loads a model with load, then writes it to fp as a MESH file, timing
+// each as its own stage
+template <typename Model, typename Loader>
+static unsigned int LoadAndConvert(Model &model, size_t size, const ConvertOptions &options, FILE *fp, const Loader &load)
+{
+	{
+		ProfileScope scope(PROFILE_STAGE_LOAD);
+		ProfileCount(PROFILE_STAGE_LOAD, PROFILE_COUNTER_BYTES_READ, size);
+		if (!load())
+			return MODEL_CONVERT_LOAD_FAILED;
+	}
+
+	ProfileScope scope(PROFILE_STAGE_WRITE);
+	return (model.ConvertToMesh(fp, options) ? MODEL_CONVERT_DONE : MODEL_CONVERT_WRITE_FAILED);
+}
+
+static unsigned int ConvertObj(const void *data, size_t size, const ConvertOptions &options, const SidecarResolver &sidecars, FILE *fp,
+	ObjMaterialCache *materialCache)
+{
+	Obj obj;
+	return LoadAndConvert(obj, size, options, fp, [&]() { return obj.Load(data, size, "./", sidecars, materialCache); });
+}
+
+static unsigned int ConvertMd2(const void *data, size_t size, const ConvertOptions &options, const SidecarResolver &sidecars, FILE *fp,
+	ObjMaterialCache *)
+{
+	Md2 md2;
+	return LoadAndConvert(md2, size, options, fp, [&]() { return md2.Load(data, size, sidecars); });
+}
+
+static unsigned int ConvertSm(const void *data, size_t size, const ConvertOptions &options, const SidecarResolver &, FILE *fp,
+	ObjMaterialCache *)
+{
+	StaticModel sm;
+	return LoadAndConvert(sm, size, options, fp, [&]() { return sm.Load(data, size); });
+}
+
+static unsigned int ConvertMs3d(const void *data, size_t size, const ConvertOptions &options, const SidecarResolver &sidecars, FILE *fp,
+	ObjMaterialCache *)
+{
+	Ms3d ms3d;
+	return LoadAndConvert(ms3d, size, options, fp, [&]() { return ms3d.Load(data, size, sidecars); });
+}
+
+// Probed in this order, so formats with a magic number come before OBJ's
+// guess at text
+static const ModelFormat g_modelFormats[] =
+{
+	{ MODEL_FORMAT_MD2, "MD2", ".md2", ProbeMd2, ConvertMd2, NULL, Md2::GetAnimationFile },
+	{ MODEL_FORMAT_MS3D, "MS3D", ".ms3d", ProbeMs3d, ConvertMs3d, NULL, Ms3d::GetAnimationFile },
+	{ MODEL_FORMAT_SM, "SM", ".sm", ProbeSm, ConvertSm, NULL, NULL },
+	{ MODEL_FORMAT_OBJ, "OBJ", ".obj", ProbeObj, ConvertObj, Obj::FindMaterialLibrary, NULL }
+};
+
+#define NUM_MODEL_FORMATS (sizeof(g_modelFormats) / sizeof(g_modelFormats[0]))
+
+const ModelFormat* FindModelFormat(unsigned int format)
+{
+	for (unsigned int i = 0; i < NUM_MODEL_FORMATS; ++i)
+	{
+		if (g_modelFormats[i].id == format)
+			return &g_modelFormats[i];
+	}
+	return NULL;
+}
+
+unsigned int GetModelFormatByExtension(const std::string &extension)
+{
+	for (unsigned int i = 0; i < NUM_MODEL_FORMATS; ++i)
+	{
+		if (extension == g_modelFormats[i].extension)
+			return g_modelFormats[i].id;
+	}
+	return MODEL_FORMAT_UNKNOWN;
+}
+
+const char* GetModelFormatName(unsigned int format)
+{
+	const ModelFormat *modelFormat = FindModelFormat(format);
+	return (modelFormat != NULL ? modelFormat->name : "unknown");
+}
+
+unsigned int GetModelFormatByName(const std::string &name)
+{
+	for (unsigned int i = 0; i < NUM_MODEL_FORMATS; ++i)
+	{
+		const char *formatName = g_modelFormats[i].name;
+		if (name.length() != strlen(formatName))
+			continue;
+
+		unsigned int j = 0;
+		while (j < name.length() && toupper(name[j]) == formatName[j])
+			++j;
+		if (j == name.length())
+			return g_modelFormats[i].id;
+	}
+	return MODEL_FORMAT_UNKNOWN;
+}
+
+unsigned int DetectModelFormat(const void *data, size_t size)
+{
+	if (size > MODEL_FORMAT_PROBE_SIZE)
+		size = MODEL_FORMAT_PROBE_SIZE;
+
+	for (unsigned int i = 0; i < NUM_MODEL_FORMATS; ++i)
+	{
+		if (g_modelFormats[i].probe((const unsigned char*)data, size))
+			return g_modelFormats[i].id;
+	}
+	return MODEL_FORMAT_UNKNOWN;
+}
@@ -0,0 +1,98 @@
+#ifndef __CONVERT_FORMATS_H_INCLUDED__
+#define __CONVERT_FORMATS_H_INCLUDED__
+
+#include <stdio.h>
+#include <string>
+
+#include "options.h"
+#include "sidecar.h"
+
+class ObjMaterialCache;
+
+// Model formats the converters read
+#define MODEL_FORMAT_UNKNOWN 0
+#define MODEL_FORMAT_OBJ 1
+#define MODEL_FORMAT_MD2 2
+#define MODEL_FORMAT_SM 3
+#define MODEL_FORMAT_MS3D 4
+
+// Bytes from the start of a model a format's probe is given at most
+#define MODEL_FORMAT_PROBE_SIZE 4096
+
+// How far a format's convert function got
+#define MODEL_CONVERT_DONE 0
+#define MODEL_CONVERT_LOAD_FAILED 1
+#define MODEL_CONVERT_WRITE_FAILED 2
+
+// A model format and the converter for it. The formats are listed in a
+// table in formats.cpp, which is all the rest of the converter knows of
+// them: adding a row there makes a new format convertible from files,
+// streams, batches and the daemon
+struct ModelFormat
+{
+	unsigned int id;                             // MODEL_FORMAT_*
+	const char *name;                            // Upper case, as in messages
+	const char *extension;                       // Lower case, including the '.'
+
+	// True if the first bytes of a model, at most MODEL_FORMAT_PROBE_SIZE
+	// of them, look like this format. Only ever sees the header, so
+	// detecting a format never reads a whole file
+	bool (*probe)(const unsigned char *header, size_t size);
+
+	// Loads a model and writes it to fp as an uncompressed MESH file,
+	// returning one of the MODEL_CONVERT_* values
+	unsigned int (*convert)(const void *data, size_t size, const ConvertOptions &options, const SidecarResolver &sidecars, FILE *fp,
+		ObjMaterialCache *materialCache);
+
+	// Sidecar files of a model file, NULL if the format has none of the
+	// kind. Material libraries are named in the model, the rest are named
+	// after it
+	bool (*findMaterialLibrary)(const std::string &file, std::string &library);
+	std::string (*getAnimationFile)(const std::string &file);
+};
+
+/**
+ * @param format one of the MODEL_FORMAT_* values
+ *
+ * @return const ModelFormat* the format, or NULL for MODEL_FORMAT_UNKNOWN
+ */
+const ModelFormat* FindModelFormat(unsigned int format);
+
+/**
+ * @param extension lower case extension, including the '.'
+ *
+ * @return unsigned int the MODEL_FORMAT_* value of the format with that
+ *                      extension, MODEL_FORMAT_UNKNOWN if there is none
+ */
+unsigned int GetModelFormatByExtension(const std::string &extension);
+
+/**
+ * @param format one of the MODEL_FORMAT_* values
+ *
+ * @return const char* readable name of the format
+ */
+const char* GetModelFormatName(unsigned int format);
+
+/**
+ * @param name name of a format, as GetModelFormatName gives it, in any
+ *             case
+ *
+ * @return unsigned int the MODEL_FORMAT_* value, MODEL_FORMAT_UNKNOWN if
+ *                      no format has that name
+ */
+unsigned int GetModelFormatByName(const std::string &name);
+
+/**
+ * Works out a model's format from its first bytes by asking each format's
+ * probe in turn. MD2, MS3D and SM files start with a magic number, OBJ
+ * files are text starting with comments or OBJ statements, so OBJ is
+ * tried last. Only the first MODEL_FORMAT_PROBE_SIZE bytes are looked at
+ * @param data contents of the model, or just its first bytes
+ * @param size size of data in bytes
+ *
+ * @return unsigned int the MODEL_FORMAT_* value, MODEL_FORMAT_UNKNOWN if
+ *                      it isn't any of them
+ */
+unsigned int DetectModelFormat(const void *data, size_t size);
+
+#endif
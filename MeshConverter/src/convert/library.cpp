@@ -0,0 +1,130 @@
+#include "library.h"
+
+#include <stdio.h>
+
+#include "../obj/materialcache.h"
+#include "../mesh/meshcompress.h"
+#include "../util/memoryfile.h"
+#include "../util/profiler.h"
+
+// Loads the model with the converter for its format and writes it out
+// uncompressed
+static bool WriteMesh(const void *data, size_t size, unsigned int format, const ConvertOptions &options, const SidecarResolver &sidecars,
+	FILE *fp, ObjMaterialCache *materialCache)
+{
+	const ModelFormat *modelFormat = FindModelFormat(format);
+	if (modelFormat == NULL)
+	{
+		printf("Unrecognized file type.\n\n");
+		return false;
+	}
+
+	printf("Using %s converter.\n", modelFormat->name);
+
+	long start = (IsProfiling() ? ftell(fp) : -1);
+	unsigned int result = modelFormat->convert(data, size, options, sidecars, fp, materialCache);
+	long end = ftell(fp);
+	if (start >= 0 && end >= start)
+		ProfileCount(PROFILE_STAGE_WRITE, PROFILE_COUNTER_BYTES_WRITTEN, end - start);
+	if (result == MODEL_CONVERT_LOAD_FAILED)
+	{
+		printf("Error loading %s file.\n\n", modelFormat->name);
+		return false;
+	}
+	if (result != MODEL_CONVERT_DONE)
+	{
+		printf("Error converting %s to MESH.\n\n", modelFormat->name);
+		return false;
+	}
+
+	return true;
+}
+
+bool ConvertModel(const void *data, size_t size, unsigned int format, const ConvertOptions &options, const SidecarResolver &sidecars,
+	std::vector<unsigned char> &mesh, ObjMaterialCache *materialCache)
+{
+	mesh.clear();
+
+	MemoryFile output;
+	FILE *fp = output.Open();
+	if (fp == NULL)
+	{
+		printf("Error creating MESH file in memory.\n\n");
+		return false;
+	}
+
+	if (!WriteMesh(data, size, format, options, sidecars, fp, materialCache))
+		return false;
+
+	if (!output.Close(mesh))
+	{
+		printf("Error converting %s to MESH.\n\n", GetModelFormatName(format));
+		return false;
+	}
+
+	if (options.compression != MESH_COMPRESSION_NONE)
+	{
+		ProfileScope scope(PROFILE_STAGE_COMPRESS);
+		ProfileCount(PROFILE_STAGE_COMPRESS, PROFILE_COUNTER_BYTES_READ, mesh.size());
+		if (!CompressMeshData(mesh, options.compression))
+		{
+			printf("Error compressing MESH file.\n\n");
+			return false;
+		}
+		ProfileCount(PROFILE_STAGE_COMPRESS, PROFILE_COUNTER_BYTES_WRITTEN, mesh.size());
+	}
+
+	return true;
+}
+
+bool ConvertModelToStream(const void *data, size_t size, unsigned int format, const ConvertOptions &options, const SidecarResolver &sidecars,
+	FILE *fp, ObjMaterialCache *materialCache)
+{
+	// Compression works on the whole file, and BVH nodes are aligned by
+	// their offset in the file, which a pipe can't tell. Either way the
+	// file is built in memory first. Otherwise the converters write
+	// straight to the stream
+	if (options.compression != MESH_COMPRESSION_NONE || (options.buildBvh && ftell(fp) != 0))
+	{
+		std::vector<unsigned char> mesh;
+		if (!ConvertModel(data, size, format, options, sidecars, mesh, materialCache))
+			return false;
+		if (mesh.size() > 0 && fwrite(mesh.data(), 1, mesh.size(), fp) != mesh.size())
+		{
+			printf("Error writing MESH file.\n\n");
+			return false;
+		}
+		return true;
+	}
+
+	if (!WriteMesh(data, size, format, options, sidecars, fp, materialCache))
+		return false;
+	if (fflush(fp) != 0 || ferror(fp) != 0)
+	{
+		printf("Error writing MESH file.\n\n");
+		return false;
+	}
+	return true;
+}
+
+bool ConvertModelToFile(const void *data, size_t size, unsigned int format, const ConvertOptions &options, const SidecarResolver &sidecars,
+	const std::string &meshFile, ObjMaterialCache *materialCache)
+{
+	FILE *fp = fopen(meshFile.c_str(), "wb");
+	if (fp == NULL)
+	{
+		printf("Error writing MESH file.\n\n");
+		return false;
+	}
+
+	// A model that fails to load or write leaves no MESH file behind
+	bool converted = ConvertModelToStream(data, size, format, options, sidecars, fp, materialCache);
+	if (fclose(fp) != 0 && converted)
+	{
+		printf("Error writing MESH file.\n\n");
+		converted = false;
+	}
+	if (!converted)
+		remove(meshFile.c_str());
+	return converted;
+}
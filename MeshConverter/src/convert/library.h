@@ -0,0 +1,77 @@
+#ifndef __CONVERT_LIBRARY_H_INCLUDED__
+#define __CONVERT_LIBRARY_H_INCLUDED__
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "options.h"
+#include "sidecar.h"
+#include "formats.h"
+
+/**
+ * Converts a model held in memory to a MESH file held in memory, for
+ * programs that want to convert models without going through the file
+ * system. This is what the command line converts files with, so the
+ * result is the same MESH file it writes for the same options. Nothing is
+ * read from disk unless the sidecar resolver does so, and several models
+ * can be converted at the same time
+ * @param data contents of the model
+ * @param size size of data in bytes
+ * @param format one of the MODEL_FORMAT_* values
+ * @param options processing to apply, compression included
+ * @param sidecars asked for the files the model refers to (material
+ *                 libraries and animation definitions), or empty to
+ *                 convert the model without them
+ * @param mesh receives the MESH file
+ * @param materialCache where OBJ material libraries are kept between
+ *                      conversions, or NULL to read them every time
+ *
+ * @return bool false if the model couldn't be read or converted
+ */
+bool ConvertModel(const void *data, size_t size, unsigned int format, const ConvertOptions &options, const SidecarResolver &sidecars,
+	std::vector<unsigned char> &mesh, ObjMaterialCache *materialCache = NULL);
+
+/**
+ * Does what ConvertModel does, writing the MESH file to disk. Without
+ * compression the converters write straight to the file rather than
+ * building it in memory first
+ * @param data contents of the model
+ * @param size size of data in bytes
+ * @param format one of the MODEL_FORMAT_* values
+ * @param options processing to apply, compression included
+ * @param sidecars asked for the files the model refers to, or empty
+ * @param meshFile MESH file to write, removed again if conversion fails
+ * @param materialCache where OBJ material libraries are kept between
+ *                      conversions, or NULL to read them every time
+ *
+ * @return bool false if the model couldn't be read or converted, or the
+ *              file couldn't be written
+ */
+bool ConvertModelToFile(const void *data, size_t size, unsigned int format, const ConvertOptions &options, const SidecarResolver &sidecars,
+	const std::string &meshFile, ObjMaterialCache *materialCache = NULL);
+
+/**
+ * Does what ConvertModel does, writing the MESH file to a stream that
+ * may not be seekable, such as standard output. The MESH layout gives
+ * every chunk's size ahead of its data, so the converters write it out
+ * as they go. Only when it needs compressing, or it has a BVH chunk that
+ * is aligned by its offset and the stream doesn't start at offset 0, is
+ * the file built in memory first
+ * @param data contents of the model
+ * @param size size of data in bytes
+ * @param format one of the MODEL_FORMAT_* values
+ * @param options processing to apply, compression included
+ * @param sidecars asked for the files the model refers to, or empty
+ * @param fp stream to write to, left open
+ * @param materialCache where OBJ material libraries are kept between
+ *                      conversions, or NULL to read them every time
+ *
+ * @return bool false if the model couldn't be read or converted, or the
+ *              stream couldn't be written. Part of the file may have
+ *              been written by then
+ */
+bool ConvertModelToStream(const void *data, size_t size, unsigned int format, const ConvertOptions &options, const SidecarResolver &sidecars,
+	FILE *fp, ObjMaterialCache *materialCache = NULL);
+
+#endif
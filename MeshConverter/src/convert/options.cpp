@@ -0,0 +1,185 @@
+#include "options.h"
+#include "../processing/meshlets.h"
+#include "../processing/simplify.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+bool ParseOption(const std::string &option, ConvertOptions &options)
+{
+	if (option == "--weld")
+		options.weldVertices = true;
+	else if (option.compare(0, 7, "--weld=") == 0)
+	{
+		options.weldVertices = true;
+		options.weldEpsilon = (float)atof(option.substr(7).c_str());
+		if (options.weldEpsilon < 0.0f)
+			return false;
+	}
+	else if (option == "--keep-seams")
+	{
+		options.weldVertices = true;
+		options.weldKeepSeams = true;
+	}
+	else if (option == "--normals")
+		options.generateNormals = true;
+	else if (option.compare(0, 10, "--normals=") == 0)
+	{
+		options.generateNormals = true;
+		options.creaseAngle = (float)atof(option.substr(10).c_str());
+		if (options.creaseAngle < 0.0f || options.creaseAngle > 180.0f)
+			return false;
+	}
+	else if (option == "--normals-by-area")
+	{
+		options.generateNormals = true;
+		options.areaWeightedNormals = true;
+	}
+	else if (option == "--vertex-cache")
+		options.optimizeVertexCache = true;
+	else if (option == "--vertex-fetch")
+		options.optimizeVertexFetch = true;
+	else if (option == "--overdraw")
+		options.optimizeOverdraw = true;
+	else if (option.compare(0, 11, "--overdraw=") == 0)
+	{
+		options.optimizeOverdraw = true;
+		options.overdrawThreshold = (float)atof(option.substr(11).c_str());
+		if (options.overdrawThreshold < 1.0f)
+			return false;
+	}
+	else if (option == "--meshlets")
+		options.buildMeshlets = true;
+	else if (option == "--bounds")
+		options.computeBounds = true;
+	else if (option == "--bvh")
+		options.buildBvh = true;
+	else if (option == "--bvh=benchmark")
+	{
+		options.buildBvh = true;
+		options.benchmarkBvh = true;
+	}
+	else if (option == "--tangents")
+		options.computeTangents = true;
+	else if (option == "--tangents=benchmark")
+	{
+		options.computeTangents = true;
+		options.benchmarkTangents = true;
+	}
+	else if (option == "--lod")
+	{
+		options.lodRatios.clear();
+		options.lodRatios.push_back(0.5f);
+		options.lodRatios.push_back(0.25f);
+		options.lodRatios.push_back(0.125f);
+	}
+	else if (option.compare(0, 6, "--lod=") == 0)
+	{
+		// Comma separated, each level has to be smaller than the last since
+		// it is made from it
+		options.lodRatios.clear();
+		std::string list = option.substr(6);
+		size_t start = 0;
+		while (start <= list.length())
+		{
+			size_t end = list.find(',', start);
+			if (end == std::string::npos)
+				end = list.length();
+			float ratio = (float)atof(list.substr(start, end - start).c_str());
+			if (ratio <= 0.0f || ratio >= 1.0f)
+				return false;
+			if (options.lodRatios.size() > 0 && ratio >= options.lodRatios.back())
+				return false;
+			options.lodRatios.push_back(ratio);
+			start = end + 1;
+		}
+		if (options.lodRatios.size() > LOD_MAX_LEVELS)
+			return false;
+	}
+	else if (option == "--quantize" || option == "--quantize=precise")
+	{
+		options.quantize.positions = true;
+		options.quantize.normalBits = 16;
+		options.quantize.texCoords = QUANTIZE_TEXCOORDS_UNORM16;
+	}
+	else if (option == "--quantize=compact")
+	{
+		options.quantize.positions = true;
+		options.quantize.normalBits = 8;
+		options.quantize.texCoords = QUANTIZE_TEXCOORDS_HALF;
+	}
+	else if (option == "--compact-indices")
+		options.compactIndices = true;
+	else if (option == "--compact-indices=split")
+	{
+		options.compactIndices = true;
+		options.splitIndices = true;
+	}
+	else if (option == "--compress" || option == "--compress=mesh")
+		options.compression = MESH_COMPRESSION_MESH_CODEC;
+	else if (option == "--compress=lz")
+		options.compression = MESH_COMPRESSION_LZ;
+	else
+		return false;
+
+	return true;
+}
+
+void PrintOptionUsage()
+{
+	printf("Options:\n");
+	printf("  --weld[=epsilon]       Merge SM and OBJ vertex positions closer than epsilon on every axis\n");
+	printf("                         (default %g, exact copies only)\n", WELD_DEFAULT_EPSILON);
+	printf("  --keep-seams           Weld, but only vertices whose normals and texcoords match too\n");
+	printf("  --normals[=degrees]   Generate smooth normals for SM and OBJ meshes that have none, keeping\n");
+	printf("                         edges sharper than the given angle hard (default %g) and following\n", NORMALS_DEFAULT_CREASE_ANGLE);
+	printf("                         OBJ smoothing groups. Triangles are weighted by their corner angles\n");
+	printf("  --normals-by-area      Generate normals, weighting triangles by their area instead\n");
+	printf("  --vertex-cache         Reorder triangles in each material/group for vertex cache reuse\n");
+	printf("  --overdraw[=threshold] Sort triangle clusters in each material/group front to back, letting its\n");
+	printf("                         ACMR degrade by at most the given factor (default %.2f). Materials/groups\n", OVERDRAW_DEFAULT_THRESHOLD);
+	printf("                         keep their cache order unless overdraw drops by more than ACMR rises\n");
+	printf("  --meshlets             Split each material/group into meshlets of up to %d vertices and %d\n", MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+	printf("                         triangles with bounding spheres and normal cones (MLT chunk)\n");
+	printf("  --bounds               Store boxes and spheres bounding the mesh, each material/group, each\n");
+	printf("                         keyframe and each animation (BND chunk)\n");
+	printf("  --bvh[=benchmark]      Build a bounding volume hierarchy for ray casts against SM and OBJ meshes\n");
+	printf("                         (BVH chunk). benchmark also times the build on 1, 2, 4... threads\n");
+	printf("                         and compares ray casts against testing every triangle\n");
+	printf("  --tangents[=benchmark] Generate MikkTSpace style tangents and bitangent signs for each triangle\n");
+	printf("                         corner of SM, OBJ and MS3D meshes (TAN chunk). benchmark also times\n");
+	printf("                         them on 1, 2, 4... threads and checks them against a reference\n");
+	printf("  --lod[=r1,r2,...]      Build simplified levels keeping the given fractions of the triangles\n");
+	printf("                         (default 0.5,0.25,0.125, at most %d levels, LOD chunk)\n", LOD_MAX_LEVELS);
+	printf("  --vertex-fetch         Renumber vertices in the order the triangles first use them\n");
+	printf("  --quantize[=profile]   Store vertex streams in 16 bit positions normalized to the bounding box\n");
+	printf("                         (QVT), octahedral normals (QNR) and 16 bit texcoords (QTX). Profiles:\n");
+	printf("                         precise (default) 2x16 bit normals, unorm16 texcoords\n");
+	printf("                         compact           2x8 bit normals, half float texcoords\n");
+	printf("  --compact-indices[=split]\n");
+	printf("                         Store triangle indices as 16 bit when they fit, 32 bit otherwise\n");
+	printf("                         (version 2 file). split cuts large meshes into 16 bit batches\n");
+	printf("  --compress[=mode]      Compress chunks into CMP chunks, printing sizes and encode/decode speed\n");
+	printf("                         per chunk. Modes:\n");
+	printf("                         mesh (default) mesh codec for vertex streams and triangle lists, LZ\n");
+	printf("                                        for everything else\n");
+	printf("                         lz             LZ for every chunk\n");
+}
+
+std::string GetOptionKey(const ConvertOptions &options)
+{
+	// Floats are printed with enough digits to tell any two apart
+	char buffer[512];
+	snprintf(buffer, sizeof(buffer), "weld=%d,%.9g,%d normals=%d,%.9g,%d cache=%d fetch=%d overdraw=%d,%.9g meshlets=%d bounds=%d bvh=%d,%d tangents=%d,%d quantize=%d,%u,%u indices=%d,%d compress=%u lod=",
+		options.weldVertices, options.weldEpsilon, options.weldKeepSeams, options.generateNormals, options.creaseAngle, options.areaWeightedNormals, options.optimizeVertexCache, options.optimizeVertexFetch,
+		options.optimizeOverdraw, options.overdrawThreshold, options.buildMeshlets, options.computeBounds, options.buildBvh, options.benchmarkBvh, options.computeTangents, options.benchmarkTangents,
+		options.quantize.positions, options.quantize.normalBits, options.quantize.texCoords, options.compactIndices, options.splitIndices, options.compression);
+
+	std::string key = buffer;
+	for (unsigned int i = 0; i < options.lodRatios.size(); ++i)
+	{
+		snprintf(buffer, sizeof(buffer), (i > 0 ? ",%.9g" : "%.9g"), options.lodRatios[i]);
+		key += buffer;
+	}
+	return key;
+}
@@ -0,0 +1,74 @@
+#ifndef __CONVERT_OPTIONS_H_INCLUDED__
+#define __CONVERT_OPTIONS_H_INCLUDED__
+
+#include <string>
+#include <vector>
+
+#include "../processing/normals.h"
+#include "../processing/overdraw.h"
+#include "../processing/quantize.h"
+#include "../processing/weld.h"
+#include "../mesh/meshcompress.h"
+
+// Optional processing applied by the converters before writing a MESH file.
+// Everything defaults to off so the output matches a plain conversion
+struct ConvertOptions
+{
+	bool weldVertices;
+	float weldEpsilon;
+	bool weldKeepSeams;
+	bool generateNormals;
+	float creaseAngle;
+	bool areaWeightedNormals;
+	bool optimizeVertexCache;
+	bool optimizeVertexFetch;
+	bool optimizeOverdraw;
+	float overdrawThreshold;
+	bool buildMeshlets;
+	bool computeBounds;
+	bool buildBvh;
+	bool benchmarkBvh;
+	bool computeTangents;
+	bool benchmarkTangents;
+	std::vector<float> lodRatios;
+	QuantizeProfile quantize;
+	bool compactIndices;
+	bool splitIndices;
+	unsigned int compression;
+
+	ConvertOptions()
+	{
+		weldVertices = false;
+		weldEpsilon = WELD_DEFAULT_EPSILON;
+		weldKeepSeams = false;
+		generateNormals = false;
+		creaseAngle = NORMALS_DEFAULT_CREASE_ANGLE;
+		areaWeightedNormals = false;
+		optimizeVertexCache = false;
+		optimizeVertexFetch = false;
+		optimizeOverdraw = false;
+		overdrawThreshold = OVERDRAW_DEFAULT_THRESHOLD;
+		buildMeshlets = false;
+		computeBounds = false;
+		buildBvh = false;
+		benchmarkBvh = false;
+		computeTangents = false;
+		benchmarkTangents = false;
+		compactIndices = false;
+		splitIndices = false;
+		compression = MESH_COMPRESSION_NONE;
+	}
+};
+
+bool ParseOption(const std::string &option, ConvertOptions &options);
+void PrintOptionUsage();
+
+/**
+ * @param options options to describe
+ *
+ * @return std::string every option's value in a fixed order, the same for
+ *                     any two sets of options that convert the same way
+ */
+std::string GetOptionKey(const ConvertOptions &options);
+
+#endif
@@ -0,0 +1,268 @@
+#include "profile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "../util/profiler.h"
+
+bool ParseProfileOption(const std::string &option, ProfileOptions &options)
+{
+	if (option == "--profile")
+		options.reportFile = PROFILE_DEFAULT_REPORT;
+	else if (option.compare(0, 10, "--profile=") == 0 && option.length() > 10)
+		options.reportFile = option.substr(10);
+	else if (option == "--trace")
+		options.traceFile = PROFILE_DEFAULT_TRACE;
+	else if (option.compare(0, 8, "--trace=") == 0 && option.length() > 8)
+		options.traceFile = option.substr(8);
+	else if (option == "--counters")
+		options.hardwareCounters = true;
+	else if (option == "--allocations")
+		options.trackAllocations = true;
+	else
+		return false;
+
+	return true;
+}
+
+void PrintProfileOptionUsage()
+{
+	printf("Profiling options:\n");
+	printf("  --profile[=file]       Time each stage of every conversion and count the bytes, elements\n");
+	printf("                         and allocations it goes through, written as JSON to file\n");
+	printf("                         (default %s), per file and summed over all of them\n", PROFILE_DEFAULT_REPORT);
+	printf("  --trace[=file]         Record when each file and stage starts and ends on each thread,\n");
+	printf("                         written to file (default %s) as Chrome trace events to be\n", PROFILE_DEFAULT_TRACE);
+	printf("                         opened in chrome://tracing or Perfetto\n");
+	printf("  --counters             Add the CPU's cycles, instructions, cache and branch misses to each\n");
+	printf("                         stage of the profile, with instructions per cycle and misses per\n");
+	printf("                         element. Linux only, and left out where the kernel won't allow them\n");
+	printf("  --allocations          Add the bytes each stage allocates and the most each stage and file\n");
+	printf("                         hold at once to the profile\n");
+	printf("  Both of these profile to %s unless --profile says otherwise\n", PROFILE_DEFAULT_REPORT);
+}
+
+static void WriteJsonString(FILE *fp, const std::string &text)
+{
+	fputc('"', fp);
+	for (unsigned int i = 0; i < text.length(); ++i)
+	{
+		unsigned char c = (unsigned char)text[i];
+		if (c == '"' || c == '\\')
+			fprintf(fp, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(fp, "\\u%04x", c);
+		else
+			fputc(c, fp);
+	}
+	fputc('"', fp);
+}
+
+static double GetRatio(unsigned long long count, unsigned long long of)
+{
+	return (of > 0 ? (double)count / of : 0.0);
+}
+
+static void WriteStages(FILE *fp, const ProfileStage *stages, bool hardwareCounters, bool trackAllocations, const char *indent)
+{
+	fprintf(fp, "{");
+	bool first = true;
+	for (unsigned int i = 0; i < NUM_PROFILE_STAGES; ++i)
+	{
+		const ProfileStage &stage = stages[i];
+		if (stage.calls == 0)
+			continue;
+
+		fprintf(fp, "%s\n%s\t\"%s\": { \"calls\": %llu, \"ms\": %.3f", (first ? "" : ","), indent, GetProfileStageName(i), stage.calls, stage.milliseconds);
+		for (unsigned int j = 0; j < NUM_PROFILE_COUNTERS; ++j)
+			fprintf(fp, ", \"%s\": %llu", GetProfileCounterName(j), stage.counters[j]);
+		if (trackAllocations)
+			fprintf(fp, ", \"allocatedBytes\": %llu, \"peakBytes\": %llu", stage.allocatedBytes, stage.peakBytes);
+		if (hardwareCounters)
+		{
+			for (unsigned int j = 0; j < NUM_HARDWARE_COUNTERS; ++j)
+				fprintf(fp, ", \"%s\": %llu", GetHardwareCounterName(j), stage.hardware[j]);
+
+			unsigned long long elements = stage.counters[PROFILE_COUNTER_ELEMENTS];
+			fprintf(fp, ", \"ipc\": %.3f", GetRatio(stage.hardware[HARDWARE_COUNTER_INSTRUCTIONS], stage.hardware[HARDWARE_COUNTER_CYCLES]));
+			if (elements > 0)
+			{
+				fprintf(fp, ", \"cacheMissesPerElement\": %.3f, \"branchMissesPerElement\": %.3f",
+					GetRatio(stage.hardware[HARDWARE_COUNTER_CACHE_MISSES], elements), GetRatio(stage.hardware[HARDWARE_COUNTER_BRANCH_MISSES], elements));
+			}
+		}
+		fprintf(fp, " }");
+		first = false;
+	}
+	if (!first)
+		fprintf(fp, "\n%s", indent);
+	fprintf(fp, "}");
+}
+
+bool WriteProfileReport(const std::string &file, double elapsed)
+{
+	std::vector<ProfileFile> files;
+	GetProfileFiles(files);
+
+	FILE *fp = fopen(file.c_str(), "w");
+	if (fp == NULL)
+		return false;
+
+	ProfileStage total[NUM_PROFILE_STAGES];
+	memset(total, 0, sizeof(total));
+	double totalTime = 0.0;
+	unsigned int numFailed = 0;
+
+	// Where counters were asked for but couldn't be had, the report says why
+	// and goes on without them
+	std::string hardwareError;
+	bool hardwareCounters = HasHardwareCounters(hardwareError);
+	bool trackAllocations = IsTrackingAllocations();
+	unsigned long long peakBytes = 0;
+
+	fprintf(fp, "{\n\t\"elapsedMs\": %.3f,\n", elapsed);
+	unsigned long long peakResident;
+	if (GetPeakResidentBytes(peakResident))
+		fprintf(fp, "\t\"peakResidentBytes\": %llu,\n", peakResident);
+	if (hardwareError.length() > 0)
+	{
+		fprintf(fp, "\t\"hardwareCounters\": false,\n\t\"hardwareCountersError\": ");
+		WriteJsonString(fp, hardwareError);
+		fprintf(fp, ",\n");
+	}
+	else if (hardwareCounters)
+		fprintf(fp, "\t\"hardwareCounters\": true,\n");
+	fprintf(fp, "\t\"files\": [");
+	for (unsigned int i = 0; i < files.size(); ++i)
+	{
+		const ProfileFile &profile = files[i];
+		fprintf(fp, "%s\n\t\t{ \"file\": ", (i > 0 ? "," : ""));
+		WriteJsonString(fp, profile.file);
+		fprintf(fp, ", \"converted\": %s, \"ms\": %.3f", (profile.converted ? "true" : "false"), profile.milliseconds);
+		if (trackAllocations)
+			fprintf(fp, ", \"peakBytes\": %llu", profile.peakBytes);
+		fprintf(fp, ", \"stages\": ");
+		WriteStages(fp, profile.stages, hardwareCounters, trackAllocations, "\t\t");
+		fprintf(fp, " }");
+
+		totalTime += profile.milliseconds;
+		if (!profile.converted)
+			++numFailed;
+		if (profile.peakBytes > peakBytes)
+			peakBytes = profile.peakBytes;
+		for (unsigned int j = 0; j < NUM_PROFILE_STAGES; ++j)
+		{
+			total[j].calls += profile.stages[j].calls;
+			total[j].milliseconds += profile.stages[j].milliseconds;
+			for (unsigned int k = 0; k < NUM_PROFILE_COUNTERS; ++k)
+				total[j].counters[k] += profile.stages[j].counters[k];
+			for (unsigned int k = 0; k < NUM_HARDWARE_COUNTERS; ++k)
+				total[j].hardware[k] += profile.stages[j].hardware[k];
+
+			// Peaks of files converted side by side could add up, those
+			// converted one after another don't, so the total is the largest
+			total[j].allocatedBytes += profile.stages[j].allocatedBytes;
+			if (profile.stages[j].peakBytes > total[j].peakBytes)
+				total[j].peakBytes = profile.stages[j].peakBytes;
+		}
+	}
+	fprintf(fp, "%s],\n", (files.size() > 0 ? "\n\t" : ""));
+
+	fprintf(fp, "\t\"total\": { \"files\": %u, \"failed\": %u, \"ms\": %.3f", (unsigned int)files.size(), numFailed, totalTime);
+	if (trackAllocations)
+		fprintf(fp, ", \"peakBytes\": %llu", peakBytes);
+	fprintf(fp, ", \"stages\": ");
+	WriteStages(fp, total, hardwareCounters, trackAllocations, "\t");
+	fprintf(fp, " }\n}\n");
+
+	bool written = (ferror(fp) == 0);
+	if (fclose(fp) != 0)
+		written = false;
+	return written;
+}
+
+bool WriteTrace(const std::string &file)
+{
+	std::vector<TraceEvent> events;
+	GetTraceEvents(events);
+
+	FILE *fp = fopen(file.c_str(), "w");
+	if (fp == NULL)
+		return false;
+
+	// Stages end in the reverse order they started on a thread, so a begin
+	// and end pair needs nothing more to match them up
+	fprintf(fp, "{\n\t\"displayTimeUnit\": \"ms\",\n\t\"traceEvents\": [");
+	fprintf(fp, "\n\t\t{ \"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": { \"name\": \"meshconverter\" } }");
+	unsigned int thread = 0;
+	for (unsigned int i = 0; i < events.size(); ++i)
+	{
+		const TraceEvent &event = events[i];
+		if (event.thread != thread)
+		{
+			thread = event.thread;
+			fprintf(fp, ",\n\t\t{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": { \"name\": \"thread %u\" } }", thread, thread);
+		}
+
+		fprintf(fp, ",\n\t\t{ \"name\": ");
+		if (event.stage >= 0)
+			fprintf(fp, "\"%s\", \"cat\": \"stage\"", GetProfileStageName((unsigned int)event.stage));
+		else
+		{
+			// Names are only given at the start, the end goes with it
+			WriteJsonString(fp, (event.begin ? event.file : std::string()));
+			fprintf(fp, ", \"cat\": \"file\"");
+		}
+		fprintf(fp, ", \"ph\": \"%c\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f", (event.begin ? 'B' : 'E'), event.thread, event.microseconds);
+		if (event.stage < 0 && !event.begin)
+			fprintf(fp, ", \"args\": { \"converted\": %s }", (event.converted ? "true" : "false"));
+		fprintf(fp, " }");
+	}
+	fprintf(fp, "\n\t]\n}\n");
+
+	bool written = (ferror(fp) == 0);
+	if (fclose(fp) != 0)
+		written = false;
+	return written;
+}
+
+ProfileReport::ProfileReport(const ProfileOptions &options)
+{
+	m_file = options.reportFile;
+	if ((options.hardwareCounters || options.trackAllocations) && m_file.length() == 0)
+		m_file = PROFILE_DEFAULT_REPORT;
+	m_traceFile = options.traceFile;
+	m_start = std::chrono::high_resolution_clock::now();
+	if (m_file.length() > 0)
+		EnableProfiling();
+	if (options.hardwareCounters)
+		EnableHardwareCounters();
+	if (options.trackAllocations)
+		EnableAllocationTracking();
+	if (m_traceFile.length() > 0)
+		EnableTracing();
+}
+
+ProfileReport::~ProfileReport()
+{
+	if (m_file.length() > 0)
+	{
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_start).count();
+		std::string hardwareError;
+		if (!HasHardwareCounters(hardwareError) && hardwareError.length() > 0)
+			printf("Hardware counters unavailable, %s.\n", hardwareError.c_str());
+		if (WriteProfileReport(m_file, elapsed))
+			printf("Wrote profile to %s\n", m_file.c_str());
+		else
+			printf("Error writing profile to %s.\n", m_file.c_str());
+	}
+
+	if (m_traceFile.length() > 0)
+	{
+		if (WriteTrace(m_traceFile))
+			printf("Wrote trace to %s\n", m_traceFile.c_str());
+		else
+			printf("Error writing trace to %s.\n", m_traceFile.c_str());
+	}
+}
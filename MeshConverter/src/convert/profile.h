@@ -0,0 +1,73 @@
+#ifndef __CONVERT_PROFILE_H_INCLUDED__
+#define __CONVERT_PROFILE_H_INCLUDED__
+
+#include <string>
+#include <chrono>
+
+// Where --profile writes its report when no file is given
+#define PROFILE_DEFAULT_REPORT "profile.json"
+
+// Where --trace writes its events when no file is given
+#define PROFILE_DEFAULT_TRACE "trace.json"
+
+struct ProfileOptions
+{
+	std::string reportFile;                      // JSON report to write, empty to not profile
+	std::string traceFile;                       // Trace to write, empty to not trace
+	bool hardwareCounters;                       // Add the CPU's counters to the report
+	bool trackAllocations;                       // Add bytes allocated and peak live bytes to the report
+
+	ProfileOptions()
+	{
+		hardwareCounters = false;
+		trackAllocations = false;
+	}
+};
+
+bool ParseProfileOption(const std::string &option, ProfileOptions &options);
+void PrintProfileOptionUsage();
+
+/**
+ * Writes what was recorded for every file converted so far as JSON: each
+ * file with the time and counters of each stage it went through, then
+ * the same summed over all of them. With hardware counters on, each stage
+ * also gets its instructions per cycle and misses per element, and with
+ * allocation tracking on each stage and file gets the bytes it allocated
+ * and the most it held at once
+ * @param file report to write
+ * @param elapsed wall clock time of the whole run in milliseconds
+ *
+ * @return bool false if the report couldn't be written
+ */
+bool WriteProfileReport(const std::string &file, double elapsed);
+
+/**
+ * Writes the start and end of every file and stage recorded so far in the
+ * Chrome trace event format, which chrome://tracing and Perfetto open as
+ * a timeline per thread
+ * @param file trace to write
+ *
+ * @return bool false if the trace couldn't be written
+ */
+bool WriteTrace(const std::string &file);
+
+/**
+ * Turns profiling or tracing on if a report or trace was asked for, and
+ * writes them when it goes out of scope, however the run ended
+ */
+class ProfileReport
+{
+public:
+	ProfileReport(const ProfileOptions &options);
+	~ProfileReport();
+
+private:
+	ProfileReport(const ProfileReport &);
+	ProfileReport& operator=(const ProfileReport &);
+
+	std::string m_file;
+	std::string m_traceFile;
+	std::chrono::high_resolution_clock::time_point m_start;
+};
+
+#endif
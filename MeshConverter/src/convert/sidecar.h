@@ -0,0 +1,24 @@
+#ifndef __CONVERT_SIDECAR_H_INCLUDED__
+#define __CONVERT_SIDECAR_H_INCLUDED__
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Files besides the model itself that a converter can ask for
+#define SIDECAR_MATERIAL_LIBRARY 0             // .mtl file an OBJ model's mtllib line names
+#define SIDECAR_ANIMATIONS 1                   // .animations file beside an MD2 or MS3D model
+
+/**
+ * Called by the converters to get the contents of a sidecar file
+ * @param type one of the SIDECAR_* values
+ * @param name the name the model gives the file, as written in it, or
+ *             empty if the model doesn't name it (animations)
+ * @param data receives the file's contents
+ *
+ * @return bool false if there is no such file, the model is converted
+ *              without it
+ */
+typedef std::function<bool(unsigned int type, const std::string &name, std::vector<unsigned char> &data)> SidecarResolver;
+
+#endif
@@ -0,0 +1,91 @@
+#include "stream.h"
+
+#include "convert.h"
+#include "../util/files.h"
+#include "../util/profiler.h"
+
+bool ParseStreamOption(const std::string &option, StreamOptions &options)
+{
+	if (option.compare(0, 9, "--output=") == 0 && option.length() > 9)
+		options.output = option.substr(9);
+	else if (option.compare(0, 9, "--format=") == 0)
+	{
+		options.format = GetModelFormatByName(option.substr(9));
+		if (options.format == MODEL_FORMAT_UNKNOWN)
+			return false;
+	}
+	else
+		return false;
+
+	return true;
+}
+
+void PrintStreamOptionUsage()
+{
+	printf("Stream options, for a single input. %s as the input reads standard input:\n", STREAM_STANDARD);
+	printf("  --output=file          Write the MESH file to file, %s for standard output (the default\n", STREAM_STANDARD);
+	printf("                         when reading standard input). Messages then go to stderr\n");
+	printf("  --format=name          Read the input as obj, md2, sm or ms3d, rather than going by its\n");
+	printf("                         first bytes or, failing that, its extension\n");
+}
+
+bool IsStreamConversion(const std::string &input, const StreamOptions &options)
+{
+	return (input == STREAM_STANDARD || options.output.length() > 0 || options.format != MODEL_FORMAT_UNKNOWN);
+}
+
+bool WritesStandardOutput(const std::string &input, const StreamOptions &options)
+{
+	if (options.output.length() > 0)
+		return (options.output == STREAM_STANDARD);
+	return (input == STREAM_STANDARD);
+}
+
+bool ConvertStream(const std::string &input, const StreamOptions &options, const ConvertOptions &convertOptions, FILE *standardOutput,
+	std::string &meshFile)
+{
+	bool standardInput = (input == STREAM_STANDARD);
+	ProfileFileScope profile(input);
+
+	std::vector<unsigned char> data;
+	bool read;
+	{
+		ProfileScope scope(PROFILE_STAGE_READ);
+		read = (standardInput ? ReadStreamContents(stdin, data) : ReadFileContents(input, data));
+	}
+	ProfileCount(PROFILE_STAGE_READ, PROFILE_COUNTER_BYTES_READ, data.size());
+	if (!read)
+	{
+		printf("Error reading %s.\n\n", (standardInput ? "standard input" : input.c_str()));
+		return false;
+	}
+
+	unsigned int format = options.format;
+	if (format == MODEL_FORMAT_UNKNOWN)
+		format = (standardInput ? DetectModelFormat(data.data(), data.size()) : GetModelFormat(input, data.data(), data.size()));
+
+	SidecarResolver sidecars;
+	if (standardInput)
+	{
+		sidecars = [](unsigned int type, const std::string &name, std::vector<unsigned char> &data)
+		{
+			return (type == SIDECAR_MATERIAL_LIBRARY && ReadFileContents(name, data));
+		};
+	}
+	else
+		sidecars = GetFileSidecarResolver(input, format);
+
+	bool converted;
+	if (WritesStandardOutput(input, options))
+	{
+		meshFile = STREAM_STANDARD;
+		converted = ConvertModelToStream(data.data(), data.size(), format, convertOptions, sidecars, standardOutput);
+	}
+	else
+	{
+		meshFile = (options.output.length() > 0 ? options.output : GetMeshFileName(input));
+		converted = ConvertModelToFile(data.data(), data.size(), format, convertOptions, sidecars, meshFile);
+	}
+	profile.SetConverted(converted);
+	return converted;
+}
@@ -0,0 +1,68 @@
+#ifndef __CONVERT_STREAM_H_INCLUDED__
+#define __CONVERT_STREAM_H_INCLUDED__
+
+#include <stdio.h>
+#include <string>
+
+#include "options.h"
+#include "library.h"
+
+// Given as the input or output, stands for standard input or output
+#define STREAM_STANDARD "-"
+
+// Where a single conversion reads from and writes to, for running the
+// converter in a pipe
+struct StreamOptions
+{
+	std::string output;                          // MESH file, STREAM_STANDARD for stdout, empty to name it after the input
+	unsigned int format;                         // MODEL_FORMAT_* of the input, MODEL_FORMAT_UNKNOWN to work it out
+
+	StreamOptions()
+	{
+		format = MODEL_FORMAT_UNKNOWN;
+	}
+};
+
+bool ParseStreamOption(const std::string &option, StreamOptions &options);
+void PrintStreamOptionUsage();
+
+/**
+ * @param input the input given on the command line
+ * @param options output and format given
+ *
+ * @return bool true if the conversion has to go through ConvertStream
+ *              rather than being a plain file to file conversion
+ */
+bool IsStreamConversion(const std::string &input, const StreamOptions &options);
+
+/**
+ * @param input the input given on the command line
+ * @param options output given
+ *
+ * @return bool true if the MESH file is written to standard output
+ */
+bool WritesStandardOutput(const std::string &input, const StreamOptions &options);
+
+/**
+ * Converts a single model, either of which may be standard input or
+ * output. The input is read to its end first, sequentially, since OBJ
+ * files are parsed in more than one pass and the MESH file gives every
+ * chunk's size ahead of its data anyway. The output is written as it's
+ * converted, so nothing goes through a temporary file. The format is the
+ * one given, else the one GetModelFormat finds. Models on
+ * standard input find material libraries in the working directory, and
+ * have no animation definitions
+ * @param input model file or STREAM_STANDARD
+ * @param options output and format
+ * @param convertOptions processing to apply
+ * @param standardOutput what DetachStandardOutput returned, if the MESH
+ *                       file goes to standard output
+ * @param meshFile receives the name of the MESH file written, or
+ *                 STREAM_STANDARD for standard output
+ *
+ * @return bool false if the model couldn't be read, converted or written
+ */
+bool ConvertStream(const std::string &input, const StreamOptions &options, const ConvertOptions &convertOptions, FILE *standardOutput,
+	std::string &meshFile);
+
+#endif
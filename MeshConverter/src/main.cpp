@@ -1,114 +1,171 @@
 #include <stdio.h>
 #include <string>
-#include <exception>
+#include <vector>
+#include <chrono>
 
-#include "md2/md2.h"
-#include "obj/obj.h"
-#include "sm/sm.h"
-#include "ms3d/ms3d.h"
+#include "mesh/meshfile.h"
+#include "mesh/meshcompress.h"
+#include "convert/options.h"
+#include "convert/convert.h"
+#include "convert/batch.h"
+#include "convert/cache.h"
+#include "convert/daemon.h"
+#include "convert/stream.h"
+#include "convert/profile.h"
+#include "util/files.h"
 
 int main(int argc, char **argv)
 {
+	ConvertOptions options;
+	BatchOptions batchOptions;
+	DaemonOptions daemonOptions;
+	StreamOptions streamOptions;
+	ProfileOptions profileOptions;
+	std::vector<std::string> files;
+	std::vector<std::string> convertArgs;
+	std::string unrecognized;
+	for (int i = 1; i < argc && unrecognized.length() == 0; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg.length() > 1 && arg[0] == '-')
+		{
+			// Conversion options are kept as given to pass on to a daemon
+			if (ParseOption(arg, options))
+				convertArgs.push_back(arg);
+			else if (!ParseBatchOption(arg, batchOptions) && !ParseDaemonOption(arg, daemonOptions) && !ParseStreamOption(arg, streamOptions)
+				&& !ParseProfileOption(arg, profileOptions))
+				unrecognized = arg;
+		}
+		else
+			files.push_back(arg);
+	}
+
+	// A MESH file written to stdout can't share it with messages, so they
+	// are moved to stderr before the first one
+	FILE *standardOutput = NULL;
+	if (files.size() == 1 && WritesStandardOutput(files[0], streamOptions))
+	{
+		standardOutput = DetachStandardOutput();
+		if (standardOutput == NULL)
+		{
+			fprintf(stderr, "Error redirecting standard output.\n\n");
+			return 1;
+		}
+	}
+
 	printf("MESH Converter\n");
 
-	if (argc == 1)
+	if (unrecognized.length() > 0)
 	{
-		printf("No input file specified.\n");
-		printf("Usage: meshconverter.exe [inputfile]\n\n");
+		printf("Unrecognized option %s.\n\n", unrecognized.c_str());
 		return 1;
 	}
 
-	std::string file = argv[1];
-	std::string extension;
+	// Written once the run is over, whichever way it ends
+	ProfileReport profileReport(profileOptions);
 
-	try
+	ConversionCache cache;
+	if (batchOptions.cacheDirectory.length() > 0 && !cache.Open(batchOptions.cacheDirectory))
 	{
-		extension = file.substr(file.find_last_of('.'), std::string::npos);
-		for (int i = 0; i < extension.size(); ++i)
-			extension[i] = tolower(extension[i]);
+		printf("Error creating cache directory %s.\n\n", batchOptions.cacheDirectory.c_str());
+		return 1;
 	}
-	catch (std::exception &e)
+
+	if (daemonOptions.serve)
+		return RunDaemon(daemonOptions, &cache);
+	if (daemonOptions.shutdown && files.size() == 0)
+		return RunDaemonClient(daemonOptions, files, convertArgs);
+
+	if (files.size() == 0 && batchOptions.listFiles.size() == 0)
 	{
-		extension = "";
+		printf("No input file specified.\n");
+		printf("Usage: meshconverter.exe [options] [inputfile|directory...|-]\n");
+		PrintOptionUsage();
+		PrintBatchOptionUsage();
+		PrintDaemonOptionUsage();
+		PrintStreamOptionUsage();
+		PrintProfileOptionUsage();
+		printf("\n");
+		return 1;
 	}
 
-	std::string meshFile = "";
-	if (extension.length() > 0)
+	if (daemonOptions.connect || daemonOptions.shutdown)
 	{
-		meshFile = file;
-		meshFile.erase(meshFile.find_last_of('.'), std::string::npos);
-		meshFile.append(".mesh");
+		if (daemonOptions.latencyRuns > 0)
+			return BenchmarkDaemonLatency(daemonOptions, files[0], convertArgs, argv[0]);
+		return RunDaemonClient(daemonOptions, files, convertArgs);
 	}
 
-	if (extension == ".obj")
+	if (IsStreamConversion(files.size() > 0 ? files[0] : "", streamOptions))
 	{
-		printf("Using OBJ converter.\n");
-
-		Obj *obj = new Obj();
-		if (!obj->Load(file, "./"))
+		if (files.size() > 1 || batchOptions.listFiles.size() > 0)
 		{
-			printf("Error loading OBJ file.\n\n");
+			printf("Standard input, --output and --format take a single input.\n\n");
 			return 1;
 		}
-		if (!obj->ConvertToMesh(meshFile))
-		{
-			printf("Error converting OBJ to MESH.\n\n");
-			return 1;
-		}
-	}
-	else if (extension == ".md2")
-	{
-		printf("Using MD2 converter.\n");
 
-		Md2 *md2 = new Md2();
-		if (!md2->Load(file))
-		{
-			printf("Error loading MD2 file.\n\n");
-			return 1;
-		}
-		if (!md2->ConvertToMesh(meshFile))
-		{
-			printf("Error converting MD2 to MESH.\n\n");
+		std::string meshFile;
+		bool converted = ConvertStream(files[0], streamOptions, options, standardOutput, meshFile);
+		if (standardOutput != NULL && fclose(standardOutput) != 0)
+			converted = false;
+		if (!converted)
 			return 1;
-		}
+
+		printf("Finished converting to %s\n", (meshFile == STREAM_STANDARD ? "standard output" : meshFile.c_str()));
+		return 0;
 	}
-	else if (extension == ".sm")
-	{
-		printf("Using SM converter.\n");
 
-		StaticModel *sm = new StaticModel();
-		if (!sm->Load(file))
-		{
-			printf("Error loading SM file.\n\n");
-			return 1;
-		}
-		if (!sm->ConvertToMesh(meshFile))
-		{
-			printf("Error converting SM to MESH.\n\n");
+	// Several inputs are converted side by side, and only failures make
+	// for a non-zero exit code
+	if (batchOptions.enabled || files.size() > 1 || batchOptions.listFiles.size() > 0 || IsDirectory(files[0]))
+	{
+		std::vector<BatchInput> inputs;
+		if (!GatherBatchInputs(files, batchOptions.listFiles, inputs))
 			return 1;
-		}
+
+		if (batchOptions.benchmark)
+			return (BenchmarkBatch(inputs, options, &cache) > 0 ? 1 : 0);
+		if (batchOptions.benchmarkMemory)
+			return (BenchmarkInMemory(inputs, options) > 0 ? 1 : 0);
+
+		BatchResult result = ConvertBatch(inputs, options, batchOptions.numJobs, &cache);
+		PrintBatchSummary(result);
+		return (result.numFailed > 0 ? 1 : 0);
 	}
-	else if (extension == ".ms3d")
+
+	std::string file = files[0];
+	if (GetFileExtension(file) == ".mesh")
 	{
-		printf("Using MS3D converter.\n");
+		printf("Inspecting MESH file.\n");
 
-		Ms3d *ms3d = new Ms3d();
-		if (!ms3d->Load(file))
+		// Only the chunk headers are read here, contents stay untouched on disk
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		MeshFile mesh;
+		if (!mesh.Open(file))
 		{
-			printf("Error loading MS3D file.\n\n");
+			printf("Error reading MESH file.\n\n");
 			return 1;
 		}
-		if (!ms3d->ConvertToMesh(meshFile))
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		printf("Version %d, %d chunks (indexed in %.3f ms)\n", mesh.GetVersion(), mesh.GetNumChunks(), elapsed);
+		for (unsigned int i = 0; i < mesh.GetNumChunks(); ++i)
 		{
-			printf("Error converting MS3D to MESH.\n\n");
-			return 1;
+			const MeshChunk *chunk = mesh.GetChunk(i);
+			if (chunk->encoding != MESH_ENCODING_NONE)
+				printf("  %s %12lu bytes (%lu stored, %s)\n", chunk->tag, chunk->size, chunk->encodedSize + MESH_COMPRESSED_HEADER_SIZE, GetMeshEncodingName(chunk->encoding));
+			else
+				printf("  %s %12lu bytes\n", chunk->tag, chunk->size);
 		}
+		printf("\n");
+
+		return 0;
 	}
-	else
-	{
-		printf("Unrecognized file type.\n\n");
+
+	std::string meshFile = GetMeshFileName(file);
+	bool hit = false;
+	if (cache.IsOpen() ? !cache.Convert(file, meshFile, options, hit) : !ConvertFileTo(file, meshFile, options))
 		return 1;
-	}
 
 	printf("Finished converting to %s\n", meshFile.c_str());
 
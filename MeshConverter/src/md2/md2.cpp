@@ -1,6 +1,54 @@
 #include "md2.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+#include "../processing/vertexcache.h"
+#include "../processing/vertexfetch.h"
+#include "../processing/indexlayout.h"
+#include "../mesh/meshwriter.h"
+#include "../util/memoryreader.h"
+#include "../util/parallel.h"
+#include "../util/profiler.h"
+
+// Bytes each element takes up in an MD2 file, a frame that many before its
+// vertices
+#define MD2_TEXCOORD_SIZE 4
+#define MD2_POLYGON_SIZE 12
+#define MD2_FRAME_HEADER_SIZE 40
+#define MD2_VERTEX_SIZE 4
+
+// Whether count items of itemSize bytes starting at offset lie within the file
+static bool IsSectionInFile(MemoryReader &input, int offset, int count, size_t itemSize)
+{
+	if (count == 0)
+		return true;
+	return (offset >= 0 && count > 0 && input.Seek(offset, SEEK_SET) && input.HasRoomFor(itemSize, count));
+}
+
+static void WritePolygon(FILE *fp, const Md2Polygon *polygon)
+{
+	long data;
+
+	// vertex indices
+	data = polygon->vertex[0];
+	fwrite(&data, sizeof(long), 1, fp);
+	data = polygon->vertex[1];
+	fwrite(&data, sizeof(long), 1, fp);
+	data = polygon->vertex[2];
+	fwrite(&data, sizeof(long), 1, fp);
+
+	// tex coord indices
+	data = polygon->texCoord[0];
+	fwrite(&data, sizeof(long), 1, fp);
+	data = polygon->texCoord[1];
+	fwrite(&data, sizeof(long), 1, fp);
+	data = polygon->texCoord[2];
+	fwrite(&data, sizeof(long), 1, fp);
+}
 
 Md2::Md2()
 {
@@ -32,51 +80,60 @@ void Md2::Release()
 	m_skins = NULL;
 }
 
-bool Md2::Load(const std::string &file)
+std::string Md2::GetAnimationFile(const std::string &file)
+{
+	std::string animationFile = file;
+	if (animationFile.find_last_of('.') != std::string::npos)
+		animationFile.erase(animationFile.find_last_of('.'));
+	animationFile.append(".animations");
+	return animationFile;
+}
+
+bool Md2::Load(const void *data, size_t size, const SidecarResolver &sidecars)
 {
-	FILE *fp;
 	unsigned char c;
 	unsigned short u, v, t;
 	float x, y, z;
 	Md2Header header;
 	Vector3 scale, translate;
 
-	fp = fopen(file.c_str(), "rb");
-	if (!fp)
-		return false;
+	MemoryReader input(data, size);
 
 	// Simple filetype verification
-	fread(&header.ident, 4, 1, fp);
+	input.Read(&header.ident, 4, 1);
 	if (header.ident[0] != 'I' || header.ident[1] != 'D' || header.ident[2] != 'P' || header.ident[3] != '2')
-	{
-		fclose(fp);
 		return false;
-	}
-	fread(&header.version, 4, 1, fp);
+	input.Read(&header.version, 4, 1);
 	if (header.version != 8)
-	{
-		fclose(fp);
 		return false;
-	}
 
 	Release();
 
 	// Read rest of the MD2 header
-	fread(&header.skinWidth, 4, 1, fp);
-	fread(&header.skinHeight, 4, 1, fp);
-	fread(&header.frameSize, 4, 1, fp);
-	fread(&header.numSkins, 4, 1, fp);
-	fread(&header.numVertices, 4, 1, fp);
-	fread(&header.numTexCoords, 4, 1, fp);
-	fread(&header.numPolys, 4, 1, fp);
-	fread(&header.numGlCmds, 4, 1, fp);
-	fread(&header.numFrames, 4, 1, fp);
-	fread(&header.offsetSkins, 4, 1, fp);
-	fread(&header.offsetTexCoords, 4, 1, fp);
-	fread(&header.offsetPolys, 4, 1, fp);
-	fread(&header.offsetFrames, 4, 1, fp);
-	fread(&header.offsetGlCmds, 4, 1, fp);
-	fread(&header.offsetEnd, 4, 1, fp);
+	input.Read(&header.skinWidth, 4, 1);
+	input.Read(&header.skinHeight, 4, 1);
+	input.Read(&header.frameSize, 4, 1);
+	input.Read(&header.numSkins, 4, 1);
+	input.Read(&header.numVertices, 4, 1);
+	input.Read(&header.numTexCoords, 4, 1);
+	input.Read(&header.numPolys, 4, 1);
+	input.Read(&header.numGlCmds, 4, 1);
+	input.Read(&header.numFrames, 4, 1);
+	input.Read(&header.offsetSkins, 4, 1);
+	input.Read(&header.offsetTexCoords, 4, 1);
+	input.Read(&header.offsetPolys, 4, 1);
+	input.Read(&header.offsetFrames, 4, 1);
+	input.Read(&header.offsetGlCmds, 4, 1);
+	input.Read(&header.offsetEnd, 4, 1);
+
+	// Counts the sections they describe don't fit in the file are rejected
+	// before anything is allocated for them
+	if (header.numVertices < 0 ||
+		!IsSectionInFile(input, header.offsetSkins, header.numSkins, MD2_SKIN_NAME_LENGTH) ||
+		!IsSectionInFile(input, header.offsetTexCoords, header.numTexCoords, MD2_TEXCOORD_SIZE) ||
+		!IsSectionInFile(input, header.offsetPolys, header.numPolys, MD2_POLYGON_SIZE) ||
+		!IsSectionInFile(input, header.offsetFrames, header.numFrames, MD2_FRAME_HEADER_SIZE + (size_t)header.numVertices * MD2_VERTEX_SIZE))
+		return false;
 
 	// Allocate memory
 	if (header.numSkins > 0)
@@ -100,16 +157,16 @@ bool Md2::Load(const std::string &file)
 	m_numVertices = header.numVertices;
 
 	// Read skin info
-	fseek(fp, header.offsetSkins, SEEK_SET);
+	input.Seek(header.offsetSkins, SEEK_SET);
 	for (int i = 0; i < header.numSkins; ++i)
 	{
 		// Not wasting the full 64 characters stored in the file here
 		for (int j = 0; j < MD2_SKIN_NAME_LENGTH; ++j)
 		{
-			fread(&c, 1, 1, fp);
+			input.Read(&c, 1, 1);
 			if (!c)
 			{
-				fseek(fp, MD2_SKIN_NAME_LENGTH - j - 1, SEEK_CUR);
+				input.Seek(MD2_SKIN_NAME_LENGTH - j - 1, SEEK_CUR);
 				break;
 			}
 			else
@@ -118,37 +175,37 @@ bool Md2::Load(const std::string &file)
 	}
 
 	// Read texture coordinates
-	fseek(fp, header.offsetTexCoords, SEEK_SET);
+	input.Seek(header.offsetTexCoords, SEEK_SET);
 	for (int i = 0; i < header.numTexCoords; ++i)
 	{
-		fread(&u, 2, 1, fp);
-		fread(&v, 2, 1, fp);
+		input.Read(&u, 2, 1);
+		input.Read(&v, 2, 1);
 		m_texCoords[i].x = u / (float)header.skinWidth;
 		m_texCoords[i].y = v / (float)header.skinHeight;
 	}
 
 	// Read polygons (this is all just indexes into m_texCoords and m_frames[].vertices)
-	fseek(fp, header.offsetPolys, SEEK_SET);
+	input.Seek(header.offsetPolys, SEEK_SET);
 	for (int i = 0; i < header.numPolys; ++i)
 	{
-		fread(&t, 2, 1, fp);
+		input.Read(&t, 2, 1);
 		m_polys[i].vertex[0] = t;
-		fread(&t, 2, 1, fp);
+		input.Read(&t, 2, 1);
 		m_polys[i].vertex[2] = t;
-		fread(&t, 2, 1, fp);
+		input.Read(&t, 2, 1);
 		m_polys[i].vertex[1] = t;
 
 		// HACK: Not sure why some of these indexes are invalid? This seems to fix the problem
-		fread(&t, 2, 1, fp);
+		input.Read(&t, 2, 1);
 		m_polys[i].texCoord[0] = (t == 65535 ? 0 : t);
-		fread(&t, 2, 1, fp);
+		input.Read(&t, 2, 1);
 		m_polys[i].texCoord[2] = (t == 65535 ? 0 : t);
-		fread(&t, 2, 1, fp);
+		input.Read(&t, 2, 1);
 		m_polys[i].texCoord[1] = (t == 65535 ? 0 : t);
 	}
 
 	// Read frames
-	fseek(fp, header.offsetFrames, SEEK_SET);
+	input.Seek(header.offsetFrames, SEEK_SET);
 	for (int i = 0; i < header.numFrames; ++i)
 	{
 		// Allocate enough memory for this frame's vertex/normal indexes
@@ -158,22 +215,22 @@ bool Md2::Load(const std::string &file)
 		//ASSERT(m_frames[i].vertices != NULL);
 		//ASSERT(m_frames[i].normals != NULL);
 
-		fread(&scale.x, 4, 1, fp);
-		fread(&scale.y, 4, 1, fp);
-		fread(&scale.z, 4, 1, fp);
+		input.Read(&scale.x, 4, 1);
+		input.Read(&scale.y, 4, 1);
+		input.Read(&scale.z, 4, 1);
 
-		fread(&translate.x, 4, 1, fp);
-		fread(&translate.y, 4, 1, fp);
-		fread(&translate.z, 4, 1, fp);
+		input.Read(&translate.x, 4, 1);
+		input.Read(&translate.y, 4, 1);
+		input.Read(&translate.z, 4, 1);
 
 		// Store the text name of the frame (we won't waste the full 16 characters
 		// reserved in the file here)
 		for (int j = 0; j < MD2_FRAME_NAME_LENGTH; ++j)
 		{
-			fread(&c, 1, 1, fp);
+			input.Read(&c, 1, 1);
 			if (!c)
 			{
-				fseek(fp, MD2_FRAME_NAME_LENGTH - j - 1, SEEK_CUR);
+				input.Seek(MD2_FRAME_NAME_LENGTH - j - 1, SEEK_CUR);
 				break;
 			}
 			else
@@ -183,11 +240,11 @@ bool Md2::Load(const std::string &file)
 		// Read vertices, and decompress as we load them for performance when rendering
 		for (int j = 0; j < header.numVertices; ++j)
 		{
-			fread(&c, 1, 1, fp);
+			input.Read(&c, 1, 1);
 			x = (float)c;
-			fread(&c, 1, 1, fp);
+			input.Read(&c, 1, 1);
 			y = (float)c;
-			fread(&c, 1, 1, fp);
+			input.Read(&c, 1, 1);
 			z = (float)c;
 
 			// Convert to OpenGL's coordinate system, otherwise models will need to be rotated to be drawn upright
@@ -195,66 +252,64 @@ bool Md2::Load(const std::string &file)
 			m_frames[i].vertices[j].y = (z * scale.z) + translate.z;
 			m_frames[i].vertices[j].z = -1.0f * ((y * scale.y) + translate.y);
 
-			fread(&c, 1, 1, fp);		// Dummy command to increment file pointer (we don't care about the normal index)
+			input.Read(&c, 1, 1);		// Dummy command to increment file pointer (we don't care about the normal index)
 		}
 
 		//m_frameMap[m_frames[i].name] = i;
 	}
 
-	fclose(fp);
-
 	// Cleanup and finishing touches.
 	// Vertex coordinates, as of now, are waaay out of range (most likely, unless the model is tiny).
 	// We could've scaled them down above while reading them in, but I noticed issues calculating normals
 	// when that was done (probably due to lacking precision). So, we calculate the normals using the 
 	// un-touched coordinates (get the most accurate normal calc that way), then scale the vertex down.
-	for (int i = 0; i < header.numFrames; ++i)
 	{
-		// Calculate vertex normals
-		Vector3 sumNormal;
-		int sum;
-		for (int j = 0; j < header.numVertices; ++j)
+		ProfileScope scope(PROFILE_STAGE_NORMALS, (unsigned long long)header.numFrames * header.numVertices);
+		for (int i = 0; i < header.numFrames; ++i)
 		{
-			sum = 0;
-			sumNormal = Vector3(0, 0, 0);
-			for (int k = 0; k < header.numPolys; ++k)
+			// Calculate vertex normals
+			Vector3 sumNormal;
+			int sum;
+			for (int j = 0; j < header.numVertices; ++j)
 			{
-				if (m_polys[k].vertex[0] == j || m_polys[k].vertex[1] == j || m_polys[k].vertex[2] == j)
+				sum = 0;
+				sumNormal = Vector3(0, 0, 0);
+				for (int k = 0; k < header.numPolys; ++k)
 				{
-					++sum;
-					sumNormal += Vector3::SurfaceNormal(m_frames[i].vertices[m_polys[k].vertex[0]], 
-						m_frames[i].vertices[m_polys[k].vertex[1]], 
-						m_frames[i].vertices[m_polys[k].vertex[2]]);
+					if (m_polys[k].vertex[0] == j || m_polys[k].vertex[1] == j || m_polys[k].vertex[2] == j)
+					{
+						++sum;
+						sumNormal += Vector3::SurfaceNormal(m_frames[i].vertices[m_polys[k].vertex[0]], 
+							m_frames[i].vertices[m_polys[k].vertex[1]], 
+							m_frames[i].vertices[m_polys[k].vertex[2]]);
+					}
 				}
+				m_frames[i].normals[j] = sumNormal / (float)sum;
 			}
-			m_frames[i].normals[j] = sumNormal / (float)sum;
-		}
 
-		//// Done, now scale the vertices down
-		//for (int j = 0; j < header.numVertices; ++j)
-		//{
-		//	m_frames[i].vertices[j] /= (float)(MD2_SCALE_FACTOR);
-		//}
+			//// Done, now scale the vertices down
+			//for (int j = 0; j < header.numVertices; ++j)
+			//{
+			//	m_frames[i].vertices[j] /= (float)(MD2_SCALE_FACTOR);
+			//}
+		}
 	}
 
 	// check for an animation definition file
-	std::string animationFile = file;
-	animationFile.erase(animationFile.find_last_of('.', std::string::npos));
-	animationFile.append(".animations");
-
-	fp = fopen(animationFile.c_str(), "r");
-	if (fp != NULL)
+	std::vector<unsigned char> animations;
+	if (sidecars && sidecars(SIDECAR_ANIMATIONS, "", animations))
 	{
-		char *buffer = new char[80];
+		MemoryReader definitions(animations.data(), animations.size());
+		char *buffer = new char[80]();
 		std::string line;
 		std::string name;
 		std::string temp;
 		int start;
 		int end;
 
-		while (!feof(fp))
+		while (!definitions.IsAtEnd())
 		{
-			fgets(buffer, 80, fp);
+			definitions.ReadLine(buffer, 80);
 			line = buffer;
 
 			if (strlen(buffer) > 5)		// minimum length for a viable frame definition
@@ -276,30 +331,35 @@ bool Md2::Load(const std::string &file)
 				temp = line.substr(startEnd + 1, std::string::npos);
 				end = atoi(temp.c_str());
 
-				Md2Animation *animation = new Md2Animation();
-				animation->name = name;
-				animation->startFrame = start;
-				animation->endFrame = end;
-				m_animations.push_back(*animation);
+				Md2Animation animation;
+				animation.name = name;
+				animation.startFrame = start;
+				animation.endFrame = end;
+				m_animations.push_back(animation);
 			}
 		}
 		delete[] buffer;
-
-		fclose(fp);
 	}
 
 	return true;
 }
 
-bool Md2::ConvertToMesh(const std::string &file)
+bool Md2::ConvertToMesh(FILE *fp, const ConvertOptions &options)
 {
-	FILE *fp = fopen(file.c_str(), "wb");
-	if (fp == NULL)
-		return false;
+	if (options.optimizeVertexCache)
+		ReorderForVertexCache();
+	if (options.optimizeVertexFetch)
+		ReorderForVertexFetch();
 
-	fputs("MESH", fp);
-	unsigned char version = 1;
-	fwrite(&version, 1, 1, fp);
+	WriteMeshHeader(fp, options.compactIndices);
+
+	// bounds chunk, first so a loader can cull before reading anything else
+	if (options.computeBounds)
+	{
+		MeshBounds bounds;
+		ComputeBoundingVolumes(bounds);
+		WriteBoundsChunk(fp, bounds);
+	}
 
 	// keyframes chunk
 	fputs("KFR", fp);
@@ -344,30 +404,48 @@ bool Md2::ConvertToMesh(const std::string &file)
 	}
 
 	// triangles chunk
+	IndexLayout layout;
+	const IndexLayout *indexLayout = NULL;
+	if (options.compactIndices)
+	{
+		std::vector<unsigned int> indices(m_numPolys * 6);
+		for (int i = 0; i < m_numPolys; ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				indices[i * 6 + j] = m_polys[i].vertex[j];
+				indices[i * 6 + 3 + j] = m_polys[i].texCoord[j];
+			}
+		}
+		unsigned int streamSizes[2] = { (unsigned int)m_numVertices, (unsigned int)m_numTexCoords };
+		BuildIndexLayout(indices.data(), m_numPolys, 2, streamSizes, options.splitIndices, layout);
+		PrintIndexLayout("KTR", layout, m_numPolys * 6, sizeof(long));
+		indexLayout = &layout;
+	}
 	fputs("KTR", fp);
 	long numPolys = m_numPolys;
-	long sizeofPolys = (sizeof(long) * 3 * 2) * numPolys + sizeof(long);
+	long indexSize = (indexLayout == NULL ? sizeof(long) : indexLayout->indexSize);
+	long sizeofPolys = (indexSize * 3 * 2) * numPolys + GetTriangleListHeaderSize(indexLayout);
 	fwrite(&sizeofPolys, sizeof(long), 1, fp);
-	fwrite(&numPolys, sizeof(long), 1, fp);
-	for (long i = 0; i < numPolys; ++i)
+	WriteTriangleListHeader(fp, numPolys, indexLayout);
+	if (indexLayout == NULL)
 	{
-		long data;
-
-		// vertex indices
-		data = m_polys[i].vertex[0];
-		fwrite(&data, sizeof(long), 1, fp);
-		data = m_polys[i].vertex[1];
-		fwrite(&data, sizeof(long), 1, fp);
-		data = m_polys[i].vertex[2];
-		fwrite(&data, sizeof(long), 1, fp);
-
-		// tex coord indices
-		data = m_polys[i].texCoord[0];
-		fwrite(&data, sizeof(long), 1, fp);
-		data = m_polys[i].texCoord[1];
-		fwrite(&data, sizeof(long), 1, fp);
-		data = m_polys[i].texCoord[2];
-		fwrite(&data, sizeof(long), 1, fp);
+		for (long i = 0; i < numPolys; ++i)
+			WritePolygon(fp, &m_polys[i]);
+	}
+	else
+	{
+		for (unsigned int i = 0; i < layout.batches.size(); ++i)
+		{
+			const IndexBatch *batch = &layout.batches[i];
+			for (unsigned int j = batch->firstTriangle; j < batch->firstTriangle + batch->numTriangles; ++j)
+			{
+				for (int k = 0; k < 3; ++k)
+					WriteIndex(fp, m_polys[j].vertex[k], batch->base[0], layout.indexSize);
+				for (int k = 0; k < 3; ++k)
+					WriteIndex(fp, m_polys[j].texCoord[k], batch->base[1], layout.indexSize);
+			}
+		}
 	}
 
 	if (m_animations.size() > 0)
@@ -397,6 +475,118 @@ bool Md2::ConvertToMesh(const std::string &file)
 		}
 	}
 
-	fclose(fp);
-	return true;
+	return (ferror(fp) == 0);
+}
+
+void Md2::ReorderForVertexCache()
+{
+	ProfileScope scope(PROFILE_STAGE_VERTEX_CACHE, m_numPolys);
+	if (m_numPolys == 0)
+		return;
+
+	// MD2 has no material or group ranges, every frame shares the one index list
+	std::vector<unsigned int> indices(m_numPolys * 3);
+	for (int i = 0; i < m_numPolys; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			indices[i * 3 + j] = m_polys[i].vertex[j];
+	}
+	VertexCacheStats before = AnalyzeVertexCache(&indices[0], m_numPolys, m_numVertices);
+
+	std::vector<unsigned int> order(m_numPolys);
+	OptimizeVertexCache(&indices[0], m_numPolys, &order[0]);
+
+	std::vector<Md2Polygon> reordered(m_numPolys);
+	for (int i = 0; i < m_numPolys; ++i)
+		reordered[i] = m_polys[order[i]];
+	for (int i = 0; i < m_numPolys; ++i)
+	{
+		m_polys[i] = reordered[i];
+		for (int j = 0; j < 3; ++j)
+			indices[i * 3 + j] = m_polys[i].vertex[j];
+	}
+
+	VertexCacheStats after = AnalyzeVertexCache(&indices[0], m_numPolys, m_numVertices);
+	printf("Vertex cache ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.acmr, after.acmr, before.atvr, after.atvr);
+}
+
+void Md2::ReorderForVertexFetch()
+{
+	ProfileScope scope(PROFILE_STAGE_VERTEX_FETCH, m_numPolys);
+	if (m_numPolys == 0)
+		return;
+
+	std::vector<unsigned int> vertices(m_numPolys * 3);
+	std::vector<unsigned int> texCoords(m_numPolys * 3);
+	for (int i = 0; i < m_numPolys; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			vertices[i * 3 + j] = m_polys[i].vertex[j];
+			texCoords[i * 3 + j] = m_polys[i].texCoord[j];
+		}
+	}
+	VertexFetchStats before = AnalyzeVertexFetch(&vertices[0], vertices.size(), m_numVertices, sizeof(Vector3));
+
+	// Every frame is indexed by the same triangles, so all of them get the
+	// exact same renumbering to keep the animation intact
+	std::vector<unsigned int> vertexRemap(m_numVertices);
+	std::vector<unsigned int> texCoordRemap(m_numTexCoords);
+	OptimizeVertexFetch(&vertices[0], vertices.size(), m_numVertices, vertexRemap.data());
+	OptimizeVertexFetch(&texCoords[0], texCoords.size(), m_numTexCoords, texCoordRemap.data());
+	for (int i = 0; i < m_numFrames; ++i)
+	{
+		RemapVertexArray(m_frames[i].vertices, m_numVertices, vertexRemap.data());
+		RemapVertexArray(m_frames[i].normals, m_numVertices, vertexRemap.data());
+	}
+	RemapVertexArray(m_texCoords, m_numTexCoords, texCoordRemap.data());
+
+	for (int i = 0; i < m_numPolys; ++i)
+	{
+		Md2Polygon *polygon = &m_polys[i];
+		for (int j = 0; j < 3; ++j)
+		{
+			if (polygon->vertex[j] < m_numVertices)
+				polygon->vertex[j] = vertexRemap[polygon->vertex[j]];
+			if (polygon->texCoord[j] < m_numTexCoords)
+				polygon->texCoord[j] = texCoordRemap[polygon->texCoord[j]];
+			vertices[i * 3 + j] = polygon->vertex[j];
+		}
+	}
+
+	VertexFetchStats after = AnalyzeVertexFetch(&vertices[0], vertices.size(), m_numVertices, sizeof(Vector3));
+	printf("Vertex fetch overfetch %.3f -> %.3f, lines per triangle %.3f -> %.3f\n", before.overfetch, after.overfetch, before.linesPerTriangle, after.linesPerTriangle);
+}
+
+void Md2::ComputeBoundingVolumes(MeshBounds &bounds)
+{
+	ProfileScope scope(PROFILE_STAGE_BOUNDS, m_numPolys);
+	std::vector<const Vector3*> frames(m_numFrames);
+	for (int i = 0; i < m_numFrames; ++i)
+		frames[i] = m_frames[i].vertices;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	ComputeBounds(frames.data(), m_numFrames, m_numVertices, bounds.mesh);
+
+	bounds.frames.resize(m_numFrames);
+	ParallelFor(m_numFrames, [&](unsigned int i)
+	{
+		ComputeBounds(frames[i], m_numVertices, bounds.frames[i]);
+	});
+
+	// Animations cover their start and end frames. Ones that run past the
+	// last frame are clamped, ones that don't make sense are left empty
+	bounds.animations.resize(m_animations.size());
+	ParallelFor(m_animations.size(), [&](unsigned int i)
+	{
+		const Md2Animation *animation = &m_animations[i];
+		unsigned int endFrame = std::min(animation->endFrame, (unsigned int)m_numFrames - 1);
+		if (m_numFrames == 0 || animation->startFrame > endFrame)
+			ClearBounds(bounds.animations[i]);
+		else
+			ComputeBounds(&frames[animation->startFrame], endFrame - animation->startFrame + 1, m_numVertices, bounds.animations[i]);
+	});
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	printf("Bounds for the mesh, %d frames and %u animations computed in %.2f ms\n", m_numFrames, (unsigned int)m_animations.size(), elapsed);
 }
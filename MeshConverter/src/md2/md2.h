@@ -3,7 +3,11 @@
 
 #include "../geometry/vector3.h"
 #include "../geometry/vector2.h"
+#include "../convert/options.h"
+#include "../convert/sidecar.h"
+#include "../processing/bounds.h"
 
+#include <stdio.h>
 #include <string>
 #include <vector>
 
@@ -72,8 +76,32 @@ public:
 	virtual ~Md2()                                  { Release(); }
 
 	void Release();
-	bool Load(const std::string &file);
-	bool ConvertToMesh(const std::string &file);
+
+	/**
+	 * @param data contents of an MD2 file
+	 * @param size size of data in bytes
+	 * @param sidecars asked for the model's animation definitions, which
+	 *                 are optional, or empty to go without
+	 *
+	 * @return bool false if data isn't an MD2 model
+	 */
+	bool Load(const void *data, size_t size, const SidecarResolver &sidecars = SidecarResolver());
+
+	/**
+	 * @param fp stream to write the MESH file to
+	 * @param options processing to apply
+	 *
+	 * @return bool false if writing failed
+	 */
+	bool ConvertToMesh(FILE *fp, const ConvertOptions &options = ConvertOptions());
+
+	/**
+	 * @param file model file
+	 *
+	 * @return std::string the animation definition file Load looks for
+	 *                     next to the model, which may not exist
+	 */
+	static std::string GetAnimationFile(const std::string &file);
 
 	int GetNumFrames()                              { return m_numFrames; }
 	int GetNumVertices()                            { return m_numVertices; }
@@ -85,6 +113,10 @@ public:
 	Vector2* GetTexCoords()                         { return m_texCoords; }
 
 private:
+	void ReorderForVertexCache();
+	void ReorderForVertexFetch();
+	void ComputeBoundingVolumes(MeshBounds &bounds);
+
 	int m_numFrames;
 	int m_numVertices;
 	int m_numTexCoords;
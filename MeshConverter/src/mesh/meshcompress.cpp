@@ -0,0 +1,336 @@
+#include "meshcompress.h"
+#include "meshfile.h"
+#include "../codec/meshcodec.h"
+#include "../codec/lz.h"
+#include "../util/files.h"
+#include "../util/memoryfile.h"
+#include "../util/parallel.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+// Decoding is repeated until it has taken at least this long, or this many
+// times, and the fastest run is reported
+#define DECODE_BENCHMARK_MIN_MS 20.0
+#define DECODE_BENCHMARK_MAX_RUNS 50
+
+static long ReadLongAt(const MeshChunk *chunk, size_t offset)
+{
+	long value = 0;
+	if (offset + sizeof(long) <= chunk->size)
+		memcpy(&value, chunk->data + offset, sizeof(long));
+	return value;
+}
+
+// Records run from the end of the prefix to the end of the chunk
+static bool SetRecords(const MeshChunk *chunk, size_t prefixSize, size_t stride, size_t distance, MeshCodecLayout &layout)
+{
+	if (prefixSize > chunk->size || stride == 0 || (chunk->size - prefixSize) % stride != 0)
+		return false;
+
+	layout.prefixSize = prefixSize;
+	layout.count = (chunk->size - prefixSize) / stride;
+	layout.stride = stride;
+	layout.distance = (distance > 0 ? distance : 1);
+	layout.indexWidth = 0;
+	layout.numIndexStreams = 0;
+	return true;
+}
+
+// A triangle list starting at offset, laid out as ReadTriangleList in
+// meshfile.cpp expects it. The index width is the layout's in version 2
+// files, otherwise whatever type the converter wrote
+static bool GetTriangleListLayout(const MeshChunk *chunk, size_t offset, unsigned char version, bool keyframe, MeshCodecLayout &layout)
+{
+	long count = ReadLongAt(chunk, offset);
+	offset += sizeof(long);
+
+	long indexSize = 0;
+	if (version >= MESH_VERSION_COMPACT_INDICES)
+	{
+		indexSize = ReadLongAt(chunk, offset);
+		long numBatches = ReadLongAt(chunk, offset + sizeof(long));
+		if ((indexSize != 2 && indexSize != 4) || numBatches < 0)
+			return false;
+		offset += sizeof(long) * (2 + numBatches * (2 + INDEX_LAYOUT_MAX_STREAMS));
+	}
+	if (count <= 0 || offset > chunk->size || (chunk->size - offset) % count != 0)
+		return false;
+	size_t stride = (chunk->size - offset) / count;
+
+	unsigned int indexWidth;
+	unsigned int numIndexStreams;
+	if (keyframe)
+	{
+		indexWidth = (indexSize != 0 ? indexSize : sizeof(long));
+		numIndexStreams = 2;
+	}
+	else if (stride == (indexSize != 0 ? indexSize : sizeof(int)) * 3 + sizeof(int) + (sizeof(float) * 3) * 3 + (sizeof(float) * 2) * 3)
+	{
+		indexWidth = (indexSize != 0 ? indexSize : sizeof(int));
+		numIndexStreams = 1;
+	}
+	else
+	{
+		indexWidth = (indexSize != 0 ? indexSize : sizeof(long));
+		numIndexStreams = 3;
+	}
+
+	if (!SetRecords(chunk, offset, stride, 1, layout) || stride < indexWidth * 3 * numIndexStreams)
+		return false;
+	layout.indexWidth = indexWidth;
+	layout.numIndexStreams = numIndexStreams;
+	return true;
+}
+
+// Works out how a chunk splits into records for the mesh codec, chunks
+// it can't do anything useful with return false
+static bool GetChunkLayout(const MeshChunk *chunk, unsigned char version, MeshCodecLayout &layout)
+{
+	const char *tag = chunk->tag;
+	if (strcmp(tag, "VTX") == 0 || strcmp(tag, "NRL") == 0)
+		return SetRecords(chunk, sizeof(long), sizeof(float) * 3, 1, layout);
+	if (strcmp(tag, "TXT") == 0 || strcmp(tag, "KTX") == 0)
+		return SetRecords(chunk, sizeof(long), sizeof(float) * 2, 1, layout);
+	if (strcmp(tag, "QVT") == 0)
+		return SetRecords(chunk, sizeof(long) + sizeof(float) * 6, sizeof(unsigned short) * 3, 1, layout);
+	if (strcmp(tag, "QNR") == 0)
+		return SetRecords(chunk, sizeof(long) * 2, (ReadLongAt(chunk, sizeof(long)) > 8 ? 4 : 2), 1, layout);
+	if (strcmp(tag, "QTX") == 0)
+		return SetRecords(chunk, sizeof(long) * 2 + sizeof(float) * 4, sizeof(unsigned short) * 2, 1, layout);
+	if (strcmp(tag, "JTV") == 0)
+		return SetRecords(chunk, sizeof(long), sizeof(int) + sizeof(float), 1, layout);
+	if (strcmp(tag, "BND") == 0)
+		return SetRecords(chunk, sizeof(long) * 3, sizeof(float) * 10, 1, layout);
+	if (strcmp(tag, "TAN") == 0)
+		return SetRecords(chunk, sizeof(long), sizeof(float) * 4, 1, layout);
+
+	// Keyframes are predicted from the same vertex or joint one frame back
+	if (strcmp(tag, "KFR") == 0)
+		return SetRecords(chunk, sizeof(long) * 2, sizeof(float) * 3, ReadLongAt(chunk, sizeof(long)) * 2, layout);
+	if (strcmp(tag, "JKF") == 0)
+	{
+		long numFrames = ReadLongAt(chunk, 0);
+		size_t frameSize = sizeof(float) * 6;
+		size_t numJoints = (numFrames > 0 ? (chunk->size - sizeof(long)) / frameSize / numFrames : 0);
+		return SetRecords(chunk, sizeof(long), frameSize, numJoints, layout);
+	}
+
+	if (strcmp(tag, "TRI") == 0)
+		return GetTriangleListLayout(chunk, 0, version, false, layout);
+	if (strcmp(tag, "KTR") == 0)
+		return GetTriangleListLayout(chunk, 0, version, true, layout);
+	if (strcmp(tag, "LOD") == 0)
+	{
+		long numLevels = ReadLongAt(chunk, 0);
+		if (numLevels < 0)
+			return false;
+		return GetTriangleListLayout(chunk, sizeof(long) + numLevels * (sizeof(float) * 2 + sizeof(long) * 2), version, false, layout);
+	}
+
+	return false;
+}
+
+static void WriteChunk(FILE *fp, const char *tag, const unsigned char *data, long size)
+{
+	fwrite(tag, MESH_CHUNK_TAG_LENGTH, 1, fp);
+	fwrite(&size, sizeof(long), 1, fp);
+	fwrite(data, size, 1, fp);
+}
+
+static double GetMegabytesPerSecond(size_t bytes, double milliseconds)
+{
+	return (milliseconds > 0.0 ? bytes / (milliseconds * 1000.0) : 0.0);
+}
+
+// Decodes a chunk again the way MeshFile would, repeating until the
+// benchmark limits are reached. Returns the fastest run in milliseconds, or
+// a negative time if the chunk doesn't decode to its original data
+static double VerifyChunk(const MeshChunk *chunk, const std::vector<unsigned char> &encoded)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	std::vector<unsigned char> decoded(chunk->size);
+	double decodeTime = 0.0;
+	double elapsed = 0.0;
+	for (int run = 0; run < DECODE_BENCHMARK_MAX_RUNS && elapsed < DECODE_BENCHMARK_MIN_MS; ++run)
+	{
+		Clock::time_point start = Clock::now();
+		bool valid;
+		if (chunk->encoding == MESH_ENCODING_MESH_CODEC)
+			valid = DecodeMeshChunk(encoded.data(), encoded.size(), decoded.data(), decoded.size());
+		else
+			valid = LzDecompress(encoded.data(), encoded.size(), decoded.data(), decoded.size());
+		double runTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		if (!valid || memcmp(decoded.data(), chunk->data, chunk->size) != 0)
+			return -1.0;
+		decodeTime = (run == 0 || runTime < decodeTime ? runTime : decodeTime);
+		elapsed += runTime;
+	}
+	return decodeTime;
+}
+
+bool CompressMeshFile(const std::string &file, unsigned int compression)
+{
+	std::vector<unsigned char> data;
+	if (!ReadFileContents(file, data) || !CompressMeshData(data, compression))
+		return false;
+	return WriteFileContents(file, data.data(), data.size());
+}
+
+bool CompressMeshData(std::vector<unsigned char> &data, unsigned int compression)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	MeshFile mesh;
+	if (!mesh.Open(data.data(), data.size()))
+		return false;
+
+	// Everything is copied out first, data is replaced by the compressed
+	// file at the end
+	unsigned char version = mesh.GetVersion();
+	std::vector<MeshChunk> chunks;
+	std::vector<std::vector<unsigned char> > contents;
+	for (unsigned int i = 0; i < mesh.GetNumChunks(); ++i)
+	{
+		const MeshChunk *chunk = mesh.GetChunk(i);
+		if (chunk->data == NULL && (chunk = mesh.FindChunk(chunk->tag)) == NULL)
+			return false;
+		chunks.push_back(*chunk);
+		contents.push_back(std::vector<unsigned char>(chunk->data, chunk->data + chunk->size));
+	}
+	mesh.Close();
+
+	// Chunks don't depend on each other, so they are all encoded at once.
+	// Geometry tries the mesh codec first and falls back to LZ if that
+	// fails or comes out larger
+	std::vector<std::vector<unsigned char> > encoded(chunks.size());
+	std::vector<double> encodeTimes(chunks.size(), 0.0);
+	for (unsigned int i = 0; i < chunks.size(); ++i)
+	{
+		chunks[i].data = contents[i].data();
+		chunks[i].encoding = MESH_ENCODING_NONE;
+	}
+	ParallelFor(chunks.size(), [&](unsigned int i)
+	{
+		MeshChunk *chunk = &chunks[i];
+		Clock::time_point start = Clock::now();
+
+		MeshCodecLayout layout;
+		if (compression == MESH_COMPRESSION_MESH_CODEC && GetChunkLayout(chunk, version, layout) &&
+			EncodeMeshChunk(chunk->data, chunk->size, layout, encoded[i]))
+			chunk->encoding = MESH_ENCODING_MESH_CODEC;
+
+		std::vector<unsigned char> lz;
+		LzCompress(chunk->data, chunk->size, lz);
+		if (chunk->encoding == MESH_ENCODING_NONE || lz.size() < encoded[i].size())
+		{
+			encoded[i].swap(lz);
+			chunk->encoding = MESH_ENCODING_LZ;
+		}
+
+		if (encoded[i].size() + MESH_COMPRESSED_HEADER_SIZE >= chunk->size)
+		{
+			encoded[i].clear();
+			chunk->encoding = MESH_ENCODING_NONE;
+		}
+		encodeTimes[i] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	});
+
+	// Verification runs one chunk at a time so the decode speeds aren't
+	// competing with each other for the cores
+	printf("Compressing chunks (%s):\n", GetMeshCompressionName(compression));
+	size_t totalOriginal = 0;
+	size_t totalStored = 0;
+	size_t totalDecoded = 0;
+	double totalDecodeTime = 0.0;
+	for (unsigned int i = 0; i < chunks.size(); ++i)
+	{
+		const MeshChunk *chunk = &chunks[i];
+		totalOriginal += chunk->size;
+		if (chunk->encoding == MESH_ENCODING_NONE)
+		{
+			printf("  %s %12lu bytes, stored as is\n", chunk->tag, chunk->size);
+			totalStored += chunk->size;
+			continue;
+		}
+
+		double decodeTime = VerifyChunk(chunk, encoded[i]);
+		if (decodeTime < 0.0)
+		{
+			printf("Error verifying compressed %s chunk.\n", chunk->tag);
+			return false;
+		}
+
+		totalStored += encoded[i].size() + MESH_COMPRESSED_HEADER_SIZE;
+		totalDecoded += chunk->size;
+		totalDecodeTime += decodeTime;
+		printf("  %s %12lu -> %10lu bytes (%5.1f%%) %-10s encode %7.1f MB/s, decode %7.1f MB/s\n", chunk->tag, chunk->size, (unsigned long)encoded[i].size(),
+			(float)encoded[i].size() / chunk->size * 100.0f, GetMeshEncodingName(chunk->encoding), GetMegabytesPerSecond(chunk->size, encodeTimes[i]),
+			GetMegabytesPerSecond(chunk->size, decodeTime));
+	}
+	printf("  Total %lu -> %lu bytes (%.1f%%), decode %.1f MB/s\n", (unsigned long)totalOriginal, (unsigned long)totalStored,
+		(totalOriginal > 0 ? (float)totalStored / totalOriginal * 100.0f : 0.0f), GetMegabytesPerSecond(totalDecoded, totalDecodeTime));
+
+	MemoryFile output;
+	FILE *fp = output.Open();
+	if (fp == NULL)
+		return false;
+
+	fwrite("MESH", 4, 1, fp);
+	fwrite(&version, 1, 1, fp);
+	for (unsigned int i = 0; i < chunks.size(); ++i)
+	{
+		const MeshChunk *chunk = &chunks[i];
+		if (chunk->encoding == MESH_ENCODING_NONE)
+		{
+			WriteChunk(fp, chunk->tag, chunk->data, chunk->size);
+			continue;
+		}
+
+		long size = MESH_COMPRESSED_HEADER_SIZE + encoded[i].size();
+		long originalSize = chunk->size;
+		fwrite(MESH_COMPRESSED_CHUNK_TAG, MESH_CHUNK_TAG_LENGTH, 1, fp);
+		fwrite(&size, sizeof(long), 1, fp);
+		fwrite(chunk->tag, MESH_CHUNK_TAG_LENGTH, 1, fp);
+		fwrite(&chunk->encoding, 1, 1, fp);
+		fwrite(&originalSize, sizeof(long), 1, fp);
+		fwrite(encoded[i].data(), encoded[i].size(), 1, fp);
+	}
+
+	std::vector<unsigned char> compressed;
+	if (!output.Close(compressed))
+		return false;
+	data.swap(compressed);
+	return true;
+}
+
+const char* GetMeshEncodingName(unsigned char encoding)
+{
+	switch (encoding)
+	{
+	case MESH_ENCODING_NONE:
+		return "none";
+	case MESH_ENCODING_MESH_CODEC:
+		return "mesh codec";
+	case MESH_ENCODING_LZ:
+		return "lz";
+	default:
+		return "unknown";
+	}
+}
+
+const char* GetMeshCompressionName(unsigned int compression)
+{
+	switch (compression)
+	{
+	case MESH_COMPRESSION_MESH_CODEC:
+		return "mesh codec and lz";
+	case MESH_COMPRESSION_LZ:
+		return "lz";
+	default:
+		return "none";
+	}
+}
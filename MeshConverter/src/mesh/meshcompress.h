@@ -0,0 +1,52 @@
+#ifndef __MESH_MESHCOMPRESS_H_INCLUDED__
+#define __MESH_MESHCOMPRESS_H_INCLUDED__
+
+#include <string>
+#include <vector>
+
+// How CompressMeshFile picks an encoding for each chunk
+#define MESH_COMPRESSION_NONE 0
+#define MESH_COMPRESSION_MESH_CODEC 1          // Mesh codec for geometry, LZ for everything else
+#define MESH_COMPRESSION_LZ 2                  // LZ for every chunk
+
+/**
+ * Rewrites a MESH file with its chunks compressed. With the mesh codec,
+ * vertex streams (VTX, NRL, TXT, KTX, the quantized forms, KFR, JKF, JTV),
+ * bounding volumes (BND) and triangle lists (TRI, KTR, LOD) go through it, and LZ is used for
+ * everything else or when it does better. Chunks are encoded in parallel
+ * and wrapped in CMP chunks when that makes them smaller, each can still
+ * be decoded on its own. Every coded chunk is decoded again and checked
+ * against the original before the file is written. Sizes and
+ * encode/decode speeds are printed per chunk
+ * @param file MESH file to compress in place
+ * @param compression one of the MESH_COMPRESSION_* values
+ *
+ * @return bool false if the file couldn't be read or written
+ */
+bool CompressMeshFile(const std::string &file, unsigned int compression);
+
+/**
+ * Does what CompressMeshFile does to a MESH file in memory
+ * @param data contents of the MESH file, replaced by the compressed file
+ * @param compression one of the MESH_COMPRESSION_* values
+ *
+ * @return bool false if data isn't a MESH file or couldn't be compressed,
+ *              it is left as it was then
+ */
+bool CompressMeshData(std::vector<unsigned char> &data, unsigned int compression);
+
+/**
+ * @param encoding one of the MESH_ENCODING_* values
+ *
+ * @return const char* readable name of the encoding
+ */
+const char* GetMeshEncodingName(unsigned char encoding);
+
+/**
+ * @param compression one of the MESH_COMPRESSION_* values
+ *
+ * @return const char* readable name of the compression mode
+ */
+const char* GetMeshCompressionName(unsigned int compression);
+
+#endif
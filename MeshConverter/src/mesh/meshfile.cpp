@@ -0,0 +1,1038 @@
+#include "meshfile.h"
+#include "../codec/meshcodec.h"
+#include "../codec/lz.h"
+
+#include <limits.h>
+#include <string.h>
+
+// Bounds checked sequential reads over a single chunk's data. Chunk data
+// has no alignment guarantees, so everything is copied out with memcpy
+struct ChunkReader
+{
+	const unsigned char *current;
+	const unsigned char *end;
+	bool failed;
+
+	ChunkReader(const MeshChunk *chunk)
+	{
+		current = chunk->data;
+		end = chunk->data + chunk->size;
+		failed = false;
+	}
+
+	bool Read(void *out, size_t length)
+	{
+		if (failed || (size_t)(end - current) < length)
+		{
+			failed = true;
+			memset(out, 0, length);
+			return false;
+		}
+		memcpy(out, current, length);
+		current += length;
+		return true;
+	}
+
+	long ReadLong()                                        { long n; Read(&n, sizeof(long)); return n; }
+	int ReadInt()                                          { int n; Read(&n, sizeof(int)); return n; }
+	float ReadFloat()                                      { float f; Read(&f, sizeof(float)); return f; }
+	unsigned short ReadShort()                             { unsigned short n; Read(&n, sizeof(unsigned short)); return n; }
+	unsigned char ReadByte()                               { unsigned char n; Read(&n, 1); return n; }
+
+	Vector3 ReadVector3()
+	{
+		Vector3 v;
+		v.x = ReadFloat();
+		v.y = ReadFloat();
+		v.z = ReadFloat();
+		return v;
+	}
+
+	Vector2 ReadVector2()
+	{
+		Vector2 v;
+		v.x = ReadFloat();
+		v.y = ReadFloat();
+		return v;
+	}
+
+	void ReadString(std::string &buffer)
+	{
+		const unsigned char *terminator = (const unsigned char*)memchr(current, '\0', end - current);
+		if (failed || terminator == NULL)
+		{
+			failed = true;
+			return;
+		}
+		buffer.assign((const char*)current, terminator - current);
+		current = terminator + 1;
+	}
+
+	// Reads a leading element count, rejecting counts that could not
+	// possibly fit in what is left of the chunk
+	unsigned long ReadCount(size_t minimumElementSize)
+	{
+		long count = ReadLong();
+		if (count < 0 || (minimumElementSize > 0 && (size_t)count > (size_t)(end - current) / minimumElementSize))
+		{
+			failed = true;
+			return 0;
+		}
+		return (unsigned long)count;
+	}
+};
+
+// Multiplies sizes read from a file, failing instead of wrapping around
+static bool MultiplySize(size_t a, size_t b, size_t &result)
+{
+	if (a != 0 && b > (size_t)-1 / a)
+		return false;
+	result = a * b;
+	return true;
+}
+
+// Whether count elements starting at offset fit within total elements,
+// without the sum wrapping around
+static bool FitsWithin(unsigned long offset, unsigned long count, unsigned long total)
+{
+	return (count <= total && offset <= total - count);
+}
+
+// Reads the index layout that follows the triangle count in version 2
+// files. Batches have to cover the triangles in order
+static bool ReadIndexLayout(ChunkReader &reader, unsigned long numTriangles, IndexLayout &layout)
+{
+	long indexSize = reader.ReadLong();
+	unsigned long numBatches = reader.ReadCount(sizeof(long) * (2 + INDEX_LAYOUT_MAX_STREAMS));
+	if (reader.failed || (indexSize != 2 && indexSize != 4))
+		return false;
+
+	layout.indexSize = indexSize;
+	layout.batches.resize(numBatches);
+	unsigned long next = 0;
+	for (unsigned long i = 0; i < numBatches; ++i)
+	{
+		IndexBatch *batch = &layout.batches[i];
+		batch->firstTriangle = reader.ReadLong();
+		batch->numTriangles = reader.ReadLong();
+		for (int j = 0; j < INDEX_LAYOUT_MAX_STREAMS; ++j)
+			batch->base[j] = reader.ReadLong();
+		if (batch->firstTriangle != next)
+			return false;
+		next += batch->numTriangles;
+	}
+
+	return !reader.failed && next == numTriangles;
+}
+
+// Reads an index as written by WriteIndex, missing indices come back as
+// the largest unsigned int
+static unsigned int ReadIndex(ChunkReader &reader, const IndexLayout &layout, const IndexBatch *batch, int stream)
+{
+	if (layout.indexSize == 2)
+	{
+		unsigned short value = reader.ReadShort();
+		return (value == 0xffff ? 0xffffffff : batch->base[stream] + value);
+	}
+
+	unsigned int value;
+	reader.Read(&value, sizeof(unsigned int));
+	return (value == 0xffffffff ? value : batch->base[stream] + value);
+}
+
+// Advances to the batch holding the given triangle, batches are in order
+static const IndexBatch* FindBatch(const IndexLayout &layout, unsigned int &current, unsigned long triangle)
+{
+	while (triangle >= layout.batches[current].firstTriangle + layout.batches[current].numTriangles)
+		++current;
+	return &layout.batches[current];
+}
+
+// Reads a triangle count followed by the triangles, running to the end of
+// the chunk. Both layouts share the same tags, they are told apart by
+// their stride. Version 2 files store an index layout after the count and
+// their indices are 16 or 32 bit
+static bool ReadTriangleList(ChunkReader &reader, unsigned char version, MeshTriangles *result)
+{
+	unsigned long count = reader.ReadCount(version >= MESH_VERSION_COMPACT_INDICES ? 2 * 3 + sizeof(long) : sizeof(int) * 4);
+	if (reader.failed)
+		return false;
+
+	result->layout.indexSize = 0;
+	result->layout.batches.clear();
+	if (version >= MESH_VERSION_COMPACT_INDICES && !ReadIndexLayout(reader, count, result->layout))
+		return false;
+	bool compact = (result->layout.indexSize != 0);
+
+	const size_t indexedStride = (compact ? result->layout.indexSize : sizeof(long)) * 9 + sizeof(long);
+	const size_t inlineStride = (compact ? result->layout.indexSize : sizeof(int)) * 3 + sizeof(int) + (sizeof(float) * 3) * 3 + (sizeof(float) * 2) * 3;
+
+	size_t remaining = reader.end - reader.current;
+	if (count > 0 && remaining == count * inlineStride)
+		result->hasInlineAttributes = true;
+	else if (remaining == count * indexedStride)
+		result->hasInlineAttributes = false;
+	else
+		return false;
+
+	unsigned int currentBatch = 0;
+	result->triangles.resize(count);
+	for (unsigned long i = 0; i < count; ++i)
+	{
+		MeshTriangle *triangle = &result->triangles[i];
+		const IndexBatch *batch = (compact ? FindBatch(result->layout, currentBatch, i) : NULL);
+
+		if (result->hasInlineAttributes)
+		{
+			for (int j = 0; j < 3; ++j)
+				triangle->vertices[j] = (compact ? ReadIndex(reader, result->layout, batch, 0) : reader.ReadInt());
+			triangle->group = reader.ReadInt();
+			triangle->material = -1;
+			for (int j = 0; j < 3; ++j)
+			{
+				triangle->normals[j] = 0;
+				triangle->texCoords[j] = 0;
+			}
+			for (int j = 0; j < 3; ++j)
+				triangle->cornerNormals[j] = reader.ReadVector3();
+			for (int j = 0; j < 3; ++j)
+				triangle->cornerTexCoords[j] = reader.ReadVector2();
+		}
+		else
+		{
+			for (int j = 0; j < 3; ++j)
+				triangle->vertices[j] = (compact ? ReadIndex(reader, result->layout, batch, 0) : reader.ReadLong());
+			for (int j = 0; j < 3; ++j)
+				triangle->normals[j] = (compact ? ReadIndex(reader, result->layout, batch, 1) : reader.ReadLong());
+			for (int j = 0; j < 3; ++j)
+				triangle->texCoords[j] = (compact ? ReadIndex(reader, result->layout, batch, 2) : reader.ReadLong());
+			triangle->material = reader.ReadLong();
+			triangle->group = -1;
+			for (int j = 0; j < 3; ++j)
+			{
+				triangle->cornerNormals[j] = ZERO_VECTOR;
+				triangle->cornerTexCoords[j].x = 0.0f;
+				triangle->cornerTexCoords[j].y = 0.0f;
+			}
+		}
+	}
+
+	return !reader.failed;
+}
+
+MeshFile::MeshFile()
+{
+	m_data = NULL;
+	m_size = 0;
+	m_version = 0;
+	m_vertices = NULL;
+	m_normals = NULL;
+	m_texCoords = NULL;
+	m_materials = NULL;
+	m_triangles = NULL;
+	m_keyframes = NULL;
+	m_keyframeTexCoords = NULL;
+	m_keyframeTriangles = NULL;
+	m_animations = NULL;
+	m_groups = NULL;
+	m_joints = NULL;
+	m_jointMappings = NULL;
+	m_jointKeyframes = NULL;
+	m_meshlets = NULL;
+	m_lods = NULL;
+	m_bounds = NULL;
+	m_bvh = NULL;
+	m_tangents = NULL;
+}
+
+bool MeshFile::Open(const std::string &file)
+{
+	Close();
+
+	if (!m_file.Open(file))
+		return false;
+	m_data = m_file.GetData();
+	m_size = m_file.GetSize();
+
+	if (!IndexChunks())
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool MeshFile::Open(const void *data, size_t size)
+{
+	Close();
+
+	m_data = (const unsigned char*)data;
+	m_size = size;
+
+	if (!IndexChunks())
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MeshFile::Close()
+{
+	ReleaseViews();
+	m_chunks.clear();
+	m_decodedChunks.clear();
+	m_file.Close();
+	m_data = NULL;
+	m_size = 0;
+	m_version = 0;
+}
+
+void MeshFile::ReleaseViews()
+{
+	delete m_vertices;
+	delete m_normals;
+	delete m_texCoords;
+	delete m_materials;
+	delete m_triangles;
+	delete m_keyframes;
+	delete m_keyframeTexCoords;
+	delete m_keyframeTriangles;
+	delete m_animations;
+	delete m_groups;
+	delete m_joints;
+	delete m_jointMappings;
+	delete m_jointKeyframes;
+	delete m_meshlets;
+	delete m_lods;
+	delete m_bounds;
+	delete m_bvh;
+	delete m_tangents;
+	m_vertices = NULL;
+	m_normals = NULL;
+	m_texCoords = NULL;
+	m_materials = NULL;
+	m_triangles = NULL;
+	m_keyframes = NULL;
+	m_keyframeTexCoords = NULL;
+	m_keyframeTriangles = NULL;
+	m_animations = NULL;
+	m_groups = NULL;
+	m_joints = NULL;
+	m_jointMappings = NULL;
+	m_jointKeyframes = NULL;
+	m_meshlets = NULL;
+	m_lods = NULL;
+	m_bounds = NULL;
+	m_bvh = NULL;
+	m_tangents = NULL;
+}
+
+bool MeshFile::IndexChunks()
+{
+	const unsigned char *data = m_data;
+	size_t size = m_size;
+
+	// "MESH" followed by a 1 byte version
+	if (size < 5 || memcmp(data, "MESH", 4) != 0)
+		return false;
+	m_version = data[4];
+
+	// Only the chunk headers are touched here, each chunk's size is used
+	// to hop straight over its contents to the next one
+	size_t offset = 5;
+	while (offset < size)
+	{
+		if (size - offset < MESH_CHUNK_TAG_LENGTH + sizeof(long))
+			return false;
+
+		MeshChunk chunk;
+		memcpy(chunk.tag, data + offset, MESH_CHUNK_TAG_LENGTH);
+		chunk.tag[MESH_CHUNK_TAG_LENGTH] = '\0';
+		offset += MESH_CHUNK_TAG_LENGTH;
+
+		long chunkSize;
+		memcpy(&chunkSize, data + offset, sizeof(long));
+		offset += sizeof(long);
+		if (chunkSize < 0 || (size_t)chunkSize > size - offset)
+			return false;
+
+		chunk.data = data + offset;
+		chunk.size = (unsigned long)chunkSize;
+		chunk.encoding = MESH_ENCODING_NONE;
+		chunk.encodedData = chunk.data;
+		chunk.encodedSize = chunk.size;
+
+		// Compressed chunks take on the tag and size of what they hold
+		if (strcmp(chunk.tag, MESH_COMPRESSED_CHUNK_TAG) == 0)
+		{
+			long originalSize;
+			if (chunk.size < MESH_COMPRESSED_HEADER_SIZE)
+				return false;
+			memcpy(chunk.tag, chunk.data, MESH_CHUNK_TAG_LENGTH);
+			chunk.encoding = chunk.data[MESH_CHUNK_TAG_LENGTH];
+			memcpy(&originalSize, chunk.data + MESH_CHUNK_TAG_LENGTH + 1, sizeof(long));
+			if (originalSize < 0 || chunk.encoding == MESH_ENCODING_NONE)
+				return false;
+
+			chunk.encodedData = chunk.data + MESH_COMPRESSED_HEADER_SIZE;
+			chunk.encodedSize = chunk.size - MESH_COMPRESSED_HEADER_SIZE;
+			chunk.data = NULL;
+			chunk.size = (unsigned long)originalSize;
+		}
+		m_chunks.push_back(chunk);
+
+		offset += chunkSize;
+	}
+
+	m_decodedChunks.resize(m_chunks.size());
+	return true;
+}
+
+bool MeshFile::DecodeChunk(unsigned int index)
+{
+	MeshChunk *chunk = &m_chunks[index];
+	std::vector<unsigned char> &buffer = m_decodedChunks[index];
+	buffer.resize(chunk->size);
+
+	bool decoded = false;
+	if (chunk->encoding == MESH_ENCODING_MESH_CODEC)
+		decoded = DecodeMeshChunk(chunk->encodedData, chunk->encodedSize, buffer.data(), buffer.size());
+	else if (chunk->encoding == MESH_ENCODING_LZ)
+		decoded = LzDecompress(chunk->encodedData, chunk->encodedSize, buffer.data(), buffer.size());
+
+	if (!decoded)
+	{
+		buffer.clear();
+		return false;
+	}
+	chunk->data = buffer.data();
+	return true;
+}
+
+const MeshChunk* MeshFile::FindChunk(const char *tag)
+{
+	for (unsigned int i = 0; i < m_chunks.size(); ++i)
+	{
+		if (strncmp(m_chunks[i].tag, tag, MESH_CHUNK_TAG_LENGTH) == 0)
+		{
+			if (m_chunks[i].data == NULL && !DecodeChunk(i))
+				return NULL;
+			return &m_chunks[i];
+		}
+	}
+
+	return NULL;
+}
+
+static MeshVectors* LoadVectors(const MeshChunk *chunk)
+{
+	ChunkReader reader(chunk);
+	unsigned long count = reader.ReadCount(sizeof(float) * 3);
+
+	MeshVectors *result = new MeshVectors();
+	result->vectors.resize(count);
+	for (unsigned long i = 0; i < count; ++i)
+		result->vectors[i] = reader.ReadVector3();
+
+	if (reader.failed)
+	{
+		delete result;
+		return NULL;
+	}
+	return result;
+}
+
+static MeshTexCoords* LoadTexCoords(const MeshChunk *chunk)
+{
+	ChunkReader reader(chunk);
+	unsigned long count = reader.ReadCount(sizeof(float) * 2);
+
+	MeshTexCoords *result = new MeshTexCoords();
+	result->texCoords.resize(count);
+	for (unsigned long i = 0; i < count; ++i)
+		result->texCoords[i] = reader.ReadVector2();
+
+	if (reader.failed)
+	{
+		delete result;
+		return NULL;
+	}
+	return result;
+}
+
+static MeshVectors* LoadQuantizedPositions(const MeshChunk *chunk)
+{
+	ChunkReader reader(chunk);
+	unsigned long count = reader.ReadCount(sizeof(unsigned short) * 3);
+
+	QuantizedPositions quantized;
+	quantized.offset = reader.ReadVector3();
+	quantized.scale = reader.ReadVector3();
+	quantized.values.resize(count * 3);
+	for (unsigned long i = 0; i < count * 3; ++i)
+		quantized.values[i] = reader.ReadShort();
+	if (reader.failed)
+		return NULL;
+
+	MeshVectors *result = new MeshVectors();
+	result->vectors.resize(count);
+	DequantizePositions(quantized, result->vectors.data());
+	return result;
+}
+
+static MeshVectors* LoadQuantizedNormals(const MeshChunk *chunk)
+{
+	ChunkReader reader(chunk);
+	unsigned long count = reader.ReadCount(2);
+
+	QuantizedNormals quantized;
+	long bits = reader.ReadLong();
+	if (bits != 8 && bits != 16)
+		return NULL;
+	quantized.bits = bits;
+	quantized.values.resize(count * 2);
+	for (unsigned long i = 0; i < count * 2; ++i)
+		quantized.values[i] = (bits > 8 ? reader.ReadShort() : reader.ReadByte());
+	if (reader.failed)
+		return NULL;
+
+	MeshVectors *result = new MeshVectors();
+	result->vectors.resize(count);
+	DequantizeNormals(quantized, result->vectors.data());
+	return result;
+}
+
+static MeshTexCoords* LoadQuantizedTexCoords(const MeshChunk *chunk)
+{
+	ChunkReader reader(chunk);
+	unsigned long count = reader.ReadCount(sizeof(unsigned short) * 2);
+
+	QuantizedTexCoords quantized;
+	long encoding = reader.ReadLong();
+	if (encoding != QUANTIZE_TEXCOORDS_HALF && encoding != QUANTIZE_TEXCOORDS_UNORM16)
+		return NULL;
+	quantized.encoding = encoding;
+	quantized.offset = reader.ReadVector2();
+	quantized.scale = reader.ReadVector2();
+	quantized.values.resize(count * 2);
+	for (unsigned long i = 0; i < count * 2; ++i)
+		quantized.values[i] = reader.ReadShort();
+	if (reader.failed)
+		return NULL;
+
+	MeshTexCoords *result = new MeshTexCoords();
+	result->texCoords.resize(count);
+	DequantizeTexCoords(quantized, result->texCoords.data());
+	return result;
+}
+
+// Quantized streams (QVT, QNR, QTX) are returned dequantized, so callers
+// don't need to care which form the file stores them in
+
+const MeshVectors* MeshFile::GetVertices()
+{
+	if (m_vertices != NULL)
+		return m_vertices;
+
+	const MeshChunk *chunk = FindChunk("VTX");
+	if (chunk != NULL)
+		m_vertices = LoadVectors(chunk);
+	else if ((chunk = FindChunk("QVT")) != NULL)
+		m_vertices = LoadQuantizedPositions(chunk);
+	return m_vertices;
+}
+
+const MeshVectors* MeshFile::GetNormals()
+{
+	if (m_normals != NULL)
+		return m_normals;
+
+	const MeshChunk *chunk = FindChunk("NRL");
+	if (chunk != NULL)
+		m_normals = LoadVectors(chunk);
+	else if ((chunk = FindChunk("QNR")) != NULL)
+		m_normals = LoadQuantizedNormals(chunk);
+	return m_normals;
+}
+
+const MeshTexCoords* MeshFile::GetTexCoords()
+{
+	if (m_texCoords != NULL)
+		return m_texCoords;
+
+	const MeshChunk *chunk = FindChunk("TXT");
+	if (chunk != NULL)
+		m_texCoords = LoadTexCoords(chunk);
+	else if ((chunk = FindChunk("QTX")) != NULL)
+		m_texCoords = LoadQuantizedTexCoords(chunk);
+	return m_texCoords;
+}
+
+const MeshTexCoords* MeshFile::GetKeyframeTexCoords()
+{
+	const MeshChunk *chunk = FindChunk("KTX");
+	if (m_keyframeTexCoords == NULL && chunk != NULL)
+		m_keyframeTexCoords = LoadTexCoords(chunk);
+	return m_keyframeTexCoords;
+}
+
+const MeshMaterials* MeshFile::GetMaterials()
+{
+	const MeshChunk *chunk = FindChunk("MTL");
+	if (m_materials != NULL || chunk == NULL)
+		return m_materials;
+
+	ChunkReader reader(chunk);
+	unsigned long count = reader.ReadCount(1);
+
+	MeshMaterials *result = new MeshMaterials();
+	result->textures.resize(count);
+	for (unsigned long i = 0; i < count; ++i)
+		reader.ReadString(result->textures[i]);
+
+	if (reader.failed)
+		delete result;
+	else
+		m_materials = result;
+	return m_materials;
+}
+
+const MeshTriangles* MeshFile::GetTriangles()
+{
+	const MeshChunk *chunk = FindChunk("TRI");
+	if (m_triangles != NULL || chunk == NULL)
+		return m_triangles;
+
+	ChunkReader reader(chunk);
+	MeshTriangles *result = new MeshTriangles();
+	if (!ReadTriangleList(reader, m_version, result))
+		delete result;
+	else
+		m_triangles = result;
+	return m_triangles;
+}
+
+const MeshKeyframes* MeshFile::GetKeyframes()
+{
+	const MeshChunk *chunk = FindChunk("KFR");
+	if (m_keyframes != NULL || chunk == NULL)
+		return m_keyframes;
+
+	ChunkReader reader(chunk);
+	long numFrames = reader.ReadLong();
+	long numVertices = reader.ReadLong();
+	if (reader.failed || numFrames < 0 || numVertices < 0 || numFrames > UINT_MAX || numVertices > UINT_MAX)
+		return NULL;
+	size_t frameSize;
+	size_t totalSize;
+	if (!MultiplySize(sizeof(float) * 3 * 2, numVertices, frameSize) || !MultiplySize(frameSize, numFrames, totalSize)
+		|| totalSize != (size_t)(reader.end - reader.current))
+		return NULL;
+
+	MeshKeyframes *result = new MeshKeyframes();
+	result->numFrames = numFrames;
+	result->numVertices = numVertices;
+	result->vertices.resize(numFrames * numVertices);
+	result->normals.resize(numFrames * numVertices);
+	for (long i = 0; i < numFrames; ++i)
+	{
+		for (long j = 0; j < numVertices; ++j)
+			result->vertices[i * numVertices + j] = reader.ReadVector3();
+		for (long j = 0; j < numVertices; ++j)
+			result->normals[i * numVertices + j] = reader.ReadVector3();
+	}
+
+	if (reader.failed)
+		delete result;
+	else
+		m_keyframes = result;
+	return m_keyframes;
+}
+
+const MeshKeyframeTriangles* MeshFile::GetKeyframeTriangles()
+{
+	const MeshChunk *chunk = FindChunk("KTR");
+	if (m_keyframeTriangles != NULL || chunk == NULL)
+		return m_keyframeTriangles;
+
+	ChunkReader reader(chunk);
+	bool compact = (m_version >= MESH_VERSION_COMPACT_INDICES);
+	unsigned long count = reader.ReadCount(compact ? 2 * 3 * 2 : sizeof(long) * 3 * 2);
+
+	MeshKeyframeTriangles *result = new MeshKeyframeTriangles();
+	result->layout.indexSize = 0;
+	if (compact && !ReadIndexLayout(reader, count, result->layout))
+	{
+		delete result;
+		return NULL;
+	}
+
+	unsigned int currentBatch = 0;
+	result->triangles.resize(count);
+	for (unsigned long i = 0; i < count; ++i)
+	{
+		MeshKeyframeTriangle *triangle = &result->triangles[i];
+		const IndexBatch *batch = (compact ? FindBatch(result->layout, currentBatch, i) : NULL);
+		for (int j = 0; j < 3; ++j)
+			triangle->vertices[j] = (compact ? ReadIndex(reader, result->layout, batch, 0) : reader.ReadLong());
+		for (int j = 0; j < 3; ++j)
+			triangle->texCoords[j] = (compact ? ReadIndex(reader, result->layout, batch, 1) : reader.ReadLong());
+	}
+
+	if (reader.failed)
+		delete result;
+	else
+		m_keyframeTriangles = result;
+	return m_keyframeTriangles;
+}
+
+const MeshAnimations* MeshFile::GetAnimations()
+{
+	const MeshChunk *chunk = FindChunk("ANI");
+	if (m_animations != NULL || chunk == NULL)
+		return m_animations;
+
+	ChunkReader reader(chunk);
+	unsigned long count = reader.ReadCount(1 + sizeof(long) * 2);
+
+	MeshAnimations *result = new MeshAnimations();
+	result->animations.resize(count);
+	for (unsigned long i = 0; i < count; ++i)
+	{
+		MeshAnimation *animation = &result->animations[i];
+		reader.ReadString(animation->name);
+		animation->startFrame = reader.ReadLong();
+		animation->endFrame = reader.ReadLong();
+	}
+
+	if (reader.failed)
+		delete result;
+	else
+		m_animations = result;
+	return m_animations;
+}
+
+const MeshGroups* MeshFile::GetGroups()
+{
+	const MeshChunk *chunk = FindChunk("GRP");
+	if (m_groups != NULL || chunk == NULL)
+		return m_groups;
+
+	ChunkReader reader(chunk);
+	unsigned long count = reader.ReadCount(1 + sizeof(int));
+
+	MeshGroups *result = new MeshGroups();
+	result->groups.resize(count);
+	for (unsigned long i = 0; i < count; ++i)
+	{
+		MeshGroup *group = &result->groups[i];
+		reader.ReadString(group->name);
+		group->numTriangles = reader.ReadInt();
+	}
+
+	if (reader.failed)
+		delete result;
+	else
+		m_groups = result;
+	return m_groups;
+}
+
+const MeshJoints* MeshFile::GetJoints()
+{
+	const MeshChunk *chunk = FindChunk("JNT");
+	if (m_joints != NULL || chunk == NULL)
+		return m_joints;
+
+	ChunkReader reader(chunk);
+	unsigned long count = reader.ReadCount(1 + sizeof(int) + sizeof(float) * 6);
+
+	MeshJoints *result = new MeshJoints();
+	result->joints.resize(count);
+	for (unsigned long i = 0; i < count; ++i)
+	{
+		MeshJoint *joint = &result->joints[i];
+		reader.ReadString(joint->name);
+		joint->parentIndex = reader.ReadInt();
+		joint->position = reader.ReadVector3();
+		joint->rotation = reader.ReadVector3();
+	}
+
+	if (reader.failed)
+		delete result;
+	else
+		m_joints = result;
+	return m_joints;
+}
+
+const MeshJointMappings* MeshFile::GetJointMappings()
+{
+	const MeshChunk *chunk = FindChunk("JTV");
+	if (m_jointMappings != NULL || chunk == NULL)
+		return m_jointMappings;
+
+	ChunkReader reader(chunk);
+	unsigned long count = reader.ReadCount(sizeof(int) + sizeof(float));
+
+	MeshJointMappings *result = new MeshJointMappings();
+	result->mappings.resize(count);
+	for (unsigned long i = 0; i < count; ++i)
+	{
+		result->mappings[i].jointIndex = reader.ReadInt();
+		result->mappings[i].weight = reader.ReadFloat();
+	}
+
+	if (reader.failed)
+		delete result;
+	else
+		m_jointMappings = result;
+	return m_jointMappings;
+}
+
+const MeshJointKeyframes* MeshFile::GetJointKeyframes()
+{
+	const MeshChunk *chunk = FindChunk("JKF");
+	if (m_jointKeyframes != NULL || chunk == NULL)
+		return m_jointKeyframes;
+
+	// The joint count isn't stored in this chunk, it falls out of the size
+	ChunkReader reader(chunk);
+	long numFrames = reader.ReadLong();
+	size_t remaining = reader.end - reader.current;
+	size_t frameSize = 0;
+	if (reader.failed || numFrames < 0 || numFrames > UINT_MAX || (numFrames == 0 && remaining != 0)
+		|| (numFrames > 0 && (!MultiplySize(sizeof(float) * 6, numFrames, frameSize) || remaining % frameSize != 0)))
+		return NULL;
+
+	MeshJointKeyframes *result = new MeshJointKeyframes();
+	result->numFrames = numFrames;
+	result->numJoints = (numFrames > 0 ? remaining / frameSize : 0);
+	result->frames.resize(result->numFrames * result->numJoints);
+	for (unsigned int i = 0; i < result->frames.size(); ++i)
+	{
+		result->frames[i].position = reader.ReadVector3();
+		result->frames[i].rotation = reader.ReadVector3();
+	}
+
+	if (reader.failed)
+		delete result;
+	else
+		m_jointKeyframes = result;
+	return m_jointKeyframes;
+}
+
+const MeshletData* MeshFile::GetMeshlets()
+{
+	const MeshChunk *chunk = FindChunk("MLT");
+	if (m_meshlets != NULL || chunk == NULL)
+		return m_meshlets;
+
+	ChunkReader reader(chunk);
+	unsigned long numMeshlets = reader.ReadCount(sizeof(int) * 6 + sizeof(float) * 11);
+	unsigned long numVertices = reader.ReadCount(sizeof(int));
+	unsigned long numTriangles = reader.ReadCount(3);
+	if (reader.failed)
+		return NULL;
+
+	MeshletData *result = new MeshletData();
+	result->meshlets.resize(numMeshlets);
+	for (unsigned long i = 0; i < numMeshlets; ++i)
+	{
+		Meshlet *meshlet = &result->meshlets[i];
+		meshlet->group = reader.ReadInt();
+		meshlet->firstTriangle = reader.ReadInt();
+		meshlet->vertexOffset = reader.ReadInt();
+		meshlet->vertexCount = reader.ReadInt();
+		meshlet->triangleOffset = reader.ReadInt();
+		meshlet->triangleCount = reader.ReadInt();
+		meshlet->center = reader.ReadVector3();
+		meshlet->radius = reader.ReadFloat();
+		meshlet->coneApex = reader.ReadVector3();
+		meshlet->coneAxis = reader.ReadVector3();
+		meshlet->coneCutoff = reader.ReadFloat();
+
+		if (!FitsWithin(meshlet->vertexOffset, meshlet->vertexCount, numVertices) || !FitsWithin(meshlet->triangleOffset, meshlet->triangleCount, numTriangles))
+			reader.failed = true;
+	}
+
+	result->vertices.resize(numVertices);
+	for (unsigned long i = 0; i < numVertices; ++i)
+		result->vertices[i] = reader.ReadInt();
+	result->triangles.resize(numTriangles * 3);
+	if (numTriangles > 0)
+		reader.Read(&result->triangles[0], numTriangles * 3);
+
+	// Local indices have to stay within their own meshlet's vertices
+	for (unsigned long i = 0; i < numMeshlets && !reader.failed; ++i)
+	{
+		const Meshlet &meshlet = result->meshlets[i];
+		const unsigned char *indices = result->triangles.data() + (size_t)meshlet.triangleOffset * 3;
+		for (unsigned int j = 0; j < meshlet.triangleCount * 3; ++j)
+		{
+			if (indices[j] >= meshlet.vertexCount)
+			{
+				reader.failed = true;
+				break;
+			}
+		}
+	}
+
+	if (reader.failed)
+		delete result;
+	else
+		m_meshlets = result;
+	return m_meshlets;
+}
+
+const MeshLods* MeshFile::GetLods()
+{
+	const MeshChunk *chunk = FindChunk("LOD");
+	if (m_lods != NULL || chunk == NULL)
+		return m_lods;
+
+	ChunkReader reader(chunk);
+	unsigned long numLevels = reader.ReadCount(sizeof(float) * 2 + sizeof(long) * 2);
+
+	MeshLods *result = new MeshLods();
+	result->levels.resize(numLevels);
+	for (unsigned long i = 0; i < numLevels; ++i)
+	{
+		LodLevel *level = &result->levels[i];
+		level->ratio = reader.ReadFloat();
+		level->error = reader.ReadFloat();
+		level->start = reader.ReadLong();
+		level->count = reader.ReadLong();
+	}
+
+	if (reader.failed || !ReadTriangleList(reader, m_version, &result->triangles))
+	{
+		delete result;
+		return NULL;
+	}
+	for (unsigned long i = 0; i < numLevels; ++i)
+	{
+		if (!FitsWithin(result->levels[i].start, result->levels[i].count, result->triangles.triangles.size()))
+		{
+			delete result;
+			return NULL;
+		}
+	}
+
+	m_lods = result;
+	return m_lods;
+}
+
+static BoundingVolume ReadBoundingVolume(ChunkReader &reader)
+{
+	BoundingVolume bounds;
+	bounds.minimum = reader.ReadVector3();
+	bounds.maximum = reader.ReadVector3();
+	bounds.center = reader.ReadVector3();
+	bounds.radius = reader.ReadFloat();
+	return bounds;
+}
+
+const MeshBounds* MeshFile::GetBounds()
+{
+	const MeshChunk *chunk = FindChunk("BND");
+	if (m_bounds != NULL || chunk == NULL)
+		return m_bounds;
+
+	ChunkReader reader(chunk);
+	unsigned long numGroups = reader.ReadCount(sizeof(float) * 10);
+	unsigned long numFrames = reader.ReadCount(sizeof(float) * 10);
+	unsigned long numAnimations = reader.ReadCount(sizeof(float) * 10);
+	if (reader.failed)
+		return NULL;
+
+	MeshBounds *result = new MeshBounds();
+	result->mesh = ReadBoundingVolume(reader);
+	result->groups.resize(numGroups);
+	for (unsigned long i = 0; i < numGroups; ++i)
+		result->groups[i] = ReadBoundingVolume(reader);
+	result->frames.resize(numFrames);
+	for (unsigned long i = 0; i < numFrames; ++i)
+		result->frames[i] = ReadBoundingVolume(reader);
+	result->animations.resize(numAnimations);
+	for (unsigned long i = 0; i < numAnimations; ++i)
+		result->animations[i] = ReadBoundingVolume(reader);
+
+	if (reader.failed)
+		delete result;
+	else
+		m_bounds = result;
+	return m_bounds;
+}
+
+const MeshBvh* MeshFile::GetBvh()
+{
+	const MeshChunk *chunk = FindChunk("BVH");
+	if (m_bvh != NULL || chunk == NULL)
+		return m_bvh;
+	const MeshVectors *vertices = GetVertices();
+	if (vertices == NULL)
+		return NULL;
+
+	ChunkReader reader(chunk);
+	unsigned long numNodes = reader.ReadCount(sizeof(BvhNode));
+	unsigned long numTriangles = reader.ReadCount(sizeof(BvhTriangle));
+	unsigned long padding = reader.ReadCount(1);
+	if (reader.failed || (size_t)(reader.end - reader.current) != padding + numNodes * sizeof(BvhNode) + numTriangles * sizeof(BvhTriangle))
+		return NULL;
+
+	MeshBvh *result = new MeshBvh();
+	result->numNodes = numNodes;
+	result->numTriangles = numTriangles;
+	const unsigned char *nodes = reader.current + padding;
+	const unsigned char *triangles = nodes + numNodes * sizeof(BvhNode);
+	if ((size_t)nodes % sizeof(unsigned int) == 0)
+	{
+		result->nodes = (const BvhNode*)nodes;
+		result->triangles = (const BvhTriangle*)triangles;
+	}
+	else
+	{
+		result->nodeCopies.resize(numNodes);
+		result->triangleCopies.resize(numTriangles);
+		if (numNodes > 0)
+			memcpy(&result->nodeCopies[0], nodes, numNodes * sizeof(BvhNode));
+		if (numTriangles > 0)
+			memcpy(&result->triangleCopies[0], triangles, numTriangles * sizeof(BvhTriangle));
+		result->nodes = result->nodeCopies.data();
+		result->triangles = result->triangleCopies.data();
+	}
+
+	if (!ValidateBvh(result->nodes, result->numNodes, result->triangles, result->numTriangles, vertices->vectors.size()))
+		delete result;
+	else
+		m_bvh = result;
+	return m_bvh;
+}
+
+const MeshTangents* MeshFile::GetTangents()
+{
+	const MeshChunk *chunk = FindChunk("TAN");
+	if (m_tangents != NULL || chunk == NULL)
+		return m_tangents;
+
+	ChunkReader reader(chunk);
+	unsigned long numTangents = reader.ReadCount(sizeof(float) * 4);
+	if (reader.failed)
+		return NULL;
+
+	MeshTangents *result = new MeshTangents();
+	result->tangents.resize(numTangents);
+	for (unsigned long i = 0; i < numTangents; ++i)
+	{
+		result->tangents[i].tangent = reader.ReadVector3();
+		result->tangents[i].sign = reader.ReadFloat();
+	}
+
+	if (reader.failed)
+		delete result;
+	else
+		m_tangents = result;
+	return m_tangents;
+}
@@ -0,0 +1,298 @@
+#ifndef __MESH_MESHFILE_H_INCLUDED__
+#define __MESH_MESHFILE_H_INCLUDED__
+
+#include "../geometry/vector3.h"
+#include "../geometry/vector2.h"
+#include "../util/mappedfile.h"
+#include "../processing/meshlets.h"
+#include "../processing/simplify.h"
+#include "../processing/quantize.h"
+#include "../processing/indexlayout.h"
+#include "../processing/bounds.h"
+#include "../processing/bvh.h"
+#include "../processing/tangents.h"
+
+#include <string>
+#include <vector>
+
+#define MESH_CHUNK_TAG_LENGTH 3
+
+// Files with compact indices are version 2, their triangle lists carry
+// an index layout after the triangle count
+#define MESH_VERSION 1
+#define MESH_VERSION_COMPACT_INDICES 2
+
+// Compressed chunks are wrapped in a chunk with this tag. Its data is the
+// original tag, a 1 byte encoding, the original size (as a long), then the
+// encoded data
+#define MESH_COMPRESSED_CHUNK_TAG "CMP"
+#define MESH_COMPRESSED_HEADER_SIZE (MESH_CHUNK_TAG_LENGTH + 1 + sizeof(long))
+
+#define MESH_ENCODING_NONE 0
+#define MESH_ENCODING_MESH_CODEC 1
+#define MESH_ENCODING_LZ 2
+
+// Location of a single chunk inside the mapped file. The data pointer is
+// just past the chunk's size field, and size is the value of that field.
+// Compressed chunks are listed under their original tag and size, their
+// data pointer stays NULL until FindChunk decodes them
+struct MeshChunk
+{
+	char tag[MESH_CHUNK_TAG_LENGTH + 1];
+	const unsigned char *data;
+	unsigned long size;
+	unsigned char encoding;
+	const unsigned char *encodedData;
+	unsigned long encodedSize;
+};
+
+// VTX, NRL. Also QVT and QNR, dequantized when loaded
+struct MeshVectors
+{
+	std::vector<Vector3> vectors;
+};
+
+// TXT, KTX. Also QTX, dequantized when loaded
+struct MeshTexCoords
+{
+	std::vector<Vector2> texCoords;
+};
+
+// MTL
+struct MeshMaterials
+{
+	std::vector<std::string> textures;
+};
+
+// TRI. Static models (SM, OBJ) store attribute indices per vertex and a
+// material index. MS3D stores the normals and texcoords inline along
+// with the group the triangle belongs to
+struct MeshTriangle
+{
+	unsigned int vertices[3];
+	unsigned int normals[3];
+	unsigned int texCoords[3];
+	int material;
+	int group;
+	Vector3 cornerNormals[3];
+	Vector2 cornerTexCoords[3];
+};
+
+// Indices are returned absolute, the layout only says how they were
+// stored. Its index size is 0 in version 1 files
+struct MeshTriangles
+{
+	bool hasInlineAttributes;
+	IndexLayout layout;
+	std::vector<MeshTriangle> triangles;
+};
+
+// LOD. Each level is a run of the triangle list, which has the same
+// layout as the TRI chunk
+struct MeshLods
+{
+	std::vector<LodLevel> levels;
+	MeshTriangles triangles;
+};
+
+// BVH. When the chunk data is suitably aligned (the file is mapped and the
+// chunk isn't compressed), nodes and triangles point straight into it,
+// otherwise into copies. Triangle vertices are checked against VTX
+struct MeshBvh
+{
+	const BvhNode *nodes;
+	unsigned int numNodes;
+	const BvhTriangle *triangles;
+	unsigned int numTriangles;
+	std::vector<BvhNode> nodeCopies;
+	std::vector<BvhTriangle> triangleCopies;
+};
+
+// TAN. 3 per triangle, in the same order as TRI
+struct MeshTangents
+{
+	std::vector<CornerTangent> tangents;
+};
+
+// KFR. Frame-major, numVertices entries per frame
+struct MeshKeyframes
+{
+	unsigned int numFrames;
+	unsigned int numVertices;
+	std::vector<Vector3> vertices;
+	std::vector<Vector3> normals;
+};
+
+// KTR
+struct MeshKeyframeTriangle
+{
+	unsigned int vertices[3];
+	unsigned int texCoords[3];
+};
+
+struct MeshKeyframeTriangles
+{
+	IndexLayout layout;
+	std::vector<MeshKeyframeTriangle> triangles;
+};
+
+// ANI
+struct MeshAnimation
+{
+	std::string name;
+	unsigned int startFrame;
+	unsigned int endFrame;
+};
+
+struct MeshAnimations
+{
+	std::vector<MeshAnimation> animations;
+};
+
+// GRP
+struct MeshGroup
+{
+	std::string name;
+	unsigned int numTriangles;
+};
+
+struct MeshGroups
+{
+	std::vector<MeshGroup> groups;
+};
+
+// JNT
+struct MeshJoint
+{
+	std::string name;
+	int parentIndex;
+	Vector3 position;
+	Vector3 rotation;
+};
+
+struct MeshJoints
+{
+	std::vector<MeshJoint> joints;
+};
+
+// JTV
+struct MeshJointMapping
+{
+	int jointIndex;
+	float weight;
+};
+
+struct MeshJointMappings
+{
+	std::vector<MeshJointMapping> mappings;
+};
+
+// JKF. Frame-major, numJoints entries per frame
+struct MeshJointKeyframe
+{
+	Vector3 position;
+	Vector3 rotation;
+};
+
+struct MeshJointKeyframes
+{
+	unsigned int numFrames;
+	unsigned int numJoints;
+	std::vector<MeshJointKeyframe> frames;
+};
+
+/**
+ * Reader for MESH files as written by the converters. The file is
+ * memory mapped and only the chunk headers are walked when opening it.
+ * Chunk contents are decoded the first time they are asked for and
+ * cached until the file is closed, so tools that only need one or
+ * two chunks never touch the rest of the file. A file already in memory
+ * can be read in place the same way.
+ *
+ * Compressed chunks are decoded into buffers owned by the file the first
+ * time FindChunk is asked for them, the rest of the file doesn't need to
+ * know they were ever compressed.
+ *
+ * Sizes and indices are read with the same types the converters write
+ * them with, so a file must be read on the same platform type it was
+ * written on.
+ */
+class MeshFile
+{
+public:
+	MeshFile();
+	virtual ~MeshFile()                                    { Close(); }
+
+	bool Open(const std::string &file);
+
+	/**
+	 * Reads a MESH file that is already in memory, without copying it
+	 * @param data contents of the file, which must stay put until Close
+	 * @param size size of data in bytes
+	 *
+	 * @return bool false if data isn't a MESH file
+	 */
+	bool Open(const void *data, size_t size);
+	void Close();
+
+	unsigned char GetVersion()                             { return m_version; }
+	unsigned int GetNumChunks()                            { return m_chunks.size(); }
+	const MeshChunk* GetChunk(unsigned int index)          { return &m_chunks[index]; }
+	const MeshChunk* FindChunk(const char *tag);
+	bool HasChunk(const char *tag)                         { return FindChunk(tag) != NULL; }
+
+	const MeshVectors* GetVertices();
+	const MeshVectors* GetNormals();
+	const MeshTexCoords* GetTexCoords();
+	const MeshMaterials* GetMaterials();
+	const MeshTriangles* GetTriangles();
+	const MeshKeyframes* GetKeyframes();
+	const MeshTexCoords* GetKeyframeTexCoords();
+	const MeshKeyframeTriangles* GetKeyframeTriangles();
+	const MeshAnimations* GetAnimations();
+	const MeshGroups* GetGroups();
+	const MeshJoints* GetJoints();
+	const MeshJointMappings* GetJointMappings();
+	const MeshJointKeyframes* GetJointKeyframes();
+	const MeshletData* GetMeshlets();
+	const MeshLods* GetLods();
+	const MeshBounds* GetBounds();
+	const MeshBvh* GetBvh();
+	const MeshTangents* GetTangents();
+
+private:
+	MeshFile(const MeshFile &);
+	MeshFile& operator=(const MeshFile &);
+
+	bool IndexChunks();
+	bool DecodeChunk(unsigned int index);
+	void ReleaseViews();
+
+	MappedFile m_file;
+	const unsigned char *m_data;                 // The mapped file, or the caller's copy
+	size_t m_size;
+	unsigned char m_version;
+	std::vector<MeshChunk> m_chunks;
+	std::vector<std::vector<unsigned char> > m_decodedChunks;
+
+	MeshVectors *m_vertices;
+	MeshVectors *m_normals;
+	MeshTexCoords *m_texCoords;
+	MeshMaterials *m_materials;
+	MeshTriangles *m_triangles;
+	MeshKeyframes *m_keyframes;
+	MeshTexCoords *m_keyframeTexCoords;
+	MeshKeyframeTriangles *m_keyframeTriangles;
+	MeshAnimations *m_animations;
+	MeshGroups *m_groups;
+	MeshJoints *m_joints;
+	MeshJointMappings *m_jointMappings;
+	MeshJointKeyframes *m_jointKeyframes;
+	MeshletData *m_meshlets;
+	MeshLods *m_lods;
+	MeshBounds *m_bounds;
+	MeshBvh *m_bvh;
+	MeshTangents *m_tangents;
+};
+
+#endif
@@ -0,0 +1,317 @@
+#include "meshwriter.h"
+#include "meshfile.h"
+
+// BVH nodes start at file offsets that are a multiple of this
+#define BVH_NODE_ALIGNMENT 32
+
+static void WriteVector3(FILE *fp, const Vector3 &v)
+{
+	fwrite(&v.x, sizeof(float), 1, fp);
+	fwrite(&v.y, sizeof(float), 1, fp);
+	fwrite(&v.z, sizeof(float), 1, fp);
+}
+
+static void PrintSizeChange(const char *attribute, long floatSize, long quantizedSize)
+{
+	printf("%s %ld -> %ld bytes (%.1f%% smaller)\n", attribute, floatSize, quantizedSize, (floatSize > 0 ? (1.0f - (float)quantizedSize / floatSize) * 100.0f : 0.0f));
+}
+
+void WriteMeshHeader(FILE *fp, bool compactIndices)
+{
+	fputs("MESH", fp);
+	unsigned char version = (compactIndices ? MESH_VERSION_COMPACT_INDICES : MESH_VERSION);
+	fwrite(&version, 1, 1, fp);
+}
+
+void WriteTriangleListHeader(FILE *fp, long numTriangles, const IndexLayout *layout)
+{
+	fwrite(&numTriangles, sizeof(long), 1, fp);
+	if (layout == NULL)
+		return;
+
+	long data = layout->indexSize;
+	fwrite(&data, sizeof(long), 1, fp);
+	data = layout->batches.size();
+	fwrite(&data, sizeof(long), 1, fp);
+	for (unsigned int i = 0; i < layout->batches.size(); ++i)
+	{
+		const IndexBatch *batch = &layout->batches[i];
+		data = batch->firstTriangle;
+		fwrite(&data, sizeof(long), 1, fp);
+		data = batch->numTriangles;
+		fwrite(&data, sizeof(long), 1, fp);
+		for (int j = 0; j < INDEX_LAYOUT_MAX_STREAMS; ++j)
+		{
+			data = batch->base[j];
+			fwrite(&data, sizeof(long), 1, fp);
+		}
+	}
+}
+
+long GetTriangleListHeaderSize(const IndexLayout *layout)
+{
+	if (layout == NULL)
+		return sizeof(long);
+	return sizeof(long) * 3 + (sizeof(long) * (2 + INDEX_LAYOUT_MAX_STREAMS)) * layout->batches.size();
+}
+
+void WriteIndex(FILE *fp, unsigned int index, unsigned int base, unsigned int indexSize)
+{
+	// The layout keeps every valid index within range of its batch's base,
+	// anything else is a missing index
+	unsigned int value = index - base;
+	if (indexSize == 2)
+	{
+		unsigned short data = (index < base || value >= INDEX_LAYOUT_MAX_SPAN_16 ? 0xffff : (unsigned short)value);
+		fwrite(&data, sizeof(unsigned short), 1, fp);
+	}
+	else
+	{
+		unsigned int data = (index < base ? 0xffffffff : value);
+		fwrite(&data, sizeof(unsigned int), 1, fp);
+	}
+}
+
+void PrintIndexLayout(const char *tag, const IndexLayout &layout, long numIndices, long wideIndexSize)
+{
+	long wideSize = wideIndexSize * numIndices;
+	long compactSize = layout.indexSize * numIndices;
+	printf("%s indices stored as %u bit in %u batch%s, %ld -> %ld bytes (%.1f%% smaller)\n", tag, layout.indexSize * 8, (unsigned int)layout.batches.size(), (layout.batches.size() == 1 ? "" : "es"), wideSize, compactSize, (wideSize > 0 ? (1.0f - (float)compactSize / wideSize) * 100.0f : 0.0f));
+}
+
+void WritePositionChunk(FILE *fp, const Vector3 *positions, long count, const QuantizeProfile &profile)
+{
+	if (!profile.positions)
+	{
+		fputs("VTX", fp);
+		long sizeofVertices = (sizeof(float) * 3) * count + sizeof(long);
+		fwrite(&sizeofVertices, sizeof(long), 1, fp);
+		fwrite(&count, sizeof(long), 1, fp);
+		for (long i = 0; i < count; ++i)
+			WriteVector3(fp, positions[i]);
+		return;
+	}
+
+	QuantizedPositions quantized;
+	float error = QuantizePositions(positions, count, quantized);
+
+	fputs("QVT", fp);
+	long sizeofVertices = (sizeof(unsigned short) * 3) * count + sizeof(float) * 6 + sizeof(long);
+	fwrite(&sizeofVertices, sizeof(long), 1, fp);
+	fwrite(&count, sizeof(long), 1, fp);
+	WriteVector3(fp, quantized.offset);
+	WriteVector3(fp, quantized.scale);
+	if (count > 0)
+		fwrite(&quantized.values[0], sizeof(unsigned short), count * 3, fp);
+
+	float diagonal = Vector3::Magnitude(quantized.scale) * 65535.0f;
+	printf("Positions quantized to 16 bits, max error %g (%.4f%% of the bounding box diagonal)\n", error, (diagonal > 0.0f ? error / diagonal * 100.0f : 0.0f));
+	PrintSizeChange("Positions", (sizeof(float) * 3) * count, sizeofVertices - sizeof(long));
+}
+
+void WriteNormalChunk(FILE *fp, const Vector3 *normals, long count, const QuantizeProfile &profile)
+{
+	if (profile.normalBits == 0)
+	{
+		fputs("NRL", fp);
+		long sizeofNormals = (sizeof(float) * 3) * count + sizeof(long);
+		fwrite(&sizeofNormals, sizeof(long), 1, fp);
+		fwrite(&count, sizeof(long), 1, fp);
+		for (long i = 0; i < count; ++i)
+			WriteVector3(fp, normals[i]);
+		return;
+	}
+
+	QuantizedNormals quantized;
+	float error = QuantizeNormals(normals, count, profile.normalBits, quantized);
+
+	fputs("QNR", fp);
+	long bits = profile.normalBits;
+	long valueSize = (bits > 8 ? sizeof(unsigned short) : sizeof(unsigned char));
+	long sizeofNormals = (valueSize * 2) * count + sizeof(long) * 2;
+	fwrite(&sizeofNormals, sizeof(long), 1, fp);
+	fwrite(&count, sizeof(long), 1, fp);
+	fwrite(&bits, sizeof(long), 1, fp);
+	if (bits > 8)
+	{
+		if (count > 0)
+			fwrite(&quantized.values[0], sizeof(unsigned short), count * 2, fp);
+	}
+	else
+	{
+		for (long i = 0; i < count * 2; ++i)
+		{
+			unsigned char value = (unsigned char)quantized.values[i];
+			fwrite(&value, 1, 1, fp);
+		}
+	}
+
+	printf("Normals quantized to 2x%ld bit octahedral, max error %.3f degrees\n", bits, error);
+	PrintSizeChange("Normals", (sizeof(float) * 3) * count, sizeofNormals - sizeof(long));
+}
+
+void WriteTexCoordChunk(FILE *fp, const Vector2 *texCoords, long count, const QuantizeProfile &profile)
+{
+	if (profile.texCoords == QUANTIZE_TEXCOORDS_FLOAT)
+	{
+		fputs("TXT", fp);
+		long sizeofTexCoords = (sizeof(float) * 2) * count + sizeof(long);
+		fwrite(&sizeofTexCoords, sizeof(long), 1, fp);
+		fwrite(&count, sizeof(long), 1, fp);
+		for (long i = 0; i < count; ++i)
+		{
+			fwrite(&texCoords[i].x, sizeof(float), 1, fp);
+			fwrite(&texCoords[i].y, sizeof(float), 1, fp);
+		}
+		return;
+	}
+
+	QuantizedTexCoords quantized;
+	float error = QuantizeTexCoords(texCoords, count, profile.texCoords, quantized);
+
+	fputs("QTX", fp);
+	long encoding = profile.texCoords;
+	long sizeofTexCoords = (sizeof(unsigned short) * 2) * count + sizeof(float) * 4 + sizeof(long) * 2;
+	fwrite(&sizeofTexCoords, sizeof(long), 1, fp);
+	fwrite(&count, sizeof(long), 1, fp);
+	fwrite(&encoding, sizeof(long), 1, fp);
+	fwrite(&quantized.offset.x, sizeof(float), 1, fp);
+	fwrite(&quantized.offset.y, sizeof(float), 1, fp);
+	fwrite(&quantized.scale.x, sizeof(float), 1, fp);
+	fwrite(&quantized.scale.y, sizeof(float), 1, fp);
+	if (count > 0)
+		fwrite(&quantized.values[0], sizeof(unsigned short), count * 2, fp);
+
+	printf("Texcoords quantized to %s, max error %g\n", (encoding == QUANTIZE_TEXCOORDS_HALF ? "half floats" : "16 bit unorm"), error);
+	PrintSizeChange("Texcoords", (sizeof(float) * 2) * count, sizeofTexCoords - sizeof(long));
+}
+
+static void WriteBoundingVolume(FILE *fp, const BoundingVolume &bounds)
+{
+	WriteVector3(fp, bounds.minimum);
+	WriteVector3(fp, bounds.maximum);
+	WriteVector3(fp, bounds.center);
+	fwrite(&bounds.radius, sizeof(float), 1, fp);
+}
+
+void WriteBoundsChunk(FILE *fp, const MeshBounds &bounds)
+{
+	fputs("BND", fp);
+	long numGroups = bounds.groups.size();
+	long numFrames = bounds.frames.size();
+	long numAnimations = bounds.animations.size();
+	long sizeOfBounds = (sizeof(float) * 10) * (1 + numGroups + numFrames + numAnimations) + sizeof(long) * 3;
+	fwrite(&sizeOfBounds, sizeof(long), 1, fp);
+	fwrite(&numGroups, sizeof(long), 1, fp);
+	fwrite(&numFrames, sizeof(long), 1, fp);
+	fwrite(&numAnimations, sizeof(long), 1, fp);
+
+	WriteBoundingVolume(fp, bounds.mesh);
+	for (long i = 0; i < numGroups; ++i)
+		WriteBoundingVolume(fp, bounds.groups[i]);
+	for (long i = 0; i < numFrames; ++i)
+		WriteBoundingVolume(fp, bounds.frames[i]);
+	for (long i = 0; i < numAnimations; ++i)
+		WriteBoundingVolume(fp, bounds.animations[i]);
+}
+
+void WriteBvhChunk(FILE *fp, const BvhData &bvh)
+{
+	fputs("BVH", fp);
+	long numNodes = bvh.nodes.size();
+	long numTriangles = bvh.triangles.size();
+	long nodesStart = ftell(fp) + sizeof(long) * 4;
+	long padding = (BVH_NODE_ALIGNMENT - nodesStart % BVH_NODE_ALIGNMENT) % BVH_NODE_ALIGNMENT;
+	long sizeOfBvh = sizeof(BvhNode) * numNodes + sizeof(BvhTriangle) * numTriangles + padding + sizeof(long) * 3;
+	fwrite(&sizeOfBvh, sizeof(long), 1, fp);
+	fwrite(&numNodes, sizeof(long), 1, fp);
+	fwrite(&numTriangles, sizeof(long), 1, fp);
+	fwrite(&padding, sizeof(long), 1, fp);
+
+	const char zeros[BVH_NODE_ALIGNMENT] = { 0 };
+	fwrite(zeros, padding, 1, fp);
+	if (numNodes > 0)
+		fwrite(bvh.nodes.data(), sizeof(BvhNode), numNodes, fp);
+	if (numTriangles > 0)
+		fwrite(bvh.triangles.data(), sizeof(BvhTriangle), numTriangles, fp);
+}
+
+void WriteTangentChunk(FILE *fp, const std::vector<CornerTangent> &tangents)
+{
+	fputs("TAN", fp);
+	long numTangents = tangents.size();
+	long sizeOfTangents = sizeof(CornerTangent) * numTangents + sizeof(long);
+	fwrite(&sizeOfTangents, sizeof(long), 1, fp);
+	fwrite(&numTangents, sizeof(long), 1, fp);
+	if (numTangents > 0)
+		fwrite(tangents.data(), sizeof(CornerTangent), numTangents, fp);
+}
+
+void WriteMeshletChunk(FILE *fp, const MeshletData &meshlets)
+{
+	fputs("MLT", fp);
+	long numMeshlets = meshlets.meshlets.size();
+	long numVertices = meshlets.vertices.size();
+	long numTriangles = meshlets.triangles.size() / 3;
+	long sizeOfMeshlets = (sizeof(int) * 6 + sizeof(float) * 11) * numMeshlets + sizeof(int) * numVertices + 3 * numTriangles + sizeof(long) * 3;
+	fwrite(&sizeOfMeshlets, sizeof(long), 1, fp);
+	fwrite(&numMeshlets, sizeof(long), 1, fp);
+	fwrite(&numVertices, sizeof(long), 1, fp);
+	fwrite(&numTriangles, sizeof(long), 1, fp);
+
+	for (long i = 0; i < numMeshlets; ++i)
+	{
+		const Meshlet *meshlet = &meshlets.meshlets[i];
+		int data;
+
+		data = meshlet->group;
+		fwrite(&data, sizeof(int), 1, fp);
+		data = meshlet->firstTriangle;
+		fwrite(&data, sizeof(int), 1, fp);
+		data = meshlet->vertexOffset;
+		fwrite(&data, sizeof(int), 1, fp);
+		data = meshlet->vertexCount;
+		fwrite(&data, sizeof(int), 1, fp);
+		data = meshlet->triangleOffset;
+		fwrite(&data, sizeof(int), 1, fp);
+		data = meshlet->triangleCount;
+		fwrite(&data, sizeof(int), 1, fp);
+
+		WriteVector3(fp, meshlet->center);
+		fwrite(&meshlet->radius, sizeof(float), 1, fp);
+		WriteVector3(fp, meshlet->coneApex);
+		WriteVector3(fp, meshlet->coneAxis);
+		fwrite(&meshlet->coneCutoff, sizeof(float), 1, fp);
+	}
+
+	for (long i = 0; i < numVertices; ++i)
+	{
+		int index = meshlets.vertices[i];
+		fwrite(&index, sizeof(int), 1, fp);
+	}
+
+	if (numTriangles > 0)
+		fwrite(&meshlets.triangles[0], 1, numTriangles * 3, fp);
+}
+
+void WriteLodChunkHeader(FILE *fp, const std::vector<LodLevel> &levels, long numTriangles, long triangleSize, const IndexLayout *layout)
+{
+	fputs("LOD", fp);
+	long numLevels = levels.size();
+	long sizeOfLods = (sizeof(float) * 2 + sizeof(long) * 2) * numLevels + triangleSize * numTriangles + GetTriangleListHeaderSize(layout) + sizeof(long);
+	fwrite(&sizeOfLods, sizeof(long), 1, fp);
+	fwrite(&numLevels, sizeof(long), 1, fp);
+	for (long i = 0; i < numLevels; ++i)
+	{
+		const LodLevel *level = &levels[i];
+		long data;
+
+		fwrite(&level->ratio, sizeof(float), 1, fp);
+		fwrite(&level->error, sizeof(float), 1, fp);
+		data = level->start;
+		fwrite(&data, sizeof(long), 1, fp);
+		data = level->count;
+		fwrite(&data, sizeof(long), 1, fp);
+	}
+	WriteTriangleListHeader(fp, numTriangles, layout);
+}
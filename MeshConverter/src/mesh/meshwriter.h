@@ -0,0 +1,159 @@
+#ifndef __MESH_MESHWRITER_H_INCLUDED__
+#define __MESH_MESHWRITER_H_INCLUDED__
+
+#include <stdio.h>
+
+#include "../processing/meshlets.h"
+#include "../processing/simplify.h"
+#include "../processing/quantize.h"
+#include "../processing/indexlayout.h"
+#include "../processing/bounds.h"
+#include "../processing/bvh.h"
+#include "../processing/tangents.h"
+
+/**
+ * Writes the "MESH" signature and version byte that start every file
+ * @param fp file to write to
+ * @param compactIndices whether triangle lists are written with index
+ *                       layouts
+ */
+void WriteMeshHeader(FILE *fp, bool compactIndices);
+
+/**
+ * Writes the count that starts every triangle list (TRI, KTR, LOD), then
+ * the index layout if there is one: the index size and number of batches
+ * (as longs), then per batch the first triangle, triangle count and one
+ * base per index stream (5 longs). Triangles in a batch store their
+ * indices minus the batch's base for that stream, with the largest value
+ * of the index size marking a missing index
+ * @param fp file to write to
+ * @param numTriangles number of triangles in the list
+ * @param layout index layout, or NULL for version 1 files
+ */
+void WriteTriangleListHeader(FILE *fp, long numTriangles, const IndexLayout *layout);
+
+/**
+ * @param layout index layout, or NULL for version 1 files
+ *
+ * @return long size in bytes of what WriteTriangleListHeader writes
+ */
+long GetTriangleListHeaderSize(const IndexLayout *layout);
+
+/**
+ * Writes an index of a compact triangle list, relative to its batch's base
+ * @param fp file to write to
+ * @param index index to write
+ * @param base base of the index's stream in the triangle's batch
+ * @param indexSize index size of the layout, 2 or 4
+ */
+void WriteIndex(FILE *fp, unsigned int index, unsigned int base, unsigned int indexSize);
+
+/**
+ * Prints the chosen index width of a triangle list and how much smaller
+ * its indices are than when written as the given type
+ * @param tag chunk the triangle list belongs to
+ * @param layout chosen index layout
+ * @param numIndices number of indices in the triangle list
+ * @param wideIndexSize size of the index type used by version 1 files
+ */
+void PrintIndexLayout(const char *tag, const IndexLayout &layout, long numIndices, long wideIndexSize);
+
+/**
+ * Writes vertex positions as a float VTX chunk, or as a QVT chunk when the
+ * profile quantizes them. Layout of QVT after the chunk size is the number
+ * of positions (as a long), the dequantization offset and scale (3 floats
+ * each), then 3 unsigned shorts per position. The quantization error and
+ * size are printed
+ * @param fp file to write to
+ * @param positions positions to write
+ * @param count number of positions
+ * @param profile quantization profile
+ */
+void WritePositionChunk(FILE *fp, const Vector3 *positions, long count, const QuantizeProfile &profile);
+
+/**
+ * Writes normals as a float NRL chunk, or as a QNR chunk when the profile
+ * quantizes them. Layout of QNR after the chunk size is the number of
+ * normals and the bits per coordinate (as longs), then 2 octahedral
+ * coordinates per normal as unsigned bytes or shorts. The quantization
+ * error and size are printed
+ * @param fp file to write to
+ * @param normals normals to write
+ * @param count number of normals
+ * @param profile quantization profile
+ */
+void WriteNormalChunk(FILE *fp, const Vector3 *normals, long count, const QuantizeProfile &profile);
+
+/**
+ * Writes texture coordinates as a float TXT chunk, or as a QTX chunk when
+ * the profile quantizes them. Layout of QTX after the chunk size is the
+ * number of texture coordinates and the encoding (as longs), the
+ * dequantization offset and scale (2 floats each, only used by unorm16),
+ * then 2 unsigned shorts per texture coordinate. The quantization error
+ * and size are printed
+ * @param fp file to write to
+ * @param texCoords texture coordinates to write
+ * @param count number of texture coordinates
+ * @param profile quantization profile
+ */
+void WriteTexCoordChunk(FILE *fp, const Vector2 *texCoords, long count, const QuantizeProfile &profile);
+
+/**
+ * Writes an MLT chunk. Layout after the chunk size is the number of
+ * meshlets, meshlet vertices and meshlet triangles (as longs), then
+ * per meshlet 6 ints (group, first triangle, vertex offset, vertex
+ * count, triangle offset, triangle count) and 11 floats (sphere center,
+ * radius, cone apex, cone axis, cone cutoff), then an int per meshlet
+ * vertex and 3 bytes per meshlet triangle
+ * @param fp file to write to
+ * @param meshlets meshlets to write
+ */
+void WriteMeshletChunk(FILE *fp, const MeshletData &meshlets);
+
+/**
+ * Writes a BND chunk. Layout after the chunk size is the number of groups,
+ * frames and animations (as longs), then the bounding volume of the whole
+ * mesh, each group, each frame and each animation in that order. Each
+ * volume is 10 floats: box minimum, box maximum, sphere center, radius
+ * @param fp file to write to
+ * @param bounds bounding volumes to write
+ */
+void WriteBoundsChunk(FILE *fp, const MeshBounds &bounds);
+
+/**
+ * Writes a BVH chunk. Layout after the chunk size is the number of nodes,
+ * the number of triangles and the number of padding bytes (as longs), the
+ * padding, then the nodes (32 bytes each, as BvhNode) and the triangles
+ * in leaf order (3 vertex indices and the TRI triangle index, as unsigned
+ * ints). The padding puts the nodes at a file offset that is a multiple
+ * of 32, so a mapped file can use them in place
+ * @param fp file to write to
+ * @param bvh nodes and triangles to write
+ */
+void WriteBvhChunk(FILE *fp, const BvhData &bvh);
+
+/**
+ * Writes a TAN chunk. Layout after the chunk size is the number of
+ * tangents (as a long), then per triangle corner in TRI order the tangent
+ * and bitangent sign (4 floats, as CornerTangent)
+ * @param fp file to write to
+ * @param tangents tangents to write, 3 per triangle
+ */
+void WriteTangentChunk(FILE *fp, const std::vector<CornerTangent> &tangents);
+
+/**
+ * Writes the start of an LOD chunk, up to and including the triangle list
+ * header. The caller writes the triangles that follow, in the same layout
+ * as its TRI chunk. Layout after the chunk size is the number of levels
+ * (as a long), per level the ratio and error (floats) and the first
+ * triangle and triangle count (longs), then the triangle list header
+ * @param fp file to write to
+ * @param levels levels to write
+ * @param numTriangles number of triangles the caller writes after this
+ * @param triangleSize size in bytes of a single triangle as the caller
+ *                     writes it
+ * @param layout index layout of the triangles, or NULL for version 1 files
+ */
+void WriteLodChunkHeader(FILE *fp, const std::vector<LodLevel> &levels, long numTriangles, long triangleSize, const IndexLayout *layout);
+
+#endif
@@ -1,8 +1,94 @@
 #include "ms3d.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#include "../util/memoryreader.h"
+#include "../processing/vertexcache.h"
+#include "../processing/vertexfetch.h"
+#include "../processing/overdraw.h"
+#include "../processing/meshlets.h"
+#include "../processing/simplify.h"
+#include "../mesh/meshwriter.h"
+#include "../util/profiler.h"
+
+// Bytes each element takes up in an MS3D file, a mesh and a joint at least
+// that many before their lists of triangles and keyframes
+#define MS3D_VERTEX_SIZE 15
+#define MS3D_TRIANGLE_SIZE 70
+#define MS3D_MIN_MESH_SIZE 36
+#define MS3D_MIN_JOINT_SIZE 93
+#define MS3D_KEYFRAME_SIZE 16
+
+static void WriteTriangle(FILE *fp, const Ms3dTriangle *triangle, const IndexLayout *layout, const IndexBatch *batch)
+{
+	int index;
+	if (layout == NULL)
+	{
+		index = triangle->vertices[0];
+		fwrite(&index, sizeof(int), 1, fp);
+		index = triangle->vertices[1];
+		fwrite(&index, sizeof(int), 1, fp);
+		index = triangle->vertices[2];
+		fwrite(&index, sizeof(int), 1, fp);
+	}
+	else
+	{
+		for (int j = 0; j < 3; ++j)
+			WriteIndex(fp, triangle->vertices[j], batch->base[0], layout->indexSize);
+	}
+
+	index = triangle->meshIndex;
+	fwrite(&index, sizeof(int), 1, fp);
+
+	for (int j = 0; j < 3; ++j)
+	{
+		fwrite(&triangle->normals[j].x, sizeof(float), 1, fp);
+		fwrite(&triangle->normals[j].y, sizeof(float), 1, fp);
+		fwrite(&triangle->normals[j].z, sizeof(float), 1, fp);
+	}
+	for (int j = 0; j < 3; ++j)
+	{
+		fwrite(&triangle->texCoords[j].x, sizeof(float), 1, fp);
+		fwrite(&triangle->texCoords[j].y, sizeof(float), 1, fp);
+	}
+}
 
-#include "../util/files.h"
+static long GetTriangleSize(const IndexLayout *layout)
+{
+	long indexSize = (layout == NULL ? sizeof(int) : layout->indexSize);
+	return indexSize * 3 + sizeof(int) + (sizeof(float) * 3) * 3 + (sizeof(float) * 2) * 3;
+}
+
+static void WriteTriangles(FILE *fp, const Ms3dTriangle *triangles, long numTriangles, const IndexLayout *layout)
+{
+	if (layout == NULL)
+	{
+		for (long i = 0; i < numTriangles; ++i)
+			WriteTriangle(fp, &triangles[i], NULL, NULL);
+		return;
+	}
+
+	for (unsigned int i = 0; i < layout->batches.size(); ++i)
+	{
+		const IndexBatch *batch = &layout->batches[i];
+		for (unsigned int j = batch->firstTriangle; j < batch->firstTriangle + batch->numTriangles; ++j)
+			WriteTriangle(fp, &triangles[j], layout, batch);
+	}
+}
+
+static void BuildTriangleIndexLayout(const Ms3dTriangle *triangles, unsigned int numTriangles, unsigned int numVertices, bool split, IndexLayout &layout)
+{
+	std::vector<unsigned int> indices(numTriangles * 3);
+	for (unsigned int i = 0; i < numTriangles; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			indices[i * 3 + j] = triangles[i].vertices[j];
+	}
+	BuildIndexLayout(indices.data(), numTriangles, 1, &numVertices, split, layout);
+}
 
 Ms3d::Ms3d()
 {
@@ -32,89 +118,97 @@ void Ms3d::Release()
 	m_numJoints = 0;
 }
 
-bool Ms3d::Load(const std::string &file)
+std::string Ms3d::GetAnimationFile(const std::string &file)
+{
+	std::string animationFile = file;
+	if (animationFile.find_last_of('.') != std::string::npos)
+		animationFile.erase(animationFile.find_last_of('.'));
+	animationFile.append(".animations");
+	return animationFile;
+}
+
+bool Ms3d::Load(const void *data, size_t size, const SidecarResolver &sidecars)
 {
-	FILE *fp;
 	Ms3dHeader header;
 
-	fp = fopen(file.c_str(), "rb");
-	if (!fp)
-		return false;
+	MemoryReader input(data, size);
 
 	// filetype verification
-	fread(&header.id, 10, 1, fp);
+	input.Read(&header.id, 10, 1);
 	if (strncmp(header.id, "MS3D000000", 10) != 0)
-	{
-		fclose(fp);
 		return false;
-	}
-	fread(&header.version, 4, 1, fp);
+	input.Read(&header.version, 4, 1);
 	if (header.version != 4)
-	{
-		fclose(fp);
 		return false;
-	}
 
 	// read vertices
-	fread(&m_numVertices, 2, 1, fp);
+	input.Read(&m_numVertices, 2, 1);
+	if (!input.HasRoomFor(MS3D_VERTEX_SIZE, m_numVertices))
+		return false;
 	m_vertices = new Ms3dVertex[m_numVertices];
 
 	for (int i = 0; i < m_numVertices; ++i)
 	{
 		Ms3dVertex *vertex = &m_vertices[i];
 
-		fread(&vertex->editorFlags, 1, 1, fp);
-		fread(&vertex->vertex.x, 4, 1, fp);
-		fread(&vertex->vertex.y, 4, 1, fp);
-		fread(&vertex->vertex.z, 4, 1, fp);
-		fread(&vertex->jointIndex, 1, 1, fp);
-		fread(&vertex->unused, 1, 1, fp);
+		input.Read(&vertex->editorFlags, 1, 1);
+		input.Read(&vertex->vertex.x, 4, 1);
+		input.Read(&vertex->vertex.y, 4, 1);
+		input.Read(&vertex->vertex.z, 4, 1);
+		input.Read(&vertex->jointIndex, 1, 1);
+		input.Read(&vertex->unused, 1, 1);
 	}
 
 	// read triangle definitions
-	fread(&m_numTriangles, 2, 1, fp);
+	input.Read(&m_numTriangles, 2, 1);
+	if (!input.HasRoomFor(MS3D_TRIANGLE_SIZE, m_numTriangles))
+		return false;
 	m_triangles = new Ms3dTriangle[m_numTriangles];
 
 	for (int i = 0; i < m_numTriangles; ++i)
 	{
 		Ms3dTriangle *triangle = &m_triangles[i];
 
-		fread(&triangle->editorFlags, 2, 1, fp);
+		input.Read(&triangle->editorFlags, 2, 1);
 		for (int j = 0; j < 3; ++j)
-			fread(&triangle->vertices[j], 2, 1, fp);
+			input.Read(&triangle->vertices[j], 2, 1);
 		for (int j = 0; j < 3; ++j)
 		{
-			fread(&triangle->normals[j].x, 4, 1, fp);
-			fread(&triangle->normals[j].y, 4, 1, fp);
-			fread(&triangle->normals[j].z, 4, 1, fp);
+			input.Read(&triangle->normals[j].x, 4, 1);
+			input.Read(&triangle->normals[j].y, 4, 1);
+			input.Read(&triangle->normals[j].z, 4, 1);
 		}
 		for (int j = 0; j < 3; ++j)
-			fread(&triangle->texCoords[j].x, 4, 1, fp);
+			input.Read(&triangle->texCoords[j].x, 4, 1);
 		for (int j = 0; j < 3; ++j)
-			fread(&triangle->texCoords[j].y, 4, 1, fp);
-		fread(&triangle->smoothingGroup, 1, 1, fp);
-		fread(&triangle->meshIndex, 1, 1, fp);
+			input.Read(&triangle->texCoords[j].y, 4, 1);
+		input.Read(&triangle->smoothingGroup, 1, 1);
+		input.Read(&triangle->meshIndex, 1, 1);
 	}
 
 	// read mesh information
-	fread(&m_numMeshes, 2, 1, fp);
+	input.Read(&m_numMeshes, 2, 1);
+	if (!input.HasRoomFor(MS3D_MIN_MESH_SIZE, m_numMeshes))
+		return false;
 	m_meshes = new Ms3dMesh[m_numMeshes];
 
 	for (int i = 0; i < m_numMeshes; ++i)
 	{
 		Ms3dMesh *mesh = &m_meshes[i];
 
-		fread(&mesh->editorFlags, 1, 1, fp);
-		ReadString(fp, mesh->name, 32);
-		fread(&mesh->numTriangles, 2, 1, fp);
+		input.Read(&mesh->editorFlags, 1, 1);
+		input.ReadString(mesh->name, 32);
+		input.Read(&mesh->numTriangles, 2, 1);
+		if (!input.HasRoomFor(2, mesh->numTriangles))
+			return false;
 		mesh->triangles = new unsigned short[mesh->numTriangles];
 		for (int j = 0; j < mesh->numTriangles; ++j)
-			fread(&mesh->triangles[j], 2, 1, fp);
-		fread(&mesh->materialIndex, 1, 1, fp);
+			input.Read(&mesh->triangles[j], 2, 1);
+		input.Read(&mesh->materialIndex, 1, 1);
 	}
 
 	// read material information
-	fread(&m_numMaterials, 2, 1, fp);
+	input.Read(&m_numMaterials, 2, 1);
 	if (m_numMaterials > 0)
 	{
 		m_materials = new Ms3dMaterial[m_numMaterials];
@@ -123,28 +217,30 @@ bool Ms3d::Load(const std::string &file)
 		{
 			Ms3dMaterial *material = &m_materials[i];
 
-			ReadString(fp, material->name, 32);
+			input.ReadString(material->name, 32);
 			for (int j = 0; j < 4; ++j)
-				fread(&material->ambient[j], 4, 1, fp);
+				input.Read(&material->ambient[j], 4, 1);
 			for (int j = 0; j < 4; ++j)
-				fread(&material->diffuse[j], 4, 1, fp);
+				input.Read(&material->diffuse[j], 4, 1);
 			for (int j = 0; j < 4; ++j)
-				fread(&material->specular[j], 4, 1, fp);
+				input.Read(&material->specular[j], 4, 1);
 			for (int j = 0; j < 4; ++j)
-				fread(&material->emissive[j], 4, 1, fp);
-			fread(&material->shininess, 4, 1, fp);
-			fread(&material->transparency, 4, 1, fp);
-			fread(&material->mode, 1, 1, fp);
-			ReadString(fp, material->texture, 128);
-			ReadString(fp, material->alpha, 128);
+				input.Read(&material->emissive[j], 4, 1);
+			input.Read(&material->shininess, 4, 1);
+			input.Read(&material->transparency, 4, 1);
+			input.Read(&material->mode, 1, 1);
+			input.ReadString(material->texture, 128);
+			input.ReadString(material->alpha, 128);
 		}
 	}
 
 	// read joints
-	fread(&m_animationFps, 4, 1, fp);
-	fread(&m_editorAnimationTime, 4, 1, fp);
-	fread(&m_numFrames, 4, 1, fp);
-	fread(&m_numJoints, 2, 1, fp);
+	input.Read(&m_animationFps, 4, 1);
+	input.Read(&m_editorAnimationTime, 4, 1);
+	input.Read(&m_numFrames, 4, 1);
+	input.Read(&m_numJoints, 2, 1);
+	if (!input.HasRoomFor(MS3D_MIN_JOINT_SIZE, m_numJoints))
+		return false;
 	if (m_numJoints > 0)
 	{
 		m_joints = new Ms3dJoint[m_numJoints];
@@ -153,58 +249,55 @@ bool Ms3d::Load(const std::string &file)
 		{
 			Ms3dJoint *joint = &m_joints[i];
 
-			fread(&joint->editorFlags, 1, 1, fp);
-			ReadString(fp, joint->name, 32);
-			ReadString(fp, joint->parentName, 32);
-			fread(&joint->rotation.x, 4, 1, fp);
-			fread(&joint->rotation.y, 4, 1, fp);
-			fread(&joint->rotation.z, 4, 1, fp);
-			fread(&joint->position.x, 4, 1, fp);
-			fread(&joint->position.y, 4, 1, fp);
-			fread(&joint->position.z, 4, 1, fp);
-			fread(&joint->numRotationFrames, 2, 1, fp);
-			fread(&joint->numTranslationFrames, 2, 1, fp);
+			input.Read(&joint->editorFlags, 1, 1);
+			input.ReadString(joint->name, 32);
+			input.ReadString(joint->parentName, 32);
+			input.Read(&joint->rotation.x, 4, 1);
+			input.Read(&joint->rotation.y, 4, 1);
+			input.Read(&joint->rotation.z, 4, 1);
+			input.Read(&joint->position.x, 4, 1);
+			input.Read(&joint->position.y, 4, 1);
+			input.Read(&joint->position.z, 4, 1);
+			input.Read(&joint->numRotationFrames, 2, 1);
+			input.Read(&joint->numTranslationFrames, 2, 1);
+			if (!input.HasRoomFor(MS3D_KEYFRAME_SIZE, (size_t)joint->numRotationFrames + joint->numTranslationFrames))
+				return false;
 			joint->rotationFrames = new Ms3dKeyFrame[joint->numRotationFrames];
 			for (int j = 0; j < joint->numRotationFrames; ++j)
 			{
 				Ms3dKeyFrame *frame = &joint->rotationFrames[j];
-				fread(&frame->time, 4, 1, fp);
-				fread(&frame->param.x, 4, 1, fp);
-				fread(&frame->param.y, 4, 1, fp);
-				fread(&frame->param.z, 4, 1, fp);
+				input.Read(&frame->time, 4, 1);
+				input.Read(&frame->param.x, 4, 1);
+				input.Read(&frame->param.y, 4, 1);
+				input.Read(&frame->param.z, 4, 1);
 			}
 			joint->translationFrames = new Ms3dKeyFrame[joint->numTranslationFrames];
 			for (int j = 0; j < joint->numTranslationFrames; ++j)
 			{
 				Ms3dKeyFrame *frame = &joint->translationFrames[j];
-				fread(&frame->time, 4, 1, fp);
-				fread(&frame->param.x, 4, 1, fp);
-				fread(&frame->param.y, 4, 1, fp);
-				fread(&frame->param.z, 4, 1, fp);
+				input.Read(&frame->time, 4, 1);
+				input.Read(&frame->param.x, 4, 1);
+				input.Read(&frame->param.y, 4, 1);
+				input.Read(&frame->param.z, 4, 1);
 			}
 		}
 	}
 
-	fclose(fp);
-
 	// check for an animation definition file
-	std::string animationFile = file;
-	animationFile.erase(animationFile.find_last_of('.', std::string::npos));
-	animationFile.append(".animations");
-
-	fp = fopen(animationFile.c_str(), "r");
-	if (fp != NULL)
+	std::vector<unsigned char> animations;
+	if (sidecars && sidecars(SIDECAR_ANIMATIONS, "", animations))
 	{
-		char *buffer = new char[80];
+		MemoryReader definitions(animations.data(), animations.size());
+		char *buffer = new char[80]();
 		std::string line;
 		std::string name;
 		std::string temp;
 		int start;
 		int end;
 
-		while (!feof(fp))
+		while (!definitions.IsAtEnd())
 		{
-			fgets(buffer, 80, fp);
+			definitions.ReadLine(buffer, 80);
 			line = buffer;
 
 			if (strlen(buffer) > 5)		// minimum length for a viable frame definition
@@ -226,74 +319,70 @@ bool Ms3d::Load(const std::string &file)
 				temp = line.substr(startEnd + 1, std::string::npos);
 				end = atoi(temp.c_str());
 
-				Ms3dAnimation *animation = new Ms3dAnimation();
-				animation->name = name;
-				animation->startFrame = start;
-				animation->endFrame = end;
-				m_animations.push_back(*animation);
+				Ms3dAnimation animation;
+				animation.name = name;
+				animation.startFrame = start;
+				animation.endFrame = end;
+				m_animations.push_back(animation);
 			}
 		}
 		delete[] buffer;
-
-		fclose(fp);
 	}
 	return true;
 }
 
-bool Ms3d::ConvertToMesh(const std::string &file)
+bool Ms3d::ConvertToMesh(FILE *fp, const ConvertOptions &options)
 {
-	FILE *fp = fopen(file.c_str(), "wb");
-	if (fp == NULL)
-		return false;
-
-	fputs("MESH", fp);
-	unsigned char version = 1;
-	fwrite(&version, 1, 1, fp);
-
-	// vertices chunk
-	fputs("VTX", fp);
-	long numVertices = m_numVertices;
-	long sizeOfVertices = ((sizeof(float) * 3)) * numVertices + sizeof(long);
-	fwrite(&sizeOfVertices, sizeof(long), 1, fp);
-	fwrite(&numVertices, sizeof(long), 1, fp);
-	for (long i = 0; i < numVertices; ++i)
+	if (options.optimizeVertexCache)
+		ReorderForVertexCache();
+	if (options.optimizeOverdraw)
+		ReorderForOverdraw(options.overdrawThreshold);
+	if (options.buildMeshlets)
+		SplitIntoMeshlets();
+	if (options.lodRatios.size() > 0)
+		BuildLevelsOfDetail(options.lodRatios);
+	if (options.optimizeVertexFetch)
+		ReorderForVertexFetch();
+
+	WriteMeshHeader(fp, options.compactIndices);
+
+	// bounds chunk, first so a loader can cull before reading anything else
+	if (options.computeBounds)
 	{
-		Ms3dVertex *vertex = &m_vertices[i];
-		fwrite(&vertex->vertex.x, sizeof(float), 1, fp);
-		fwrite(&vertex->vertex.y, sizeof(float), 1, fp);
-		fwrite(&vertex->vertex.z, sizeof(float), 1, fp);
+		MeshBounds bounds;
+		ComputeBoundingVolumes(bounds);
+		WriteBoundsChunk(fp, bounds);
 	}
 
+	// vertices chunk. Normals and texcoords are inline in the triangles,
+	// so only the positions can be quantized
+	std::vector<Vector3> positions(m_numVertices);
+	for (int i = 0; i < m_numVertices; ++i)
+		positions[i] = m_vertices[i].vertex;
+	WritePositionChunk(fp, positions.data(), m_numVertices, options.quantize);
+
 	// triangles chunk
+	IndexLayout layout;
+	const IndexLayout *indexLayout = NULL;
+	if (options.compactIndices)
+	{
+		BuildTriangleIndexLayout(m_triangles, m_numTriangles, m_numVertices, options.splitIndices, layout);
+		PrintIndexLayout("TRI", layout, m_numTriangles * 3, sizeof(int));
+		indexLayout = &layout;
+	}
 	fputs("TRI", fp);
 	long numTriangles = m_numTriangles;
-	long sizeOfTriangles = (sizeof(int) * 4 + (sizeof(float) * 3) * 3 + (sizeof(float) * 2) * 3) * numTriangles + sizeof(long);
+	long sizeOfTriangles = GetTriangleSize(indexLayout) * numTriangles + GetTriangleListHeaderSize(indexLayout);
 	fwrite(&sizeOfTriangles, sizeof(long), 1, fp);
-	fwrite(&numTriangles, sizeof(long), 1, fp);
-	for (long i = 0; i < numTriangles; ++i)
-	{
-		Ms3dTriangle *triangle = &m_triangles[i];
-		int index = triangle->vertices[0];
-		fwrite(&index, sizeof(int), 1, fp);
-		index = triangle->vertices[1];
-		fwrite(&index, sizeof(int), 1, fp);
-		index = triangle->vertices[2];
-		fwrite(&index, sizeof(int), 1, fp);
-
-		index = triangle->meshIndex;
-		fwrite(&index, sizeof(int), 1, fp);
+	WriteTriangleListHeader(fp, numTriangles, indexLayout);
+	WriteTriangles(fp, m_triangles, numTriangles, indexLayout);
 
-		for (int j = 0; j < 3; ++j)
-		{
-			fwrite(&triangle->normals[j].x, sizeof(float), 1, fp);
-			fwrite(&triangle->normals[j].y, sizeof(float), 1, fp);
-			fwrite(&triangle->normals[j].z, sizeof(float), 1, fp);
-		}
-		for (int j = 0; j < 3; ++j)
-		{
-			fwrite(&triangle->texCoords[j].x, sizeof(float), 1, fp);
-			fwrite(&triangle->texCoords[j].y, sizeof(float), 1, fp);
-		}
+	// tangents chunk, per corner of the triangles written above
+	if (options.computeTangents)
+	{
+		std::vector<CornerTangent> tangents;
+		ComputeCornerTangents(options.benchmarkTangents, tangents);
+		WriteTangentChunk(fp, tangents);
 	}
 
 	// sub-meshes / groups chunk
@@ -342,7 +431,7 @@ bool Ms3d::ConvertToMesh(const std::string &file)
 
 	// joints to vertices mapping chunk
 	fputs("JTV", fp);
-	long numMappings = numVertices;
+	long numMappings = m_numVertices;
 	long sizeOfJointMappings = (sizeof(int) + sizeof(float)) * numMappings + sizeof(long);
 	fwrite(&sizeOfJointMappings, sizeof(long), 1, fp);
 	fwrite(&numMappings, sizeof(long), 1, fp);
@@ -414,9 +503,26 @@ bool Ms3d::ConvertToMesh(const std::string &file)
 		}
 	}
 
-	fclose(fp);
+	if (m_meshlets.meshlets.size() > 0)
+		WriteMeshletChunk(fp, m_meshlets);
 
-	return true;
+	// levels of detail chunk, the triangles are laid out like TRI's
+	if (m_lodLevels.size() > 0)
+	{
+		long numLodTriangles = m_lodTriangles.size();
+		IndexLayout lodLayout;
+		const IndexLayout *lodIndexLayout = NULL;
+		if (options.compactIndices)
+		{
+			BuildTriangleIndexLayout(m_lodTriangles.data(), numLodTriangles, m_numVertices, options.splitIndices, lodLayout);
+			PrintIndexLayout("LOD", lodLayout, numLodTriangles * 3, sizeof(int));
+			lodIndexLayout = &lodLayout;
+		}
+		WriteLodChunkHeader(fp, m_lodLevels, numLodTriangles, GetTriangleSize(lodIndexLayout), lodIndexLayout);
+		WriteTriangles(fp, m_lodTriangles.data(), numLodTriangles, lodIndexLayout);
+	}
+
+	return (ferror(fp) == 0);
 }
 
 int Ms3d::FindIndexOfJoint(const std::string &jointName)
@@ -433,3 +539,476 @@ int Ms3d::FindIndexOfJoint(const std::string &jointName)
 
 	return -1;
 }
+
+void Ms3d::ReorderForVertexCache()
+{
+	ProfileScope scope(PROFILE_STAGE_VERTEX_CACHE, m_numTriangles);
+	if (m_numTriangles == 0)
+		return;
+
+	std::vector<unsigned int> indices(m_numTriangles * 3);
+	for (int i = 0; i < m_numTriangles; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			indices[i * 3 + j] = m_triangles[i].vertices[j];
+	}
+	VertexCacheStats before = AnalyzeVertexCache(&indices[0], m_numTriangles, m_numVertices);
+
+	// Groups reference their triangles through index lists which can be
+	// scattered over the whole triangle array. Each group's triangles are
+	// optimized and then laid out one group after another
+	std::vector<int> newIndex(m_numTriangles, -1);
+	std::vector<unsigned int> newOrder;
+	std::vector<unsigned int> groupIndices;
+	std::vector<unsigned int> order;
+	newOrder.reserve(m_numTriangles);
+	for (int i = 0; i < m_numMeshes; ++i)
+	{
+		Ms3dMesh *mesh = &m_meshes[i];
+		if (mesh->numTriangles == 0)
+			continue;
+
+		groupIndices.resize(mesh->numTriangles * 3);
+		for (int j = 0; j < mesh->numTriangles; ++j)
+		{
+			for (int k = 0; k < 3; ++k)
+				groupIndices[j * 3 + k] = indices[mesh->triangles[j] * 3 + k];
+		}
+		order.resize(mesh->numTriangles);
+		OptimizeVertexCache(&groupIndices[0], mesh->numTriangles, &order[0]);
+
+		for (int j = 0; j < mesh->numTriangles; ++j)
+		{
+			unsigned short triangle = mesh->triangles[order[j]];
+			if (newIndex[triangle] == -1)
+			{
+				newIndex[triangle] = newOrder.size();
+				newOrder.push_back(triangle);
+			}
+		}
+	}
+
+	// Anything not referenced by a group keeps its relative order at the end
+	for (int i = 0; i < m_numTriangles; ++i)
+	{
+		if (newIndex[i] == -1)
+		{
+			newIndex[i] = newOrder.size();
+			newOrder.push_back(i);
+		}
+	}
+
+	std::vector<Ms3dTriangle> reordered(m_numTriangles);
+	for (int i = 0; i < m_numTriangles; ++i)
+		reordered[i] = m_triangles[newOrder[i]];
+	for (int i = 0; i < m_numTriangles; ++i)
+	{
+		m_triangles[i] = reordered[i];
+		for (int j = 0; j < 3; ++j)
+			indices[i * 3 + j] = m_triangles[i].vertices[j];
+	}
+
+	for (int i = 0; i < m_numMeshes; ++i)
+	{
+		Ms3dMesh *mesh = &m_meshes[i];
+		for (int j = 0; j < mesh->numTriangles; ++j)
+			mesh->triangles[j] = newIndex[mesh->triangles[j]];
+		std::sort(mesh->triangles, mesh->triangles + mesh->numTriangles);
+	}
+
+	VertexCacheStats after = AnalyzeVertexCache(&indices[0], m_numTriangles, m_numVertices);
+	printf("Vertex cache ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.acmr, after.acmr, before.atvr, after.atvr);
+}
+
+void Ms3d::ReorderForVertexFetch()
+{
+	ProfileScope scope(PROFILE_STAGE_VERTEX_FETCH, m_numTriangles);
+	if (m_numTriangles == 0)
+		return;
+
+	std::vector<unsigned int> vertices(m_numTriangles * 3);
+	for (int i = 0; i < m_numTriangles; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			vertices[i * 3 + j] = m_triangles[i].vertices[j];
+	}
+	VertexFetchStats before = AnalyzeVertexFetch(&vertices[0], vertices.size(), m_numVertices, sizeof(float) * 3);
+
+	// Normals and texcoords are stored per triangle corner, only the vertices
+	// move. The joint index travels with each vertex, which keeps the JTV
+	// mapping chunk in step with the VTX chunk
+	std::vector<unsigned int> remap(m_numVertices);
+	OptimizeVertexFetch(&vertices[0], vertices.size(), m_numVertices, remap.data());
+	RemapVertexArray(m_vertices, m_numVertices, remap.data());
+
+	for (int i = 0; i < m_numTriangles; ++i)
+	{
+		Ms3dTriangle *triangle = &m_triangles[i];
+		for (int j = 0; j < 3; ++j)
+		{
+			if (triangle->vertices[j] < m_numVertices)
+				triangle->vertices[j] = remap[triangle->vertices[j]];
+			vertices[i * 3 + j] = triangle->vertices[j];
+		}
+	}
+	for (unsigned int i = 0; i < m_meshlets.vertices.size(); ++i)
+		m_meshlets.vertices[i] = remap[m_meshlets.vertices[i]];
+	for (unsigned int i = 0; i < m_lodTriangles.size(); ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			m_lodTriangles[i].vertices[j] = remap[m_lodTriangles[i].vertices[j]];
+	}
+
+	VertexFetchStats after = AnalyzeVertexFetch(&vertices[0], vertices.size(), m_numVertices, sizeof(float) * 3);
+	printf("Vertex fetch overfetch %.3f -> %.3f, lines per triangle %.3f -> %.3f\n", before.overfetch, after.overfetch, before.linesPerTriangle, after.linesPerTriangle);
+}
+
+void Ms3d::ReorderForOverdraw(float threshold)
+{
+	ProfileScope scope(PROFILE_STAGE_OVERDRAW, m_numTriangles);
+	if (m_numTriangles == 0 || m_numVertices == 0)
+		return;
+
+	std::vector<Vector3> positions(m_numVertices);
+	for (int i = 0; i < m_numVertices; ++i)
+		positions[i] = m_vertices[i].vertex;
+
+	std::vector<unsigned int> indices(m_numTriangles * 3);
+	for (int i = 0; i < m_numTriangles; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			indices[i * 3 + j] = m_triangles[i].vertices[j];
+	}
+	VertexCacheStats cacheBefore = AnalyzeVertexCache(&indices[0], m_numTriangles, m_numVertices);
+	OverdrawStats overdrawBefore = AnalyzeOverdraw(&indices[0], m_numTriangles, &positions[0], m_numVertices);
+
+	// Clusters are sorted within each group. The groups' triangle lists are
+	// sorted as a side effect, which is the layout ReorderForVertexCache
+	// leaves behind and what the GRP chunk expects
+	std::vector<int> newIndex(m_numTriangles, -1);
+	std::vector<unsigned int> newOrder;
+	std::vector<unsigned int> groupIndices;
+	std::vector<unsigned int> order;
+	newOrder.reserve(m_numTriangles);
+	for (int i = 0; i < m_numMeshes; ++i)
+	{
+		Ms3dMesh *mesh = &m_meshes[i];
+		if (mesh->numTriangles == 0)
+			continue;
+
+		std::sort(mesh->triangles, mesh->triangles + mesh->numTriangles);
+		groupIndices.resize(mesh->numTriangles * 3);
+		for (int j = 0; j < mesh->numTriangles; ++j)
+		{
+			for (int k = 0; k < 3; ++k)
+				groupIndices[j * 3 + k] = indices[mesh->triangles[j] * 3 + k];
+		}
+		order.resize(mesh->numTriangles);
+		OptimizeOverdraw(&groupIndices[0], mesh->numTriangles, &positions[0], m_numVertices, threshold, &order[0]);
+
+		for (int j = 0; j < mesh->numTriangles; ++j)
+		{
+			unsigned short triangle = mesh->triangles[order[j]];
+			if (newIndex[triangle] == -1)
+			{
+				newIndex[triangle] = newOrder.size();
+				newOrder.push_back(triangle);
+			}
+		}
+	}
+
+	for (int i = 0; i < m_numTriangles; ++i)
+	{
+		if (newIndex[i] == -1)
+		{
+			newIndex[i] = newOrder.size();
+			newOrder.push_back(i);
+		}
+	}
+
+	std::vector<Ms3dTriangle> reordered(m_numTriangles);
+	for (int i = 0; i < m_numTriangles; ++i)
+		reordered[i] = m_triangles[newOrder[i]];
+	for (int i = 0; i < m_numTriangles; ++i)
+	{
+		m_triangles[i] = reordered[i];
+		for (int j = 0; j < 3; ++j)
+			indices[i * 3 + j] = m_triangles[i].vertices[j];
+	}
+
+	for (int i = 0; i < m_numMeshes; ++i)
+	{
+		Ms3dMesh *mesh = &m_meshes[i];
+		for (int j = 0; j < mesh->numTriangles; ++j)
+			mesh->triangles[j] = newIndex[mesh->triangles[j]];
+		std::sort(mesh->triangles, mesh->triangles + mesh->numTriangles);
+	}
+
+	VertexCacheStats cacheAfter = AnalyzeVertexCache(&indices[0], m_numTriangles, m_numVertices);
+	OverdrawStats overdrawAfter = AnalyzeOverdraw(&indices[0], m_numTriangles, &positions[0], m_numVertices);
+	printf("Overdraw %.3f -> %.3f, ACMR %.3f -> %.3f\n", overdrawBefore.overdraw, overdrawAfter.overdraw, cacheBefore.acmr, cacheAfter.acmr);
+}
+
+void Ms3d::GroupTriangles(std::vector<TriangleRange> &ranges)
+{
+	// Lays the triangles out one group after another, keeping their relative
+	// order, so every group covers a single run of the triangle array.
+	// Anything not in a group ends up after the last group
+	std::vector<unsigned int> order;
+	std::vector<bool> placed(m_numTriangles, false);
+	order.reserve(m_numTriangles);
+	ranges.clear();
+	for (int i = 0; i < m_numMeshes; ++i)
+	{
+		Ms3dMesh *mesh = &m_meshes[i];
+		std::sort(mesh->triangles, mesh->triangles + mesh->numTriangles);
+
+		TriangleRange range;
+		range.start = order.size();
+		range.group = i;
+		for (int j = 0; j < mesh->numTriangles; ++j)
+		{
+			unsigned short triangle = mesh->triangles[j];
+			if (triangle < m_numTriangles && !placed[triangle])
+			{
+				placed[triangle] = true;
+				order.push_back(triangle);
+			}
+		}
+		range.end = order.size();
+		if (range.end > range.start)
+			ranges.push_back(range);
+	}
+
+	for (int i = 0; i < m_numTriangles; ++i)
+	{
+		if (!placed[i])
+			order.push_back(i);
+	}
+
+	PermuteTriangles(&order[0]);
+}
+
+void Ms3d::PermuteTriangles(const unsigned int *order)
+{
+	// order holds the old index of the triangle for every new position, the
+	// groups' triangle lists are updated to match and kept sorted
+	std::vector<unsigned short> newIndex(m_numTriangles);
+	std::vector<Ms3dTriangle> original(m_triangles, m_triangles + m_numTriangles);
+	for (int i = 0; i < m_numTriangles; ++i)
+	{
+		m_triangles[i] = original[order[i]];
+		newIndex[order[i]] = i;
+	}
+
+	for (int i = 0; i < m_numMeshes; ++i)
+	{
+		Ms3dMesh *mesh = &m_meshes[i];
+		for (int j = 0; j < mesh->numTriangles; ++j)
+		{
+			if (mesh->triangles[j] < m_numTriangles)
+				mesh->triangles[j] = newIndex[mesh->triangles[j]];
+		}
+		std::sort(mesh->triangles, mesh->triangles + mesh->numTriangles);
+	}
+}
+
+void Ms3d::SplitIntoMeshlets()
+{
+	ProfileScope scope(PROFILE_STAGE_MESHLETS, m_numTriangles);
+	if (m_numTriangles == 0 || m_numVertices == 0)
+		return;
+
+	std::vector<TriangleRange> ranges;
+	GroupTriangles(ranges);
+
+	std::vector<Vector3> positions(m_numVertices);
+	for (int i = 0; i < m_numVertices; ++i)
+		positions[i] = m_vertices[i].vertex;
+
+	std::vector<unsigned int> indices(m_numTriangles * 3);
+	for (int i = 0; i < m_numTriangles; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			indices[i * 3 + j] = m_triangles[i].vertices[j];
+	}
+
+	std::vector<unsigned int> order(m_numTriangles);
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	BuildMeshlets(&indices[0], m_numTriangles, ranges.data(), ranges.size(), &positions[0], m_numVertices, m_meshlets, &order[0]);
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	PermuteTriangles(&order[0]);
+
+	MeshletStats stats = AnalyzeMeshlets(m_meshlets);
+	printf("Meshlets %u, %.1f vertices %.1f triangles average, %.0f%% with usable cones, built in %.2f ms (%.2f Mtris/s)\n", stats.numMeshlets, stats.averageVertices, stats.averageTriangles, stats.conesUsable * 100.0f, elapsed, (elapsed > 0.0 ? m_numTriangles / (elapsed * 1000.0) : 0.0));
+}
+
+void Ms3d::BuildLevelsOfDetail(const std::vector<float> &ratios)
+{
+	ProfileScope scope(PROFILE_STAGE_LOD, m_numTriangles);
+	if (m_numTriangles == 0 || m_numVertices == 0)
+		return;
+
+	std::vector<TriangleRange> ranges;
+	GroupTriangles(ranges);
+
+	// Normals and texcoords are stored per corner, so corners share a wedge
+	// when the values of all their attributes match. Copies of a vertex
+	// only count as the same point if they are bound to the same joint
+	std::vector<unsigned int> vertices(m_numTriangles * 3);
+	std::vector<Vector3> normals(m_numTriangles * 3);
+	std::vector<Vector2> texCoords(m_numTriangles * 3);
+	for (int i = 0; i < m_numTriangles; ++i)
+	{
+		const Ms3dTriangle *triangle = &m_triangles[i];
+		for (int j = 0; j < 3; ++j)
+		{
+			if (triangle->vertices[j] >= m_numVertices)
+			{
+				printf("Skipping LOD generation, triangles reference missing vertices\n");
+				return;
+			}
+			vertices[i * 3 + j] = triangle->vertices[j];
+			normals[i * 3 + j] = triangle->normals[j];
+			texCoords[i * 3 + j] = triangle->texCoords[j];
+		}
+	}
+
+	std::vector<Vector3> vertexPositions(m_numVertices);
+	std::vector<float> joints(m_numVertices);
+	for (int i = 0; i < m_numVertices; ++i)
+	{
+		vertexPositions[i] = m_vertices[i].vertex;
+		joints[i] = m_vertices[i].jointIndex;
+	}
+
+	std::vector<unsigned int> cornerWedges(m_numTriangles * 3);
+	std::vector<unsigned int> wedgeCorners;
+	std::vector<unsigned int> wedgePositions;
+	std::vector<Vector3> positions;
+	unsigned int numWedges = BuildAttributeWedges(&vertices[0], m_numTriangles * 3, &vertexPositions[0], m_numVertices, &joints[0], &normals[0], &texCoords[0], &cornerWedges[0], wedgeCorners, wedgePositions, positions);
+
+	LodData lods;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	BuildLodChain(&cornerWedges[0], m_numTriangles, ranges.data(), ranges.size(), &wedgePositions[0], numWedges, &positions[0], positions.size(), &ratios[0], ratios.size(), lods);
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	m_lodLevels = lods.levels;
+	m_lodTriangles.resize(lods.indices.size() / 3);
+	for (unsigned int i = 0; i < m_lodTriangles.size(); ++i)
+	{
+		Ms3dTriangle *triangle = &m_lodTriangles[i];
+		triangle->editorFlags = 0;
+		triangle->smoothingGroup = 0;
+		triangle->meshIndex = (unsigned char)lods.groups[i];
+		for (int j = 0; j < 3; ++j)
+		{
+			unsigned int corner = wedgeCorners[lods.indices[i * 3 + j]];
+			const Ms3dTriangle *original = &m_triangles[corner / 3];
+			triangle->vertices[j] = original->vertices[corner % 3];
+			triangle->normals[j] = original->normals[corner % 3];
+			triangle->texCoords[j] = original->texCoords[corner % 3];
+		}
+	}
+
+	for (unsigned int i = 0; i < m_lodLevels.size(); ++i)
+		printf("LOD %u: %u of %u triangles (%.1f%%, asked for %.1f%%), error %.5f\n", i + 1, m_lodLevels[i].count, m_numTriangles, m_lodLevels[i].count * 100.0f / m_numTriangles, m_lodLevels[i].ratio * 100.0f, m_lodLevels[i].error);
+	for (unsigned int i = 0; i < lods.dropped.size(); ++i)
+		printf("LOD dropped: only got down to %u of %u triangles (%.1f%%, asked for %.1f%%)\n", lods.dropped[i].count, m_numTriangles, lods.dropped[i].count * 100.0f / m_numTriangles, lods.dropped[i].ratio * 100.0f);
+	printf("LOD chain built in %.2f ms (%.2f Mtris/s)\n", elapsed, (elapsed > 0.0 ? m_numTriangles / (elapsed * 1000.0) : 0.0));
+}
+
+void Ms3d::ComputeBoundingVolumes(MeshBounds &bounds)
+{
+	ProfileScope scope(PROFILE_STAGE_BOUNDS, m_numTriangles);
+	std::vector<Vector3> positions(m_numVertices);
+	for (int i = 0; i < m_numVertices; ++i)
+		positions[i] = m_vertices[i].vertex;
+
+	// Groups list their triangles rather than covering a run of the
+	// triangle array, so their vertices are gathered one group after
+	// another. Bounds don't care about vertex joints, they are for the
+	// bind pose
+	std::vector<unsigned int> indices;
+	std::vector<TriangleRange> ranges;
+	for (int i = 0; i < m_numMeshes; ++i)
+	{
+		Ms3dMesh *mesh = &m_meshes[i];
+		TriangleRange range;
+		range.start = indices.size() / 3;
+		for (int j = 0; j < mesh->numTriangles; ++j)
+		{
+			if (mesh->triangles[j] >= m_numTriangles)
+				continue;
+			for (int k = 0; k < 3; ++k)
+				indices.push_back(m_triangles[mesh->triangles[j]].vertices[k]);
+		}
+		range.end = indices.size() / 3;
+		range.group = i;
+		if (range.end > range.start)
+			ranges.push_back(range);
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	ComputeBounds(positions.data(), m_numVertices, bounds.mesh);
+	bounds.groups.resize(m_numMeshes);
+	for (int i = 0; i < m_numMeshes; ++i)
+		ClearBounds(bounds.groups[i]);
+	ComputeRangeBounds(positions.data(), indices.data(), ranges.data(), ranges.size(), bounds.groups.data());
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	printf("Bounds for the mesh and %d groups computed in %.2f ms\n", m_numMeshes, elapsed);
+}
+
+void Ms3d::ComputeCornerTangents(bool benchmark, std::vector<CornerTangent> &tangents)
+{
+	ProfileScope scope(PROFILE_STAGE_TANGENTS, m_numTriangles);
+	// Normals and texcoords are stored per corner, so they index themselves
+	unsigned int numCorners = m_numTriangles * 3;
+	std::vector<unsigned int> vertices(numCorners);
+	std::vector<unsigned int> corners(numCorners);
+	std::vector<Vector3> positions(m_numVertices);
+	std::vector<Vector3> normals(numCorners);
+	std::vector<Vector2> texCoords(numCorners);
+	for (int i = 0; i < m_numVertices; ++i)
+		positions[i] = m_vertices[i].vertex;
+	for (unsigned int i = 0; i < m_numTriangles; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			vertices[i * 3 + j] = m_triangles[i].vertices[j];
+			corners[i * 3 + j] = i * 3 + j;
+			normals[i * 3 + j] = m_triangles[i].normals[j];
+			texCoords[i * 3 + j] = m_triangles[i].texCoords[j];
+		}
+	}
+
+	TangentMesh mesh;
+	mesh.positionIndices = vertices.data();
+	mesh.normalIndices = corners.data();
+	mesh.texCoordIndices = corners.data();
+	mesh.numTriangles = m_numTriangles;
+	mesh.positions = positions.data();
+	mesh.numPositions = m_numVertices;
+	mesh.normals = normals.data();
+	mesh.numNormals = numCorners;
+	mesh.texCoords = texCoords.data();
+	mesh.numTexCoords = numCorners;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	TangentStats stats = ComputeTangents(mesh, tangents);
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	printf("Tangents for %u corners (%u vertices, %u mirrored, %u degenerate) computed in %.2f ms (%.2f Mtris/s)\n", (unsigned int)tangents.size(), stats.numVertices, stats.numMirrored, stats.numDegenerate, elapsed,
+		(elapsed > 0.0 ? mesh.numTriangles / (elapsed * 1000.0) : 0.0));
+	if (!benchmark)
+		return;
+
+	TangentBenchmark result = BenchmarkTangents(mesh);
+	printf("Tangent times:");
+	for (unsigned int i = 0; i < result.threadCounts.size(); ++i)
+		printf(" %u thread%s %.2f ms,", result.threadCounts[i], (result.threadCounts[i] > 1 ? "s" : ""), result.times[i]);
+	printf(" reference %.2f ms\n", result.referenceTime);
+	printf("Tangents against the reference: largest difference %.4f degrees, average %.6f degrees, %u sign mismatches\n", result.comparison.maxAngle, result.comparison.averageAngle, result.comparison.signMismatches);
+}
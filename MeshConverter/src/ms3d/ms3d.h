@@ -1,15 +1,22 @@
 #ifndef __MS3D_H_INCLUDED__
 #define __MS3D_H_INCLUDED__
 
+#include <stdio.h>
 #include <string>
 #include "../geometry/vector3.h"
 #include "../geometry/vector2.h"
+#include "../convert/options.h"
+#include "../convert/sidecar.h"
+#include "../processing/meshlets.h"
+#include "../processing/simplify.h"
+#include "../processing/bounds.h"
+#include "../processing/tangents.h"
 #include <vector>
 
 struct Ms3dHeader
 {
 	char id[10];
-	long version;
+	int version;                                 // 4 bytes in the file, long is 8 on 64 bit Linux
 };
 
 struct Ms3dVertex
@@ -108,8 +115,32 @@ public:
 	virtual ~Ms3d()                                        { Release(); }
 
 	void Release();
-	bool Load(const std::string &file);
-	bool ConvertToMesh(const std::string &file);
+
+	/**
+	 * @param data contents of an MS3D file
+	 * @param size size of data in bytes
+	 * @param sidecars asked for the model's animation definitions, which
+	 *                 are optional, or empty to go without
+	 *
+	 * @return bool false if data isn't an MS3D model
+	 */
+	bool Load(const void *data, size_t size, const SidecarResolver &sidecars = SidecarResolver());
+
+	/**
+	 * @param fp stream to write the MESH file to
+	 * @param options processing to apply
+	 *
+	 * @return bool false if writing failed
+	 */
+	bool ConvertToMesh(FILE *fp, const ConvertOptions &options = ConvertOptions());
+
+	/**
+	 * @param file model file
+	 *
+	 * @return std::string the animation definition file Load looks for
+	 *                     next to the model, which may not exist
+	 */
+	static std::string GetAnimationFile(const std::string &file);
 
 	unsigned short GetNumVertices()                        { return m_numVertices; }
 	unsigned short GetNumTriangles()                       { return m_numTriangles; }
@@ -126,6 +157,15 @@ public:
 
 private:
 	int FindIndexOfJoint(const std::string &jointName);
+	void ReorderForVertexCache();
+	void ReorderForOverdraw(float threshold);
+	void ReorderForVertexFetch();
+	void SplitIntoMeshlets();
+	void BuildLevelsOfDetail(const std::vector<float> &ratios);
+	void ComputeBoundingVolumes(MeshBounds &bounds);
+	void ComputeCornerTangents(bool benchmark, std::vector<CornerTangent> &tangents);
+	void GroupTriangles(std::vector<TriangleRange> &ranges);
+	void PermuteTriangles(const unsigned int *order);
 
 	unsigned short m_numVertices;
 	unsigned short m_numTriangles;
@@ -141,6 +181,9 @@ private:
 	Ms3dMaterial *m_materials;
 	Ms3dJoint *m_joints;
 	std::vector<Ms3dAnimation> m_animations;
+	MeshletData m_meshlets;
+	std::vector<LodLevel> m_lodLevels;
+	std::vector<Ms3dTriangle> m_lodTriangles;
 };
 
 #endif
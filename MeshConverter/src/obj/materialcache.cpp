@@ -0,0 +1,52 @@
+#include "materialcache.h"
+#include "../util/hash.h"
+
+#include <string.h>
+
+ObjMaterialCache::ObjMaterialCache()
+{
+	m_numHits = 0;
+	m_numMisses = 0;
+}
+
+bool ObjMaterialCache::Load(const void *data, size_t size, const std::string &texturePath, ObjMaterialLibrary &library)
+{
+	uint64_t hash = HashBytes(data, size);
+
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		std::map<uint64_t, Entry>::const_iterator found = m_entries.find(hash);
+		if (found != m_entries.end() && found->second.contents.size() == size && found->second.texturePath == texturePath &&
+			(size == 0 || memcmp(found->second.contents.data(), data, size) == 0))
+		{
+			++m_numHits;
+			library = found->second.library;
+			return true;
+		}
+		++m_numMisses;
+	}
+
+	// Read without holding the lock, so threads missing on different
+	// libraries don't wait on each other
+	if (!Obj::ReadMaterialLibrary(data, size, texturePath, library))
+		return false;
+
+	std::lock_guard<std::mutex> guard(m_lock);
+	Entry &entry = m_entries[hash];
+	entry.contents.assign((const unsigned char*)data, (const unsigned char*)data + size);
+	entry.texturePath = texturePath;
+	entry.library = library;
+	return true;
+}
+
+unsigned int ObjMaterialCache::GetNumHits()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_numHits;
+}
+
+unsigned int ObjMaterialCache::GetNumMisses()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_numMisses;
+}
@@ -0,0 +1,56 @@
+#ifndef __OBJ_MATERIALCACHE_H_INCLUDED__
+#define __OBJ_MATERIALCACHE_H_INCLUDED__
+
+#include "obj.h"
+
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Keeps the materials of the .mtl files OBJ models use once read, for a
+ * process that converts many models sharing the same libraries. Libraries
+ * are looked up by their contents, so an edited library is read again
+ * straight away and the same library reached under different names is
+ * only read once. Safe to share between threads
+ */
+class ObjMaterialCache
+{
+public:
+	ObjMaterialCache();
+
+	/**
+	 * Gets the materials a library defines, without reading it again if
+	 * a library with the same contents has been read before
+	 * @param data contents of the material library
+	 * @param size size of data in bytes
+	 * @param texturePath prepended to the name of every texture map
+	 * @param library receives the materials
+	 *
+	 * @return bool false if the library couldn't be read
+	 */
+	bool Load(const void *data, size_t size, const std::string &texturePath, ObjMaterialLibrary &library);
+
+	unsigned int GetNumHits();
+	unsigned int GetNumMisses();
+
+private:
+	ObjMaterialCache(const ObjMaterialCache &);
+	ObjMaterialCache& operator=(const ObjMaterialCache &);
+
+	struct Entry
+	{
+		std::vector<unsigned char> contents;     // Compared in full, so a hash collision can't hand out the wrong materials
+		std::string texturePath;
+		ObjMaterialLibrary library;
+	};
+
+	std::mutex m_lock;                           // Guards everything below
+	std::map<uint64_t, Entry> m_entries;         // By hash of the contents
+	unsigned int m_numHits;
+	unsigned int m_numMisses;
+};
+
+#endif
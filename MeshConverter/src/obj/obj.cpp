@@ -1,8 +1,108 @@
 #include "obj.h"
+#include "materialcache.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <fstream>
 #include <sstream>
+#include <vector>
+#include <utility>
+#include <chrono>
+
+#include "../processing/vertexcache.h"
+#include "../processing/vertexfetch.h"
+#include "../processing/overdraw.h"
+#include "../processing/meshlets.h"
+#include "../processing/simplify.h"
+#include "../mesh/meshwriter.h"
+#include "../util/memoryreader.h"
+#include "../util/profiler.h"
+
+static void WriteFace(FILE *fp, const ObjFace *face, long material)
+{
+	long data;
+
+	for (int k = 0; k < 3; ++k)
+	{
+		data = face->vertices[k];
+		fwrite(&data, sizeof(long), 1, fp);
+	}
+	for (int k = 0; k < 3; ++k)
+	{
+		data = face->normals[k];
+		fwrite(&data, sizeof(long), 1, fp);
+	}
+	for (int k = 0; k < 3; ++k)
+	{
+		data = face->texcoords[k];
+		fwrite(&data, sizeof(long), 1, fp);
+	}
+
+	fwrite(&material, sizeof(long), 1, fp);
+}
+
+static long GetFaceSize(const IndexLayout *layout)
+{
+	if (layout == NULL)
+		return (sizeof(long) * 3) * 3 + sizeof(long);
+	return (layout->indexSize * 3) * 3 + sizeof(long);
+}
+
+static void WriteFaces(FILE *fp, const ObjFace *faces, const unsigned int *materials, long numFaces, const IndexLayout *layout)
+{
+	if (layout == NULL)
+	{
+		for (long i = 0; i < numFaces; ++i)
+			WriteFace(fp, &faces[i], materials[i]);
+		return;
+	}
+
+	for (unsigned int i = 0; i < layout->batches.size(); ++i)
+	{
+		const IndexBatch *batch = &layout->batches[i];
+		for (unsigned int j = batch->firstTriangle; j < batch->firstTriangle + batch->numTriangles; ++j)
+		{
+			const ObjFace *face = &faces[j];
+			for (int k = 0; k < 3; ++k)
+				WriteIndex(fp, face->vertices[k], batch->base[0], layout->indexSize);
+			for (int k = 0; k < 3; ++k)
+				WriteIndex(fp, face->normals[k], batch->base[1], layout->indexSize);
+			for (int k = 0; k < 3; ++k)
+				WriteIndex(fp, face->texcoords[k], batch->base[2], layout->indexSize);
+
+			long material = materials[j];
+			fwrite(&material, sizeof(long), 1, fp);
+		}
+	}
+}
+
+// Models are read from memory rather than a file opened in text mode,
+// so the '\r' of a "\r\n" line ending is dropped here instead
+static void ReadLine(std::istream &input, std::string &line)
+{
+	std::getline(input, line, '\n');
+	if (line.length() > 0 && line[line.length() - 1] == '\r')
+		line.erase(line.length() - 1);
+}
+
+// Counts the vertices of an "f" line. Faces can mix triangles, quads and
+// larger polygons within one model, so every line is counted on its own
+static int CountFaceVertices(const std::string &faceDefinition)
+{
+	int count = 0;
+	bool inToken = false;
+	for (size_t i = 0; i < faceDefinition.length(); ++i)
+	{
+		bool space = (faceDefinition[i] == ' ' || faceDefinition[i] == '\t');
+		if (!space && !inToken)
+			++count;
+		inToken = !space;
+	}
+
+	// The "f" itself isn't a vertex
+	return (count > 0 ? count - 1 : 0);
+}
 
 Obj::Obj()
 {
@@ -14,6 +114,9 @@ Obj::Obj()
 	m_numNormals = 0;
 	m_numTexCoords = 0;
 	m_numMaterials = 0;
+	m_defaultMaterial = -1;
+	m_faceVertexTypeKnown = false;
+	m_faceVertexType = OBJ_VERTEX_FULL;
 }
 
 void Obj::Release()
@@ -30,36 +133,32 @@ void Obj::Release()
 	m_numNormals = 0;
 	m_numTexCoords = 0;
 	m_numMaterials = 0;
+	m_defaultMaterial = -1;
+	m_faceVertexTypeKnown = false;
+	m_faceVertexType = OBJ_VERTEX_FULL;
 }
 
-bool Obj::Load(const std::string &file, const std::string &texturePath)
+bool Obj::Load(const void *data, size_t size, const std::string &texturePath, const SidecarResolver &sidecars, ObjMaterialCache *materialCache)
 {
-	std::ifstream input;
+	MemoryStreamBuffer buffer(data, size);
+	std::istream input(&buffer);
 	std::string line;
 	std::string op;
-	std::string path;
 	std::string tempName;
 	Vector3 vertex;
 	Vector3 normal;
-	ObjMaterial *currentMaterial = NULL;
+	ObjMaterial *currentMaterial;
 	int currentVertex = 0;
 	int currentNormal = 0;
 	int currentTexCoord = 0;
 	int numGroups = 0;
+	unsigned int smoothingGroup = 1;
 
-	// Get pathname from filename given (if present)
-	// Need this as we assume any .mtl files specified are in the same path as this .obj file
-	if (file.find_last_of('/') != std::string::npos)
-		path = file.substr(0, file.find_last_of('/') + 1);
-
-	if (!FindAndLoadMaterials(path, texturePath, file))
-		return false;
-	if (!GetDataSizes(file))
+	if (!FindAndLoadMaterials(texturePath, data, size, sidecars, materialCache))
 		return false;
-
-	input.open(file.c_str());
-	if (input.fail())
+	if (!GetDataSizes(data, size))
 		return false;
+	currentMaterial = (m_defaultMaterial >= 0 ? &m_materials[m_defaultMaterial] : NULL);
 
 	// Extract name of model from the filename given (basically, chop off the extension and path)
 	//if (file.find_last_of('.') != std::string::npos)
@@ -71,7 +170,7 @@ bool Obj::Load(const std::string &file, const std::string &texturePath)
 		if (numGroups > 1)
 			break;
 
-		std::getline(input, line, '\n');
+		ReadLine(input, line);
 
 		op = line.substr(0, line.find(' '));
 
@@ -91,7 +190,7 @@ bool Obj::Load(const std::string &file, const std::string &texturePath)
 		else if (op ==  "vt")
 		{
 			sscanf(line.c_str(), "vt %f %f", &m_texCoords[currentTexCoord].x, &m_texCoords[currentTexCoord].y);
-			m_texCoords[currentTexCoord].x = -m_texCoords[currentTexCoord].y;
+			m_texCoords[currentTexCoord].y = -m_texCoords[currentTexCoord].y;
 			++currentTexCoord;
 		}
 
@@ -105,7 +204,17 @@ bool Obj::Load(const std::string &file, const std::string &texturePath)
 		// Face definition
 		else if (op == "f")
 		{
-			ParseFaceDefinition(line, currentMaterial);
+			ParseFaceDefinition(line, currentMaterial, smoothingGroup);
+		}
+
+		// Smoothing group, everything is smoothed together until one is given
+		else if (op == "s")
+		{
+			tempName = line.substr(line.find(' ') + 1);
+			if (tempName.compare(0, 3, "off") == 0)
+				smoothingGroup = NORMALS_NO_SMOOTHING;
+			else
+				smoothingGroup = (unsigned int)strtoul(tempName.c_str(), NULL, 10);
 		}
 
 		// Group name
@@ -122,21 +231,11 @@ bool Obj::Load(const std::string &file, const std::string &texturePath)
 		// Material
 		else if (op == "usemtl")
 		{
-			tempName = line.substr(line.find(' ') + 1);
-
-			currentMaterial = NULL;
-
-			// Find the named material and set it as current
-			for (unsigned int i = 0; i < m_numMaterials; ++i)
-			{
-				if (m_materials[i].name == tempName)
-				{
-					currentMaterial = &m_materials[i];
-					break;
-				}
-			}
-
-			//ASSERT(currentMaterial != NULL);
+			// Faces go in the same material here as they were counted in
+			int material = FindMaterial(line.substr(line.find(' ') + 1));
+			if (material < 0)
+				material = m_defaultMaterial;
+			currentMaterial = (material >= 0 ? &m_materials[material] : NULL);
 		}
 
 		// Material file
@@ -146,15 +245,11 @@ bool Obj::Load(const std::string &file, const std::string &texturePath)
 		}
 	}
 
-	input.close();
-
 	return true;
 }
 
-void Obj::ParseFaceDefinition(const std::string &faceDefinition, ObjMaterial *currentMaterial)
+void Obj::ParseFaceDefinition(const std::string &faceDefinition, ObjMaterial *currentMaterial, unsigned int smoothingGroup)
 {
-	static int numFaceVertices = 0;
-	static OBJ_FACE_VERTEX_TYPE vertexType;
 	std::string def;
 	int pos;
 	int n = 0;
@@ -165,25 +260,19 @@ void Obj::ParseFaceDefinition(const std::string &faceDefinition, ObjMaterial *cu
 
 	// Few different face formats, and variable amount of vertices per face possible
 
-	// How many vertices are there in this face definition? (only calc this once)
-	// Also calc the vertex format
-	if (!numFaceVertices)
-	{
-		pos = 0;
-		while (def.length() > 0 && def[def.length() - 1] == ' ')
-			def = def.substr(0, def.length() - 1);
-		//ASSERT(def.length() > 0);
+	// How many vertices are there in this face definition? This has to match
+	// what GetDataSizes counted, which made room for n - 2 triangles
+	int numFaceVertices = CountFaceVertices(faceDefinition);
 
-		while (pos != std::string::npos)
-		{
-			++pos;
-			++numFaceVertices;
-			pos = def.find(' ', pos);
-		}
+	// Calc the vertex format (only once per model, kept in the object rather
+	// than statics so several models can load at the same time)
+	if (!m_faceVertexTypeKnown && numFaceVertices > 0)
+	{
+		m_faceVertexTypeKnown = true;
 
 		std::string tempVertex = def.substr(0, def.find(' '));
 		if (tempVertex.find("//") != std::string::npos)
-			vertexType = OBJ_VERTEX_NORMAL;
+			m_faceVertexType = OBJ_VERTEX_NORMAL;
 		else
 		{
 			pos = 0;
@@ -195,9 +284,9 @@ void Obj::ParseFaceDefinition(const std::string &faceDefinition, ObjMaterial *cu
 			}
 
 			if (n == 1)
-				vertexType = OBJ_VERTEX_TEXCOORD;
+				m_faceVertexType = OBJ_VERTEX_TEXCOORD;
 			else
-				vertexType = OBJ_VERTEX_FULL;
+				m_faceVertexType = OBJ_VERTEX_FULL;
 		}
 	}
 
@@ -219,6 +308,7 @@ void Obj::ParseFaceDefinition(const std::string &faceDefinition, ObjMaterial *cu
 	memset(&firstVertex, 0, sizeof(int) * 3);
 	memset(&lastReadVertex, 0, sizeof(int) * 3);
 	memset(&thisTriangle, 0, sizeof(int) * (3 * 3));
+	face.smoothingGroup = smoothingGroup;
 	parser.clear();
 	parser.str(def);
 
@@ -230,7 +320,7 @@ void Obj::ParseFaceDefinition(const std::string &faceDefinition, ObjMaterial *cu
 		// Add vertex/texcoord/normal indexes to the data arrays 
 		// (OBJ file indexes are NOT zero based. We fix that here)
 		memset(&thisVertex, 0, sizeof(int) * 3);
-		switch (vertexType)
+		switch (m_faceVertexType)
 		{
 		case OBJ_VERTEX_FULL:			// v/vt/vn
 			sscanf(currentVertex.c_str(), "%d/%d/%d", &thisVertex[0], &thisVertex[1], &thisVertex[2]);
@@ -239,7 +329,7 @@ void Obj::ParseFaceDefinition(const std::string &faceDefinition, ObjMaterial *cu
 			sscanf(currentVertex.c_str(), "%d//%d", &thisVertex[0], &thisVertex[2]);
 			break;
 		case OBJ_VERTEX_TEXCOORD:		// v/vt
-			sscanf(currentVertex.c_str(), "%d/%d", &thisVertex[0]);
+			sscanf(currentVertex.c_str(), "%d/%d", &thisVertex[0], &thisVertex[1]);
 			break;
 		}
 
@@ -279,28 +369,25 @@ void Obj::ParseFaceDefinition(const std::string &faceDefinition, ObjMaterial *cu
 	}
 }
 
-bool Obj::GetDataSizes(const std::string &file)
+bool Obj::GetDataSizes(const void *data, size_t size)
 {
-	std::ifstream input;
+	MemoryStreamBuffer buffer(data, size);
+	std::istream input(&buffer);
 	std::string line;
 	std::string op;
 	int countVertices = 0;
 	int countNormals = 0;
 	int countTexCoords = 0;
 	int numGroups = 0;
-	std::string useMtlName;
-	ObjMaterial *currentMaterial;
-
-	input.open(file.c_str());
-	if (input.fail())
-		return false;
+	int currentMaterial = -1;
+	unsigned int numDefaultFaces = 0;
 
 	while (!input.eof())
 	{
 		if (numGroups > 1)
 			break;
 
-		std::getline(input, line, '\n');
+		ReadLine(input, line);
 
 		op = line.substr(0, line.find(' '));
 
@@ -313,30 +400,27 @@ bool Obj::GetDataSizes(const std::string &file)
 		else if (op == "vn")
 			++countNormals;
 		else if (op == "f")
-			// TODO: count number of vertices per face definition, and adjust the ++ operation accordingly (i.e. for 4 vertices per face, needs to be "+= 2")
-			++currentMaterial->numFaces;
-
-		else if (op == "usemtl")
 		{
-			std::string useMtlName = line.substr(line.find(' ') + 1);
-
-			currentMaterial = NULL;
-
-			// Find the named material and set it as current
-			for (unsigned int i = 0; i < m_numMaterials; ++i)
-			{
-				if (m_materials[i].name == useMtlName)
-				{
-					currentMaterial = &m_materials[i];
-					break;
-				}
-			}
-
-			//ASSERT(currentMaterial != NULL);
+			// Faces are split into a fan of n - 2 triangles when loaded
+			int numFaceVertices = CountFaceVertices(line);
+			unsigned int numTriangles = (numFaceVertices > 2 ? numFaceVertices - 2 : 0);
+			if (currentMaterial >= 0)
+				m_materials[currentMaterial].numFaces += numTriangles;
+			else
+				numDefaultFaces += numTriangles;
 		}
+
+		// Faces before any usemtl, or after one naming a material the
+		// library doesn't have, go in a default material
+		else if (op == "usemtl")
+			currentMaterial = FindMaterial(line.substr(line.find(' ') + 1));
 	}
 
-	input.close();
+	if (numDefaultFaces > 0)
+	{
+		AddDefaultMaterial();
+		m_materials[m_defaultMaterial].numFaces = numDefaultFaces;
+	}
 
 	m_numVertices = countVertices;
 	m_numTexCoords = countTexCoords;
@@ -352,25 +436,67 @@ bool Obj::GetDataSizes(const std::string &file)
 	return true;
 }
 
-bool Obj::LoadMaterialLibrary(const std::string &file, const std::string &texturePath)
+int Obj::FindMaterial(const std::string &name)
 {
-	std::ifstream input;
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		if ((int)i != m_defaultMaterial && m_materials[i].name == name)
+			return (int)i;
+	}
+	return -1;
+}
+
+void Obj::AddDefaultMaterial()
+{
+	// Moved across rather than copied, ObjMaterial owns what it points to
+	ObjMaterial *materials = new ObjMaterial[m_numMaterials + 1];
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		materials[i].name.swap(m_materials[i].name);
+		std::swap(materials[i].material, m_materials[i].material);
+		std::swap(materials[i].faces, m_materials[i].faces);
+		materials[i].numFaces = m_materials[i].numFaces;
+		materials[i].lastFaceIndex = m_materials[i].lastFaceIndex;
+	}
+	delete[] m_materials;
+
+	m_materials = materials;
+	m_defaultMaterial = (int)m_numMaterials;
+	++m_numMaterials;
+}
+
+bool Obj::LoadMaterialLibrary(const std::vector<unsigned char> &data, const std::string &texturePath, ObjMaterialCache *materialCache)
+{
+	ObjMaterialLibrary library;
+	if (materialCache != NULL ? !materialCache->Load(data.data(), data.size(), texturePath, library) : !ReadMaterialLibrary(data.data(), data.size(), texturePath, library))
+		return false;
+
+	m_numMaterials = (unsigned int)library.names.size();
+	m_materials = new ObjMaterial[m_numMaterials];
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		m_materials[i].name = library.names[i];
+		*m_materials[i].material = library.materials[i];
+	}
+
+	return true;
+}
+
+bool Obj::ReadMaterialLibrary(const void *data, size_t size, const std::string &texturePath, ObjMaterialLibrary &library)
+{
+	MemoryStreamBuffer buffer(data, size);
+	std::istream input(&buffer);
 	std::string line;
 	std::string op;
 	int currentMaterial = -1;
 	float r, g, b;
 
-	if (!CountDefinedMaterials(file))
-		return false;
-	m_materials = new ObjMaterial[m_numMaterials];
-
-	input.open(file.c_str());
-	if (input.fail())
-		return false;
+	library.names.clear();
+	library.materials.clear();
 
 	while (!input.eof())
 	{
-		std::getline(input, line, '\n');
+		ReadLine(input, line);
 
 		op = line.substr(0, line.find(' '));
 
@@ -378,31 +504,29 @@ bool Obj::LoadMaterialLibrary(const std::string &file, const std::string &textur
 		if (op == "newmtl")
 		{
 			++currentMaterial;
-			m_materials[currentMaterial].name = line.substr(op.length() + 1);
+			library.names.push_back(line.substr(op.length() + 1));
+			library.materials.push_back(Material());
 		}
 
 		// Ambient color
-		else if (op == "Ka")
+		else if (op == "Ka" && currentMaterial >= 0)
 		{
-			//ASSERT(currentMaterial >= 0);
 			sscanf(line.c_str(), "Ka %f %f %f", &r, &g, &b);
-			m_materials[currentMaterial].material->SetAmbient(RGB_24_f(r, g, b));
+			library.materials[currentMaterial].SetAmbient(RGB_24_f(r, g, b));
 		}
 
 		// Diffuse color
-		else if (op == "Kd")
+		else if (op == "Kd" && currentMaterial >= 0)
 		{
-			//ASSERT(currentMaterial >= 0);
 			sscanf(line.c_str(), "Kd %f %f %f", &r, &g, &b);
-			m_materials[currentMaterial].material->SetDiffuse(RGB_24_f(r, g, b));
+			library.materials[currentMaterial].SetDiffuse(RGB_24_f(r, g, b));
 		}
 
 		// Specular color
-		else if (op == "Ks")
+		else if (op == "Ks" && currentMaterial >= 0)
 		{
-			//ASSERT(currentMaterial >= 0);
 			sscanf(line.c_str(), "Ks %f %f %f", &r, &g, &b);
-			m_materials[currentMaterial].material->SetSpecular(RGB_24_f(r, g, b));
+			library.materials[currentMaterial].SetSpecular(RGB_24_f(r, g, b));
 		}
 
 		// Alpha value
@@ -424,73 +548,730 @@ bool Obj::LoadMaterialLibrary(const std::string &file, const std::string &textur
 		}
 
 		// Texture
-		else if (op == "map_Ka" || op == "map_Kd")
+		else if ((op == "map_Ka" || op == "map_Kd") && currentMaterial >= 0)
 		{
-			//ASSERT(currentMaterial >= 0);
-			m_materials[currentMaterial].material->SetTexture(texturePath + line.substr(op.length() + 1));
+			library.materials[currentMaterial].SetTexture(texturePath + line.substr(op.length() + 1));
 		}
 
 	}
 
-	input.close();
+	return true;
+}
+
+bool Obj::FindAndLoadMaterials(const std::string &texturePath, const void *data, size_t size, const SidecarResolver &sidecars, ObjMaterialCache *materialCache)
+{
+	MemoryStreamBuffer buffer(data, size);
+	std::istream input(&buffer);
+	std::string name;
+	FindMaterialLibraryName(input, name);
+
+	std::vector<unsigned char> library;
+	if (name.length() > 0 && sidecars && sidecars(SIDECAR_MATERIAL_LIBRARY, name, library))
+		LoadMaterialLibrary(library, texturePath, materialCache);
 
 	return true;
 }
 
-bool Obj::CountDefinedMaterials(const std::string &file)
+bool Obj::FindMaterialLibrary(const std::string &file, std::string &library)
 {
 	std::ifstream input;
-	std::string line;
-	std::string op;
-	int count = 0;
+	std::string path;
+	std::string name;
+
+	library.clear();
+
+	// Get pathname from filename given (if present)
+	// Need this as we assume any .mtl files specified are in the same path as this .obj file
+	if (file.find_last_of('/') != std::string::npos)
+		path = file.substr(0, file.find_last_of('/') + 1);
 
 	input.open(file.c_str());
 	if (input.fail())
 		return false;
 
-	while (!input.eof())
-	{
-		std::getline(input, line, '\n');
-
-		op = line.substr(0, line.find(' '));
-		if (op == "newmtl")
-			++m_numMaterials;
-	}
+	FindMaterialLibraryName(input, name);
+	if (name.length() > 0)
+		library = path + name;
 
 	input.close();
 
 	return true;
 }
 
-bool Obj::FindAndLoadMaterials(const std::string &materialPath, const std::string &texturePath, const std::string &file)
+void Obj::FindMaterialLibraryName(std::istream &input, std::string &name)
 {
-	std::ifstream input;
 	std::string line;
 	std::string op;
 
-	input.open(file.c_str());
-	if (input.fail())
-		return false;
+	name.clear();
 
 	while (!input.eof())
 	{
-		std::getline(input, line, '\n');
+		ReadLine(input, line);
 
 		op = line.substr(0, line.find(' '));
 
 		if (op == "mtllib")
 		{
-			LoadMaterialLibrary(materialPath + line.substr(line.find(' ') + 1), texturePath);
+			name = line.substr(line.find(' ') + 1);
 			break;
 		}
 	}
+}
 
-	input.close();
+bool Obj::ConvertToMesh(FILE *fp, const ConvertOptions &options)
+{
+	if (options.weldVertices)
+		WeldVertexPositions(options.weldEpsilon, options.weldKeepSeams);
+	if (options.generateNormals)
+		GenerateSmoothNormals(options.creaseAngle, options.areaWeightedNormals);
+	if (options.optimizeVertexCache)
+		ReorderForVertexCache();
+	if (options.optimizeOverdraw)
+		ReorderForOverdraw(options.overdrawThreshold);
+	if (options.buildMeshlets)
+		SplitIntoMeshlets();
+	if (options.lodRatios.size() > 0)
+		BuildLevelsOfDetail(options.lodRatios);
+	if (options.optimizeVertexFetch)
+		ReorderForVertexFetch();
+
+	WriteMeshHeader(fp, options.compactIndices);
+
+	// bounds chunk, first so a loader can cull before reading anything else
+	if (options.computeBounds)
+	{
+		MeshBounds bounds;
+		ComputeBoundingVolumes(bounds);
+		WriteBoundsChunk(fp, bounds);
+	}
 
-	return true;
+	// vertices chunk
+	WritePositionChunk(fp, m_vertices, m_numVertices, options.quantize);
+
+	// normals chunk
+	WriteNormalChunk(fp, m_normals, m_numNormals, options.quantize);
+
+	// texture coordinates chunk
+	WriteTexCoordChunk(fp, m_texCoords, m_numTexCoords, options.quantize);
+
+	// materials chunk
+	fputs("MTL", fp);
+
+	long numMaterials = m_numMaterials;
+
+	// figure out the size of all the material texture filename strings
+	long sizeofNames = 0;
+	for (long i = 0; i < numMaterials; ++i)
+		sizeofNames += m_materials[i].material->GetTexture().length() + 1;
+
+	long sizeofMaterials = sizeofNames + sizeof(long);
+	fwrite(&sizeofMaterials, sizeof(long), 1, fp);
+	fwrite(&numMaterials, sizeof(long), 1, fp);
+	for (long i = 0; i < numMaterials; ++i)
+	{
+		const ObjMaterial *material = &m_materials[i];
+		fputs(material->material->GetTexture().c_str(), fp);
+		fwrite("\0", 1, 1, fp);
+	}
+
+	// triangles chunk, same layout as the SM converter writes. Faces are
+	// stored per material so they come out already sorted by material
+	std::vector<ObjFace> faces;
+	std::vector<unsigned int> faceMaterials;
+	for (long i = 0; i < numMaterials; ++i)
+	{
+		const ObjMaterial *material = &m_materials[i];
+		faces.insert(faces.end(), material->faces, material->faces + material->lastFaceIndex);
+		faceMaterials.insert(faceMaterials.end(), material->lastFaceIndex, i);
+	}
+	long numFaces = faces.size();
+
+	IndexLayout layout;
+	const IndexLayout *indexLayout = NULL;
+	if (options.compactIndices)
+	{
+		BuildFaceIndexLayout(faces.data(), numFaces, options.splitIndices, layout);
+		PrintIndexLayout("TRI", layout, numFaces * 9, sizeof(long));
+		indexLayout = &layout;
+	}
+	fputs("TRI", fp);
+	long sizeofFaces = GetFaceSize(indexLayout) * numFaces + GetTriangleListHeaderSize(indexLayout);
+	fwrite(&sizeofFaces, sizeof(long), 1, fp);
+	WriteTriangleListHeader(fp, numFaces, indexLayout);
+	WriteFaces(fp, faces.data(), faceMaterials.data(), numFaces, indexLayout);
+
+	// tangents chunk, per corner of the triangles written above
+	if (options.computeTangents)
+	{
+		std::vector<CornerTangent> tangents;
+		ComputeCornerTangents(options.benchmarkTangents, tangents);
+		WriteTangentChunk(fp, tangents);
+	}
+
+	// bounding volume hierarchy chunk, over the triangles as written above
+	if (options.buildBvh)
+	{
+		BvhData bvh;
+		BuildBoundingVolumeHierarchy(options.benchmarkBvh, bvh);
+		WriteBvhChunk(fp, bvh);
+	}
+
+	if (m_meshlets.meshlets.size() > 0)
+		WriteMeshletChunk(fp, m_meshlets);
+
+	// levels of detail chunk, the triangles are laid out like TRI's
+	if (m_lodLevels.size() > 0)
+	{
+		long numLodFaces = m_lodFaces.size();
+		IndexLayout lodLayout;
+		const IndexLayout *lodIndexLayout = NULL;
+		if (options.compactIndices)
+		{
+			BuildFaceIndexLayout(m_lodFaces.data(), numLodFaces, options.splitIndices, lodLayout);
+			PrintIndexLayout("LOD", lodLayout, numLodFaces * 9, sizeof(long));
+			lodIndexLayout = &lodLayout;
+		}
+		WriteLodChunkHeader(fp, m_lodLevels, numLodFaces, GetFaceSize(lodIndexLayout), lodIndexLayout);
+		WriteFaces(fp, m_lodFaces.data(), m_lodMaterials.data(), numLodFaces, lodIndexLayout);
+	}
+
+	return (ferror(fp) == 0);
+}
+
+void Obj::BuildFaceIndexLayout(const ObjFace *faces, unsigned int numFaces, bool split, IndexLayout &layout)
+{
+	std::vector<unsigned int> indices(numFaces * 9);
+	for (unsigned int i = 0; i < numFaces; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			indices[i * 9 + j] = faces[i].vertices[j];
+			indices[i * 9 + 3 + j] = faces[i].normals[j];
+			indices[i * 9 + 6 + j] = faces[i].texcoords[j];
+		}
+	}
+
+	unsigned int streamSizes[3] = { m_numVertices, m_numNormals, m_numTexCoords };
+	BuildIndexLayout(indices.data(), numFaces, 3, streamSizes, split, layout);
+}
+
+unsigned int Obj::GetNumFaces()
+{
+	unsigned int numFaces = 0;
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+		numFaces += m_materials[i].lastFaceIndex;
+	return numFaces;
+}
+
+void Obj::WeldVertexPositions(float epsilon, bool keepSeams)
+{
+	ProfileScope scope(PROFILE_STAGE_WELD, m_numVertices);
+	if (m_numVertices == 0)
+		return;
+
+	std::vector<unsigned int> vertices;
+	std::vector<unsigned int> normals;
+	std::vector<unsigned int> texCoords;
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		for (unsigned int j = 0; j < m_materials[i].lastFaceIndex; ++j)
+		{
+			const ObjFace *face = &m_materials[i].faces[j];
+			for (int k = 0; k < 3; ++k)
+			{
+				vertices.push_back(face->vertices[k]);
+				normals.push_back(face->normals[k]);
+				texCoords.push_back(face->texcoords[k]);
+			}
+		}
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::vector<float> attributes;
+	if (keepSeams)
+		GatherSeamAttributes(vertices.data(), normals.data(), texCoords.data(), vertices.size(), m_normals, m_numNormals, m_texCoords, m_numTexCoords, m_numVertices, epsilon, attributes);
+	std::vector<unsigned int> remap(m_numVertices);
+	unsigned int numWelded = WeldVertices(m_vertices, m_numVertices, epsilon, (keepSeams ? attributes.data() : NULL), WELD_SEAM_ATTRIBUTES, remap.data());
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	CompactVertexArray(m_vertices, m_numVertices, remap.data());
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		for (unsigned int j = 0; j < m_materials[i].lastFaceIndex; ++j)
+		{
+			ObjFace *face = &m_materials[i].faces[j];
+			for (int k = 0; k < 3; ++k)
+			{
+				if (face->vertices[k] < m_numVertices)
+					face->vertices[k] = remap[face->vertices[k]];
+			}
+		}
+	}
+
+	unsigned int removed = m_numVertices - numWelded;
+	printf("Welded %u -> %u vertices (%u removed, %.1f%%) in %.2f ms (%.2f ms per million vertices)\n", m_numVertices, numWelded, removed, removed * 100.0f / m_numVertices, elapsed, elapsed * 1000000.0 / m_numVertices);
+	m_numVertices = numWelded;
+}
+
+void Obj::GenerateSmoothNormals(float creaseAngle, bool areaWeighted)
+{
+	ProfileScope scope(PROFILE_STAGE_NORMALS, m_numVertices);
+	std::vector<unsigned int> vertices;
+	std::vector<unsigned int> smoothingGroups;
+	bool hasNormals = false;
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		for (unsigned int j = 0; j < m_materials[i].lastFaceIndex; ++j)
+		{
+			const ObjFace *face = &m_materials[i].faces[j];
+			for (int k = 0; k < 3; ++k)
+			{
+				vertices.push_back(face->vertices[k]);
+				if (face->normals[k] < m_numNormals)
+					hasNormals = true;
+			}
+			smoothingGroups.push_back(face->smoothingGroup);
+		}
+	}
+	if (hasNormals)
+	{
+		printf("Keeping the normals stored in the model\n");
+		return;
+	}
+
+	unsigned int numFaces = (unsigned int)smoothingGroups.size();
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::vector<Vector3> normals;
+	std::vector<unsigned int> normalIndices(numFaces * 3);
+	NormalStats stats = GenerateNormals(vertices.data(), numFaces, m_vertices, m_numVertices, smoothingGroups.data(), creaseAngle, (areaWeighted ? NORMALS_WEIGHT_AREA : NORMALS_WEIGHT_ANGLE), normals, normalIndices.data());
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	delete[] m_normals;
+	m_numNormals = (unsigned int)normals.size();
+	m_normals = new Vector3[m_numNormals > 0 ? m_numNormals : 1];
+	for (unsigned int i = 0; i < m_numNormals; ++i)
+		m_normals[i] = normals[i];
+
+	unsigned int corner = 0;
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		for (unsigned int j = 0; j < m_materials[i].lastFaceIndex; ++j)
+		{
+			ObjFace *face = &m_materials[i].faces[j];
+			for (int k = 0; k < 3; ++k)
+				face->normals[k] = normalIndices[corner++];
+		}
+	}
+
+	printf("Generated %u normals for %u vertices (%u hard corners) in %.2f ms (%.2f Mtris/s)\n", stats.numNormals, stats.numVertices, stats.numHardCorners, elapsed, (elapsed > 0.0 ? numFaces / (elapsed * 1000.0) : 0.0));
+}
+
+void Obj::ReorderForVertexCache()
+{
+	ProfileScope scope(PROFILE_STAGE_VERTEX_CACHE, GetNumFaces());
+	unsigned int numFaces = 0;
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+		numFaces += m_materials[i].lastFaceIndex;
+	if (numFaces == 0)
+		return;
+
+	std::vector<unsigned int> indices;
+	indices.reserve(numFaces * 3);
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		for (unsigned int j = 0; j < m_materials[i].lastFaceIndex; ++j)
+		{
+			for (int k = 0; k < 3; ++k)
+				indices.push_back(m_materials[i].faces[j].vertices[k]);
+		}
+	}
+	VertexCacheStats before = AnalyzeVertexCache(&indices[0], numFaces, m_numVertices);
+
+	// Every material keeps its own face list, so each is optimized on its own
+	std::vector<unsigned int> order;
+	std::vector<ObjFace> reordered;
+	unsigned int offset = 0;
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		ObjMaterial *material = &m_materials[i];
+		unsigned int count = material->lastFaceIndex;
+		if (count == 0)
+			continue;
+
+		order.resize(count);
+		OptimizeVertexCache(&indices[offset * 3], count, &order[0]);
+
+		reordered.resize(count);
+		for (unsigned int j = 0; j < count; ++j)
+			reordered[j] = material->faces[order[j]];
+		for (unsigned int j = 0; j < count; ++j)
+		{
+			material->faces[j] = reordered[j];
+			for (int k = 0; k < 3; ++k)
+				indices[(offset + j) * 3 + k] = reordered[j].vertices[k];
+		}
+
+		offset += count;
+	}
+
+	VertexCacheStats after = AnalyzeVertexCache(&indices[0], numFaces, m_numVertices);
+	printf("Vertex cache ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.acmr, after.acmr, before.atvr, after.atvr);
 }
 
-bool Obj::ConvertToMesh(const std::string &file)
+void Obj::ReorderForVertexFetch()
 {
-	return false;
+	ProfileScope scope(PROFILE_STAGE_VERTEX_FETCH, GetNumFaces());
+	// Faces are written out material by material, so that is the order the
+	// index streams are walked in here too
+	std::vector<unsigned int> vertices;
+	std::vector<unsigned int> normals;
+	std::vector<unsigned int> texCoords;
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		for (unsigned int j = 0; j < m_materials[i].lastFaceIndex; ++j)
+		{
+			const ObjFace *face = &m_materials[i].faces[j];
+			for (int k = 0; k < 3; ++k)
+			{
+				vertices.push_back(face->vertices[k]);
+				normals.push_back(face->normals[k]);
+				texCoords.push_back(face->texcoords[k]);
+			}
+		}
+	}
+	if (vertices.size() == 0)
+		return;
+	VertexFetchStats before = AnalyzeVertexFetch(&vertices[0], vertices.size(), m_numVertices, sizeof(Vector3));
+
+	std::vector<unsigned int> vertexRemap(m_numVertices);
+	std::vector<unsigned int> normalRemap(m_numNormals);
+	std::vector<unsigned int> texCoordRemap(m_numTexCoords);
+	OptimizeVertexFetch(&vertices[0], vertices.size(), m_numVertices, vertexRemap.data());
+	OptimizeVertexFetch(&normals[0], normals.size(), m_numNormals, normalRemap.data());
+	OptimizeVertexFetch(&texCoords[0], texCoords.size(), m_numTexCoords, texCoordRemap.data());
+	RemapVertexArray(m_vertices, m_numVertices, vertexRemap.data());
+	RemapVertexArray(m_normals, m_numNormals, normalRemap.data());
+	RemapVertexArray(m_texCoords, m_numTexCoords, texCoordRemap.data());
+
+	unsigned int offset = 0;
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		for (unsigned int j = 0; j < m_materials[i].lastFaceIndex; ++j)
+		{
+			ObjFace *face = &m_materials[i].faces[j];
+			for (int k = 0; k < 3; ++k)
+			{
+				if (face->vertices[k] < m_numVertices)
+					face->vertices[k] = vertexRemap[face->vertices[k]];
+				if (face->normals[k] < m_numNormals)
+					face->normals[k] = normalRemap[face->normals[k]];
+				if (face->texcoords[k] < m_numTexCoords)
+					face->texcoords[k] = texCoordRemap[face->texcoords[k]];
+				vertices[offset++] = face->vertices[k];
+			}
+		}
+	}
+	for (unsigned int i = 0; i < m_meshlets.vertices.size(); ++i)
+		m_meshlets.vertices[i] = vertexRemap[m_meshlets.vertices[i]];
+	for (unsigned int i = 0; i < m_lodFaces.size(); ++i)
+	{
+		ObjFace *face = &m_lodFaces[i];
+		for (int j = 0; j < 3; ++j)
+		{
+			face->vertices[j] = vertexRemap[face->vertices[j]];
+			if (face->normals[j] < m_numNormals)
+				face->normals[j] = normalRemap[face->normals[j]];
+			if (face->texcoords[j] < m_numTexCoords)
+				face->texcoords[j] = texCoordRemap[face->texcoords[j]];
+		}
+	}
+
+	VertexFetchStats after = AnalyzeVertexFetch(&vertices[0], vertices.size(), m_numVertices, sizeof(Vector3));
+	printf("Vertex fetch overfetch %.3f -> %.3f, lines per triangle %.3f -> %.3f\n", before.overfetch, after.overfetch, before.linesPerTriangle, after.linesPerTriangle);
+}
+
+void Obj::ReorderForOverdraw(float threshold)
+{
+	ProfileScope scope(PROFILE_STAGE_OVERDRAW, GetNumFaces());
+	std::vector<unsigned int> indices;
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		for (unsigned int j = 0; j < m_materials[i].lastFaceIndex; ++j)
+		{
+			for (int k = 0; k < 3; ++k)
+				indices.push_back(m_materials[i].faces[j].vertices[k]);
+		}
+	}
+	unsigned int numFaces = indices.size() / 3;
+	if (numFaces == 0 || m_numVertices == 0)
+		return;
+
+	VertexCacheStats cacheBefore = AnalyzeVertexCache(&indices[0], numFaces, m_numVertices);
+	OverdrawStats overdrawBefore = AnalyzeOverdraw(&indices[0], numFaces, m_vertices, m_numVertices);
+
+	std::vector<unsigned int> order;
+	std::vector<ObjFace> reordered;
+	unsigned int offset = 0;
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		ObjMaterial *material = &m_materials[i];
+		unsigned int count = material->lastFaceIndex;
+		if (count == 0)
+			continue;
+
+		order.resize(count);
+		OptimizeOverdraw(&indices[offset * 3], count, m_vertices, m_numVertices, threshold, &order[0]);
+
+		reordered.resize(count);
+		for (unsigned int j = 0; j < count; ++j)
+			reordered[j] = material->faces[order[j]];
+		for (unsigned int j = 0; j < count; ++j)
+		{
+			material->faces[j] = reordered[j];
+			for (int k = 0; k < 3; ++k)
+				indices[(offset + j) * 3 + k] = reordered[j].vertices[k];
+		}
+
+		offset += count;
+	}
+
+	VertexCacheStats cacheAfter = AnalyzeVertexCache(&indices[0], numFaces, m_numVertices);
+	OverdrawStats overdrawAfter = AnalyzeOverdraw(&indices[0], numFaces, m_vertices, m_numVertices);
+	printf("Overdraw %.3f -> %.3f, ACMR %.3f -> %.3f\n", overdrawBefore.overdraw, overdrawAfter.overdraw, cacheBefore.acmr, cacheAfter.acmr);
+}
+
+void Obj::SplitIntoMeshlets()
+{
+	ProfileScope scope(PROFILE_STAGE_MESHLETS, GetNumFaces());
+	// Faces are written material by material, which makes every material
+	// one range of the combined triangle list
+	std::vector<unsigned int> indices;
+	std::vector<TriangleRange> ranges;
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		TriangleRange range;
+		range.start = indices.size() / 3;
+		for (unsigned int j = 0; j < m_materials[i].lastFaceIndex; ++j)
+		{
+			for (int k = 0; k < 3; ++k)
+				indices.push_back(m_materials[i].faces[j].vertices[k]);
+		}
+		range.end = indices.size() / 3;
+		range.group = i;
+		if (range.end > range.start)
+			ranges.push_back(range);
+	}
+	unsigned int numFaces = indices.size() / 3;
+	if (numFaces == 0 || m_numVertices == 0)
+		return;
+
+	std::vector<unsigned int> order(numFaces);
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	BuildMeshlets(&indices[0], numFaces, ranges.data(), ranges.size(), m_vertices, m_numVertices, m_meshlets, &order[0]);
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::vector<ObjFace> reordered;
+	for (unsigned int i = 0; i < ranges.size(); ++i)
+	{
+		ObjMaterial *material = &m_materials[ranges[i].group];
+		unsigned int offset = ranges[i].start;
+		reordered.assign(material->faces, material->faces + material->lastFaceIndex);
+		for (unsigned int j = 0; j < material->lastFaceIndex; ++j)
+			material->faces[j] = reordered[order[offset + j] - offset];
+	}
+
+	MeshletStats stats = AnalyzeMeshlets(m_meshlets);
+	printf("Meshlets %u, %.1f vertices %.1f triangles average, %.0f%% with usable cones, built in %.2f ms (%.2f Mtris/s)\n", stats.numMeshlets, stats.averageVertices, stats.averageTriangles, stats.conesUsable * 100.0f, elapsed, (elapsed > 0.0 ? numFaces / (elapsed * 1000.0) : 0.0));
+}
+
+void Obj::BuildLevelsOfDetail(const std::vector<float> &ratios)
+{
+	ProfileScope scope(PROFILE_STAGE_LOD, GetNumFaces());
+	// Corners with the same position, normal and texcoord values are the
+	// same wedge, even when the file indexes copies of them. Materials are
+	// ranges of the combined face list, same as when writing the TRI chunk
+	std::vector<unsigned int> vertices;
+	std::vector<Vector3> normals;
+	std::vector<Vector2> texCoords;
+	Vector2 none = { 0.0f, 0.0f };
+	std::vector<const ObjFace*> faces;
+	std::vector<TriangleRange> ranges;
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		TriangleRange range;
+		range.start = faces.size();
+		for (unsigned int j = 0; j < m_materials[i].lastFaceIndex; ++j)
+		{
+			const ObjFace *face = &m_materials[i].faces[j];
+			for (int k = 0; k < 3; ++k)
+			{
+				if (face->vertices[k] >= m_numVertices)
+				{
+					printf("Skipping LOD generation, faces reference missing vertices\n");
+					return;
+				}
+				vertices.push_back(face->vertices[k]);
+				normals.push_back(face->normals[k] < m_numNormals ? m_normals[face->normals[k]] : ZERO_VECTOR);
+				texCoords.push_back(face->texcoords[k] < m_numTexCoords ? m_texCoords[face->texcoords[k]] : none);
+			}
+			faces.push_back(face);
+		}
+		range.end = faces.size();
+		range.group = i;
+		if (range.end > range.start)
+			ranges.push_back(range);
+	}
+	unsigned int numFaces = faces.size();
+	if (numFaces == 0 || m_numVertices == 0)
+		return;
+
+	std::vector<unsigned int> cornerWedges(numFaces * 3);
+	std::vector<unsigned int> wedgeCorners;
+	std::vector<unsigned int> wedgePositions;
+	std::vector<Vector3> positions;
+	unsigned int numWedges = BuildAttributeWedges(&vertices[0], numFaces * 3, m_vertices, m_numVertices, NULL, &normals[0], &texCoords[0], &cornerWedges[0], wedgeCorners, wedgePositions, positions);
+
+	LodData lods;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	BuildLodChain(&cornerWedges[0], numFaces, ranges.data(), ranges.size(), &wedgePositions[0], numWedges, &positions[0], positions.size(), &ratios[0], ratios.size(), lods);
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	m_lodLevels = lods.levels;
+	m_lodMaterials = lods.groups;
+	m_lodFaces.resize(lods.indices.size() / 3);
+	for (unsigned int i = 0; i < m_lodFaces.size(); ++i)
+	{
+		ObjFace *face = &m_lodFaces[i];
+		for (int j = 0; j < 3; ++j)
+		{
+			unsigned int corner = wedgeCorners[lods.indices[i * 3 + j]];
+			const ObjFace *original = faces[corner / 3];
+			face->vertices[j] = original->vertices[corner % 3];
+			face->normals[j] = original->normals[corner % 3];
+			face->texcoords[j] = original->texcoords[corner % 3];
+			face->smoothingGroup = original->smoothingGroup;
+		}
+	}
+
+	for (unsigned int i = 0; i < m_lodLevels.size(); ++i)
+		printf("LOD %u: %u of %u triangles (%.1f%%, asked for %.1f%%), error %.5f\n", i + 1, m_lodLevels[i].count, numFaces, m_lodLevels[i].count * 100.0f / numFaces, m_lodLevels[i].ratio * 100.0f, m_lodLevels[i].error);
+	for (unsigned int i = 0; i < lods.dropped.size(); ++i)
+		printf("LOD dropped: only got down to %u of %u triangles (%.1f%%, asked for %.1f%%)\n", lods.dropped[i].count, numFaces, lods.dropped[i].count * 100.0f / numFaces, lods.dropped[i].ratio * 100.0f);
+	printf("LOD chain built in %.2f ms (%.2f Mtris/s)\n", elapsed, (elapsed > 0.0 ? numFaces / (elapsed * 1000.0) : 0.0));
+}
+
+void Obj::ComputeBoundingVolumes(MeshBounds &bounds)
+{
+	ProfileScope scope(PROFILE_STAGE_BOUNDS, GetNumFaces());
+	// Faces are written material by material, which makes every material
+	// one range of the combined triangle list
+	std::vector<unsigned int> indices;
+	std::vector<TriangleRange> ranges;
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		TriangleRange range;
+		range.start = indices.size() / 3;
+		for (unsigned int j = 0; j < m_materials[i].lastFaceIndex; ++j)
+		{
+			for (int k = 0; k < 3; ++k)
+				indices.push_back(m_materials[i].faces[j].vertices[k]);
+		}
+		range.end = indices.size() / 3;
+		range.group = i;
+		if (range.end > range.start)
+			ranges.push_back(range);
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	ComputeBounds(m_vertices, m_numVertices, bounds.mesh);
+	bounds.groups.resize(m_numMaterials);
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+		ClearBounds(bounds.groups[i]);
+	ComputeRangeBounds(m_vertices, indices.data(), ranges.data(), ranges.size(), bounds.groups.data());
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	printf("Bounds for the mesh and %u materials computed in %.2f ms\n", m_numMaterials, elapsed);
+}
+
+void Obj::BuildBoundingVolumeHierarchy(bool benchmark, BvhData &bvh)
+{
+	ProfileScope scope(PROFILE_STAGE_BVH, GetNumFaces());
+	// Same order the faces are written in, material by material
+	std::vector<unsigned int> indices;
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		for (unsigned int j = 0; j < m_materials[i].lastFaceIndex; ++j)
+		{
+			for (int k = 0; k < 3; ++k)
+				indices.push_back(m_materials[i].faces[j].vertices[k]);
+		}
+	}
+	unsigned int numTriangles = indices.size() / 3;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	BuildBvh(indices.data(), numTriangles, m_vertices, bvh);
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	BvhStats stats = AnalyzeBvh(bvh);
+	printf("BVH %u nodes, %u leaves, %.1f triangles per leaf, depth %u, SAH cost %.1f, built in %.2f ms (%.2f Mtris/s)\n", stats.numNodes, stats.numLeaves, stats.averageLeafTriangles, stats.maxDepth, stats.cost, elapsed, (elapsed > 0.0 ? numTriangles / (elapsed * 1000.0) : 0.0));
+	if (!benchmark)
+		return;
+
+	BvhBenchmark result = BenchmarkBvh(indices.data(), numTriangles, m_vertices, bvh, BVH_BENCHMARK_RAYS);
+	printf("BVH build times:");
+	for (unsigned int i = 0; i < result.threadCounts.size(); ++i)
+		printf(" %u thread%s %.2f ms%s", result.threadCounts[i], (result.threadCounts[i] > 1 ? "s" : ""), result.buildTimes[i], (i + 1 < result.threadCounts.size() ? "," : "\n"));
+	printf("Ray casts %u rays (%u hits) %.2f Mrays/s, brute force %.4f Mrays/s (%.0fx slower, %u mismatches in %u rays)\n", result.numRays, result.numHits, result.raysPerSecond / 1000000.0,
+		result.bruteForceRaysPerSecond / 1000000.0, (result.bruteForceRaysPerSecond > 0.0 ? result.raysPerSecond / result.bruteForceRaysPerSecond : 0.0), result.mismatches, result.numBruteForceRays);
+}
+
+void Obj::ComputeCornerTangents(bool benchmark, std::vector<CornerTangent> &tangents)
+{
+	ProfileScope scope(PROFILE_STAGE_TANGENTS, GetNumFaces());
+	// Same order as the faces are written in, material by material
+	std::vector<unsigned int> vertices;
+	std::vector<unsigned int> normals;
+	std::vector<unsigned int> texCoords;
+	for (unsigned int i = 0; i < m_numMaterials; ++i)
+	{
+		for (unsigned int j = 0; j < m_materials[i].lastFaceIndex; ++j)
+		{
+			const ObjFace *face = &m_materials[i].faces[j];
+			for (int k = 0; k < 3; ++k)
+			{
+				vertices.push_back(face->vertices[k]);
+				normals.push_back(face->normals[k]);
+				texCoords.push_back(face->texcoords[k]);
+			}
+		}
+	}
+
+	TangentMesh mesh;
+	mesh.positionIndices = vertices.data();
+	mesh.normalIndices = normals.data();
+	mesh.texCoordIndices = texCoords.data();
+	mesh.numTriangles = vertices.size() / 3;
+	mesh.positions = m_vertices;
+	mesh.numPositions = m_numVertices;
+	mesh.normals = m_normals;
+	mesh.numNormals = m_numNormals;
+	mesh.texCoords = m_texCoords;
+	mesh.numTexCoords = m_numTexCoords;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	TangentStats stats = ComputeTangents(mesh, tangents);
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	printf("Tangents for %u corners (%u vertices, %u mirrored, %u degenerate) computed in %.2f ms (%.2f Mtris/s)\n", (unsigned int)tangents.size(), stats.numVertices, stats.numMirrored, stats.numDegenerate, elapsed,
+		(elapsed > 0.0 ? mesh.numTriangles / (elapsed * 1000.0) : 0.0));
+	if (!benchmark)
+		return;
+
+	TangentBenchmark result = BenchmarkTangents(mesh);
+	printf("Tangent times:");
+	for (unsigned int i = 0; i < result.threadCounts.size(); ++i)
+		printf(" %u thread%s %.2f ms,", result.threadCounts[i], (result.threadCounts[i] > 1 ? "s" : ""), result.times[i]);
+	printf(" reference %.2f ms\n", result.referenceTime);
+	printf("Tangents against the reference: largest difference %.4f degrees, average %.6f degrees, %u sign mismatches\n", result.comparison.maxAngle, result.comparison.averageAngle, result.comparison.signMismatches);
 }
@@ -4,8 +4,21 @@
 #include "../geometry/vector3.h"
 #include "../geometry/vector2.h"
 #include "../assets/material.h"
+#include "../convert/options.h"
+#include "../convert/sidecar.h"
+#include "../processing/meshlets.h"
+#include "../processing/simplify.h"
+#include "../processing/indexlayout.h"
+#include "../processing/bounds.h"
+#include "../processing/bvh.h"
+#include "../processing/weld.h"
+#include "../processing/tangents.h"
+#include "../processing/normals.h"
 
+#include <stdio.h>
+#include <istream>
 #include <string>
+#include <vector>
 
 typedef enum OBJ_FACE_VERTEX_TYPE
 {
@@ -19,6 +32,7 @@ typedef struct
 	unsigned int vertices[3];
 	unsigned int texcoords[3];
 	unsigned int normals[3];
+	unsigned int smoothingGroup;                 // 0 when smoothing is off
 } ObjFace;
 
 typedef struct ObjMaterial
@@ -44,6 +58,15 @@ typedef struct ObjMaterial
 	}
 } ObjMaterial;
 
+// Materials a .mtl file defines, in the order it defines them
+typedef struct
+{
+	std::vector<std::string> names;
+	std::vector<Material> materials;
+} ObjMaterialLibrary;
+
+class ObjMaterialCache;
+
 class Obj
 {
 public:
@@ -51,8 +74,49 @@ public:
 	virtual ~Obj()                                  { Release(); }
 
 	void Release();
-	bool Load(const std::string &file, const std::string &texturePath);
-	bool ConvertToMesh(const std::string &file);
+
+	/**
+	 * @param data contents of an OBJ file
+	 * @param size size of data in bytes
+	 * @param texturePath prepended to the name of every texture map
+	 * @param sidecars asked for the material library the model names, or
+	 *                 empty to go without materials
+	 * @param materialCache where material libraries are kept between
+	 *                      models, or NULL to read them every time
+	 *
+	 * @return bool false if the model couldn't be read
+	 */
+	bool Load(const void *data, size_t size, const std::string &texturePath, const SidecarResolver &sidecars = SidecarResolver(), ObjMaterialCache *materialCache = NULL);
+
+	/**
+	 * @param fp stream to write the MESH file to
+	 * @param options processing to apply
+	 *
+	 * @return bool false if writing failed
+	 */
+	bool ConvertToMesh(FILE *fp, const ConvertOptions &options = ConvertOptions());
+
+	/**
+	 * Finds the material library an OBJ file uses, which is the first one
+	 * its mtllib lines name, in the same directory as the file
+	 * @param file OBJ file
+	 * @param library receives the path of the material library, empty if
+	 *                the file names none
+	 *
+	 * @return bool false if the file couldn't be read
+	 */
+	static bool FindMaterialLibrary(const std::string &file, std::string &library);
+
+	/**
+	 * Reads the materials defined in a .mtl file
+	 * @param data contents of the material library
+	 * @param size size of data in bytes
+	 * @param texturePath prepended to the name of every texture map
+	 * @param library receives the materials
+	 *
+	 * @return bool false if the library couldn't be read
+	 */
+	static bool ReadMaterialLibrary(const void *data, size_t size, const std::string &texturePath, ObjMaterialLibrary &library);
 
 	int GetNumVertices()                            { return m_numVertices; }
 	int GetNumNormals()                             { return m_numNormals; }
@@ -64,11 +128,25 @@ public:
 	ObjMaterial* GetMaterials()                     { return m_materials; }
 
 private:
-	bool GetDataSizes(const std::string &file);
-	bool LoadMaterialLibrary(const std::string &file, const std::string &texturePath);
-	bool CountDefinedMaterials(const std::string &file);
-	bool FindAndLoadMaterials(const std::string &materialPath, const std::string &texturePath, const std::string &file);
-	void ParseFaceDefinition(const std::string &faceDefinition, ObjMaterial *currentMaterial);
+	static void FindMaterialLibraryName(std::istream &input, std::string &name);
+	bool GetDataSizes(const void *data, size_t size);
+	bool LoadMaterialLibrary(const std::vector<unsigned char> &data, const std::string &texturePath, ObjMaterialCache *materialCache);
+	bool FindAndLoadMaterials(const std::string &texturePath, const void *data, size_t size, const SidecarResolver &sidecars, ObjMaterialCache *materialCache);
+	void ParseFaceDefinition(const std::string &faceDefinition, ObjMaterial *currentMaterial, unsigned int smoothingGroup);
+	void WeldVertexPositions(float epsilon, bool keepSeams);
+	void GenerateSmoothNormals(float creaseAngle, bool areaWeighted);
+	void ReorderForVertexCache();
+	void ReorderForOverdraw(float threshold);
+	void ReorderForVertexFetch();
+	void SplitIntoMeshlets();
+	void BuildLevelsOfDetail(const std::vector<float> &ratios);
+	void ComputeBoundingVolumes(MeshBounds &bounds);
+	void BuildBoundingVolumeHierarchy(bool benchmark, BvhData &bvh);
+	void ComputeCornerTangents(bool benchmark, std::vector<CornerTangent> &tangents);
+	void BuildFaceIndexLayout(const ObjFace *faces, unsigned int numFaces, bool split, IndexLayout &layout);
+	unsigned int GetNumFaces();
+	int FindMaterial(const std::string &name);
+	void AddDefaultMaterial();
 
 	Vector3 *m_vertices;
 	Vector3 *m_normals;
@@ -78,6 +156,13 @@ private:
 	unsigned int m_numNormals;
 	unsigned int m_numTexCoords;
 	unsigned int m_numMaterials;
+	int m_defaultMaterial;                          // Holds faces with no material, -1 if there are none
+	bool m_faceVertexTypeKnown;
+	OBJ_FACE_VERTEX_TYPE m_faceVertexType;
+	MeshletData m_meshlets;
+	std::vector<LodLevel> m_lodLevels;
+	std::vector<ObjFace> m_lodFaces;
+	std::vector<unsigned int> m_lodMaterials;
 
 };
 
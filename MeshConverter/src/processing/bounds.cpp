@@ -0,0 +1,165 @@
+#include "bounds.h"
+#include "../util/parallel.h"
+
+#include <math.h>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define BOUNDS_SSE
+#include <xmmintrin.h>
+#endif
+
+// Points are read as a flat array of floats, 4 points (12 floats, 3 SSE
+// registers) at a time
+static_assert(sizeof(Vector3) == sizeof(float) * 3, "Vector3 must be 3 packed floats");
+
+static void GrowBox(const Vector3 *points, unsigned int count, Vector3 &minimum, Vector3 &maximum)
+{
+	const float *data = &points[0].x;
+	unsigned int i = 0;
+
+#ifdef BOUNDS_SSE
+	if (count >= 4)
+	{
+		// Lane k of register r holds component (r * 4 + k) % 3, so each
+		// register only ever sees a fixed mix of x, y and z
+		__m128 min0 = _mm_loadu_ps(data);
+		__m128 min1 = _mm_loadu_ps(data + 4);
+		__m128 min2 = _mm_loadu_ps(data + 8);
+		__m128 max0 = min0;
+		__m128 max1 = min1;
+		__m128 max2 = min2;
+		for (i = 4; i + 4 <= count; i += 4)
+		{
+			const float *p = data + i * 3;
+			__m128 a = _mm_loadu_ps(p);
+			__m128 b = _mm_loadu_ps(p + 4);
+			__m128 c = _mm_loadu_ps(p + 8);
+			min0 = _mm_min_ps(min0, a);
+			min1 = _mm_min_ps(min1, b);
+			min2 = _mm_min_ps(min2, c);
+			max0 = _mm_max_ps(max0, a);
+			max1 = _mm_max_ps(max1, b);
+			max2 = _mm_max_ps(max2, c);
+		}
+
+		float lanes[12];
+		_mm_storeu_ps(lanes, min0);
+		_mm_storeu_ps(lanes + 4, min1);
+		_mm_storeu_ps(lanes + 8, min2);
+		for (int j = 0; j < 12; ++j)
+			(&minimum.x)[j % 3] = std::min((&minimum.x)[j % 3], lanes[j]);
+		_mm_storeu_ps(lanes, max0);
+		_mm_storeu_ps(lanes + 4, max1);
+		_mm_storeu_ps(lanes + 8, max2);
+		for (int j = 0; j < 12; ++j)
+			(&maximum.x)[j % 3] = std::max((&maximum.x)[j % 3], lanes[j]);
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		const Vector3 &p = points[i];
+		minimum.x = std::min(minimum.x, p.x);
+		minimum.y = std::min(minimum.y, p.y);
+		minimum.z = std::min(minimum.z, p.z);
+		maximum.x = std::max(maximum.x, p.x);
+		maximum.y = std::max(maximum.y, p.y);
+		maximum.z = std::max(maximum.z, p.z);
+	}
+}
+
+static float GetMaxSquaredDistance(const Vector3 *points, unsigned int count, const Vector3 &center, float distance)
+{
+	const float *data = &points[0].x;
+	unsigned int i = 0;
+
+#ifdef BOUNDS_SSE
+	if (count >= 4)
+	{
+		__m128 cx = _mm_set1_ps(center.x);
+		__m128 cy = _mm_set1_ps(center.y);
+		__m128 cz = _mm_set1_ps(center.z);
+		__m128 largest = _mm_set1_ps(distance);
+		for (; i + 4 <= count; i += 4)
+		{
+			// Transposes 4 points from xyzx yzxy zxyz into one register
+			// per component
+			const float *p = data + i * 3;
+			__m128 a = _mm_loadu_ps(p);
+			__m128 b = _mm_loadu_ps(p + 4);
+			__m128 c = _mm_loadu_ps(p + 8);
+			__m128 x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+			__m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), c, _MM_SHUFFLE(3, 0, 2, 0));
+
+			x = _mm_sub_ps(x, cx);
+			y = _mm_sub_ps(y, cy);
+			z = _mm_sub_ps(z, cz);
+			__m128 squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+			largest = _mm_max_ps(largest, squared);
+		}
+
+		float lanes[4];
+		_mm_storeu_ps(lanes, largest);
+		distance = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+	}
+#endif
+
+	for (; i < count; ++i)
+		distance = std::max(distance, Vector3::SquaredLength(points[i] - center));
+	return distance;
+}
+
+void ClearBounds(BoundingVolume &bounds)
+{
+	bounds.minimum = ZERO_VECTOR;
+	bounds.maximum = ZERO_VECTOR;
+	bounds.center = ZERO_VECTOR;
+	bounds.radius = 0.0f;
+}
+
+void ComputeBounds(const Vector3 *points, unsigned int count, BoundingVolume &bounds)
+{
+	ComputeBounds(&points, 1, count, bounds);
+}
+
+void ComputeBounds(const Vector3 *const *pointSets, unsigned int numSets, unsigned int count, BoundingVolume &bounds)
+{
+	ClearBounds(bounds);
+	if (numSets == 0 || count == 0)
+		return;
+
+	Vector3 minimum = pointSets[0][0];
+	Vector3 maximum = minimum;
+	for (unsigned int i = 0; i < numSets; ++i)
+		GrowBox(pointSets[i], count, minimum, maximum);
+
+	// Not the smallest sphere, but tight enough for culling and it only
+	// takes one more pass
+	bounds.minimum = minimum;
+	bounds.maximum = maximum;
+	bounds.center = (minimum + maximum) / 2.0f;
+	float distance = 0.0f;
+	for (unsigned int i = 0; i < numSets; ++i)
+		distance = GetMaxSquaredDistance(pointSets[i], count, bounds.center, distance);
+	bounds.radius = sqrtf(distance);
+}
+
+void ComputeRangeBounds(const Vector3 *positions, const unsigned int *indices, const TriangleRange *ranges, unsigned int numRanges, BoundingVolume *bounds)
+{
+	ParallelFor(numRanges, [&](unsigned int i)
+	{
+		const TriangleRange *range = &ranges[i];
+
+		// Each vertex is only looked at once, however many triangles use it
+		std::vector<unsigned int> used(indices + range->start * 3, indices + range->end * 3);
+		std::sort(used.begin(), used.end());
+		used.erase(std::unique(used.begin(), used.end()), used.end());
+
+		std::vector<Vector3> points(used.size());
+		for (unsigned int j = 0; j < used.size(); ++j)
+			points[j] = positions[used[j]];
+		ComputeBounds(points.data(), points.size(), bounds[range->group]);
+	});
+}
@@ -0,0 +1,64 @@
+#ifndef __PROCESSING_BOUNDS_H_INCLUDED__
+#define __PROCESSING_BOUNDS_H_INCLUDED__
+
+#include "../geometry/vector3.h"
+#include "trianglerange.h"
+
+#include <vector>
+
+// Axis aligned box and a sphere around its center. Anything with no
+// points at all gets zeros everywhere
+struct BoundingVolume
+{
+	Vector3 minimum;
+	Vector3 maximum;
+	Vector3 center;
+	float radius;
+};
+
+struct MeshBounds
+{
+	BoundingVolume mesh;                         // Everything, over all frames for keyframed meshes
+	std::vector<BoundingVolume> groups;          // Per MS3D group, SM or OBJ material
+	std::vector<BoundingVolume> frames;          // Per MD2 keyframe
+	std::vector<BoundingVolume> animations;      // Per animation, over all of its frames
+};
+
+/**
+ * Bounds a set of points. The box comes from SIMD min/max reductions, and
+ * the sphere radius from a second SIMD pass for the farthest point from
+ * the box center
+ * @param points points to bound
+ * @param count number of points
+ * @param bounds receives the bounding volume
+ */
+void ComputeBounds(const Vector3 *points, unsigned int count, BoundingVolume &bounds);
+
+/**
+ * Bounds several sets of points together, such as a run of keyframes
+ * @param pointSets numSets arrays of points
+ * @param numSets number of point sets
+ * @param count number of points in each set
+ * @param bounds receives the bounding volume
+ */
+void ComputeBounds(const Vector3 *const *pointSets, unsigned int numSets, unsigned int count, BoundingVolume &bounds);
+
+/**
+ * Bounds the vertices used by the triangles of each range. Ranges are
+ * done in parallel
+ * @param positions vertex positions the indices refer to
+ * @param indices 3 vertex indices per triangle
+ * @param ranges triangle ranges to bound
+ * @param numRanges number of ranges
+ * @param bounds receives the bounding volume of each range at the
+ *               range's group index, entries no range refers to are left
+ *               untouched
+ */
+void ComputeRangeBounds(const Vector3 *positions, const unsigned int *indices, const TriangleRange *ranges, unsigned int numRanges, BoundingVolume *bounds);
+
+/**
+ * @param bounds sets all of the volume to zero
+ */
+void ClearBounds(BoundingVolume &bounds);
+
+#endif
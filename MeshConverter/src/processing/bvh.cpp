@@ -0,0 +1,765 @@
+#include "bvh.h"
+#include "../util/parallel.h"
+
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+static_assert(sizeof(BvhNode) == 32, "BVH nodes must stay 32 bytes");
+static_assert(sizeof(BvhTriangle) == 16, "BVH triangles must stay 16 bytes");
+
+// Cost of visiting a node relative to testing a triangle
+#define BVH_TRAVERSAL_COST 1.0f
+
+// Nodes with at least this many triangles bin them in parallel, in blocks
+// of the given size
+#define BVH_PARALLEL_BINNING_SIZE 65536
+#define BVH_BINNING_BLOCK_SIZE 16384
+
+// Subtrees are handed to separate tasks once they are smaller than the
+// mesh split evenly over this many tasks per thread, but never smaller
+// than the minimum
+#define BVH_TASKS_PER_THREAD 8
+#define BVH_MIN_TASK_SIZE 4096
+
+// Past this depth splits go down the middle, which guarantees the tree
+// stays within BVH_MAX_DEPTH
+#define BVH_MEDIAN_SPLIT_DEPTH (BVH_MAX_DEPTH / 2)
+
+// Builds are repeated this many times per thread count, the fastest counts
+#define BVH_BENCHMARK_BUILDS 3
+
+// Brute force rays are limited to this many triangle tests in total
+#define BVH_BENCHMARK_BRUTE_FORCE_TESTS 200000000.0
+
+struct Box
+{
+	Vector3 minimum;
+	Vector3 maximum;
+};
+
+struct Bins
+{
+	Box bounds[3][BVH_NUM_BINS];
+	Box centroids[3][BVH_NUM_BINS];
+	unsigned int counts[3][BVH_NUM_BINS];
+};
+
+// A run of the triangle order, the bounds of its triangles and of their
+// centroids
+struct BuildRange
+{
+	unsigned int start;
+	unsigned int end;
+	unsigned int depth;
+	Box bounds;
+	Box centroids;
+};
+
+struct BuildContext
+{
+	std::vector<Box> boxes;                      // Per triangle
+	std::vector<Vector3> centroids;              // Per triangle, the center of its box
+	std::vector<unsigned int> order;             // Triangles in the order the leaves refer to them
+};
+
+struct Split
+{
+	unsigned int axis;
+	unsigned int bin;                            // Last bin on the left side
+	float cost;
+	BuildRange left;
+	BuildRange right;
+};
+
+// Nodes of the top of the tree, built one split at a time before the
+// subtrees below them are built as tasks
+struct TopNode
+{
+	Box bounds;
+	int left;
+	int right;
+	int task;                                    // Subtree task, -1 for inner nodes
+};
+
+static inline void EmptyBox(Box &box)
+{
+	box.minimum = Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+	box.maximum = Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+}
+
+static inline void GrowBox(Box &box, const Vector3 &point)
+{
+	box.minimum.x = std::min(box.minimum.x, point.x);
+	box.minimum.y = std::min(box.minimum.y, point.y);
+	box.minimum.z = std::min(box.minimum.z, point.z);
+	box.maximum.x = std::max(box.maximum.x, point.x);
+	box.maximum.y = std::max(box.maximum.y, point.y);
+	box.maximum.z = std::max(box.maximum.z, point.z);
+}
+
+static inline void GrowBox(Box &box, const Box &other)
+{
+	box.minimum.x = std::min(box.minimum.x, other.minimum.x);
+	box.minimum.y = std::min(box.minimum.y, other.minimum.y);
+	box.minimum.z = std::min(box.minimum.z, other.minimum.z);
+	box.maximum.x = std::max(box.maximum.x, other.maximum.x);
+	box.maximum.y = std::max(box.maximum.y, other.maximum.y);
+	box.maximum.z = std::max(box.maximum.z, other.maximum.z);
+}
+
+// Half the surface area, which is all the heuristic needs
+static inline float GetHalfArea(const Box &box)
+{
+	Vector3 size = box.maximum - box.minimum;
+	if (size.x < 0.0f)
+		return 0.0f;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+static inline float GetComponent(const Vector3 &v, unsigned int axis)
+{
+	return (&v.x)[axis];
+}
+
+// Filling the bins and partitioning have to agree exactly on which bin a
+// centroid goes in, so both go through here
+static inline unsigned int GetBin(const BuildRange &range, unsigned int axis, float scale, const Vector3 &centroid)
+{
+	int bin = (int)((GetComponent(centroid, axis) - GetComponent(range.centroids.minimum, axis)) * scale);
+	return (unsigned int)std::max(0, std::min(bin, BVH_NUM_BINS - 1));
+}
+
+static inline float GetBinScale(const BuildRange &range, unsigned int axis)
+{
+	float extent = GetComponent(range.centroids.maximum, axis) - GetComponent(range.centroids.minimum, axis);
+	return (extent > 0.0f ? BVH_NUM_BINS / extent : 0.0f);
+}
+
+static void ClearBins(Bins &bins)
+{
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		for (int i = 0; i < BVH_NUM_BINS; ++i)
+		{
+			EmptyBox(bins.bounds[axis][i]);
+			EmptyBox(bins.centroids[axis][i]);
+			bins.counts[axis][i] = 0;
+		}
+	}
+}
+
+static void FillBins(const BuildContext &context, const BuildRange &range, unsigned int start, unsigned int end, Bins &bins)
+{
+	float scales[3] = { GetBinScale(range, 0), GetBinScale(range, 1), GetBinScale(range, 2) };
+	ClearBins(bins);
+	for (unsigned int i = start; i < end; ++i)
+	{
+		unsigned int triangle = context.order[i];
+		const Vector3 &centroid = context.centroids[triangle];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			unsigned int bin = GetBin(range, axis, scales[axis], centroid);
+			GrowBox(bins.bounds[axis][bin], context.boxes[triangle]);
+			GrowBox(bins.centroids[axis][bin], centroid);
+			++bins.counts[axis][bin];
+		}
+	}
+}
+
+static void MergeBins(Bins &bins, const Bins &other)
+{
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		for (int i = 0; i < BVH_NUM_BINS; ++i)
+		{
+			GrowBox(bins.bounds[axis][i], other.bounds[axis][i]);
+			GrowBox(bins.centroids[axis][i], other.centroids[axis][i]);
+			bins.counts[axis][i] += other.counts[axis][i];
+		}
+	}
+}
+
+// Sweeps the bins of every axis from both sides for the cheapest split.
+// The children's bounds come out of the bins, so they never need another
+// pass over the triangles
+static bool FindBestSplit(const BuildContext &context, const BuildRange &range, bool parallel, Split &split)
+{
+	Bins bins;
+	unsigned int count = range.end - range.start;
+	if (parallel && count >= BVH_PARALLEL_BINNING_SIZE)
+	{
+		unsigned int numBlocks = (count + BVH_BINNING_BLOCK_SIZE - 1) / BVH_BINNING_BLOCK_SIZE;
+		std::vector<Bins> blocks(numBlocks);
+		ParallelFor(numBlocks, [&](unsigned int i)
+		{
+			unsigned int start = range.start + i * BVH_BINNING_BLOCK_SIZE;
+			FillBins(context, range, start, std::min(start + BVH_BINNING_BLOCK_SIZE, range.end), blocks[i]);
+		});
+		bins = blocks[0];
+		for (unsigned int i = 1; i < numBlocks; ++i)
+			MergeBins(bins, blocks[i]);
+	}
+	else
+		FillBins(context, range, range.start, range.end, bins);
+
+	bool found = false;
+	float area = std::max(GetHalfArea(range.bounds), FLT_MIN);
+	for (unsigned int axis = 0; axis < 3; ++axis)
+	{
+		if (GetBinScale(range, axis) == 0.0f)
+			continue;
+
+		// rightCosts[i] is the cost of bins i + 1 and up
+		float rightCosts[BVH_NUM_BINS];
+		Box box;
+		EmptyBox(box);
+		unsigned int rightCount = 0;
+		for (int i = BVH_NUM_BINS - 1; i > 0; --i)
+		{
+			GrowBox(box, bins.bounds[axis][i]);
+			rightCount += bins.counts[axis][i];
+			rightCosts[i - 1] = GetHalfArea(box) * rightCount;
+		}
+
+		EmptyBox(box);
+		unsigned int leftCount = 0;
+		for (int i = 0; i < BVH_NUM_BINS - 1; ++i)
+		{
+			GrowBox(box, bins.bounds[axis][i]);
+			leftCount += bins.counts[axis][i];
+			if (leftCount == 0 || leftCount == count)
+				continue;
+
+			float cost = BVH_TRAVERSAL_COST + (GetHalfArea(box) * leftCount + rightCosts[i]) / area;
+			if (!found || cost < split.cost)
+			{
+				found = true;
+				split.axis = axis;
+				split.bin = i;
+				split.cost = cost;
+			}
+		}
+	}
+	if (!found)
+		return false;
+
+	split.left.start = range.start;
+	split.left.end = range.start;
+	split.right.end = range.end;
+	split.left.depth = range.depth + 1;
+	split.right.depth = range.depth + 1;
+	EmptyBox(split.left.bounds);
+	EmptyBox(split.left.centroids);
+	EmptyBox(split.right.bounds);
+	EmptyBox(split.right.centroids);
+	for (unsigned int i = 0; i < BVH_NUM_BINS; ++i)
+	{
+		BuildRange &side = (i <= split.bin ? split.left : split.right);
+		GrowBox(side.bounds, bins.bounds[split.axis][i]);
+		GrowBox(side.centroids, bins.centroids[split.axis][i]);
+		if (i <= split.bin)
+			split.left.end += bins.counts[split.axis][i];
+	}
+	split.right.start = split.left.end;
+	return true;
+}
+
+static void GetRangeBounds(const BuildContext &context, BuildRange &range)
+{
+	EmptyBox(range.bounds);
+	EmptyBox(range.centroids);
+	for (unsigned int i = range.start; i < range.end; ++i)
+	{
+		GrowBox(range.bounds, context.boxes[context.order[i]]);
+		GrowBox(range.centroids, context.centroids[context.order[i]]);
+	}
+}
+
+// Splits a range in two, by the heuristic when it finds a split and the
+// range is shallow enough, otherwise down the middle along the longest
+// axis of the centroids. Returns false when the range should be a leaf
+static bool SplitRange(BuildContext &context, const BuildRange &range, bool parallel, Split &split)
+{
+	unsigned int count = range.end - range.start;
+	if (count <= 1)
+		return false;
+
+	if (range.depth < BVH_MEDIAN_SPLIT_DEPTH && FindBestSplit(context, range, parallel, split))
+	{
+		// Splitting isn't worth it when testing every triangle is cheaper
+		if (count <= BVH_MAX_LEAF_TRIANGLES && split.cost >= (float)count)
+			return false;
+
+		float scale = GetBinScale(range, split.axis);
+		std::partition(context.order.begin() + range.start, context.order.begin() + range.end, [&](unsigned int triangle)
+		{
+			return GetBin(range, split.axis, scale, context.centroids[triangle]) <= split.bin;
+		});
+		return true;
+	}
+
+	// Only identical centroids are left, or the tree is getting too deep
+	if (count <= BVH_MAX_LEAF_TRIANGLES)
+		return false;
+
+	Vector3 extent = range.centroids.maximum - range.centroids.minimum;
+	unsigned int axis = (extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2));
+	unsigned int middle = range.start + count / 2;
+	std::nth_element(context.order.begin() + range.start, context.order.begin() + middle, context.order.begin() + range.end, [&](unsigned int a, unsigned int b)
+	{
+		return GetComponent(context.centroids[a], axis) < GetComponent(context.centroids[b], axis);
+	});
+
+	split.axis = axis;
+	split.left.start = range.start;
+	split.left.end = middle;
+	split.right.start = middle;
+	split.right.end = range.end;
+	split.left.depth = range.depth + 1;
+	split.right.depth = range.depth + 1;
+	GetRangeBounds(context, split.left);
+	GetRangeBounds(context, split.right);
+	return true;
+}
+
+static void SetNodeBounds(BvhNode &node, const Box &bounds)
+{
+	node.minimum[0] = bounds.minimum.x;
+	node.minimum[1] = bounds.minimum.y;
+	node.minimum[2] = bounds.minimum.z;
+	node.maximum[0] = bounds.maximum.x;
+	node.maximum[1] = bounds.maximum.y;
+	node.maximum[2] = bounds.maximum.z;
+}
+
+static void BuildSubtree(BuildContext &context, const BuildRange &range, std::vector<BvhNode> &nodes)
+{
+	unsigned int index = nodes.size();
+	nodes.push_back(BvhNode());
+	SetNodeBounds(nodes[index], range.bounds);
+
+	Split split;
+	if (!SplitRange(context, range, false, split))
+	{
+		nodes[index].offset = range.start;
+		nodes[index].count = range.end - range.start;
+		return;
+	}
+
+	nodes[index].count = 0;
+	BuildSubtree(context, split.left, nodes);
+	nodes[index].offset = nodes.size();
+	BuildSubtree(context, split.right, nodes);
+}
+
+static int BuildTop(BuildContext &context, const BuildRange &range, unsigned int taskSize, std::vector<TopNode> &topNodes, std::vector<BuildRange> &tasks)
+{
+	TopNode node;
+	node.bounds = range.bounds;
+	node.left = -1;
+	node.right = -1;
+	node.task = -1;
+
+	Split split;
+	if (range.end - range.start <= taskSize || !SplitRange(context, range, true, split))
+	{
+		node.task = tasks.size();
+		tasks.push_back(range);
+		topNodes.push_back(node);
+		return topNodes.size() - 1;
+	}
+
+	int index = topNodes.size();
+	topNodes.push_back(node);
+	int left = BuildTop(context, split.left, taskSize, topNodes, tasks);
+	int right = BuildTop(context, split.right, taskSize, topNodes, tasks);
+	topNodes[index].left = left;
+	topNodes[index].right = right;
+	return index;
+}
+
+// Lays the top nodes and the subtrees below them out depth first, moving
+// the subtrees' child offsets to where they end up
+static void FlattenTop(const std::vector<TopNode> &topNodes, int index, const std::vector<std::vector<BvhNode> > &subtrees, std::vector<BvhNode> &nodes)
+{
+	const TopNode *top = &topNodes[index];
+	if (top->task >= 0)
+	{
+		const std::vector<BvhNode> &subtree = subtrees[top->task];
+		unsigned int base = nodes.size();
+		for (unsigned int i = 0; i < subtree.size(); ++i)
+		{
+			nodes.push_back(subtree[i]);
+			if (subtree[i].count == 0)
+				nodes.back().offset += base;
+		}
+		return;
+	}
+
+	unsigned int node = nodes.size();
+	nodes.push_back(BvhNode());
+	SetNodeBounds(nodes[node], top->bounds);
+	nodes[node].count = 0;
+	FlattenTop(topNodes, top->left, subtrees, nodes);
+	nodes[node].offset = nodes.size();
+	FlattenTop(topNodes, top->right, subtrees, nodes);
+}
+
+void BuildBvh(const unsigned int *indices, unsigned int numTriangles, const Vector3 *positions, BvhData &bvh)
+{
+	bvh.nodes.clear();
+	bvh.triangles.clear();
+	if (numTriangles == 0)
+		return;
+
+	BuildContext context;
+	context.boxes.resize(numTriangles);
+	context.centroids.resize(numTriangles);
+	context.order.resize(numTriangles);
+
+	unsigned int numBlocks = (numTriangles + BVH_BINNING_BLOCK_SIZE - 1) / BVH_BINNING_BLOCK_SIZE;
+	std::vector<BuildRange> blockRanges(numBlocks);
+	ParallelFor(numBlocks, [&](unsigned int block)
+	{
+		BuildRange &blockRange = blockRanges[block];
+		blockRange.start = block * BVH_BINNING_BLOCK_SIZE;
+		blockRange.end = std::min(blockRange.start + BVH_BINNING_BLOCK_SIZE, numTriangles);
+		EmptyBox(blockRange.bounds);
+		EmptyBox(blockRange.centroids);
+		for (unsigned int i = blockRange.start; i < blockRange.end; ++i)
+		{
+			Box &box = context.boxes[i];
+			EmptyBox(box);
+			for (int j = 0; j < 3; ++j)
+				GrowBox(box, positions[indices[i * 3 + j]]);
+			context.centroids[i] = (box.minimum + box.maximum) * 0.5f;
+			context.order[i] = i;
+			GrowBox(blockRange.bounds, box);
+			GrowBox(blockRange.centroids, context.centroids[i]);
+		}
+	});
+
+	BuildRange root;
+	root.start = 0;
+	root.end = numTriangles;
+	root.depth = 0;
+	root.bounds = blockRanges[0].bounds;
+	root.centroids = blockRanges[0].centroids;
+	for (unsigned int i = 1; i < numBlocks; ++i)
+	{
+		GrowBox(root.bounds, blockRanges[i].bounds);
+		GrowBox(root.centroids, blockRanges[i].centroids);
+	}
+
+	// Subtree tasks only touch their own run of the triangle order
+	unsigned int taskSize = std::max((unsigned int)BVH_MIN_TASK_SIZE, numTriangles / (GetNumWorkerThreads() * BVH_TASKS_PER_THREAD));
+	std::vector<TopNode> topNodes;
+	std::vector<BuildRange> tasks;
+	BuildTop(context, root, taskSize, topNodes, tasks);
+
+	std::vector<std::vector<BvhNode> > subtrees(tasks.size());
+	ParallelFor(tasks.size(), [&](unsigned int i)
+	{
+		BuildSubtree(context, tasks[i], subtrees[i]);
+	});
+
+	unsigned int numNodes = 0;
+	for (unsigned int i = 0; i < subtrees.size(); ++i)
+		numNodes += subtrees[i].size();
+	bvh.nodes.reserve(numNodes + topNodes.size());
+	FlattenTop(topNodes, 0, subtrees, bvh.nodes);
+
+	bvh.triangles.resize(numTriangles);
+	for (unsigned int i = 0; i < numTriangles; ++i)
+	{
+		unsigned int triangle = context.order[i];
+		for (int j = 0; j < 3; ++j)
+			bvh.triangles[i].vertices[j] = indices[triangle * 3 + j];
+		bvh.triangles[i].triangle = triangle;
+	}
+}
+
+static void AnalyzeNode(const BvhData &bvh, unsigned int index, unsigned int depth, float rootArea, BvhStats &stats)
+{
+	const BvhNode *node = &bvh.nodes[index];
+	Box box;
+	box.minimum = Vector3(node->minimum);
+	box.maximum = Vector3(node->maximum);
+	float probability = (rootArea > 0.0f ? GetHalfArea(box) / rootArea : 1.0f);
+
+	stats.maxDepth = std::max(stats.maxDepth, depth);
+	if (node->count > 0)
+	{
+		++stats.numLeaves;
+		stats.cost += probability * node->count;
+		return;
+	}
+
+	stats.cost += probability * BVH_TRAVERSAL_COST;
+	AnalyzeNode(bvh, index + 1, depth + 1, rootArea, stats);
+	AnalyzeNode(bvh, node->offset, depth + 1, rootArea, stats);
+}
+
+BvhStats AnalyzeBvh(const BvhData &bvh)
+{
+	BvhStats stats;
+	stats.numNodes = bvh.nodes.size();
+	stats.numLeaves = 0;
+	stats.maxDepth = 0;
+	stats.averageLeafTriangles = 0.0f;
+	stats.cost = 0.0f;
+	if (bvh.nodes.empty())
+		return stats;
+
+	Box root;
+	root.minimum = Vector3(bvh.nodes[0].minimum);
+	root.maximum = Vector3(bvh.nodes[0].maximum);
+	AnalyzeNode(bvh, 0, 1, GetHalfArea(root), stats);
+	stats.averageLeafTriangles = (float)bvh.triangles.size() / stats.numLeaves;
+	return stats;
+}
+
+// Moller-Trumbore, without culling back faces
+static inline bool IntersectTriangle(const Vector3 &origin, const Vector3 &direction, const Vector3 &a, const Vector3 &b, const Vector3 &c, float &distance)
+{
+	Vector3 edge1 = b - a;
+	Vector3 edge2 = c - a;
+	Vector3 p = Vector3::Cross(direction, edge2);
+	float determinant = Vector3::Dot(edge1, p);
+	if (fabsf(determinant) < FLT_MIN)
+		return false;
+
+	float inverse = 1.0f / determinant;
+	Vector3 t = origin - a;
+	float u = Vector3::Dot(t, p) * inverse;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+	Vector3 q = Vector3::Cross(t, edge1);
+	float v = Vector3::Dot(direction, q) * inverse;
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+
+	distance = Vector3::Dot(edge2, q) * inverse;
+	return true;
+}
+
+// Slab test, returns the distance the ray enters the box at, or FLT_MAX
+// if it misses it or only gets there past maxDistance
+static inline float IntersectNode(const BvhNode &node, const float *origin, const float *inverseDirection, float maxDistance)
+{
+	float nearest = 0.0f;
+	float farthest = maxDistance;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float t0 = (node.minimum[axis] - origin[axis]) * inverseDirection[axis];
+		float t1 = (node.maximum[axis] - origin[axis]) * inverseDirection[axis];
+		nearest = std::max(nearest, std::min(t0, t1));
+		farthest = std::min(farthest, std::max(t0, t1));
+	}
+	return (nearest <= farthest ? nearest : FLT_MAX);
+}
+
+bool IntersectBvh(const BvhNode *nodes, const BvhTriangle *triangles, const Vector3 *positions, const Vector3 &origin, const Vector3 &direction, float maxDistance, BvhHit &hit)
+{
+	float start[3] = { origin.x, origin.y, origin.z };
+	float inverseDirection[3] = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+	hit.distance = maxDistance;
+	bool found = false;
+	if (IntersectNode(nodes[0], start, inverseDirection, maxDistance) == FLT_MAX)
+		return false;
+
+	// Children are visited nearest first, the farther one waits on the
+	// stack with the distance it was entered at, so it can be skipped
+	// if something closer turns up in the meantime
+	unsigned int stack[BVH_MAX_DEPTH];
+	float stackDistances[BVH_MAX_DEPTH];
+	unsigned int stackSize = 0;
+	unsigned int index = 0;
+	for (;;)
+	{
+		const BvhNode *node = &nodes[index];
+		if (node->count > 0)
+		{
+			for (unsigned int i = node->offset; i < node->offset + node->count; ++i)
+			{
+				const BvhTriangle *triangle = &triangles[i];
+				float distance;
+				if (IntersectTriangle(origin, direction, positions[triangle->vertices[0]], positions[triangle->vertices[1]], positions[triangle->vertices[2]], distance) &&
+					distance >= 0.0f && distance < hit.distance)
+				{
+					hit.distance = distance;
+					hit.triangle = triangle->triangle;
+					found = true;
+				}
+			}
+		}
+		else
+		{
+			unsigned int first = index + 1;
+			unsigned int second = node->offset;
+			float firstDistance = IntersectNode(nodes[first], start, inverseDirection, hit.distance);
+			float secondDistance = IntersectNode(nodes[second], start, inverseDirection, hit.distance);
+			if (secondDistance < firstDistance)
+			{
+				std::swap(first, second);
+				std::swap(firstDistance, secondDistance);
+			}
+
+			if (firstDistance != FLT_MAX)
+			{
+				if (secondDistance != FLT_MAX)
+				{
+					stack[stackSize] = second;
+					stackDistances[stackSize] = secondDistance;
+					++stackSize;
+				}
+				index = first;
+				continue;
+			}
+		}
+
+		do
+		{
+			if (stackSize == 0)
+				return found;
+			--stackSize;
+			index = stack[stackSize];
+		} while (stackDistances[stackSize] > hit.distance);
+	}
+}
+
+bool IntersectTriangles(const unsigned int *indices, unsigned int numTriangles, const Vector3 *positions, const Vector3 &origin, const Vector3 &direction, float maxDistance, BvhHit &hit)
+{
+	hit.distance = maxDistance;
+	bool found = false;
+	for (unsigned int i = 0; i < numTriangles; ++i)
+	{
+		const unsigned int *triangle = &indices[i * 3];
+		float distance;
+		if (IntersectTriangle(origin, direction, positions[triangle[0]], positions[triangle[1]], positions[triangle[2]], distance) &&
+			distance >= 0.0f && distance < hit.distance)
+		{
+			hit.distance = distance;
+			hit.triangle = i;
+			found = true;
+		}
+	}
+	return found;
+}
+
+BvhBenchmark BenchmarkBvh(const unsigned int *indices, unsigned int numTriangles, const Vector3 *positions, const BvhData &bvh, unsigned int numRays)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	BvhBenchmark benchmark;
+	unsigned int maxThreads = GetNumWorkerThreads();
+	for (unsigned int threads = 1; ; threads *= 2)
+	{
+		threads = std::min(threads, maxThreads);
+		SetMaxWorkerThreads(threads);
+		double best = 0.0;
+		for (int i = 0; i < BVH_BENCHMARK_BUILDS; ++i)
+		{
+			BvhData rebuilt;
+			Clock::time_point start = Clock::now();
+			BuildBvh(indices, numTriangles, positions, rebuilt);
+			double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			best = (i == 0 || elapsed < best ? elapsed : best);
+		}
+		benchmark.threadCounts.push_back(threads);
+		benchmark.buildTimes.push_back(best);
+		if (threads == maxThreads)
+			break;
+	}
+	SetMaxWorkerThreads(0);
+
+	// Rays start on a sphere around the mesh and aim at a random point in
+	// its bounds, so most of them hit something. The generator is seeded
+	// the same every time so runs can be compared
+	benchmark.numRays = (bvh.nodes.empty() ? 0 : numRays);
+	std::vector<Vector3> origins(benchmark.numRays);
+	std::vector<Vector3> directions(benchmark.numRays);
+	if (benchmark.numRays > 0)
+	{
+		Vector3 minimum(bvh.nodes[0].minimum);
+		Vector3 maximum(bvh.nodes[0].maximum);
+		Vector3 center = (minimum + maximum) * 0.5f;
+		float radius = std::max(Vector3::Distance(minimum, maximum), FLT_MIN);
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (unsigned int i = 0; i < benchmark.numRays; ++i)
+		{
+			Vector3 around(unit(random) * 2.0f - 1.0f, unit(random) * 2.0f - 1.0f, unit(random) * 2.0f - 1.0f);
+			if (Vector3::SquaredLength(around) < 0.0001f)
+				around = Vector3(1.0f, 0.0f, 0.0f);
+			origins[i] = center + Vector3::SetLength(around, radius);
+			Vector3 target(minimum.x + (maximum.x - minimum.x) * unit(random), minimum.y + (maximum.y - minimum.y) * unit(random), minimum.z + (maximum.z - minimum.z) * unit(random));
+			directions[i] = target - origins[i];
+		}
+	}
+
+	std::vector<BvhHit> hits(benchmark.numRays);
+	std::vector<bool> hitSomething(benchmark.numRays);
+	Clock::time_point start = Clock::now();
+	for (unsigned int i = 0; i < benchmark.numRays; ++i)
+		hitSomething[i] = IntersectBvh(bvh.nodes.data(), bvh.triangles.data(), positions, origins[i], directions[i], FLT_MAX, hits[i]);
+	double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	benchmark.raysPerSecond = (elapsed > 0.0 ? benchmark.numRays / elapsed : 0.0);
+	benchmark.numHits = std::count(hitSomething.begin(), hitSomething.end(), true);
+
+	benchmark.numBruteForceRays = std::min(benchmark.numRays, (unsigned int)std::max(1.0, BVH_BENCHMARK_BRUTE_FORCE_TESTS / std::max(numTriangles, 1u)));
+	benchmark.mismatches = 0;
+	start = Clock::now();
+	for (unsigned int i = 0; i < benchmark.numBruteForceRays; ++i)
+	{
+		BvhHit hit;
+		bool found = IntersectTriangles(indices, numTriangles, positions, origins[i], directions[i], FLT_MAX, hit);
+		if (found != hitSomething[i] || (found && hit.distance != hits[i].distance))
+			++benchmark.mismatches;
+	}
+	elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	benchmark.bruteForceRaysPerSecond = (elapsed > 0.0 ? benchmark.numBruteForceRays / elapsed : 0.0);
+	return benchmark;
+}
+
+bool ValidateBvh(const BvhNode *nodes, unsigned int numNodes, const BvhTriangle *triangles, unsigned int numTriangles, unsigned int numVertices)
+{
+	if (numNodes == 0)
+		return false;
+
+	for (unsigned int i = 0; i < numTriangles; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			if (triangles[i].vertices[j] >= numVertices)
+				return false;
+		}
+	}
+
+	// Children always come after their parent, so depths can be worked out
+	// in a single pass in order. A node referred to twice takes the deeper
+	// of the two
+	std::vector<unsigned char> depths(numNodes, 0);
+	depths[0] = 1;
+	for (unsigned int i = 0; i < numNodes; ++i)
+	{
+		const BvhNode *node = &nodes[i];
+		if (depths[i] == 0)
+			return false;
+		if (node->count > 0)
+		{
+			if (node->offset > numTriangles || node->count > numTriangles - node->offset)
+				return false;
+			continue;
+		}
+
+		if (depths[i] >= BVH_MAX_DEPTH || node->offset <= i + 1 || node->offset >= numNodes)
+			return false;
+		depths[i + 1] = std::max(depths[i + 1], (unsigned char)(depths[i] + 1));
+		depths[node->offset] = std::max(depths[node->offset], (unsigned char)(depths[i] + 1));
+	}
+	return true;
+}
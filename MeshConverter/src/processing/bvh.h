@@ -0,0 +1,150 @@
+#ifndef __PROCESSING_BVH_H_INCLUDED__
+#define __PROCESSING_BVH_H_INCLUDED__
+
+#include "../geometry/vector3.h"
+
+#include <vector>
+
+// Split candidates per axis when evaluating the surface area heuristic
+#define BVH_NUM_BINS 16
+
+// Leaves hold at most this many triangles, unless they can't be split
+#define BVH_MAX_LEAF_TRIANGLES 4
+
+// Deepest a tree can get, which is also the traversal stack size. Splits
+// fall back to the median past half of this, so the limit is never reached
+#define BVH_MAX_DEPTH 64
+
+// Rays cast when benchmarking a BVH
+#define BVH_BENCHMARK_RAYS 100000
+
+// 32 bytes, so two nodes share a cache line. Nodes are in depth first
+// order, an inner node's first child directly follows it
+struct BvhNode
+{
+	float minimum[3];
+	unsigned int offset;                         // Leaf: first triangle, inner node: second child
+	float maximum[3];
+	unsigned int count;                          // Leaf: number of triangles, 0 for inner nodes
+};
+
+// Triangles are stored in leaf order, so a leaf's triangles are next to
+// each other in memory
+struct BvhTriangle
+{
+	unsigned int vertices[3];
+	unsigned int triangle;                       // Index in the original triangle list
+};
+
+struct BvhData
+{
+	std::vector<BvhNode> nodes;
+	std::vector<BvhTriangle> triangles;
+};
+
+struct BvhHit
+{
+	unsigned int triangle;                       // Index in the original triangle list
+	float distance;                              // Along the ray, in units of its direction
+};
+
+struct BvhStats
+{
+	unsigned int numNodes;
+	unsigned int numLeaves;
+	unsigned int maxDepth;
+	float averageLeafTriangles;
+	float cost;                                  // SAH cost, in triangle tests per ray that hits the root
+};
+
+// Build times and ray throughput of a BVH against testing every triangle
+struct BvhBenchmark
+{
+	std::vector<unsigned int> threadCounts;
+	std::vector<double> buildTimes;              // Milliseconds, fastest of a few builds per thread count
+	unsigned int numRays;
+	double raysPerSecond;
+	unsigned int numBruteForceRays;              // First rays also cast by brute force, as many as is quick
+	double bruteForceRaysPerSecond;
+	unsigned int numHits;
+	unsigned int mismatches;                     // Brute force rays with a different closest hit distance
+};
+
+/**
+ * Builds a BVH over a triangle list, splitting by the surface area
+ * heuristic over binned centroids. Large nodes near the top are binned and
+ * partitioned in parallel, the subtrees below them are then built in
+ * parallel as separate tasks and joined in depth first order
+ * @param indices 3 vertex indices per triangle
+ * @param numTriangles number of triangles in the list
+ * @param positions vertex positions the indices refer to
+ * @param bvh receives the nodes and reordered triangles
+ */
+void BuildBvh(const unsigned int *indices, unsigned int numTriangles, const Vector3 *positions, BvhData &bvh);
+
+/**
+ * @param bvh BVH to look at
+ *
+ * @return BvhStats node counts, depth and SAH cost of the tree
+ */
+BvhStats AnalyzeBvh(const BvhData &bvh);
+
+/**
+ * Finds the closest triangle hit by a ray. Works on the nodes and
+ * triangles as stored in a BVH chunk, so they can be used in place
+ * @param nodes BVH nodes, the root first
+ * @param triangles BVH triangles
+ * @param positions vertex positions the triangles refer to
+ * @param origin start of the ray
+ * @param direction direction of the ray, doesn't have to be normalized
+ * @param maxDistance ignore hits further along than this
+ * @param hit receives the closest hit
+ *
+ * @return bool whether anything was hit
+ */
+bool IntersectBvh(const BvhNode *nodes, const BvhTriangle *triangles, const Vector3 *positions, const Vector3 &origin, const Vector3 &direction, float maxDistance, BvhHit &hit);
+
+/**
+ * Finds the closest triangle hit by a ray by testing every triangle, for
+ * checking and comparing against IntersectBvh
+ * @param indices 3 vertex indices per triangle
+ * @param numTriangles number of triangles in the list
+ * @param positions vertex positions the indices refer to
+ * @param origin start of the ray
+ * @param direction direction of the ray, doesn't have to be normalized
+ * @param maxDistance ignore hits further along than this
+ * @param hit receives the closest hit
+ *
+ * @return bool whether anything was hit
+ */
+bool IntersectTriangles(const unsigned int *indices, unsigned int numTriangles, const Vector3 *positions, const Vector3 &origin, const Vector3 &direction, float maxDistance, BvhHit &hit);
+
+/**
+ * Times BuildBvh with 1, 2, 4... worker threads up to all of them, then
+ * casts random rays from around the mesh at points inside its bounds,
+ * through the BVH and by brute force
+ * @param indices 3 vertex indices per triangle
+ * @param numTriangles number of triangles in the list
+ * @param positions vertex positions the indices refer to
+ * @param bvh BVH built over the triangles
+ * @param numRays number of rays to cast through the BVH
+ *
+ * @return BvhBenchmark timings
+ */
+BvhBenchmark BenchmarkBvh(const unsigned int *indices, unsigned int numTriangles, const Vector3 *positions, const BvhData &bvh, unsigned int numRays);
+
+/**
+ * Checks that a BVH's nodes only refer forward to nodes and triangles that
+ * exist and that it is no deeper than BVH_MAX_DEPTH, so it can be
+ * traversed safely
+ * @param nodes BVH nodes
+ * @param numNodes number of nodes
+ * @param triangles BVH triangles
+ * @param numTriangles number of triangles
+ * @param numVertices number of vertices the triangles may refer to
+ *
+ * @return bool whether the BVH is safe to traverse
+ */
+bool ValidateBvh(const BvhNode *nodes, unsigned int numNodes, const BvhTriangle *triangles, unsigned int numTriangles, unsigned int numVertices);
+
+#endif
@@ -0,0 +1,97 @@
+#include "indexlayout.h"
+
+static void StartBatch(IndexLayout &layout, unsigned int firstTriangle)
+{
+	IndexBatch batch;
+	batch.firstTriangle = firstTriangle;
+	batch.numTriangles = 0;
+	for (int i = 0; i < INDEX_LAYOUT_MAX_STREAMS; ++i)
+		batch.base[i] = 0;
+	layout.batches.push_back(batch);
+}
+
+static void BuildSingleBatch(const unsigned int *indices, unsigned int numTriangles, unsigned int numStreams, const unsigned int *streamSizes, IndexLayout &layout)
+{
+	unsigned int maxIndex = 0;
+	for (unsigned int i = 0; i < numTriangles; ++i)
+	{
+		for (unsigned int j = 0; j < numStreams; ++j)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				unsigned int index = indices[(i * numStreams + j) * 3 + k];
+				if (index < streamSizes[j] && index > maxIndex)
+					maxIndex = index;
+			}
+		}
+	}
+
+	layout.indexSize = (maxIndex < INDEX_LAYOUT_MAX_SPAN_16 ? 2 : 4);
+	layout.batches.clear();
+	StartBatch(layout, 0);
+	layout.batches.back().numTriangles = numTriangles;
+}
+
+void BuildIndexLayout(const unsigned int *indices, unsigned int numTriangles, unsigned int numStreams, const unsigned int *streamSizes, bool split, IndexLayout &layout)
+{
+	BuildSingleBatch(indices, numTriangles, numStreams, streamSizes, layout);
+	if (!split || layout.indexSize == 2)
+		return;
+
+	// Greedy, a batch is closed as soon as the next triangle would widen
+	// any of its streams past the 16 bit span
+	IndexLayout result;
+	result.indexSize = 2;
+	unsigned int low[INDEX_LAYOUT_MAX_STREAMS];
+	unsigned int high[INDEX_LAYOUT_MAX_STREAMS];
+	for (unsigned int i = 0; i < numTriangles; ++i)
+	{
+		unsigned int triangleLow[INDEX_LAYOUT_MAX_STREAMS];
+		unsigned int triangleHigh[INDEX_LAYOUT_MAX_STREAMS];
+		for (unsigned int j = 0; j < numStreams; ++j)
+		{
+			triangleLow[j] = streamSizes[j];
+			triangleHigh[j] = 0;
+			for (int k = 0; k < 3; ++k)
+			{
+				unsigned int index = indices[(i * numStreams + j) * 3 + k];
+				if (index >= streamSizes[j])
+					continue;
+				triangleLow[j] = (index < triangleLow[j] ? index : triangleLow[j]);
+				triangleHigh[j] = (index > triangleHigh[j] ? index : triangleHigh[j]);
+			}
+			if (triangleLow[j] <= triangleHigh[j] && triangleHigh[j] - triangleLow[j] >= INDEX_LAYOUT_MAX_SPAN_16)
+				return;
+		}
+
+		bool fits = (result.batches.size() > 0);
+		for (unsigned int j = 0; j < numStreams && fits; ++j)
+		{
+			unsigned int newLow = (triangleLow[j] < low[j] ? triangleLow[j] : low[j]);
+			unsigned int newHigh = (triangleHigh[j] > high[j] ? triangleHigh[j] : high[j]);
+			if (newLow <= newHigh && newHigh - newLow >= INDEX_LAYOUT_MAX_SPAN_16)
+				fits = false;
+		}
+
+		if (!fits)
+		{
+			StartBatch(result, i);
+			for (unsigned int j = 0; j < numStreams; ++j)
+			{
+				low[j] = streamSizes[j];
+				high[j] = 0;
+			}
+		}
+
+		IndexBatch *batch = &result.batches.back();
+		++batch->numTriangles;
+		for (unsigned int j = 0; j < numStreams; ++j)
+		{
+			low[j] = (triangleLow[j] < low[j] ? triangleLow[j] : low[j]);
+			high[j] = (triangleHigh[j] > high[j] ? triangleHigh[j] : high[j]);
+			batch->base[j] = (low[j] <= high[j] ? low[j] : 0);
+		}
+	}
+
+	layout = result;
+}
@@ -0,0 +1,46 @@
+#ifndef __PROCESSING_INDEXLAYOUT_H_INCLUDED__
+#define __PROCESSING_INDEXLAYOUT_H_INCLUDED__
+
+#include <vector>
+
+// A triangle list has up to this many index streams (vertex, normal,
+// texcoord), each with its own base in every batch
+#define INDEX_LAYOUT_MAX_STREAMS 3
+
+// The largest value of each index width is kept free to mark a missing
+// index, so a 16 bit batch can span at most 65535 values
+#define INDEX_LAYOUT_MAX_SPAN_16 65535
+
+// A run of triangles whose indices are stored relative to base
+struct IndexBatch
+{
+	unsigned int firstTriangle;
+	unsigned int numTriangles;
+	unsigned int base[INDEX_LAYOUT_MAX_STREAMS];
+};
+
+struct IndexLayout
+{
+	unsigned int indexSize;                      // Bytes per stored index, 2 or 4
+	std::vector<IndexBatch> batches;
+};
+
+/**
+ * Picks the narrowest index width that can hold a triangle list. Without
+ * splitting there is a single batch with bases of 0, and 16 bit indices
+ * are used when every index fits. With splitting the triangles are cut
+ * into consecutive batches whose indices each span a 16 bit range, which
+ * works well once the vertices are in fetch order. If that isn't possible
+ * for some triangle the whole list falls back to 32 bits
+ * @param indices numStreams * 3 indices per triangle, one stream after
+ *                the other. Indices outside their stream are treated as
+ *                missing and don't affect the width
+ * @param numTriangles number of triangles
+ * @param numStreams number of index streams per triangle
+ * @param streamSizes number of elements each stream indexes
+ * @param split whether the list may be cut into batches
+ * @param layout receives the chosen width and batches
+ */
+void BuildIndexLayout(const unsigned int *indices, unsigned int numTriangles, unsigned int numStreams, const unsigned int *streamSizes, bool split, IndexLayout &layout);
+
+#endif
@@ -0,0 +1,353 @@
+#include "meshlets.h"
+#include "../util/parallel.h"
+
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+#define NOT_IN_MESHLET 0xff
+
+static void ComputeMeshletBounds(const unsigned int *vertices, const unsigned char *triangles, const Vector3 *positions, Meshlet &meshlet)
+{
+	Vector3 minimum = positions[vertices[0]];
+	Vector3 maximum = minimum;
+	for (unsigned int i = 1; i < meshlet.vertexCount; ++i)
+	{
+		const Vector3 &p = positions[vertices[i]];
+		minimum.x = std::min(minimum.x, p.x);
+		minimum.y = std::min(minimum.y, p.y);
+		minimum.z = std::min(minimum.z, p.z);
+		maximum.x = std::max(maximum.x, p.x);
+		maximum.y = std::max(maximum.y, p.y);
+		maximum.z = std::max(maximum.z, p.z);
+	}
+
+	meshlet.center = (minimum + maximum) / 2.0f;
+	meshlet.radius = 0.0f;
+	for (unsigned int i = 0; i < meshlet.vertexCount; ++i)
+		meshlet.radius = std::max(meshlet.radius, Vector3::Distance(meshlet.center, positions[vertices[i]]));
+
+	// Defaults for a meshlet that can never be rejected by its cone
+	meshlet.coneApex = meshlet.center;
+	meshlet.coneAxis = ZERO_VECTOR;
+	meshlet.coneCutoff = 1.0f;
+
+	std::vector<Vector3> normals;
+	normals.reserve(meshlet.triangleCount);
+	Vector3 axis = ZERO_VECTOR;
+	for (unsigned int i = 0; i < meshlet.triangleCount; ++i)
+	{
+		const unsigned char *triangle = &triangles[i * 3];
+		const Vector3 &a = positions[vertices[triangle[0]]];
+		const Vector3 &b = positions[vertices[triangle[1]]];
+		const Vector3 &c = positions[vertices[triangle[2]]];
+
+		Vector3 normal = Vector3::Cross(b - a, c - a);
+		float length = Vector3::Magnitude(normal);
+		if (length <= FLT_EPSILON)
+		{
+			normals.push_back(ZERO_VECTOR);
+			continue;
+		}
+		normal /= length;
+		normals.push_back(normal);
+		axis += normal;
+	}
+
+	float axisLength = Vector3::Magnitude(axis);
+	if (axisLength <= FLT_EPSILON)
+		return;
+	axis /= axisLength;
+
+	float minimumDot = 1.0f;
+	for (unsigned int i = 0; i < normals.size(); ++i)
+	{
+		if (normals[i] == ZERO_VECTOR)
+			continue;
+		minimumDot = std::min(minimumDot, Vector3::Dot(normals[i], axis));
+	}
+
+	// Normals spread over more than a hemisphere, some triangle always
+	// faces the viewer
+	if (minimumDot <= 0.0f)
+		return;
+
+	// Move the apex back along the axis until every triangle's plane is in
+	// front of it, so the test stays conservative for viewers near the meshlet
+	float maximumT = 0.0f;
+	for (unsigned int i = 0; i < meshlet.triangleCount; ++i)
+	{
+		if (normals[i] == ZERO_VECTOR)
+			continue;
+		const Vector3 &a = positions[vertices[triangles[i * 3]]];
+		float dc = Vector3::Dot(normals[i], axis);
+		float t = Vector3::Dot(meshlet.center - a, normals[i]) / dc;
+		maximumT = std::max(maximumT, t);
+	}
+
+	meshlet.coneApex = meshlet.center - axis * maximumT;
+	meshlet.coneAxis = axis;
+	meshlet.coneCutoff = sqrtf(1.0f - minimumDot * minimumDot);
+}
+
+static void BuildRangeMeshlets(const unsigned int *indices, const TriangleRange &range, const Vector3 *positions, unsigned int numVertices, MeshletData &result, unsigned int *triangleOrder)
+{
+	unsigned int count = range.end - range.start;
+	const unsigned int *rangeIndices = &indices[range.start * 3];
+
+	// Compact the vertices this range uses to local ids, in order of first
+	// use, so the per vertex bookkeeping only costs as much as the range
+	// itself. The lookup table is sized by the range, not the whole mesh
+	unsigned int tableSize = 1;
+	while (tableSize < count * 6)
+		tableSize <<= 1;
+	std::vector<unsigned int> tableKeys(tableSize, (unsigned int)-1);
+	std::vector<unsigned int> tableValues(tableSize);
+
+	std::vector<unsigned int> used;
+	std::vector<unsigned int> local(count * 3);
+	std::vector<unsigned char> emitted(count, 0);
+	std::vector<unsigned int> invalid;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		const unsigned int *triangle = &rangeIndices[i * 3];
+		if (triangle[0] >= numVertices || triangle[1] >= numVertices || triangle[2] >= numVertices)
+		{
+			// Kept at the end of the range without a meshlet
+			emitted[i] = 1;
+			invalid.push_back(i);
+			continue;
+		}
+		for (int j = 0; j < 3; ++j)
+		{
+			unsigned int vertex = triangle[j];
+			unsigned int bucket = (vertex * 0x9e3779b1u) & (tableSize - 1);
+			while (tableKeys[bucket] != vertex && tableKeys[bucket] != (unsigned int)-1)
+				bucket = (bucket + 1) & (tableSize - 1);
+			if (tableKeys[bucket] == (unsigned int)-1)
+			{
+				tableKeys[bucket] = vertex;
+				tableValues[bucket] = used.size();
+				used.push_back(vertex);
+			}
+			local[i * 3 + j] = tableValues[bucket];
+		}
+	}
+	unsigned int numLocal = used.size();
+
+	// Triangles using each local vertex
+	std::vector<unsigned int> adjacencyStart(numLocal + 1, 0);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		if (emitted[i])
+			continue;
+		for (int j = 0; j < 3; ++j)
+			++adjacencyStart[local[i * 3 + j] + 1];
+	}
+	for (unsigned int i = 0; i < numLocal; ++i)
+		adjacencyStart[i + 1] += adjacencyStart[i];
+	std::vector<unsigned int> adjacency(adjacencyStart[numLocal]);
+	std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		if (emitted[i])
+			continue;
+		for (int j = 0; j < 3; ++j)
+			adjacency[fill[local[i * 3 + j]]++] = i;
+	}
+
+	std::vector<unsigned char> slot(numLocal, NOT_IN_MESHLET);
+	std::vector<unsigned int> meshletVertices;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> queuedFor(count, 0);
+	unsigned int meshletNumber = 1;
+	unsigned int meshletTriangles = 0;
+	unsigned int position = range.start;
+	unsigned int cursor = 0;
+
+	Meshlet meshlet;
+	meshlet.group = range.group;
+	meshlet.firstTriangle = position;
+	meshlet.vertexOffset = result.vertices.size();
+	meshlet.triangleOffset = result.triangles.size() / 3;
+
+	for (;;)
+	{
+		// Best candidate adds the fewest new vertices, ties go to the one
+		// found first. Nothing beats a triangle that adds no vertices, the
+		// search stops at the first of those
+		unsigned int best = count;
+		unsigned int bestNew = 4;
+		bool hasCandidates = false;
+		unsigned int kept = 0;
+		unsigned int i = 0;
+		for (; i < candidates.size(); ++i)
+		{
+			unsigned int triangle = candidates[i];
+			if (emitted[triangle])
+				continue;
+			candidates[kept++] = triangle;
+			hasCandidates = true;
+
+			unsigned int added = 0;
+			for (int j = 0; j < 3; ++j)
+				added += (slot[local[triangle * 3 + j]] == NOT_IN_MESHLET);
+			if (meshletVertices.size() + added > MESHLET_MAX_VERTICES)
+				continue;
+			if (added < bestNew)
+			{
+				best = triangle;
+				bestNew = added;
+				if (added == 0)
+				{
+					++i;
+					break;
+				}
+			}
+		}
+		for (; i < candidates.size(); ++i)
+			candidates[kept++] = candidates[i];
+		candidates.resize(kept);
+
+		bool flush = false;
+		if (best == count)
+		{
+			if (hasCandidates)
+			{
+				// Neighbours left but none fit, start over somewhere else
+				flush = true;
+			}
+			else
+			{
+				while (cursor < count && emitted[cursor])
+					++cursor;
+				if (cursor == count && meshletTriangles == 0)
+					break;
+				if (cursor == count)
+				{
+					flush = true;
+				}
+				else
+				{
+					unsigned int added = 0;
+					for (int j = 0; j < 3; ++j)
+						added += (slot[local[cursor * 3 + j]] == NOT_IN_MESHLET);
+					if (meshletVertices.size() + added > MESHLET_MAX_VERTICES)
+						flush = true;
+					else
+						best = cursor;
+				}
+			}
+		}
+
+		if (!flush)
+		{
+			emitted[best] = 1;
+			triangleOrder[position++] = range.start + best;
+			for (int j = 0; j < 3; ++j)
+			{
+				unsigned int vertex = local[best * 3 + j];
+				if (slot[vertex] == NOT_IN_MESHLET)
+				{
+					slot[vertex] = (unsigned char)meshletVertices.size();
+					meshletVertices.push_back(vertex);
+					for (unsigned int k = adjacencyStart[vertex]; k < adjacencyStart[vertex + 1]; ++k)
+					{
+						unsigned int triangle = adjacency[k];
+						if (!emitted[triangle] && queuedFor[triangle] != meshletNumber)
+						{
+							queuedFor[triangle] = meshletNumber;
+							candidates.push_back(triangle);
+						}
+					}
+				}
+				result.triangles.push_back(slot[vertex]);
+			}
+			++meshletTriangles;
+			flush = (meshletTriangles == MESHLET_MAX_TRIANGLES);
+		}
+
+		if (flush)
+		{
+			meshlet.vertexCount = meshletVertices.size();
+			meshlet.triangleCount = meshletTriangles;
+			for (unsigned int i = 0; i < meshletVertices.size(); ++i)
+			{
+				slot[meshletVertices[i]] = NOT_IN_MESHLET;
+				result.vertices.push_back(used[meshletVertices[i]]);
+			}
+			ComputeMeshletBounds(&result.vertices[meshlet.vertexOffset], &result.triangles[meshlet.triangleOffset * 3], positions, meshlet);
+			result.meshlets.push_back(meshlet);
+
+			meshletVertices.clear();
+			candidates.clear();
+			++meshletNumber;
+			meshletTriangles = 0;
+			meshlet.firstTriangle = position;
+			meshlet.vertexOffset = result.vertices.size();
+			meshlet.triangleOffset = result.triangles.size() / 3;
+		}
+	}
+
+	for (unsigned int i = 0; i < invalid.size(); ++i)
+		triangleOrder[position++] = range.start + invalid[i];
+}
+
+void BuildMeshlets(const unsigned int *indices, unsigned int numTriangles, const TriangleRange *ranges, unsigned int numRanges, const Vector3 *positions, unsigned int numVertices, MeshletData &meshlets, unsigned int *triangleOrder)
+{
+	for (unsigned int i = 0; i < numTriangles; ++i)
+		triangleOrder[i] = i;
+
+	// Every range builds into its own list, they are joined in range order
+	// afterwards so the output doesn't depend on thread timing
+	std::vector<MeshletData> results(numRanges);
+	ParallelFor(numRanges, [&](unsigned int i)
+	{
+		const TriangleRange &range = ranges[i];
+		if (range.end > range.start && range.end <= numTriangles)
+			BuildRangeMeshlets(indices, range, positions, numVertices, results[i], triangleOrder);
+	});
+
+	meshlets.meshlets.clear();
+	meshlets.vertices.clear();
+	meshlets.triangles.clear();
+	for (unsigned int i = 0; i < numRanges; ++i)
+	{
+		unsigned int vertexBase = meshlets.vertices.size();
+		unsigned int triangleBase = meshlets.triangles.size() / 3;
+		for (unsigned int j = 0; j < results[i].meshlets.size(); ++j)
+		{
+			Meshlet meshlet = results[i].meshlets[j];
+			meshlet.vertexOffset += vertexBase;
+			meshlet.triangleOffset += triangleBase;
+			meshlets.meshlets.push_back(meshlet);
+		}
+		meshlets.vertices.insert(meshlets.vertices.end(), results[i].vertices.begin(), results[i].vertices.end());
+		meshlets.triangles.insert(meshlets.triangles.end(), results[i].triangles.begin(), results[i].triangles.end());
+	}
+}
+
+MeshletStats AnalyzeMeshlets(const MeshletData &meshlets)
+{
+	MeshletStats stats;
+	stats.numMeshlets = meshlets.meshlets.size();
+	stats.averageVertices = 0.0f;
+	stats.averageTriangles = 0.0f;
+	stats.conesUsable = 0.0f;
+	if (stats.numMeshlets == 0)
+		return stats;
+
+	unsigned int withCone = 0;
+	for (unsigned int i = 0; i < stats.numMeshlets; ++i)
+	{
+		const Meshlet &meshlet = meshlets.meshlets[i];
+		stats.averageVertices += meshlet.vertexCount;
+		stats.averageTriangles += meshlet.triangleCount;
+		if (meshlet.coneCutoff < 1.0f)
+			++withCone;
+	}
+	stats.averageVertices /= stats.numMeshlets;
+	stats.averageTriangles /= stats.numMeshlets;
+	stats.conesUsable = withCone / (float)stats.numMeshlets;
+	return stats;
+}
@@ -0,0 +1,71 @@
+#ifndef __PROCESSING_MESHLETS_H_INCLUDED__
+#define __PROCESSING_MESHLETS_H_INCLUDED__
+
+#include "../geometry/vector3.h"
+#include "trianglerange.h"
+
+#include <vector>
+
+// Limits matching what mesh shaders are commonly tuned for. 124 triangles
+// keeps the local index data of a meshlet within 372 bytes
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+struct Meshlet
+{
+	unsigned int group;                          // Material or group the triangles belong to
+	unsigned int firstTriangle;                  // First triangle in the reordered triangle list
+	unsigned int vertexOffset;                   // First entry in MeshletData::vertices
+	unsigned int vertexCount;
+	unsigned int triangleOffset;                 // First triangle in MeshletData::triangles
+	unsigned int triangleCount;
+	Vector3 center;                              // Bounding sphere
+	float radius;
+	Vector3 coneApex;                            // Backface cone, the whole meshlet faces away from
+	Vector3 coneAxis;                            // a viewer at v when
+	float coneCutoff;                            // dot(normalize(coneApex - v), coneAxis) >= coneCutoff
+};
+
+struct MeshletData
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<unsigned int> vertices;          // Mesh vertex indices, vertexCount per meshlet
+	std::vector<unsigned char> triangles;        // 3 indices into the meshlet's vertices per triangle
+};
+
+struct MeshletStats
+{
+	unsigned int numMeshlets;
+	float averageVertices;                       // Vertices per meshlet, MESHLET_MAX_VERTICES is ideal
+	float averageTriangles;                      // Triangles per meshlet, MESHLET_MAX_TRIANGLES is ideal
+	float conesUsable;                           // Fraction of meshlets with a cone that can ever reject them
+};
+
+/**
+ * Splits triangle ranges into meshlets, growing each meshlet from the
+ * triangles that share the most vertices with it. Ranges are built in
+ * parallel. The triangles are reordered so every meshlet covers a
+ * contiguous run of the triangle list
+ * @param indices 3 vertex indices per triangle
+ * @param numTriangles number of triangles in the list
+ * @param ranges triangle ranges to build meshlets for, these must not
+ *               overlap. Triangles outside of them get no meshlets
+ * @param numRanges number of ranges
+ * @param positions vertex positions the indices refer to
+ * @param numVertices number of vertex positions
+ * @param meshlets receives the meshlets, in range order
+ * @param triangleOrder receives numTriangles entries, the index of the
+ *                      triangle that should be placed at each position.
+ *                      Triangles only move within their own range
+ */
+void BuildMeshlets(const unsigned int *indices, unsigned int numTriangles, const TriangleRange *ranges, unsigned int numRanges, const Vector3 *positions, unsigned int numVertices, MeshletData &meshlets, unsigned int *triangleOrder);
+
+/**
+ * Summarizes how well the meshlets fill up their limits
+ * @param meshlets meshlets to look at
+ *
+ * @return MeshletStats averages over all of the meshlets
+ */
+MeshletStats AnalyzeMeshlets(const MeshletData &meshlets);
+
+#endif
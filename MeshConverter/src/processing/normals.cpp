@@ -0,0 +1,250 @@
+#include "normals.h"
+#include "weld.h"
+#include "../util/parallel.h"
+
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+
+// Triangles are handed to the worker threads in blocks this big
+#define NORMALS_BLOCK_SIZE 16384
+
+#define DEGREES_TO_RADIANS 0.017453292519943295
+
+static inline Vector3 GetPosition(const unsigned int *indices, const Vector3 *positions, unsigned int numPositions, unsigned int corner)
+{
+	return (indices[corner] < numPositions ? positions[indices[corner]] : ZERO_VECTOR);
+}
+
+static inline unsigned int GetGroup(const unsigned int *smoothingGroups, unsigned int triangle)
+{
+	return (smoothingGroups != NULL ? smoothingGroups[triangle] : 1);
+}
+
+// Angle between the 2 edges leaving a corner, 0 where either has no length
+static float GetCornerAngle(const Vector3 &position, const Vector3 &previous, const Vector3 &next)
+{
+	Vector3 v1 = previous - position;
+	Vector3 v2 = next - position;
+	float lengths = Vector3::Magnitude(v1) * Vector3::Magnitude(v2);
+	if (!(lengths > FLT_MIN))
+		return 0.0f;
+
+	float cosine = std::max(-1.0f, std::min(Vector3::Dot(v1, v2) / lengths, 1.0f));
+	return acosf(cosine);
+}
+
+struct NormalAdjacency
+{
+	const Vector3 *faceNormals;                  // Unit length, zero for degenerate triangles
+	const float *weights;                        // Per corner
+	const unsigned int *smoothingGroups;
+	const unsigned int *vertexStarts;            // numVertices + 2 offsets into vertexCorners
+	const unsigned int *vertexCorners;           // Corners around each vertex, in corner order
+	float minCosine;                             // Of the crease angle
+	float minHalfCosine;                         // Of half the crease angle
+};
+
+// Sums the triangles around the corner's vertex that are in its smoothing
+// group and within the crease angle of its own triangle. Degenerate
+// triangles have no normal to compare, so they take everything in their
+// group, and add nothing to the others
+static Vector3 GetCornerNormal(const NormalAdjacency &adjacency, unsigned int vertex, unsigned int corner, bool &hard)
+{
+	const Vector3 &faceNormal = adjacency.faceNormals[corner / 3];
+	bool degenerate = (Vector3::SquaredLength(faceNormal) == 0.0f);
+	unsigned int group = GetGroup(adjacency.smoothingGroups, corner / 3);
+	if (group == NORMALS_NO_SMOOTHING)
+		return (degenerate ? UP_VECTOR : faceNormal);
+
+	Vector3 normal = ZERO_VECTOR;
+	for (unsigned int i = adjacency.vertexStarts[vertex]; i < adjacency.vertexStarts[vertex + 1]; ++i)
+	{
+		unsigned int other = adjacency.vertexCorners[i];
+		const Vector3 &otherNormal = adjacency.faceNormals[other / 3];
+		if (GetGroup(adjacency.smoothingGroups, other / 3) != group || Vector3::SquaredLength(otherNormal) == 0.0f)
+			continue;
+		if (!degenerate && Vector3::Dot(otherNormal, faceNormal) < adjacency.minCosine)
+		{
+			hard = true;
+			continue;
+		}
+		normal += otherNormal * adjacency.weights[other];
+	}
+
+	float length = Vector3::Magnitude(normal);
+	if (length > FLT_MIN)
+		return normal / length;
+	return (degenerate ? UP_VECTOR : faceNormal);
+}
+
+// Checking every corner against every other is quadratic in the number of
+// triangles around a vertex, which adds up at the poles of a sphere or the
+// middle of a fan. Where all of them are in one group and within half the
+// crease angle of their sum, no 2 can be further apart than the crease
+// angle, so every corner gets the sum GetCornerNormal would have given it
+static unsigned int SmoothVertex(const NormalAdjacency &adjacency, unsigned int vertex, Vector3 *cornerNormals)
+{
+	unsigned int start = adjacency.vertexStarts[vertex];
+	unsigned int end = adjacency.vertexStarts[vertex + 1];
+	if (start == end)
+		return 0;
+
+	unsigned int group = GetGroup(adjacency.smoothingGroups, adjacency.vertexCorners[start] / 3);
+	bool shared = (group != NORMALS_NO_SMOOTHING);
+	Vector3 sum = ZERO_VECTOR;
+	for (unsigned int i = start; i < end && shared; ++i)
+	{
+		unsigned int corner = adjacency.vertexCorners[i];
+		if (GetGroup(adjacency.smoothingGroups, corner / 3) != group)
+			shared = false;
+		else if (Vector3::SquaredLength(adjacency.faceNormals[corner / 3]) != 0.0f)
+			sum += adjacency.faceNormals[corner / 3] * adjacency.weights[corner];
+	}
+
+	float length = Vector3::Magnitude(sum);
+	if (shared && length > FLT_MIN)
+	{
+		Vector3 axis = sum / length;
+		for (unsigned int i = start; i < end && shared; ++i)
+		{
+			const Vector3 &faceNormal = adjacency.faceNormals[adjacency.vertexCorners[i] / 3];
+			if (Vector3::SquaredLength(faceNormal) != 0.0f && Vector3::Dot(faceNormal, axis) < adjacency.minHalfCosine)
+				shared = false;
+		}
+		if (shared)
+		{
+			for (unsigned int i = start; i < end; ++i)
+				cornerNormals[adjacency.vertexCorners[i]] = axis;
+			return 0;
+		}
+	}
+
+	unsigned int numHard = 0;
+	for (unsigned int i = start; i < end; ++i)
+	{
+		bool hard = false;
+		unsigned int corner = adjacency.vertexCorners[i];
+		cornerNormals[corner] = GetCornerNormal(adjacency, vertex, corner, hard);
+		if (hard)
+			++numHard;
+	}
+	return numHard;
+}
+
+NormalStats GenerateNormals(const unsigned int *indices, unsigned int numTriangles, const Vector3 *positions, unsigned int numPositions, const unsigned int *smoothingGroups, float creaseAngle, unsigned int weighting,
+	std::vector<Vector3> &normals, unsigned int *normalIndices)
+{
+	NormalStats stats;
+	stats.numVertices = 0;
+	stats.numNormals = 0;
+	stats.numHardCorners = 0;
+	normals.clear();
+	if (numTriangles == 0)
+		return stats;
+
+	// Copies of a position split along texture or normal seams are the same
+	// point as far as smoothing goes. Corners with an invalid index get a
+	// vertex of their own past the welded ones
+	std::vector<unsigned int> remap(numPositions);
+	unsigned int numVertices = WeldVertices(positions, numPositions, 0.0f, NULL, 0, remap.data());
+	stats.numVertices = numVertices;
+
+	unsigned int numCorners = numTriangles * 3;
+	unsigned int numBlocks = (numTriangles + NORMALS_BLOCK_SIZE - 1) / NORMALS_BLOCK_SIZE;
+	std::vector<Vector3> faceNormals(numTriangles);
+	std::vector<float> weights(numCorners);
+	ParallelFor(numBlocks, [&](unsigned int block)
+	{
+		unsigned int end = std::min((block + 1) * NORMALS_BLOCK_SIZE, numTriangles);
+		for (unsigned int i = block * NORMALS_BLOCK_SIZE; i < end; ++i)
+		{
+			Vector3 p[3];
+			for (unsigned int j = 0; j < 3; ++j)
+				p[j] = GetPosition(indices, positions, numPositions, i * 3 + j);
+
+			Vector3 cross = Vector3::Cross(p[1] - p[0], p[2] - p[0]);
+			float length = Vector3::Magnitude(cross);
+			faceNormals[i] = (length > FLT_MIN ? cross / length : ZERO_VECTOR);
+			for (unsigned int j = 0; j < 3; ++j)
+			{
+				if (weighting == NORMALS_WEIGHT_AREA)
+					weights[i * 3 + j] = length * 0.5f;
+				else
+					weights[i * 3 + j] = GetCornerAngle(p[j], p[(j + 2) % 3], p[(j + 1) % 3]);
+			}
+		}
+	});
+
+	// Corners around each vertex, filled in corner order so every vertex
+	// lists its triangles in the same order whatever the thread count
+	std::vector<unsigned int> cornerVertices(numCorners);
+	std::vector<unsigned int> vertexStarts(numVertices + 2, 0);
+	for (unsigned int i = 0; i < numCorners; ++i)
+	{
+		cornerVertices[i] = (indices[i] < numPositions ? remap[indices[i]] : numVertices);
+		++vertexStarts[cornerVertices[i] + 1];
+	}
+	for (unsigned int i = 0; i <= numVertices; ++i)
+		vertexStarts[i + 1] += vertexStarts[i];
+
+	std::vector<unsigned int> vertexCorners(numCorners);
+	std::vector<unsigned int> fill(vertexStarts.begin(), vertexStarts.end() - 1);
+	for (unsigned int i = 0; i < numCorners; ++i)
+		vertexCorners[fill[cornerVertices[i]]++] = i;
+
+	NormalAdjacency adjacency;
+	adjacency.faceNormals = &faceNormals[0];
+	adjacency.weights = &weights[0];
+	adjacency.smoothingGroups = smoothingGroups;
+	adjacency.vertexStarts = &vertexStarts[0];
+	adjacency.vertexCorners = &vertexCorners[0];
+	double crease = std::max(0.0, std::min((double)creaseAngle, 180.0)) * DEGREES_TO_RADIANS;
+	adjacency.minCosine = (float)cos(crease);
+	adjacency.minHalfCosine = (float)cos(crease * 0.5);
+
+	// Corners are only ever written by their own vertex, so vertices can
+	// be smoothed in parallel. The extra vertex holds the invalid corners
+	std::vector<Vector3> cornerNormals(numCorners);
+	unsigned int numVertexBlocks = (numVertices + NORMALS_BLOCK_SIZE) / NORMALS_BLOCK_SIZE;
+	std::vector<unsigned int> hardCorners(numVertexBlocks, 0);
+	ParallelFor(numVertexBlocks, [&](unsigned int block)
+	{
+		unsigned int end = std::min((block + 1) * NORMALS_BLOCK_SIZE, numVertices + 1);
+		for (unsigned int i = block * NORMALS_BLOCK_SIZE; i < end; ++i)
+			hardCorners[block] += SmoothVertex(adjacency, i, &cornerNormals[0]);
+	});
+	for (unsigned int i = 0; i < numVertexBlocks; ++i)
+		stats.numHardCorners += hardCorners[i];
+
+	// Corners around a smooth vertex all come out the same, so each corner
+	// points at the first corner of its vertex with the same normal. That
+	// corner is never later than itself, since a vertex lists its corners
+	// in order, and numbering them in corner order only looks back. Stopping
+	// at the corner itself keeps NaNs from positions out of the way
+	ParallelFor(numBlocks, [&](unsigned int block)
+	{
+		unsigned int end = std::min((block + 1) * NORMALS_BLOCK_SIZE, numTriangles) * 3;
+		for (unsigned int i = block * NORMALS_BLOCK_SIZE * 3; i < end; ++i)
+		{
+			unsigned int vertex = cornerVertices[i];
+			unsigned int k = vertexStarts[vertex];
+			while (vertexCorners[k] != i && !(cornerNormals[vertexCorners[k]] == cornerNormals[i]))
+				++k;
+			normalIndices[i] = vertexCorners[k];
+		}
+	});
+
+	for (unsigned int i = 0; i < numCorners; ++i)
+	{
+		if (normalIndices[i] == i)
+		{
+			normalIndices[i] = (unsigned int)normals.size();
+			normals.push_back(cornerNormals[i]);
+		}
+		else
+			normalIndices[i] = normalIndices[normalIndices[i]];
+	}
+	stats.numNormals = (unsigned int)normals.size();
+	return stats;
+}
@@ -0,0 +1,57 @@
+#ifndef __PROCESSING_NORMALS_H_INCLUDED__
+#define __PROCESSING_NORMALS_H_INCLUDED__
+
+#include "../geometry/vector3.h"
+
+#include <vector>
+
+// Triangles meeting at more than this angle, in degrees, keep a hard edge
+// when no angle is given
+#define NORMALS_DEFAULT_CREASE_ANGLE 60.0f
+
+// Triangles in smoothing group 0 are flat shaded, like OBJ's "s off"
+#define NORMALS_NO_SMOOTHING 0
+
+#define NORMALS_WEIGHT_ANGLE 0
+#define NORMALS_WEIGHT_AREA 1
+
+struct NormalStats
+{
+	unsigned int numVertices;                    // Distinct positions the triangles were smoothed over
+	unsigned int numNormals;                     // Distinct normals generated
+	unsigned int numHardCorners;                 // Corners that left out a neighbour over the crease angle
+};
+
+/**
+ * Generates a normal for every triangle corner by averaging the normals of
+ * the triangles around the corner's position. Positions are matched by
+ * value, so copies of a vertex split along seams still smooth together.
+ * Only triangles in the same smoothing group whose normals are within the
+ * crease angle of the corner's own triangle count. Each triangle's normal
+ * is weighted by its angle at the position, or by its area.
+ *
+ * Triangle normals and weights are worked out in parallel, then each
+ * position sums the triangles around it through a position to corner
+ * adjacency list, once for all its corners where none of them can be
+ * over the crease angle apart. Triangles are always summed in order, so
+ * the result doesn't depend on the number of threads. Corners that end up
+ * with the same normal at the same position share it
+ * @param indices 3 position indices per triangle, invalid ones count as
+ *                the origin
+ * @param numTriangles number of triangles
+ * @param positions vertex positions the indices refer to
+ * @param numPositions number of positions
+ * @param smoothingGroups smoothing group of each triangle, or NULL to
+ *                        smooth all triangles together
+ * @param creaseAngle largest angle between triangles, in degrees, that is
+ *                    still smoothed over
+ * @param weighting NORMALS_WEIGHT_ANGLE or NORMALS_WEIGHT_AREA
+ * @param normals receives the distinct normals
+ * @param normalIndices receives 3 indices into normals per triangle
+ *
+ * @return NormalStats vertex, normal and hard corner counts
+ */
+NormalStats GenerateNormals(const unsigned int *indices, unsigned int numTriangles, const Vector3 *positions, unsigned int numPositions, const unsigned int *smoothingGroups, float creaseAngle, unsigned int weighting,
+	std::vector<Vector3> &normals, unsigned int *normalIndices);
+
+#endif
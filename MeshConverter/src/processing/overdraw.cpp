@@ -0,0 +1,344 @@
+#include "overdraw.h"
+#include "vertexcache.h"
+
+#include <float.h>
+#include <vector>
+#include <algorithm>
+
+struct TriangleCluster
+{
+	unsigned int start;
+	unsigned int end;
+	float sortKey;
+};
+
+static bool CompareClusters(const TriangleCluster &a, const TriangleCluster &b)
+{
+	return a.sortKey > b.sortKey;
+}
+
+static void RasterizeView(const unsigned int *indices, unsigned int numTriangles, const Vector3 *positions, unsigned int numVertices, const Vector3 &direction, OverdrawStats &stats)
+{
+	// Orthographic camera looking down the given direction
+	Vector3 up = (fabsf(direction.y) > 0.99f ? Z_AXIS : Y_AXIS);
+	Vector3 right = Vector3::Normalize(Vector3::Cross(direction, up));
+	up = Vector3::Cross(right, direction);
+
+	float minX = FLT_MAX, minY = FLT_MAX;
+	float maxX = -FLT_MAX, maxY = -FLT_MAX;
+	for (unsigned int i = 0; i < numTriangles * 3; ++i)
+	{
+		if (indices[i] >= numVertices)
+			continue;
+		float x = Vector3::Dot(positions[indices[i]], right);
+		float y = Vector3::Dot(positions[indices[i]], up);
+		minX = (x < minX ? x : minX);
+		minY = (y < minY ? y : minY);
+		maxX = (x > maxX ? x : maxX);
+		maxY = (y > maxY ? y : maxY);
+	}
+
+	float extent = ((maxX - minX) > (maxY - minY) ? (maxX - minX) : (maxY - minY));
+	if (extent <= 0.0f)
+		return;
+	float scale = (OVERDRAW_VIEWPORT_SIZE - 1) / extent;
+
+	std::vector<float> depthBuffer(OVERDRAW_VIEWPORT_SIZE * OVERDRAW_VIEWPORT_SIZE, FLT_MAX);
+
+	for (unsigned int i = 0; i < numTriangles; ++i)
+	{
+		const unsigned int *triangle = &indices[i * 3];
+		if (triangle[0] >= numVertices || triangle[1] >= numVertices || triangle[2] >= numVertices)
+			continue;
+
+		const Vector3 &a = positions[triangle[0]];
+		const Vector3 &b = positions[triangle[1]];
+		const Vector3 &c = positions[triangle[2]];
+
+		// Backface culling, counter-clockwise triangles face the camera
+		if (Vector3::Dot(Vector3::Cross(b - a, c - a), direction) >= 0.0f)
+			continue;
+
+		float x[3], y[3], z[3];
+		const Vector3 *corners[3] = { &a, &b, &c };
+		for (int j = 0; j < 3; ++j)
+		{
+			x[j] = (Vector3::Dot(*corners[j], right) - minX) * scale;
+			y[j] = (Vector3::Dot(*corners[j], up) - minY) * scale;
+			z[j] = Vector3::Dot(*corners[j], direction);
+		}
+
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (area == 0.0f)
+			continue;
+		if (area < 0.0f)
+		{
+			std::swap(x[1], x[2]);
+			std::swap(y[1], y[2]);
+			std::swap(z[1], z[2]);
+			area = -area;
+		}
+
+		int left = (int)std::max(0.0f, std::min(x[0], std::min(x[1], x[2])));
+		int bottom = (int)std::max(0.0f, std::min(y[0], std::min(y[1], y[2])));
+		int rightmost = (int)std::min((float)(OVERDRAW_VIEWPORT_SIZE - 1), std::max(x[0], std::max(x[1], x[2])));
+		int top = (int)std::min((float)(OVERDRAW_VIEWPORT_SIZE - 1), std::max(y[0], std::max(y[1], y[2])));
+
+		for (int py = bottom; py <= top; ++py)
+		{
+			for (int px = left; px <= rightmost; ++px)
+			{
+				float sx = px + 0.5f;
+				float sy = py + 0.5f;
+				float w0 = (x[2] - x[1]) * (sy - y[1]) - (y[2] - y[1]) * (sx - x[1]);
+				float w1 = (x[0] - x[2]) * (sy - y[2]) - (y[0] - y[2]) * (sx - x[2]);
+				float w2 = (x[1] - x[0]) * (sy - y[0]) - (y[1] - y[0]) * (sx - x[0]);
+				if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+					continue;
+
+				float depth = (w0 * z[0] + w1 * z[1] + w2 * z[2]) / area;
+				float &stored = depthBuffer[py * OVERDRAW_VIEWPORT_SIZE + px];
+				if (depth < stored)
+				{
+					if (stored == FLT_MAX)
+						++stats.pixelsCovered;
+					stored = depth;
+					++stats.pixelsShaded;
+				}
+			}
+		}
+	}
+}
+
+OverdrawStats AnalyzeOverdraw(const unsigned int *indices, unsigned int numTriangles, const Vector3 *positions, unsigned int numVertices)
+{
+	OverdrawStats stats;
+	stats.overdraw = 0.0f;
+	stats.pixelsCovered = 0;
+	stats.pixelsShaded = 0;
+
+	// The 6 axis directions plus the 8 cube corners
+	for (int dx = -1; dx <= 1; ++dx)
+	{
+		for (int dy = -1; dy <= 1; ++dy)
+		{
+			for (int dz = -1; dz <= 1; ++dz)
+			{
+				int axes = (dx != 0) + (dy != 0) + (dz != 0);
+				if (axes != 1 && axes != 3)
+					continue;
+
+				Vector3 direction = Vector3::Normalize(Vector3((float)dx, (float)dy, (float)dz));
+				RasterizeView(indices, numTriangles, positions, numVertices, direction, stats);
+			}
+		}
+	}
+
+	if (stats.pixelsCovered > 0)
+		stats.overdraw = stats.pixelsShaded / (float)stats.pixelsCovered;
+	return stats;
+}
+
+// Counts FIFO cache misses over a run of triangles starting from a cold
+// cache. The timestamps are shared between calls, time has to keep
+// increasing for a cold start to work
+static unsigned int CountCacheMisses(const unsigned int *indices, unsigned int start, unsigned int end, std::vector<unsigned int> &loadedAt, unsigned int &time)
+{
+	unsigned int misses = 0;
+	time += VERTEX_CACHE_FIFO_SIZE + 1;
+	for (unsigned int i = start * 3; i < end * 3; ++i)
+	{
+		unsigned int vertex = indices[i];
+		if (time - loadedAt[vertex] > VERTEX_CACHE_FIFO_SIZE)
+		{
+			loadedAt[vertex] = time;
+			++time;
+			++misses;
+		}
+	}
+	return misses;
+}
+
+// Sorts clusters by how far their surface faces out from the center
+static void ComputeSortKey(const unsigned int *indices, const Vector3 *positions, const Vector3 &center, TriangleCluster &cluster)
+{
+	Vector3 centroid = ZERO_VECTOR;
+	Vector3 normal = ZERO_VECTOR;
+	float totalArea = 0.0f;
+
+	for (unsigned int j = cluster.start; j < cluster.end; ++j)
+	{
+		const Vector3 &a = positions[indices[j * 3]];
+		const Vector3 &b = positions[indices[j * 3 + 1]];
+		const Vector3 &c = positions[indices[j * 3 + 2]];
+
+		// Cross product length is twice the area, which weighs both sums evenly
+		Vector3 weightedNormal = Vector3::Cross(b - a, c - a);
+		float area = Vector3::Magnitude(weightedNormal);
+
+		centroid += (a + b + c) * (area / 3.0f);
+		normal += weightedNormal;
+		totalArea += area;
+	}
+
+	if (totalArea > 0.0f)
+		centroid /= totalArea;
+	cluster.sortKey = Vector3::Dot(centroid - center, Vector3::Normalize(normal));
+}
+
+// Merges each pair of neighbouring clusters (in their original order)
+// into one, the merged cluster's sort key has to be computed again
+static void MergeClusterPairs(std::vector<TriangleCluster> &clusters)
+{
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < clusters.size(); i += 2)
+	{
+		clusters[count] = clusters[i];
+		if (i + 1 < clusters.size())
+			clusters[count].end = clusters[i + 1].end;
+		++count;
+	}
+	clusters.resize(count);
+}
+
+void OptimizeOverdraw(const unsigned int *indices, unsigned int numTriangles, const Vector3 *positions, unsigned int numVertices, float threshold, unsigned int *triangleOrder)
+{
+	if (numTriangles == 0)
+		return;
+
+	for (unsigned int i = 0; i < numTriangles * 3; ++i)
+	{
+		if (indices[i] >= numVertices)
+		{
+			// Can't reason about geometry that isn't there, keep the order as is
+			for (unsigned int j = 0; j < numTriangles; ++j)
+				triangleOrder[j] = j;
+			return;
+		}
+	}
+
+	// Hard boundaries are where the cache optimizer had nothing left in the
+	// cache to continue from (all 3 vertices miss). Splitting there costs nothing
+	std::vector<unsigned int> loadedAt(numVertices, 0);
+	unsigned int time = 0;
+	std::vector<unsigned int> hardBoundaries;
+	time += VERTEX_CACHE_FIFO_SIZE + 1;
+	for (unsigned int i = 0; i < numTriangles; ++i)
+	{
+		unsigned int misses = 0;
+		for (int j = 0; j < 3; ++j)
+		{
+			unsigned int vertex = indices[i * 3 + j];
+			if (time - loadedAt[vertex] > VERTEX_CACHE_FIFO_SIZE)
+			{
+				loadedAt[vertex] = time;
+				++time;
+				++misses;
+			}
+		}
+		if (i == 0 || misses == 3)
+			hardBoundaries.push_back(i);
+	}
+	hardBoundaries.push_back(numTriangles);
+
+	// Soft boundaries split the hard clusters further, wherever the part
+	// seen so far (starting cold) is no worse than threshold times the
+	// whole cluster's ACMR
+	std::vector<TriangleCluster> clusters;
+	for (unsigned int i = 0; i + 1 < hardBoundaries.size(); ++i)
+	{
+		unsigned int start = hardBoundaries[i];
+		unsigned int end = hardBoundaries[i + 1];
+		float clusterAcmr = CountCacheMisses(indices, start, end, loadedAt, time) / (float)(end - start);
+
+		TriangleCluster cluster;
+		cluster.start = start;
+		unsigned int misses = 0;
+		time += VERTEX_CACHE_FIFO_SIZE + 1;
+		for (unsigned int j = start; j < end; ++j)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				unsigned int vertex = indices[j * 3 + k];
+				if (time - loadedAt[vertex] > VERTEX_CACHE_FIFO_SIZE)
+				{
+					loadedAt[vertex] = time;
+					++time;
+					++misses;
+				}
+			}
+
+			if (j + 1 < end && misses / (float)(j + 1 - cluster.start) <= clusterAcmr * threshold)
+			{
+				cluster.end = j + 1;
+				clusters.push_back(cluster);
+				cluster.start = j + 1;
+				misses = 0;
+				time += VERTEX_CACHE_FIFO_SIZE + 1;
+			}
+		}
+		cluster.end = end;
+		clusters.push_back(cluster);
+	}
+
+	Vector3 minimum = positions[0];
+	Vector3 maximum = positions[0];
+	for (unsigned int i = 1; i < numVertices; ++i)
+	{
+		minimum.x = std::min(minimum.x, positions[i].x);
+		minimum.y = std::min(minimum.y, positions[i].y);
+		minimum.z = std::min(minimum.z, positions[i].z);
+		maximum.x = std::max(maximum.x, positions[i].x);
+		maximum.y = std::max(maximum.y, positions[i].y);
+		maximum.z = std::max(maximum.z, positions[i].z);
+	}
+	Vector3 center = (minimum + maximum) / 2.0f;
+
+	// Clusters whose surface faces away from the center are on the outside
+	// of the mesh and most likely to occlude the rest, those go first. The
+	// split above only bounds each cluster on its own, so the sorted list as
+	// a whole is checked against threshold too. Sorting also has to cut
+	// overdraw by a larger factor than it adds vertex transforms to pay for
+	// itself. Until both hold, neighbouring clusters are merged, which ends
+	// in a single cluster (the cache order)
+	unsigned int inputMisses = CountCacheMisses(indices, 0, numTriangles, loadedAt, time);
+	float inputOverdraw = -1.0f;
+	std::vector<unsigned int> reordered(numTriangles * 3);
+	std::vector<TriangleCluster> sorted;
+	for (unsigned int i = 0; i < clusters.size(); ++i)
+		ComputeSortKey(indices, positions, center, clusters[i]);
+	while (clusters.size() > 1)
+	{
+		sorted = clusters;
+		std::stable_sort(sorted.begin(), sorted.end(), CompareClusters);
+
+		unsigned int position = 0;
+		for (unsigned int i = 0; i < sorted.size(); ++i)
+		{
+			for (unsigned int j = sorted[i].start; j < sorted[i].end; ++j)
+			{
+				triangleOrder[position] = j;
+				for (int k = 0; k < 3; ++k)
+					reordered[position * 3 + k] = indices[j * 3 + k];
+				++position;
+			}
+		}
+
+		unsigned int sortedMisses = CountCacheMisses(&reordered[0], 0, numTriangles, loadedAt, time);
+		if (sortedMisses <= inputMisses * threshold)
+		{
+			if (inputOverdraw < 0.0f)
+				inputOverdraw = AnalyzeOverdraw(indices, numTriangles, positions, numVertices).overdraw;
+			float sortedOverdraw = AnalyzeOverdraw(&reordered[0], numTriangles, positions, numVertices).overdraw;
+			if (sortedOverdraw * sortedMisses < inputOverdraw * inputMisses)
+				return;
+		}
+
+		MergeClusterPairs(clusters);
+		for (unsigned int i = 0; i < clusters.size(); ++i)
+			ComputeSortKey(indices, positions, center, clusters[i]);
+	}
+
+	for (unsigned int i = 0; i < numTriangles; ++i)
+		triangleOrder[i] = i;
+}
@@ -0,0 +1,51 @@
+#ifndef __PROCESSING_OVERDRAW_H_INCLUDED__
+#define __PROCESSING_OVERDRAW_H_INCLUDED__
+
+#include "../geometry/vector3.h"
+
+// Resolution of the depth buffer used by the overdraw estimate, per view
+#define OVERDRAW_VIEWPORT_SIZE 256
+
+// How much worse the ACMR of a reordered triangle list may get
+// (1.05 allows 5% more vertex transforms)
+#define OVERDRAW_DEFAULT_THRESHOLD 1.05f
+
+struct OverdrawStats
+{
+	float overdraw;                              // Pixels shaded / pixels covered, 1.0 is ideal
+	unsigned int pixelsCovered;
+	unsigned int pixelsShaded;
+};
+
+/**
+ * Estimates overdraw by rasterizing the triangles in order, with depth
+ * testing and backface culling, from a set of orthographic views
+ * spread around the mesh
+ * @param indices 3 vertex indices per triangle
+ * @param numTriangles number of triangles in the list
+ * @param positions vertex positions the indices refer to
+ * @param numVertices number of vertex positions
+ *
+ * @return OverdrawStats totals over all of the views
+ */
+OverdrawStats AnalyzeOverdraw(const unsigned int *indices, unsigned int numTriangles, const Vector3 *positions, unsigned int numVertices);
+
+/**
+ * Splits an already cache optimized triangle list into clusters and sorts
+ * the clusters so the ones facing outwards from the mesh center (most
+ * likely to be in front of the others) are drawn first. Clusters are
+ * merged until the sorted list's ACMR is within threshold of the input's,
+ * and the input order is kept unless sorting lowers the overdraw estimate
+ * by a larger factor than it raises ACMR
+ * @param indices 3 vertex indices per triangle
+ * @param numTriangles number of triangles in the list
+ * @param positions vertex positions of the whole mesh, the center of
+ *                  their bounds is used as the mesh center
+ * @param numVertices number of vertex positions
+ * @param threshold how much the list's ACMR may degrade
+ * @param triangleOrder receives numTriangles entries, the index of the
+ *                      triangle that should be placed at each position
+ */
+void OptimizeOverdraw(const unsigned int *indices, unsigned int numTriangles, const Vector3 *positions, unsigned int numVertices, float threshold, unsigned int *triangleOrder);
+
+#endif
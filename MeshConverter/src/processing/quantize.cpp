@@ -0,0 +1,307 @@
+#include "quantize.h"
+
+#include <string.h>
+#include <math.h>
+
+unsigned short FloatToHalf(float value)
+{
+	// Rounds to nearest even. Values too large for a half become infinity,
+	// values too small become denormals or zero
+	const unsigned int halfOverflow = (127 + 16) << 23;
+	const unsigned int floatInfinity = 255 << 23;
+	const unsigned int denormalMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(float));
+	unsigned int sign = (bits >> 16) & 0x8000;
+	bits &= 0x7fffffff;
+
+	unsigned int result;
+	if (bits >= halfOverflow)
+		result = (bits > floatInfinity ? 0x7e00 : 0x7c00);
+	else if (bits < (113 << 23))
+	{
+		// Adding the magic number lines the mantissa up so the hardware
+		// rounds it to the denormal's precision
+		float magic;
+		float scaled;
+		memcpy(&magic, &denormalMagic, sizeof(float));
+		memcpy(&scaled, &bits, sizeof(float));
+		scaled += magic;
+		memcpy(&bits, &scaled, sizeof(float));
+		result = bits - denormalMagic;
+	}
+	else
+	{
+		unsigned int mantissaOdd = (bits >> 13) & 1;
+		bits += ((unsigned int)(15 - 127) << 23) + 0xfff;
+		bits += mantissaOdd;
+		result = bits >> 13;
+	}
+
+	return (unsigned short)(result | sign);
+}
+
+float HalfToFloat(unsigned short value)
+{
+	unsigned int sign = (unsigned int)(value & 0x8000) << 16;
+	unsigned int exponent = (value >> 10) & 0x1f;
+	unsigned int mantissa = value & 0x3ff;
+
+	unsigned int bits;
+	if (exponent == 0)
+	{
+		float result = ldexpf((float)mantissa, -24);
+		return (sign ? -result : result);
+	}
+	else if (exponent == 31)
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	else
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+	float result;
+	memcpy(&result, &bits, sizeof(float));
+	return result;
+}
+
+static unsigned short QuantizeUnorm16(float value, float offset, float scale)
+{
+	if (scale <= 0.0f)
+		return 0;
+	float q = (value - offset) / scale + 0.5f;
+	if (q < 0.0f)
+		return 0;
+	if (q > 65535.0f)
+		return 65535;
+	return (unsigned short)q;
+}
+
+static float SignNotZero(float value)
+{
+	return (value >= 0.0f ? 1.0f : -1.0f);
+}
+
+static Vector3 DecodeOctahedral(float u, float v)
+{
+	Vector3 n(u, v, 1.0f - fabsf(u) - fabsf(v));
+	if (n.z < 0.0f)
+	{
+		float x = n.x;
+		n.x = (1.0f - fabsf(n.y)) * SignNotZero(x);
+		n.y = (1.0f - fabsf(x)) * SignNotZero(n.y);
+	}
+	return Vector3::Normalize(n);
+}
+
+float QuantizePositions(const Vector3 *positions, unsigned int count, QuantizedPositions &result)
+{
+	result.offset = ZERO_VECTOR;
+	result.scale = ZERO_VECTOR;
+	result.values.resize(count * 3);
+	if (count == 0)
+		return 0.0f;
+
+	Vector3 min = positions[0];
+	Vector3 max = positions[0];
+	for (unsigned int i = 1; i < count; ++i)
+	{
+		const Vector3 &p = positions[i];
+		min.x = (p.x < min.x ? p.x : min.x);
+		min.y = (p.y < min.y ? p.y : min.y);
+		min.z = (p.z < min.z ? p.z : min.z);
+		max.x = (p.x > max.x ? p.x : max.x);
+		max.y = (p.y > max.y ? p.y : max.y);
+		max.z = (p.z > max.z ? p.z : max.z);
+	}
+
+	result.offset = min;
+	result.scale = (max - min) / 65535.0f;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		result.values[i * 3 + 0] = QuantizeUnorm16(positions[i].x, result.offset.x, result.scale.x);
+		result.values[i * 3 + 1] = QuantizeUnorm16(positions[i].y, result.offset.y, result.scale.y);
+		result.values[i * 3 + 2] = QuantizeUnorm16(positions[i].z, result.offset.z, result.scale.z);
+	}
+
+	// Measured on the dequantized values, exactly as a reader sees them
+	std::vector<Vector3> decoded(count);
+	DequantizePositions(result, &decoded[0]);
+	float maxError = 0.0f;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		float error = Vector3::Distance(positions[i], decoded[i]);
+		if (error > maxError)
+			maxError = error;
+	}
+	return maxError;
+}
+
+float QuantizeNormals(const Vector3 *normals, unsigned int count, unsigned int bits, QuantizedNormals &result)
+{
+	// Signed mapping around the middle of the range, so the axes (which
+	// are common in modelled normals) are exactly representable
+	const float range = (float)((1 << (bits - 1)) - 1);
+
+	result.bits = bits;
+	result.values.resize(count * 2);
+	if (count == 0)
+		return 0.0f;
+
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		const Vector3 &n = normals[i];
+		float length = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+		if (length == 0.0f)
+		{
+			result.values[i * 2 + 0] = (unsigned short)range;
+			result.values[i * 2 + 1] = (unsigned short)range;
+			continue;
+		}
+
+		float u = n.x / length;
+		float v = n.y / length;
+		if (n.z < 0.0f)
+		{
+			float x = u;
+			u = (1.0f - fabsf(v)) * SignNotZero(x);
+			v = (1.0f - fabsf(x)) * SignNotZero(v);
+		}
+
+		// Rounding each coordinate on its own is not always the closest
+		// grid point once decoded, so try all four around it
+		Vector3 unit = Vector3::Normalize(n);
+		float baseU = floorf(u * range);
+		float baseV = floorf(v * range);
+		float bestDot = -2.0f;
+		for (int j = 0; j < 4; ++j)
+		{
+			float qu = baseU + (j & 1);
+			float qv = baseV + (j >> 1);
+			if (qu > range || qv > range)
+				continue;
+
+			float dot = Vector3::Dot(unit, DecodeOctahedral(qu / range, qv / range));
+			if (dot > bestDot)
+			{
+				bestDot = dot;
+				result.values[i * 2 + 0] = (unsigned short)(qu + range);
+				result.values[i * 2 + 1] = (unsigned short)(qv + range);
+			}
+		}
+	}
+
+	// atan2 of the cross and dot products keeps its precision for the tiny
+	// angles 16 bit normals end up with, where acos of the dot does not
+	std::vector<Vector3> decoded(count);
+	DequantizeNormals(result, &decoded[0]);
+	float maxAngle = 0.0f;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		if (normals[i].x == 0.0f && normals[i].y == 0.0f && normals[i].z == 0.0f)
+			continue;
+		Vector3 unit = Vector3::Normalize(normals[i]);
+		float angle = atan2f(Vector3::Magnitude(Vector3::Cross(unit, decoded[i])), Vector3::Dot(unit, decoded[i]));
+		if (angle > maxAngle)
+			maxAngle = angle;
+	}
+	return maxAngle * (180.0f / 3.14159265f);
+}
+
+float QuantizeTexCoords(const Vector2 *texCoords, unsigned int count, unsigned int encoding, QuantizedTexCoords &result)
+{
+	result.encoding = encoding;
+	result.offset.x = 0.0f;
+	result.offset.y = 0.0f;
+	result.scale.x = 1.0f;
+	result.scale.y = 1.0f;
+	result.values.resize(count * 2);
+	if (count == 0)
+		return 0.0f;
+
+	if (encoding == QUANTIZE_TEXCOORDS_HALF)
+	{
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			result.values[i * 2 + 0] = FloatToHalf(texCoords[i].x);
+			result.values[i * 2 + 1] = FloatToHalf(texCoords[i].y);
+		}
+	}
+	else
+	{
+		Vector2 min = texCoords[0];
+		Vector2 max = texCoords[0];
+		for (unsigned int i = 1; i < count; ++i)
+		{
+			const Vector2 &t = texCoords[i];
+			min.x = (t.x < min.x ? t.x : min.x);
+			min.y = (t.y < min.y ? t.y : min.y);
+			max.x = (t.x > max.x ? t.x : max.x);
+			max.y = (t.y > max.y ? t.y : max.y);
+		}
+
+		result.offset = min;
+		result.scale.x = (max.x - min.x) / 65535.0f;
+		result.scale.y = (max.y - min.y) / 65535.0f;
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			result.values[i * 2 + 0] = QuantizeUnorm16(texCoords[i].x, result.offset.x, result.scale.x);
+			result.values[i * 2 + 1] = QuantizeUnorm16(texCoords[i].y, result.offset.y, result.scale.y);
+		}
+	}
+
+	std::vector<Vector2> decoded(count);
+	DequantizeTexCoords(result, &decoded[0]);
+	float maxError = 0.0f;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		float error = fabsf(texCoords[i].x - decoded[i].x);
+		if (error > maxError)
+			maxError = error;
+		error = fabsf(texCoords[i].y - decoded[i].y);
+		if (error > maxError)
+			maxError = error;
+	}
+	return maxError;
+}
+
+void DequantizePositions(const QuantizedPositions &positions, Vector3 *result)
+{
+	unsigned int count = positions.values.size() / 3;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		result[i].x = positions.offset.x + positions.values[i * 3 + 0] * positions.scale.x;
+		result[i].y = positions.offset.y + positions.values[i * 3 + 1] * positions.scale.y;
+		result[i].z = positions.offset.z + positions.values[i * 3 + 2] * positions.scale.z;
+	}
+}
+
+void DequantizeNormals(const QuantizedNormals &normals, Vector3 *result)
+{
+	const float range = (float)((1 << (normals.bits - 1)) - 1);
+
+	unsigned int count = normals.values.size() / 2;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		float u = (normals.values[i * 2 + 0] - range) / range;
+		float v = (normals.values[i * 2 + 1] - range) / range;
+		result[i] = DecodeOctahedral(u, v);
+	}
+}
+
+void DequantizeTexCoords(const QuantizedTexCoords &texCoords, Vector2 *result)
+{
+	unsigned int count = texCoords.values.size() / 2;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		if (texCoords.encoding == QUANTIZE_TEXCOORDS_HALF)
+		{
+			result[i].x = HalfToFloat(texCoords.values[i * 2 + 0]);
+			result[i].y = HalfToFloat(texCoords.values[i * 2 + 1]);
+		}
+		else
+		{
+			result[i].x = texCoords.offset.x + texCoords.values[i * 2 + 0] * texCoords.scale.x;
+			result[i].y = texCoords.offset.y + texCoords.values[i * 2 + 1] * texCoords.scale.y;
+		}
+	}
+}
@@ -0,0 +1,96 @@
+#ifndef __PROCESSING_QUANTIZE_H_INCLUDED__
+#define __PROCESSING_QUANTIZE_H_INCLUDED__
+
+#include "../geometry/vector3.h"
+#include "../geometry/vector2.h"
+
+#include <vector>
+
+#define QUANTIZE_TEXCOORDS_FLOAT 0
+#define QUANTIZE_TEXCOORDS_HALF 1
+#define QUANTIZE_TEXCOORDS_UNORM16 2
+
+// Which vertex streams get stored in a smaller form, and how
+struct QuantizeProfile
+{
+	bool positions;                              // 16 bits per component, normalized to the bounding box
+	unsigned int normalBits;                     // Bits per octahedral component (8 or 16), 0 keeps floats
+	unsigned int texCoords;                      // One of the QUANTIZE_TEXCOORDS_* encodings
+
+	QuantizeProfile()
+	{
+		positions = false;
+		normalBits = 0;
+		texCoords = QUANTIZE_TEXCOORDS_FLOAT;
+	}
+};
+
+// position = offset + value * scale, per component
+struct QuantizedPositions
+{
+	Vector3 offset;
+	Vector3 scale;
+	std::vector<unsigned short> values;          // 3 per position
+};
+
+struct QuantizedNormals
+{
+	unsigned int bits;
+	std::vector<unsigned short> values;          // 2 octahedral coordinates per normal
+};
+
+// Half floats are stored as is, unorm16 values are mapped with
+// texcoord = offset + value * scale, per component
+struct QuantizedTexCoords
+{
+	unsigned int encoding;
+	Vector2 offset;
+	Vector2 scale;
+	std::vector<unsigned short> values;          // 2 per texcoord
+};
+
+unsigned short FloatToHalf(float value);
+float HalfToFloat(unsigned short value);
+
+/**
+ * Quantizes positions to 16 bits per component over their bounding box
+ * @param positions positions to quantize
+ * @param count number of positions
+ * @param result receives the quantized positions
+ *
+ * @return float largest distance between a position and its dequantized
+ *               value
+ */
+float QuantizePositions(const Vector3 *positions, unsigned int count, QuantizedPositions &result);
+
+/**
+ * Quantizes unit length normals with an octahedral mapping. Each normal
+ * picks whichever of the neighbouring grid points decodes closest to it
+ * @param normals normals to quantize
+ * @param count number of normals
+ * @param bits bits per octahedral coordinate, 8 or 16
+ * @param result receives the quantized normals
+ *
+ * @return float largest angle in degrees between a normal and its
+ *               dequantized value
+ */
+float QuantizeNormals(const Vector3 *normals, unsigned int count, unsigned int bits, QuantizedNormals &result);
+
+/**
+ * Quantizes texture coordinates to half floats, or to 16 bits per
+ * component over their bounding box
+ * @param texCoords texture coordinates to quantize
+ * @param count number of texture coordinates
+ * @param encoding QUANTIZE_TEXCOORDS_HALF or QUANTIZE_TEXCOORDS_UNORM16
+ * @param result receives the quantized texture coordinates
+ *
+ * @return float largest per component difference between a texture
+ *               coordinate and its dequantized value
+ */
+float QuantizeTexCoords(const Vector2 *texCoords, unsigned int count, unsigned int encoding, QuantizedTexCoords &result);
+
+void DequantizePositions(const QuantizedPositions &positions, Vector3 *result);
+void DequantizeNormals(const QuantizedNormals &normals, Vector3 *result);
+void DequantizeTexCoords(const QuantizedTexCoords &texCoords, Vector2 *result);
+
+#endif
@@ -0,0 +1,643 @@
+#include "simplify.h"
+#include "weld.h"
+#include "../util/parallel.h"
+
+#include <math.h>
+#include <string.h>
+#include <float.h>
+#include <algorithm>
+
+// Border planes are weighted up so open edges keep their outline
+#define BORDER_WEIGHT 10.0f
+
+#define NO_ENTRY 0xffffffff
+#define MULTIPLE_ENTRIES 0xfffffffe
+
+enum VertexKind
+{
+	VERTEX_MANIFOLD,                             // Interior vertex, can collapse onto any neighbour
+	VERTEX_BORDER,                               // On an open border, can only collapse along it
+	VERTEX_LOCKED                                // Seams, range boundaries, non-manifold geometry
+};
+
+// Symmetric 4x4 matrix of plane equations, plus the total weight so the
+// error can be turned back into a squared distance
+struct Quadric
+{
+	double a00, a01, a02, a03;
+	double a11, a12, a13;
+	double a22, a23;
+	double a33;
+	double weight;
+};
+
+struct Collapse
+{
+	unsigned int source;
+	unsigned int target;
+	float cost;
+};
+
+static bool CompareCollapses(const Collapse &a, const Collapse &b)
+{
+	return a.cost < b.cost;
+}
+
+static void AddPlane(Quadric &q, const Vector3 &normal, float distance, float weight)
+{
+	double a = normal.x, b = normal.y, c = normal.z, d = distance;
+	q.a00 += weight * a * a;
+	q.a01 += weight * a * b;
+	q.a02 += weight * a * c;
+	q.a03 += weight * a * d;
+	q.a11 += weight * b * b;
+	q.a12 += weight * b * c;
+	q.a13 += weight * b * d;
+	q.a22 += weight * c * c;
+	q.a23 += weight * c * d;
+	q.a33 += weight * d * d;
+	q.weight += weight;
+}
+
+static void AddQuadric(Quadric &q, const Quadric &other)
+{
+	q.a00 += other.a00;
+	q.a01 += other.a01;
+	q.a02 += other.a02;
+	q.a03 += other.a03;
+	q.a11 += other.a11;
+	q.a12 += other.a12;
+	q.a13 += other.a13;
+	q.a22 += other.a22;
+	q.a23 += other.a23;
+	q.a33 += other.a33;
+	q.weight += other.weight;
+}
+
+// Squared distance to the planes in both quadrics, averaged by weight
+static float CollapseError(const Quadric &a, const Quadric &b, const Vector3 &p)
+{
+	double x = p.x, y = p.y, z = p.z;
+	double error = 0.0;
+	const Quadric *quadrics[2] = { &a, &b };
+	double weight = 0.0;
+	for (int i = 0; i < 2; ++i)
+	{
+		const Quadric &q = *quadrics[i];
+		error += q.a00 * x * x + 2.0 * q.a01 * x * y + 2.0 * q.a02 * x * z + 2.0 * q.a03 * x
+		       + q.a11 * y * y + 2.0 * q.a12 * y * z + 2.0 * q.a13 * y
+		       + q.a22 * z * z + 2.0 * q.a23 * z
+		       + q.a33;
+		weight += q.weight;
+	}
+	if (weight <= 0.0)
+		return 0.0f;
+	return (float)(fabs(error) / weight);
+}
+
+// Triangles using each vertex, stored back to back
+static void BuildVertexTriangles(const std::vector<unsigned int> &indices, unsigned int numVertices, std::vector<unsigned int> &start, std::vector<unsigned int> &triangles)
+{
+	start.assign(numVertices + 1, 0);
+	for (unsigned int i = 0; i < indices.size(); ++i)
+		++start[indices[i] + 1];
+	for (unsigned int i = 0; i < numVertices; ++i)
+		start[i + 1] += start[i];
+
+	triangles.resize(indices.size());
+	std::vector<unsigned int> fill(start.begin(), start.end() - 1);
+	for (unsigned int i = 0; i < indices.size(); ++i)
+		triangles[fill[indices[i]]++] = i / 3;
+}
+
+// Number of triangles around a that also use b
+static unsigned int CountEdgeTriangles(const std::vector<unsigned int> &indices, const std::vector<unsigned int> &start, const std::vector<unsigned int> &triangles, unsigned int a, unsigned int b)
+{
+	unsigned int count = 0;
+	for (unsigned int i = start[a]; i < start[a + 1]; ++i)
+	{
+		const unsigned int *triangle = &indices[triangles[i] * 3];
+		if (triangle[0] == b || triangle[1] == b || triangle[2] == b)
+			++count;
+	}
+	return count;
+}
+
+static void ClassifyVertices(const std::vector<unsigned int> &indices, const std::vector<unsigned char> &locked, const std::vector<unsigned int> &start, const std::vector<unsigned int> &triangles, std::vector<unsigned char> &kinds)
+{
+	unsigned int numVertices = locked.size();
+	kinds.resize(numVertices);
+	for (unsigned int v = 0; v < numVertices; ++v)
+	{
+		if (locked[v])
+		{
+			kinds[v] = VERTEX_LOCKED;
+			continue;
+		}
+
+		// Every edge is seen from both of its triangles, so a border
+		// vertex on a simple border sees 2 border edges
+		unsigned int borderEdges = 0;
+		bool manifold = true;
+		for (unsigned int i = start[v]; i < start[v + 1] && manifold; ++i)
+		{
+			const unsigned int *triangle = &indices[triangles[i] * 3];
+			for (int j = 0; j < 3; ++j)
+			{
+				if (triangle[j] == v)
+					continue;
+				unsigned int count = CountEdgeTriangles(indices, start, triangles, v, triangle[j]);
+				if (count == 1)
+					++borderEdges;
+				else if (count > 2)
+					manifold = false;
+			}
+		}
+
+		if (!manifold || (borderEdges != 0 && borderEdges != 2))
+			kinds[v] = VERTEX_LOCKED;
+		else if (borderEdges == 2)
+			kinds[v] = VERTEX_BORDER;
+		else
+			kinds[v] = VERTEX_MANIFOLD;
+	}
+}
+
+static void ComputeQuadrics(const std::vector<unsigned int> &indices, const std::vector<Vector3> &positions, const std::vector<unsigned int> &start, const std::vector<unsigned int> &triangles, std::vector<Quadric> &quadrics)
+{
+	Quadric empty;
+	memset(&empty, 0, sizeof(Quadric));
+	quadrics.assign(positions.size(), empty);
+
+	for (unsigned int i = 0; i < indices.size(); i += 3)
+	{
+		const Vector3 &a = positions[indices[i]];
+		const Vector3 &b = positions[indices[i + 1]];
+		const Vector3 &c = positions[indices[i + 2]];
+		Vector3 normal = Vector3::Cross(b - a, c - a);
+		float length = Vector3::Magnitude(normal);
+		if (length <= FLT_EPSILON)
+			continue;
+		normal /= length;
+		float area = length * 0.5f;
+
+		Quadric plane;
+		memset(&plane, 0, sizeof(Quadric));
+		AddPlane(plane, normal, -Vector3::Dot(normal, a), area);
+		for (int j = 0; j < 3; ++j)
+			AddQuadric(quadrics[indices[i + j]], plane);
+
+		// Planes standing on border edges, perpendicular to the triangle,
+		// keep the border from being pulled inwards
+		for (int j = 0; j < 3; ++j)
+		{
+			unsigned int v0 = indices[i + j];
+			unsigned int v1 = indices[i + (j + 1) % 3];
+			if (CountEdgeTriangles(indices, start, triangles, v0, v1) != 1)
+				continue;
+
+			Vector3 edge = positions[v1] - positions[v0];
+			float edgeLength = Vector3::Magnitude(edge);
+			if (edgeLength <= FLT_EPSILON)
+				continue;
+			Vector3 borderNormal = Vector3::Normalize(Vector3::Cross(edge, normal));
+
+			Quadric border;
+			memset(&border, 0, sizeof(Quadric));
+			AddPlane(border, borderNormal, -Vector3::Dot(borderNormal, positions[v0]), edgeLength * edgeLength * BORDER_WEIGHT);
+			AddQuadric(quadrics[v0], border);
+			AddQuadric(quadrics[v1], border);
+		}
+	}
+}
+
+// Collapsing source onto target must not flip any of the triangles that
+// get stretched, and must not fold the surface onto itself, which is what
+// happens when the two vertices have neighbours in common other than the
+// ones across the edge being collapsed
+static bool IsCollapseValid(const std::vector<unsigned int> &indices, const std::vector<Vector3> &positions, const std::vector<unsigned int> &start, const std::vector<unsigned int> &triangles, unsigned int source, unsigned int target)
+{
+	unsigned int sharedTriangles = 0;
+	for (unsigned int i = start[source]; i < start[source + 1]; ++i)
+	{
+		const unsigned int *triangle = &indices[triangles[i] * 3];
+		if (triangle[0] == target || triangle[1] == target || triangle[2] == target)
+		{
+			++sharedTriangles;
+			continue;
+		}
+
+		Vector3 corners[3];
+		for (int j = 0; j < 3; ++j)
+			corners[j] = positions[triangle[j]];
+		Vector3 before = Vector3::Cross(corners[1] - corners[0], corners[2] - corners[0]);
+		for (int j = 0; j < 3; ++j)
+		{
+			if (triangle[j] == source)
+				corners[j] = positions[target];
+		}
+		Vector3 after = Vector3::Cross(corners[1] - corners[0], corners[2] - corners[0]);
+		if (Vector3::Dot(before, after) <= 0.0f)
+			return false;
+	}
+
+	unsigned int sharedNeighbours = 0;
+	for (unsigned int i = start[source]; i < start[source + 1]; ++i)
+	{
+		const unsigned int *triangle = &indices[triangles[i] * 3];
+		for (int j = 0; j < 3; ++j)
+		{
+			unsigned int neighbour = triangle[j];
+			if (neighbour == source || neighbour == target)
+				continue;
+
+			// Only count every neighbour once, from the first triangle it shows up in
+			bool seen = false;
+			for (unsigned int k = start[source]; k < i && !seen; ++k)
+			{
+				const unsigned int *other = &indices[triangles[k] * 3];
+				seen = (other[0] == neighbour || other[1] == neighbour || other[2] == neighbour);
+			}
+			if (!seen && CountEdgeTriangles(indices, start, triangles, target, neighbour) > 0)
+				++sharedNeighbours;
+		}
+	}
+
+	return sharedNeighbours == sharedTriangles;
+}
+
+// Simplifies a compacted triangle list down to targetTriangles or until
+// nothing more can be collapsed. Returns the largest squared collapse error
+static float SimplifyLocal(std::vector<unsigned int> &indices, const std::vector<Vector3> &positions, const std::vector<unsigned char> &locked, unsigned int targetTriangles)
+{
+	unsigned int numVertices = positions.size();
+	std::vector<unsigned int> start;
+	std::vector<unsigned int> triangles;
+	BuildVertexTriangles(indices, numVertices, start, triangles);
+
+	std::vector<unsigned char> kinds;
+	std::vector<Quadric> quadrics;
+	ClassifyVertices(indices, locked, start, triangles, kinds);
+	ComputeQuadrics(indices, positions, start, triangles, quadrics);
+
+	float maximumError = 0.0f;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> remap(numVertices);
+	std::vector<unsigned char> touched(numVertices);
+
+	// Cheapest collapse of every vertex, only recomputed for vertices whose
+	// surroundings changed in the previous pass
+	std::vector<Collapse> cheapest(numVertices);
+	std::vector<unsigned char> dirty(numVertices, 1);
+
+	while (indices.size() / 3 > targetTriangles)
+	{
+		collapses.clear();
+		for (unsigned int v = 0; v < numVertices; ++v)
+		{
+			Collapse &best = cheapest[v];
+			if (!dirty[v])
+			{
+				if (best.target != NO_ENTRY)
+					collapses.push_back(best);
+				continue;
+			}
+
+			dirty[v] = 0;
+			best.source = v;
+			best.target = NO_ENTRY;
+			best.cost = FLT_MAX;
+			if (kinds[v] == VERTEX_LOCKED)
+				continue;
+
+			for (unsigned int i = start[v]; i < start[v + 1]; ++i)
+			{
+				const unsigned int *triangle = &indices[triangles[i] * 3];
+				for (int j = 0; j < 3; ++j)
+				{
+					unsigned int target = triangle[j];
+					if (target == v)
+						continue;
+					if (kinds[v] == VERTEX_BORDER && (kinds[target] == VERTEX_MANIFOLD || CountEdgeTriangles(indices, start, triangles, v, target) != 1))
+						continue;
+
+					float cost = CollapseError(quadrics[v], quadrics[target], positions[target]);
+					if (cost < best.cost)
+					{
+						best.target = target;
+						best.cost = cost;
+					}
+				}
+			}
+			if (best.target != NO_ENTRY)
+				collapses.push_back(best);
+		}
+		if (collapses.empty())
+			break;
+
+		// Every collapse removes at least one triangle, so only the cheapest
+		// few can possibly be used this pass and only those need sorting
+		unsigned int needed = indices.size() / 3 - targetTriangles;
+		if (collapses.size() > needed)
+		{
+			std::nth_element(collapses.begin(), collapses.begin() + needed, collapses.end(), CompareCollapses);
+			collapses.resize(needed);
+		}
+		std::sort(collapses.begin(), collapses.end(), CompareCollapses);
+
+		// Take collapses cheapest first. Anything around a collapse is off
+		// limits for the rest of the pass, the adjacency it was checked
+		// against is out of date
+		unsigned int removed = 0;
+		bool collapsed = false;
+		for (unsigned int i = 0; i < numVertices; ++i)
+		{
+			remap[i] = i;
+			touched[i] = 0;
+		}
+		for (unsigned int i = 0; i < collapses.size() && removed < needed; ++i)
+		{
+			const Collapse &collapse = collapses[i];
+			if (touched[collapse.source] || touched[collapse.target])
+				continue;
+			if (!IsCollapseValid(indices, positions, start, triangles, collapse.source, collapse.target))
+			{
+				// Stays invalid until something around it changes
+				cheapest[collapse.source].target = NO_ENTRY;
+				continue;
+			}
+
+			remap[collapse.source] = collapse.target;
+			AddQuadric(quadrics[collapse.target], quadrics[collapse.source]);
+			maximumError = std::max(maximumError, collapse.cost);
+			for (unsigned int j = start[collapse.source]; j < start[collapse.source + 1]; ++j)
+			{
+				const unsigned int *triangle = &indices[triangles[j] * 3];
+				for (int k = 0; k < 3; ++k)
+				{
+					touched[triangle[k]] = 1;
+					dirty[triangle[k]] = 1;
+				}
+			}
+			for (unsigned int j = start[collapse.target]; j < start[collapse.target + 1]; ++j)
+			{
+				const unsigned int *triangle = &indices[triangles[j] * 3];
+				for (int k = 0; k < 3; ++k)
+					dirty[triangle[k]] = 1;
+			}
+			removed += (kinds[collapse.source] == VERTEX_BORDER ? 1 : 2);
+			collapsed = true;
+		}
+		if (!collapsed)
+			break;
+
+		unsigned int kept = 0;
+		for (unsigned int i = 0; i < indices.size(); i += 3)
+		{
+			unsigned int a = remap[indices[i]];
+			unsigned int b = remap[indices[i + 1]];
+			unsigned int c = remap[indices[i + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+			indices[kept++] = a;
+			indices[kept++] = b;
+			indices[kept++] = c;
+		}
+		indices.resize(kept);
+		BuildVertexTriangles(indices, numVertices, start, triangles);
+	}
+
+	return maximumError;
+}
+
+static void SimplifyRange(const unsigned int *indices, const TriangleRange &range, const unsigned int *wedgePositions, const Vector3 *positions, const std::vector<unsigned char> &lockedWedges, const float *ratios, unsigned int numLevels, std::vector<std::vector<unsigned int> > &levelIndices, std::vector<float> &levelErrors)
+{
+	unsigned int count = range.end - range.start;
+
+	// Compact the wedges to local ids, the lookup table is sized by the
+	// range rather than by the whole mesh
+	unsigned int tableSize = 1;
+	while (tableSize < count * 6)
+		tableSize <<= 1;
+	std::vector<unsigned int> tableKeys(tableSize, NO_ENTRY);
+	std::vector<unsigned int> tableValues(tableSize);
+
+	std::vector<unsigned int> wedges;
+	std::vector<unsigned int> local(count * 3);
+	for (unsigned int i = 0; i < count * 3; ++i)
+	{
+		unsigned int wedge = indices[range.start * 3 + i];
+		unsigned int bucket = (wedge * 0x9e3779b1u) & (tableSize - 1);
+		while (tableKeys[bucket] != wedge && tableKeys[bucket] != NO_ENTRY)
+			bucket = (bucket + 1) & (tableSize - 1);
+		if (tableKeys[bucket] == NO_ENTRY)
+		{
+			tableKeys[bucket] = wedge;
+			tableValues[bucket] = wedges.size();
+			wedges.push_back(wedge);
+		}
+		local[i] = tableValues[bucket];
+	}
+
+	std::vector<Vector3> localPositions(wedges.size());
+	std::vector<unsigned char> localLocked(wedges.size());
+	for (unsigned int i = 0; i < wedges.size(); ++i)
+	{
+		localPositions[i] = positions[wedgePositions[wedges[i]]];
+		localLocked[i] = lockedWedges[wedges[i]];
+	}
+
+	levelIndices.resize(numLevels);
+	levelErrors.resize(numLevels);
+	for (unsigned int level = 0; level < numLevels; ++level)
+	{
+		unsigned int target = (unsigned int)(count * ratios[level]);
+		float error = SimplifyLocal(local, localPositions, localLocked, target);
+
+		// Errors carry over, a level is never more accurate than the one it
+		// was made from
+		levelErrors[level] = std::max(error, (level > 0 ? levelErrors[level - 1] : 0.0f));
+		levelIndices[level].resize(local.size());
+		for (unsigned int i = 0; i < local.size(); ++i)
+			levelIndices[level][i] = wedges[local[i]];
+	}
+}
+
+unsigned int BuildWedges(const unsigned int *cornerKeys, unsigned int keySize, unsigned int numCorners, unsigned int *cornerWedges, std::vector<unsigned int> &wedgeCorners)
+{
+	unsigned int tableSize = 1;
+	while (tableSize < numCorners * 2)
+		tableSize <<= 1;
+	std::vector<unsigned int> table(tableSize, NO_ENTRY);
+	wedgeCorners.clear();
+
+	for (unsigned int i = 0; i < numCorners; ++i)
+	{
+		const unsigned int *key = &cornerKeys[i * keySize];
+		unsigned int hash = 2166136261u;
+		for (unsigned int j = 0; j < keySize; ++j)
+			hash = (hash ^ key[j]) * 16777619u;
+
+		unsigned int bucket = hash & (tableSize - 1);
+		for (;;)
+		{
+			unsigned int wedge = table[bucket];
+			if (wedge == NO_ENTRY)
+			{
+				table[bucket] = wedgeCorners.size();
+				cornerWedges[i] = wedgeCorners.size();
+				wedgeCorners.push_back(i);
+				break;
+			}
+			if (memcmp(&cornerKeys[wedgeCorners[wedge] * keySize], key, keySize * sizeof(unsigned int)) == 0)
+			{
+				cornerWedges[i] = wedge;
+				break;
+			}
+			bucket = (bucket + 1) & (tableSize - 1);
+		}
+	}
+
+	return wedgeCorners.size();
+}
+
+unsigned int BuildAttributeWedges(const unsigned int *vertices, unsigned int numCorners, const Vector3 *positions, unsigned int numPositions, const float *vertexAttributes,
+	const Vector3 *cornerNormals, const Vector2 *cornerTexCoords, unsigned int *cornerWedges, std::vector<unsigned int> &wedgeCorners,
+	std::vector<unsigned int> &wedgePositions, std::vector<Vector3> &weldedPositions)
+{
+	std::vector<unsigned int> remap(numPositions);
+	unsigned int numWelded = WeldVertices(positions, numPositions, 0.0f, vertexAttributes, (vertexAttributes != NULL ? 1 : 0), remap.data());
+	weldedPositions.assign(positions, positions + numPositions);
+	CompactVertexArray(weldedPositions.data(), numPositions, remap.data());
+	weldedPositions.resize(numWelded);
+
+	// Values are compared bit for bit. Adding 0 turns -0 into 0, which
+	// would otherwise start a seam where there is none
+	const unsigned int keySize = 6;
+	std::vector<unsigned int> keys(numCorners * keySize);
+	for (unsigned int i = 0; i < numCorners; ++i)
+	{
+		float values[5] = { cornerNormals[i].x + 0.0f, cornerNormals[i].y + 0.0f, cornerNormals[i].z + 0.0f, cornerTexCoords[i].x + 0.0f, cornerTexCoords[i].y + 0.0f };
+		unsigned int *key = &keys[i * keySize];
+		key[0] = remap[vertices[i]];
+		memcpy(&key[1], values, sizeof(values));
+	}
+
+	unsigned int numWedges = BuildWedges(keys.data(), keySize, numCorners, cornerWedges, wedgeCorners);
+	wedgePositions.resize(numWedges);
+	for (unsigned int i = 0; i < numWedges; ++i)
+		wedgePositions[i] = keys[wedgeCorners[i] * keySize];
+	return numWedges;
+}
+
+void BuildLodChain(const unsigned int *indices, unsigned int numTriangles, const TriangleRange *ranges, unsigned int numRanges, const unsigned int *wedgePositions, unsigned int numWedges, const Vector3 *positions, unsigned int numPositions, const float *ratios, unsigned int numLevels, LodData &lods)
+{
+	lods.levels.clear();
+	lods.indices.clear();
+	lods.groups.clear();
+	lods.dropped.clear();
+	if (numLevels == 0)
+		return;
+
+	// Positions with more than one wedge are on a seam, positions used by
+	// more than one range are on a material boundary. Wedges at either
+	// stay where they are so the pieces still line up
+	std::vector<unsigned int> positionWedge(numPositions, NO_ENTRY);
+	std::vector<unsigned int> positionRange(numPositions, NO_ENTRY);
+	for (unsigned int i = 0; i < numRanges; ++i)
+	{
+		if (ranges[i].end <= ranges[i].start || ranges[i].end > numTriangles)
+			continue;
+		for (unsigned int j = ranges[i].start * 3; j < ranges[i].end * 3; ++j)
+		{
+			unsigned int wedge = indices[j];
+			unsigned int position = wedgePositions[wedge];
+			if (positionWedge[position] == NO_ENTRY)
+				positionWedge[position] = wedge;
+			else if (positionWedge[position] != wedge)
+				positionWedge[position] = MULTIPLE_ENTRIES;
+			if (positionRange[position] == NO_ENTRY)
+				positionRange[position] = i;
+			else if (positionRange[position] != i)
+				positionRange[position] = MULTIPLE_ENTRIES;
+		}
+	}
+
+	std::vector<unsigned char> lockedWedges(numWedges);
+	for (unsigned int i = 0; i < numWedges; ++i)
+	{
+		unsigned int position = wedgePositions[i];
+		lockedWedges[i] = (positionWedge[position] == MULTIPLE_ENTRIES || positionRange[position] == MULTIPLE_ENTRIES);
+	}
+
+	Vector3 minimum = ZERO_VECTOR;
+	Vector3 maximum = ZERO_VECTOR;
+	for (unsigned int i = 0; i < numPositions; ++i)
+	{
+		if (i == 0)
+		{
+			minimum = maximum = positions[0];
+			continue;
+		}
+		minimum.x = std::min(minimum.x, positions[i].x);
+		minimum.y = std::min(minimum.y, positions[i].y);
+		minimum.z = std::min(minimum.z, positions[i].z);
+		maximum.x = std::max(maximum.x, positions[i].x);
+		maximum.y = std::max(maximum.y, positions[i].y);
+		maximum.z = std::max(maximum.z, positions[i].z);
+	}
+	float extent = Vector3::Distance(minimum, maximum);
+
+	std::vector<std::vector<std::vector<unsigned int> > > rangeLevels(numRanges);
+	std::vector<std::vector<float> > rangeErrors(numRanges);
+	ParallelFor(numRanges, [&](unsigned int i)
+	{
+		const TriangleRange &range = ranges[i];
+		if (range.end > range.start && range.end <= numTriangles)
+			SimplifyRange(indices, range, wedgePositions, positions, lockedWedges, ratios, numLevels, rangeLevels[i], rangeErrors[i]);
+	});
+
+	// Seams and material boundaries can lock so much of a mesh that a level
+	// barely shrinks, which would only be written as a copy of the last one
+	unsigned int previousCount = 0;
+	for (unsigned int i = 0; i < numRanges; ++i)
+	{
+		if (!rangeLevels[i].empty())
+			previousCount += ranges[i].end - ranges[i].start;
+	}
+	for (unsigned int level = 0; level < numLevels; ++level)
+	{
+		LodLevel lod;
+		lod.ratio = ratios[level];
+		lod.error = 0.0f;
+		lod.start = lods.indices.size() / 3;
+		lod.count = 0;
+		unsigned int targetCount = 0;
+		for (unsigned int i = 0; i < numRanges; ++i)
+		{
+			if (rangeLevels[i].empty())
+				continue;
+			lod.count += rangeLevels[i][level].size() / 3;
+			targetCount += (unsigned int)((ranges[i].end - ranges[i].start) * ratios[level]);
+			lod.error = std::max(lod.error, rangeErrors[i][level]);
+		}
+		lod.error = (extent > 0.0f ? sqrtf(lod.error) / extent : 0.0f);
+
+		if (previousCount > targetCount && previousCount - lod.count < (previousCount - targetCount) * LOD_MIN_PROGRESS)
+		{
+			lods.dropped.push_back(lod);
+			continue;
+		}
+
+		for (unsigned int i = 0; i < numRanges; ++i)
+		{
+			if (rangeLevels[i].empty())
+				continue;
+			const std::vector<unsigned int> &levelIndices = rangeLevels[i][level];
+			lods.indices.insert(lods.indices.end(), levelIndices.begin(), levelIndices.end());
+			lods.groups.insert(lods.groups.end(), levelIndices.size() / 3, ranges[i].group);
+		}
+		lods.levels.push_back(lod);
+		previousCount = lod.count;
+	}
+}
@@ -0,0 +1,98 @@
+#ifndef __PROCESSING_SIMPLIFY_H_INCLUDED__
+#define __PROCESSING_SIMPLIFY_H_INCLUDED__
+
+#include "../geometry/vector3.h"
+#include "../geometry/vector2.h"
+#include "trianglerange.h"
+
+#include <vector>
+
+#define LOD_MAX_LEVELS 8
+
+// Fraction of the triangles asked of a level (counting from the level
+// before it) it has to remove, or it is no real improvement and dropped
+#define LOD_MIN_PROGRESS 0.5f
+
+struct LodLevel
+{
+	float ratio;                                 // Requested fraction of the original triangle count
+	float error;                                 // Largest collapse error, relative to the mesh's bounding box diagonal
+	unsigned int start;                          // First triangle of this level in LodData
+	unsigned int count;
+};
+
+struct LodData
+{
+	std::vector<LodLevel> levels;
+	std::vector<unsigned int> indices;           // 3 wedge indices per triangle, level after level
+	std::vector<unsigned int> groups;            // Material or group of every triangle
+	std::vector<LodLevel> dropped;               // Levels left out for falling short, count is what they got down to
+};
+
+/**
+ * Finds the unique combinations of vertex attributes ("wedges") used by
+ * the corners of a triangle list. Corners are described by keySize words
+ * each, the first of which must be the position index. Any other words
+ * (normal indices, texcoord indices, raw attribute bits) only have to
+ * compare equal when the corners share the attribute
+ * @param cornerKeys keySize words per corner
+ * @param keySize number of words describing a corner
+ * @param numCorners number of corners, 3 per triangle
+ * @param cornerWedges receives numCorners entries, the wedge of each corner
+ * @param wedgeCorners receives the first corner using every wedge
+ *
+ * @return unsigned int number of wedges
+ */
+unsigned int BuildWedges(const unsigned int *cornerKeys, unsigned int keySize, unsigned int numCorners, unsigned int *cornerWedges, std::vector<unsigned int> &wedgeCorners);
+
+/**
+ * Finds the wedges of a triangle list by the values of their attributes
+ * rather than by the indices a model happens to store. Positions that are
+ * exact copies of each other count as one point, and corners share a
+ * wedge whenever their normals and texcoords are equal, so only real
+ * attribute seams keep vertices from being collapsed
+ * @param vertices position index of every corner, all below numPositions
+ * @param numCorners number of corners, 3 per triangle
+ * @param positions vertex positions
+ * @param numPositions number of vertex positions
+ * @param vertexAttributes optional value per position that also has to be
+ *                         equal for copies to count as one point (such as
+ *                         a joint index), NULL to only compare positions
+ * @param cornerNormals normal of every corner, zero where there is none
+ * @param cornerTexCoords texcoord of every corner, zero where there is none
+ * @param cornerWedges receives numCorners entries, the wedge of each corner
+ * @param wedgeCorners receives the first corner using every wedge
+ * @param wedgePositions receives the welded position of every wedge
+ * @param weldedPositions receives the welded positions
+ *
+ * @return unsigned int number of wedges
+ */
+unsigned int BuildAttributeWedges(const unsigned int *vertices, unsigned int numCorners, const Vector3 *positions, unsigned int numPositions, const float *vertexAttributes,
+	const Vector3 *cornerNormals, const Vector2 *cornerTexCoords, unsigned int *cornerWedges, std::vector<unsigned int> &wedgeCorners,
+	std::vector<unsigned int> &wedgePositions, std::vector<Vector3> &weldedPositions);
+
+/**
+ * Builds a chain of simplified versions of a triangle list with quadric
+ * error metric edge collapses. Vertices never move, a vertex is collapsed
+ * onto one of its neighbours, so every level indexes the original wedges.
+ * Wedges on attribute seams (positions with more than one wedge) and on
+ * range boundaries are never removed, and open borders can only collapse
+ * along themselves. Ranges are simplified in parallel, each level is made
+ * from the one before it. Levels that remove less than LOD_MIN_PROGRESS of
+ * the triangles asked of them go in lods.dropped instead of lods.levels
+ * @param indices 3 wedge indices per triangle
+ * @param numTriangles number of triangles in the list
+ * @param ranges triangle ranges (materials or groups) to simplify, these
+ *               must not overlap
+ * @param numRanges number of ranges
+ * @param wedgePositions position index of every wedge
+ * @param numWedges number of wedges
+ * @param positions vertex positions
+ * @param numPositions number of vertex positions
+ * @param ratios fraction of each range's triangles to keep, per level
+ * @param numLevels number of levels to build
+ * @param lods receives the levels
+ */
+void BuildLodChain(const unsigned int *indices, unsigned int numTriangles, const TriangleRange *ranges, unsigned int numRanges, const unsigned int *wedgePositions, unsigned int numWedges, const Vector3 *positions, unsigned int numPositions, const float *ratios, unsigned int numLevels, LodData &lods);
+
+#endif
@@ -0,0 +1,453 @@
+#include "tangents.h"
+#include "weld.h"
+#include "../util/parallel.h"
+
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+static_assert(sizeof(CornerTangent) == 16, "Corner tangents must stay 16 bytes");
+
+// Triangles are handed to the worker threads in blocks this big
+#define TANGENT_BLOCK_SIZE 16384
+
+// Texture orientation of a triangle, as MikkTSpace flags it
+#define TANGENT_ORIENT_PRESERVING 1
+#define TANGENT_GROUP_WITH_ANY 2
+
+#define RADIANS_TO_DEGREES 57.29577951308232
+
+struct TriangleFrame
+{
+	Vector3 direction;                           // Texture space s direction, flipped for mirrored triangles
+	unsigned int flags;
+};
+
+static inline bool NotZero(float value)
+{
+	return fabsf(value) > FLT_MIN;
+}
+
+static inline bool NotZero(double value)
+{
+	return fabs(value) > FLT_MIN;
+}
+
+static Vector3 GetPosition(const TangentMesh &mesh, unsigned int corner)
+{
+	unsigned int index = mesh.positionIndices[corner];
+	return (index < mesh.numPositions ? mesh.positions[index] : ZERO_VECTOR);
+}
+
+static Vector2 GetTexCoord(const TangentMesh &mesh, unsigned int corner)
+{
+	unsigned int index = mesh.texCoordIndices[corner];
+	if (index < mesh.numTexCoords)
+		return mesh.texCoords[index];
+	Vector2 none = { 0.0f, 0.0f };
+	return none;
+}
+
+static Vector3 GetNormal(const TangentMesh &mesh, unsigned int corner)
+{
+	unsigned int index = mesh.normalIndices[corner];
+	if (index < mesh.numNormals)
+		return mesh.normals[index];
+
+	unsigned int first = corner - corner % 3;
+	return Vector3::SurfaceNormal(GetPosition(mesh, first), GetPosition(mesh, first + 1), GetPosition(mesh, first + 2));
+}
+
+// Any direction will do where the texcoords don't give one, as long as it
+// is the same every time
+static Vector3 GetAnyTangent(const Vector3 &normal)
+{
+	Vector3 axis = (fabsf(normal.x) < 0.5f ? Vector3(1.0f, 0.0f, 0.0f) : Vector3(0.0f, 1.0f, 0.0f));
+	Vector3 tangent = axis - normal * Vector3::Dot(normal, axis);
+	if (!NotZero(Vector3::SquaredLength(tangent)))
+		return axis;
+	return Vector3::Normalize(tangent);
+}
+
+static TriangleFrame GetTriangleFrame(const TangentMesh &mesh, unsigned int triangle)
+{
+	unsigned int first = triangle * 3;
+	Vector3 p1 = GetPosition(mesh, first);
+	Vector2 t1 = GetTexCoord(mesh, first);
+	Vector3 d1 = GetPosition(mesh, first + 1) - p1;
+	Vector3 d2 = GetPosition(mesh, first + 2) - p1;
+	float t21x = GetTexCoord(mesh, first + 1).x - t1.x;
+	float t21y = GetTexCoord(mesh, first + 1).y - t1.y;
+	float t31x = GetTexCoord(mesh, first + 2).x - t1.x;
+	float t31y = GetTexCoord(mesh, first + 2).y - t1.y;
+
+	TriangleFrame frame;
+	frame.direction = ZERO_VECTOR;
+	frame.flags = TANGENT_GROUP_WITH_ANY;
+
+	float signedArea = t21x * t31y - t21y * t31x;
+	Vector3 s = d1 * t31y - d2 * t21y;
+	Vector3 t = d2 * t21x - d1 * t31x;
+	if (signedArea > 0.0f)
+		frame.flags |= TANGENT_ORIENT_PRESERVING;
+
+	if (NotZero(signedArea))
+	{
+		float area = fabsf(signedArea);
+		float lengthS = Vector3::Magnitude(s);
+		float lengthT = Vector3::Magnitude(t);
+		float sign = (frame.flags & TANGENT_ORIENT_PRESERVING ? 1.0f : -1.0f);
+		if (NotZero(lengthS))
+			frame.direction = s * (sign / lengthS);
+		if (NotZero(lengthS / area) && NotZero(lengthT / area))
+			frame.flags &= ~TANGENT_GROUP_WITH_ANY;
+	}
+	return frame;
+}
+
+// The triangle's direction in the corner's normal plane, weighted by the
+// angle of the triangle at the corner
+static Vector3 GetCornerTerm(const TangentMesh &mesh, unsigned int corner, const TriangleFrame &frame)
+{
+	unsigned int first = corner - corner % 3;
+	Vector3 normal = GetNormal(mesh, corner);
+	Vector3 direction = frame.direction - normal * Vector3::Dot(normal, frame.direction);
+	if (NotZero(Vector3::Magnitude(direction)))
+		direction = Vector3::Normalize(direction);
+
+	Vector3 position = GetPosition(mesh, corner);
+	Vector3 v1 = GetPosition(mesh, first + (corner + 2) % 3) - position;
+	Vector3 v2 = GetPosition(mesh, first + (corner + 1) % 3) - position;
+	v1 -= normal * Vector3::Dot(normal, v1);
+	v2 -= normal * Vector3::Dot(normal, v2);
+	if (NotZero(Vector3::Magnitude(v1)))
+		v1 = Vector3::Normalize(v1);
+	if (NotZero(Vector3::Magnitude(v2)))
+		v2 = Vector3::Normalize(v2);
+
+	float cosine = std::max(-1.0f, std::min(Vector3::Dot(v1, v2), 1.0f));
+	return direction * acosf(cosine);
+}
+
+// Corners that get no orientation from their own triangle take the one
+// their vertex has, preferring preserving like MikkTSpace's grouping
+static bool IsPreserving(unsigned int triangleFlags, unsigned int vertexFlags)
+{
+	if (!(triangleFlags & TANGENT_GROUP_WITH_ANY))
+		return (triangleFlags & TANGENT_ORIENT_PRESERVING) != 0;
+	if (vertexFlags & 1)
+		return true;
+	if (vertexFlags & 2)
+		return false;
+	return (triangleFlags & TANGENT_ORIENT_PRESERVING) != 0;
+}
+
+TangentStats ComputeTangents(const TangentMesh &mesh, std::vector<CornerTangent> &tangents)
+{
+	TangentStats stats;
+	stats.numVertices = 0;
+	stats.numMirrored = 0;
+	stats.numDegenerate = 0;
+
+	unsigned int numTriangles = mesh.numTriangles;
+	unsigned int numCorners = numTriangles * 3;
+	tangents.resize(numCorners);
+	if (numTriangles == 0)
+		return stats;
+
+	// Corners are welded on their exact values, the same as MikkTSpace
+	// finding shared vertices
+	unsigned int numBlocks = (numTriangles + TANGENT_BLOCK_SIZE - 1) / TANGENT_BLOCK_SIZE;
+	std::vector<TriangleFrame> frames(numTriangles);
+	std::vector<Vector3> positions(numCorners);
+	std::vector<float> attributes((size_t)numCorners * WELD_SEAM_ATTRIBUTES);
+	ParallelFor(numBlocks, [&](unsigned int block)
+	{
+		unsigned int end = std::min((block + 1) * TANGENT_BLOCK_SIZE, numTriangles);
+		for (unsigned int i = block * TANGENT_BLOCK_SIZE; i < end; ++i)
+		{
+			frames[i] = GetTriangleFrame(mesh, i);
+			for (unsigned int j = i * 3; j < i * 3 + 3; ++j)
+			{
+				Vector3 normal = GetNormal(mesh, j);
+				Vector2 texCoord = GetTexCoord(mesh, j);
+				float *attribute = &attributes[(size_t)j * WELD_SEAM_ATTRIBUTES];
+				positions[j] = GetPosition(mesh, j);
+				attribute[0] = normal.x;
+				attribute[1] = normal.y;
+				attribute[2] = normal.z;
+				attribute[3] = texCoord.x;
+				attribute[4] = texCoord.y;
+			}
+		}
+	});
+
+	std::vector<unsigned int> vertices(numCorners);
+	stats.numVertices = WeldVertices(positions.data(), numCorners, 0.0f, attributes.data(), WELD_SEAM_ATTRIBUTES, vertices.data());
+
+	std::vector<unsigned char> vertexFlags(stats.numVertices, 0);
+	for (unsigned int i = 0; i < numCorners; ++i)
+	{
+		unsigned int flags = frames[i / 3].flags;
+		if (!(flags & TANGENT_GROUP_WITH_ANY))
+			vertexFlags[vertices[i]] |= (flags & TANGENT_ORIENT_PRESERVING ? 1 : 2);
+	}
+
+	std::vector<Vector3> terms(numCorners);
+	ParallelFor(numBlocks, [&](unsigned int block)
+	{
+		unsigned int end = std::min((block + 1) * TANGENT_BLOCK_SIZE, numTriangles);
+		for (unsigned int i = block * TANGENT_BLOCK_SIZE; i < end; ++i)
+		{
+			for (unsigned int j = i * 3; j < i * 3 + 3; ++j)
+				terms[j] = GetCornerTerm(mesh, j, frames[i]);
+		}
+	});
+
+	// Each vertex has a sum per orientation. Adding the terms up in corner
+	// order keeps the float rounding the same on any number of threads
+	std::vector<unsigned int> groups(numCorners);
+	std::vector<Vector3> sums((size_t)stats.numVertices * 2, ZERO_VECTOR);
+	for (unsigned int i = 0; i < numCorners; ++i)
+	{
+		bool preserving = IsPreserving(frames[i / 3].flags, vertexFlags[vertices[i]]);
+		groups[i] = vertices[i] * 2 + (preserving ? 1 : 0);
+		sums[groups[i]] += terms[i];
+	}
+
+	std::vector<unsigned int> blockDegenerate(numBlocks, 0);
+	ParallelFor(numBlocks, [&](unsigned int block)
+	{
+		unsigned int end = std::min((block + 1) * TANGENT_BLOCK_SIZE, numTriangles) * 3;
+		for (unsigned int i = block * TANGENT_BLOCK_SIZE * 3; i < end; ++i)
+		{
+			CornerTangent &tangent = tangents[i];
+			const Vector3 &sum = sums[groups[i]];
+			if (NotZero(Vector3::Magnitude(sum)))
+				tangent.tangent = Vector3::Normalize(sum);
+			else
+			{
+				tangent.tangent = GetAnyTangent(GetNormal(mesh, i));
+				++blockDegenerate[block];
+			}
+			tangent.sign = (groups[i] & 1 ? 1.0f : -1.0f);
+		}
+	});
+
+	for (unsigned int i = 0; i < numBlocks; ++i)
+		stats.numDegenerate += blockDegenerate[i];
+	for (unsigned int i = 0; i < numCorners; ++i)
+		stats.numMirrored += (tangents[i].sign < 0.0f ? 1 : 0);
+	return stats;
+}
+
+// Exact attribute values of a corner, and the orientation of its group
+// once that is known
+struct ReferenceKey
+{
+	float values[8];
+	int orientation;
+
+	bool operator<(const ReferenceKey &other) const
+	{
+		for (int i = 0; i < 8; ++i)
+		{
+			if (values[i] != other.values[i])
+				return values[i] < other.values[i];
+		}
+		return orientation < other.orientation;
+	}
+};
+
+struct ReferenceVector
+{
+	double x;
+	double y;
+	double z;
+};
+
+static ReferenceVector ToReference(const Vector3 &v)
+{
+	ReferenceVector result = { v.x, v.y, v.z };
+	return result;
+}
+
+static double Dot(const ReferenceVector &a, const ReferenceVector &b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// a + b * scale
+static ReferenceVector AddScaled(const ReferenceVector &a, const ReferenceVector &b, double scale)
+{
+	ReferenceVector result = { a.x + b.x * scale, a.y + b.y * scale, a.z + b.z * scale };
+	return result;
+}
+
+static ReferenceVector NormalizeIfNotZero(const ReferenceVector &v)
+{
+	double length = sqrt(Dot(v, v));
+	if (!NotZero(length))
+		return v;
+	ReferenceVector result = { v.x / length, v.y / length, v.z / length };
+	return result;
+}
+
+void ComputeTangentsReference(const TangentMesh &mesh, std::vector<CornerTangent> &tangents)
+{
+	unsigned int numCorners = mesh.numTriangles * 3;
+	tangents.resize(numCorners);
+
+	std::vector<ReferenceKey> keys(numCorners);
+	std::vector<ReferenceVector> directions(mesh.numTriangles);
+	std::vector<unsigned int> flags(mesh.numTriangles);
+	std::map<ReferenceKey, unsigned int> vertexFlags;
+	for (unsigned int i = 0; i < mesh.numTriangles; ++i)
+	{
+		ReferenceVector p[3];
+		double u[3];
+		double v[3];
+		for (unsigned int j = 0; j < 3; ++j)
+		{
+			unsigned int corner = i * 3 + j;
+			Vector3 position = GetPosition(mesh, corner);
+			Vector3 normal = GetNormal(mesh, corner);
+			Vector2 texCoord = GetTexCoord(mesh, corner);
+			float values[8] = { position.x, position.y, position.z, normal.x, normal.y, normal.z, texCoord.x, texCoord.y };
+			for (int k = 0; k < 8; ++k)
+				keys[corner].values[k] = (values[k] == 0.0f ? 0.0f : values[k]);
+			keys[corner].orientation = 0;
+			p[j] = ToReference(position);
+			u[j] = texCoord.x;
+			v[j] = texCoord.y;
+		}
+
+		ReferenceVector d1 = AddScaled(p[1], p[0], -1.0);
+		ReferenceVector d2 = AddScaled(p[2], p[0], -1.0);
+		double t21x = u[1] - u[0];
+		double t21y = v[1] - v[0];
+		double t31x = u[2] - u[0];
+		double t31y = v[2] - v[0];
+		double signedArea = t21x * t31y - t21y * t31x;
+		ReferenceVector s = { d1.x * t31y - d2.x * t21y, d1.y * t31y - d2.y * t21y, d1.z * t31y - d2.z * t21y };
+		ReferenceVector t = { d2.x * t21x - d1.x * t31x, d2.y * t21x - d1.y * t31x, d2.z * t21x - d1.z * t31x };
+
+		flags[i] = TANGENT_GROUP_WITH_ANY | (signedArea > 0.0 ? TANGENT_ORIENT_PRESERVING : 0);
+		ReferenceVector zero = { 0.0, 0.0, 0.0 };
+		directions[i] = zero;
+		if (NotZero(signedArea))
+		{
+			double lengthS = sqrt(Dot(s, s));
+			double lengthT = sqrt(Dot(t, t));
+			double sign = (signedArea > 0.0 ? 1.0 : -1.0);
+			if (NotZero(lengthS))
+				directions[i] = AddScaled(zero, s, sign / lengthS);
+			if (NotZero(lengthS / fabs(signedArea)) && NotZero(lengthT / fabs(signedArea)))
+				flags[i] &= ~TANGENT_GROUP_WITH_ANY;
+		}
+
+		if (!(flags[i] & TANGENT_GROUP_WITH_ANY))
+		{
+			for (unsigned int j = 0; j < 3; ++j)
+				vertexFlags[keys[i * 3 + j]] |= (flags[i] & TANGENT_ORIENT_PRESERVING ? 1 : 2);
+		}
+	}
+
+	std::map<ReferenceKey, ReferenceVector> sums;
+	for (unsigned int corner = 0; corner < numCorners; ++corner)
+	{
+		unsigned int triangle = corner / 3;
+		std::map<ReferenceKey, unsigned int>::const_iterator found = vertexFlags.find(keys[corner]);
+		keys[corner].orientation = (IsPreserving(flags[triangle], (found != vertexFlags.end() ? found->second : 0)) ? 1 : -1);
+
+		ReferenceVector normal = ToReference(GetNormal(mesh, corner));
+		ReferenceVector direction = NormalizeIfNotZero(AddScaled(directions[triangle], normal, -Dot(normal, directions[triangle])));
+		ReferenceVector position = ToReference(GetPosition(mesh, corner));
+		ReferenceVector v1 = AddScaled(ToReference(GetPosition(mesh, triangle * 3 + (corner + 2) % 3)), position, -1.0);
+		ReferenceVector v2 = AddScaled(ToReference(GetPosition(mesh, triangle * 3 + (corner + 1) % 3)), position, -1.0);
+		v1 = NormalizeIfNotZero(AddScaled(v1, normal, -Dot(normal, v1)));
+		v2 = NormalizeIfNotZero(AddScaled(v2, normal, -Dot(normal, v2)));
+		double angle = acos(std::max(-1.0, std::min(Dot(v1, v2), 1.0)));
+
+		std::map<ReferenceKey, ReferenceVector>::iterator sum = sums.find(keys[corner]);
+		if (sum == sums.end())
+		{
+			ReferenceVector zero = { 0.0, 0.0, 0.0 };
+			sum = sums.insert(std::make_pair(keys[corner], zero)).first;
+		}
+		sum->second = AddScaled(sum->second, direction, angle);
+	}
+
+	for (unsigned int corner = 0; corner < numCorners; ++corner)
+	{
+		ReferenceVector sum = sums[keys[corner]];
+		double length = sqrt(Dot(sum, sum));
+		CornerTangent &tangent = tangents[corner];
+		if (NotZero(length))
+			tangent.tangent = Vector3((float)(sum.x / length), (float)(sum.y / length), (float)(sum.z / length));
+		else
+			tangent.tangent = GetAnyTangent(GetNormal(mesh, corner));
+		tangent.sign = (float)keys[corner].orientation;
+	}
+}
+
+TangentComparison CompareTangents(const CornerTangent *a, const CornerTangent *b, unsigned int count)
+{
+	TangentComparison comparison;
+	comparison.maxAngle = 0.0f;
+	comparison.averageAngle = 0.0f;
+	comparison.signMismatches = 0;
+
+	double total = 0.0;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		// atan2 stays accurate for nearly parallel vectors, where acos of
+		// the dot product would round to 0
+		ReferenceVector first = ToReference(a[i].tangent);
+		ReferenceVector second = ToReference(b[i].tangent);
+		ReferenceVector cross = { first.y * second.z - first.z * second.y, first.z * second.x - first.x * second.z, first.x * second.y - first.y * second.x };
+		double angle = atan2(sqrt(Dot(cross, cross)), Dot(first, second)) * RADIANS_TO_DEGREES;
+		comparison.maxAngle = std::max(comparison.maxAngle, (float)angle);
+		total += angle;
+		if (a[i].sign != b[i].sign)
+			++comparison.signMismatches;
+	}
+	comparison.averageAngle = (count > 0 ? (float)(total / count) : 0.0f);
+	return comparison;
+}
+
+TangentBenchmark BenchmarkTangents(const TangentMesh &mesh)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	TangentBenchmark benchmark;
+	std::vector<CornerTangent> tangents;
+	unsigned int maxThreads = GetNumWorkerThreads();
+	for (unsigned int threads = 1; ; threads *= 2)
+	{
+		threads = std::min(threads, maxThreads);
+		SetMaxWorkerThreads(threads);
+		double best = 0.0;
+		for (int i = 0; i < TANGENT_BENCHMARK_RUNS; ++i)
+		{
+			Clock::time_point start = Clock::now();
+			ComputeTangents(mesh, tangents);
+			double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			best = (i == 0 || elapsed < best ? elapsed : best);
+		}
+		benchmark.threadCounts.push_back(threads);
+		benchmark.times.push_back(best);
+		if (threads == maxThreads)
+			break;
+	}
+	SetMaxWorkerThreads(0);
+
+	std::vector<CornerTangent> reference;
+	Clock::time_point start = Clock::now();
+	ComputeTangentsReference(mesh, reference);
+	benchmark.referenceTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	benchmark.comparison = CompareTangents(tangents.data(), reference.data(), tangents.size());
+	return benchmark;
+}
@@ -0,0 +1,104 @@
+#ifndef __PROCESSING_TANGENTS_H_INCLUDED__
+#define __PROCESSING_TANGENTS_H_INCLUDED__
+
+#include "../geometry/vector3.h"
+#include "../geometry/vector2.h"
+
+#include <vector>
+
+// Times each tangent computation is repeated when benchmarking, the
+// fastest counts
+#define TANGENT_BENCHMARK_RUNS 3
+
+// Triangle corners and the attributes they index, 3 corners per triangle.
+// Corners with an index past the end of an attribute array have no value
+// for it: a missing normal is replaced by the triangle's own normal, a
+// missing texcoord counts as (0, 0)
+struct TangentMesh
+{
+	const unsigned int *positionIndices;
+	const unsigned int *normalIndices;
+	const unsigned int *texCoordIndices;
+	unsigned int numTriangles;
+	const Vector3 *positions;
+	unsigned int numPositions;
+	const Vector3 *normals;
+	unsigned int numNormals;
+	const Vector2 *texCoords;
+	unsigned int numTexCoords;
+};
+
+// 16 bytes, so a TAN chunk can be read straight into a float4 stream.
+// bitangent = sign * cross(normal, tangent)
+struct CornerTangent
+{
+	Vector3 tangent;
+	float sign;                                  // 1 or -1, -1 where the texture is mirrored
+};
+
+struct TangentStats
+{
+	unsigned int numVertices;                    // Distinct position, normal and texcoord combinations
+	unsigned int numMirrored;                    // Corners with a sign of -1
+	unsigned int numDegenerate;                  // Corners whose texcoords gave no direction, given any tangent
+};
+
+struct TangentComparison
+{
+	float maxAngle;                              // Largest angle between matching tangents, in degrees
+	float averageAngle;
+	unsigned int signMismatches;
+};
+
+// Computation times at 1, 2, 4... threads and against the reference
+struct TangentBenchmark
+{
+	std::vector<unsigned int> threadCounts;
+	std::vector<double> times;                   // Milliseconds, fastest of TANGENT_BENCHMARK_RUNS
+	double referenceTime;
+	TangentComparison comparison;
+};
+
+/**
+ * Computes a tangent and bitangent sign for every triangle corner the way
+ * MikkTSpace does by default: each triangle's texture space direction is
+ * projected onto the corner's normal plane, weighted by the corner angle
+ * and summed over all corners that share a position, normal and texcoord
+ * and the same texture orientation. Triangles with degenerate texcoords
+ * take the orientation of the vertex they share. The per corner terms
+ * are computed in parallel, and summed in corner order so the result
+ * doesn't depend on the number of threads
+ * @param mesh corners and attributes
+ * @param tangents receives 3 tangents per triangle, in triangle order
+ *
+ * @return TangentStats vertex and corner counts
+ */
+TangentStats ComputeTangents(const TangentMesh &mesh, std::vector<CornerTangent> &tangents);
+
+/**
+ * Computes the same tangents as ComputeTangents one corner at a time in
+ * double precision, grouping vertices with a map, to check it against
+ * @param mesh corners and attributes
+ * @param tangents receives 3 tangents per triangle, in triangle order
+ */
+void ComputeTangentsReference(const TangentMesh &mesh, std::vector<CornerTangent> &tangents);
+
+/**
+ * @param a first set of tangents
+ * @param b second set of tangents
+ * @param count number of tangents in each set
+ *
+ * @return TangentComparison how far apart the two sets are
+ */
+TangentComparison CompareTangents(const CornerTangent *a, const CornerTangent *b, unsigned int count);
+
+/**
+ * Times ComputeTangents with 1, 2, 4... worker threads up to all of them
+ * and ComputeTangentsReference, and compares their results
+ * @param mesh corners and attributes
+ *
+ * @return TangentBenchmark timings and differences
+ */
+TangentBenchmark BenchmarkTangents(const TangentMesh &mesh);
+
+#endif
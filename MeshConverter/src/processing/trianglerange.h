@@ -0,0 +1,13 @@
+#ifndef __PROCESSING_TRIANGLERANGE_H_INCLUDED__
+#define __PROCESSING_TRIANGLERANGE_H_INCLUDED__
+
+// A run of consecutive triangles belonging to one material or group, the
+// unit the per-group processing passes work on
+struct TriangleRange
+{
+	unsigned int start;                          // First triangle in the range
+	unsigned int end;                            // One past the last triangle
+	unsigned int group;                          // Material or group index
+};
+
+#endif
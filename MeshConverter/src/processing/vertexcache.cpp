@@ -0,0 +1,213 @@
+#include "vertexcache.h"
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+// Scoring constants from Forsyth's "Linear-Speed Vertex Cache Optimisation"
+#define CACHE_DECAY_POWER 1.5f
+#define LAST_TRIANGLE_SCORE 0.75f
+#define VALENCE_BOOST_SCALE 2.0f
+#define VALENCE_BOOST_POWER 0.5f
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int *indices, unsigned int numTriangles, unsigned int numVertices, unsigned int cacheSize)
+{
+	VertexCacheStats stats;
+	stats.acmr = 0.0f;
+	stats.atvr = 0.0f;
+	if (numTriangles == 0 || numVertices == 0)
+		return stats;
+
+	// A vertex is still in the FIFO if fewer than cacheSize misses have
+	// happened since it was last loaded
+	std::vector<unsigned int> loadedAt(numVertices, 0);
+	unsigned int time = cacheSize + 1;
+	unsigned int misses = 0;
+	unsigned int used = 0;
+
+	for (unsigned int i = 0; i < numTriangles * 3; ++i)
+	{
+		unsigned int vertex = indices[i];
+		if (vertex >= numVertices)
+			continue;
+
+		if (loadedAt[vertex] == 0)
+			++used;
+		if (time - loadedAt[vertex] > cacheSize)
+		{
+			loadedAt[vertex] = time;
+			++time;
+			++misses;
+		}
+	}
+
+	stats.acmr = misses / (float)numTriangles;
+	stats.atvr = (used > 0 ? misses / (float)used : 0.0f);
+	return stats;
+}
+
+static float ScoreVertex(int cachePosition, unsigned int remainingTriangles)
+{
+	// Nothing left to draw with this vertex, it shouldn't attract anything
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// The three most recent vertices were used by the last triangle, they get
+		// a fixed score so the next triangle doesn't just reuse the same edge
+		if (cachePosition < 3)
+			score = LAST_TRIANGLE_SCORE;
+		else
+		{
+			float scaler = 1.0f / (VERTEX_CACHE_LRU_SIZE - 3);
+			score = powf(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+		}
+	}
+
+	// Boost vertices with few triangles left so they get finished off
+	// instead of leaving lone triangles behind
+	score += VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -VALENCE_BOOST_POWER);
+	return score;
+}
+
+void OptimizeVertexCache(const unsigned int *indices, unsigned int numTriangles, unsigned int *triangleOrder)
+{
+	if (numTriangles == 0)
+		return;
+
+	unsigned int numIndices = numTriangles * 3;
+
+	// Ranges are usually a small part of a much larger vertex array, so work
+	// on compacted vertex ids to keep the per-vertex state proportional to the
+	// range being optimized
+	std::vector<unsigned int> vertexIds(indices, indices + numIndices);
+	std::sort(vertexIds.begin(), vertexIds.end());
+	vertexIds.erase(std::unique(vertexIds.begin(), vertexIds.end()), vertexIds.end());
+	unsigned int numVertices = vertexIds.size();
+
+	std::vector<unsigned int> localIndices(numIndices);
+	for (unsigned int i = 0; i < numIndices; ++i)
+		localIndices[i] = std::lower_bound(vertexIds.begin(), vertexIds.end(), indices[i]) - vertexIds.begin();
+
+	// Per vertex list of triangles still to be drawn. Emitted triangles are
+	// swapped to the end of each list so remaining[v] is also the list length
+	std::vector<unsigned int> remaining(numVertices, 0);
+	for (unsigned int i = 0; i < numIndices; ++i)
+		++remaining[localIndices[i]];
+
+	std::vector<unsigned int> adjacencyOffsets(numVertices + 1, 0);
+	for (unsigned int i = 0; i < numVertices; ++i)
+		adjacencyOffsets[i + 1] = adjacencyOffsets[i] + remaining[i];
+
+	std::vector<unsigned int> adjacency(numIndices);
+	std::vector<unsigned int> filled(numVertices, 0);
+	for (unsigned int i = 0; i < numIndices; ++i)
+	{
+		unsigned int vertex = localIndices[i];
+		adjacency[adjacencyOffsets[vertex] + filled[vertex]] = i / 3;
+		++filled[vertex];
+	}
+
+	std::vector<float> vertexScores(numVertices);
+	for (unsigned int i = 0; i < numVertices; ++i)
+		vertexScores[i] = ScoreVertex(-1, remaining[i]);
+
+	std::vector<float> triangleScores(numTriangles);
+	for (unsigned int i = 0; i < numTriangles; ++i)
+	{
+		triangleScores[i] = vertexScores[localIndices[i * 3]] +
+			vertexScores[localIndices[i * 3 + 1]] +
+			vertexScores[localIndices[i * 3 + 2]];
+	}
+
+	std::vector<bool> emitted(numTriangles, false);
+	unsigned int cache[VERTEX_CACHE_LRU_SIZE + 3];
+	unsigned int newCache[VERTEX_CACHE_LRU_SIZE + 3];
+	unsigned int cacheCount = 0;
+	unsigned int nextUnemitted = 0;
+	int bestTriangle = -1;
+
+	for (unsigned int i = 0; i < numTriangles; ++i)
+	{
+		// Nothing in the cache connects to an unfinished triangle, carry on
+		// with the next one in the original order
+		if (bestTriangle < 0)
+		{
+			while (emitted[nextUnemitted])
+				++nextUnemitted;
+			bestTriangle = nextUnemitted;
+		}
+
+		triangleOrder[i] = bestTriangle;
+		emitted[bestTriangle] = true;
+
+		const unsigned int *triangle = &localIndices[bestTriangle * 3];
+		unsigned int newCacheCount = 0;
+		for (int j = 0; j < 3; ++j)
+		{
+			unsigned int vertex = triangle[j];
+
+			// Take this triangle out of the vertex's remaining list
+			unsigned int *list = &adjacency[adjacencyOffsets[vertex]];
+			for (unsigned int k = 0; k < remaining[vertex]; ++k)
+			{
+				if (list[k] == (unsigned int)bestTriangle)
+				{
+					std::swap(list[k], list[remaining[vertex] - 1]);
+					break;
+				}
+			}
+			--remaining[vertex];
+
+			newCache[newCacheCount++] = vertex;
+		}
+
+		// Rest of the old cache follows the new triangle's vertices, anything
+		// pushed past the end is evicted
+		for (unsigned int j = 0; j < cacheCount; ++j)
+		{
+			unsigned int vertex = cache[j];
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+				newCache[newCacheCount++] = vertex;
+		}
+		for (unsigned int j = 0; j < newCacheCount; ++j)
+			cache[j] = newCache[j];
+		cacheCount = (newCacheCount > VERTEX_CACHE_LRU_SIZE ? VERTEX_CACHE_LRU_SIZE : newCacheCount);
+
+		// Rescore every vertex whose position changed (including the evicted
+		// ones) and push the difference onto the triangles still using them
+		for (unsigned int j = 0; j < newCacheCount; ++j)
+		{
+			unsigned int vertex = cache[j];
+			int position = (j < VERTEX_CACHE_LRU_SIZE ? (int)j : -1);
+
+			float score = ScoreVertex(position, remaining[vertex]);
+			float delta = score - vertexScores[vertex];
+			vertexScores[vertex] = score;
+
+			const unsigned int *list = &adjacency[adjacencyOffsets[vertex]];
+			for (unsigned int k = 0; k < remaining[vertex]; ++k)
+				triangleScores[list[k]] += delta;
+		}
+
+		// Only triangles touching the cache can have gained score, so the
+		// next pick comes from those
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (unsigned int j = 0; j < cacheCount; ++j)
+		{
+			unsigned int vertex = cache[j];
+			const unsigned int *list = &adjacency[adjacencyOffsets[vertex]];
+			for (unsigned int k = 0; k < remaining[vertex]; ++k)
+			{
+				if (triangleScores[list[k]] > bestScore)
+				{
+					bestScore = triangleScores[list[k]];
+					bestTriangle = list[k];
+				}
+			}
+		}
+	}
+}
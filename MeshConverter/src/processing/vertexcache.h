@@ -0,0 +1,38 @@
+#ifndef __PROCESSING_VERTEXCACHE_H_INCLUDED__
+#define __PROCESSING_VERTEXCACHE_H_INCLUDED__
+
+// Size of the FIFO cache simulated when measuring an index order. 16 entries
+// is a conservative match for most post-transform caches in use
+#define VERTEX_CACHE_FIFO_SIZE 16
+
+// Size of the LRU cache modelled while optimizing
+#define VERTEX_CACHE_LRU_SIZE 32
+
+struct VertexCacheStats
+{
+	float acmr;                                  // Average cache miss ratio, vertex transforms per triangle
+	float atvr;                                  // Average transform to vertex ratio, 1.0 is ideal
+};
+
+/**
+ * Simulates a FIFO post-transform vertex cache over a triangle list
+ * @param indices 3 vertex indices per triangle
+ * @param numTriangles number of triangles in the list
+ * @param numVertices number of vertices the indices refer to
+ * @param cacheSize number of entries in the simulated cache
+ *
+ * @return VertexCacheStats the miss ratios for the given order
+ */
+VertexCacheStats AnalyzeVertexCache(const unsigned int *indices, unsigned int numTriangles, unsigned int numVertices, unsigned int cacheSize = VERTEX_CACHE_FIFO_SIZE);
+
+/**
+ * Computes a triangle order with good post-transform cache reuse using
+ * Tom Forsyth's linear-speed vertex cache optimization
+ * @param indices 3 vertex indices per triangle
+ * @param numTriangles number of triangles in the list
+ * @param triangleOrder receives numTriangles entries, the index of the
+ *                      triangle that should be placed at each position
+ */
+void OptimizeVertexCache(const unsigned int *indices, unsigned int numTriangles, unsigned int *triangleOrder);
+
+#endif
@@ -0,0 +1,75 @@
+#include "vertexfetch.h"
+
+VertexFetchStats AnalyzeVertexFetch(const unsigned int *indices, unsigned int numIndices, unsigned int numVertices, unsigned int vertexSize)
+{
+	VertexFetchStats stats;
+	stats.overfetch = 0.0f;
+	stats.linesPerTriangle = 0.0f;
+	if (numIndices == 0 || numVertices == 0 || vertexSize == 0)
+		return stats;
+
+	// Same timestamp trick as the vertex cache simulation, a line is still
+	// cached if fewer than VERTEX_FETCH_CACHE_LINES misses happened since it
+	// was loaded
+	unsigned int numLines = (unsigned int)(((unsigned long long)numVertices * vertexSize + VERTEX_FETCH_LINE_SIZE - 1) / VERTEX_FETCH_LINE_SIZE);
+	std::vector<unsigned int> loadedAt(numLines, 0);
+	std::vector<bool> referenced(numVertices, false);
+	unsigned int time = VERTEX_FETCH_CACHE_LINES + 1;
+	unsigned long long bytesFetched = 0;
+	unsigned int used = 0;
+
+	for (unsigned int i = 0; i < numIndices; ++i)
+	{
+		unsigned int vertex = indices[i];
+		if (vertex >= numVertices)
+			continue;
+
+		if (!referenced[vertex])
+		{
+			referenced[vertex] = true;
+			++used;
+		}
+
+		unsigned long long start = (unsigned long long)vertex * vertexSize;
+		unsigned int firstLine = (unsigned int)(start / VERTEX_FETCH_LINE_SIZE);
+		unsigned int lastLine = (unsigned int)((start + vertexSize - 1) / VERTEX_FETCH_LINE_SIZE);
+		for (unsigned int line = firstLine; line <= lastLine; ++line)
+		{
+			if (time - loadedAt[line] > VERTEX_FETCH_CACHE_LINES)
+			{
+				loadedAt[line] = time;
+				++time;
+				bytesFetched += VERTEX_FETCH_LINE_SIZE;
+			}
+		}
+	}
+
+	if (used > 0)
+		stats.overfetch = (float)((double)bytesFetched / ((double)used * vertexSize));
+	stats.linesPerTriangle = (float)((double)(bytesFetched / VERTEX_FETCH_LINE_SIZE) / (numIndices / 3.0));
+	return stats;
+}
+
+unsigned int OptimizeVertexFetch(const unsigned int *indices, unsigned int numIndices, unsigned int numVertices, unsigned int *remap)
+{
+	const unsigned int unassigned = (unsigned int)-1;
+	for (unsigned int i = 0; i < numVertices; ++i)
+		remap[i] = unassigned;
+
+	unsigned int next = 0;
+	for (unsigned int i = 0; i < numIndices; ++i)
+	{
+		unsigned int vertex = indices[i];
+		if (vertex < numVertices && remap[vertex] == unassigned)
+			remap[vertex] = next++;
+	}
+	unsigned int used = next;
+
+	for (unsigned int i = 0; i < numVertices; ++i)
+	{
+		if (remap[i] == unassigned)
+			remap[i] = next++;
+	}
+
+	return used;
+}
@@ -0,0 +1,59 @@
+#ifndef __PROCESSING_VERTEXFETCH_H_INCLUDED__
+#define __PROCESSING_VERTEXFETCH_H_INCLUDED__
+
+#include <vector>
+
+// Cache line size and number of lines in the cache simulated when
+// measuring vertex fetch locality
+#define VERTEX_FETCH_LINE_SIZE 64
+#define VERTEX_FETCH_CACHE_LINES 256
+
+struct VertexFetchStats
+{
+	float overfetch;                             // Bytes fetched / bytes of unique vertices referenced, 1.0 is ideal
+	float linesPerTriangle;                      // Memory lines loaded per triangle drawn
+};
+
+/**
+ * Simulates fetching vertex data through a small FIFO cache of
+ * memory lines, in the order the indices reference it
+ * @param indices vertex indices, invalid ones are skipped
+ * @param numIndices number of indices
+ * @param numVertices number of vertices the indices refer to
+ * @param vertexSize size of a single vertex in bytes
+ *
+ * @return VertexFetchStats locality measurements for the given order
+ */
+VertexFetchStats AnalyzeVertexFetch(const unsigned int *indices, unsigned int numIndices, unsigned int numVertices, unsigned int vertexSize);
+
+/**
+ * Builds a vertex renumbering so vertices appear in the order they are
+ * first referenced by the index list. Unreferenced vertices keep their
+ * relative order after all of the referenced ones
+ * @param indices vertex indices, invalid ones are skipped
+ * @param numIndices number of indices
+ * @param numVertices number of vertices the indices refer to
+ * @param remap receives numVertices entries, the new index of each vertex
+ *
+ * @return unsigned int the number of referenced vertices
+ */
+unsigned int OptimizeVertexFetch(const unsigned int *indices, unsigned int numIndices, unsigned int numVertices, unsigned int *remap);
+
+/**
+ * Moves every element of an attribute array to the position given by remap
+ * @param vertices attribute array to reorder in place
+ * @param numVertices number of elements in the array
+ * @param remap new index of each element
+ */
+template <class T>
+void RemapVertexArray(T *vertices, unsigned int numVertices, const unsigned int *remap)
+{
+	if (numVertices == 0)
+		return;
+
+	std::vector<T> original(vertices, vertices + numVertices);
+	for (unsigned int i = 0; i < numVertices; ++i)
+		vertices[remap[i]] = original[i];
+}
+
+#endif
@@ -0,0 +1,253 @@
+#include "weld.h"
+#include "../util/parallel.h"
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+// Vertices and buckets are handed to the worker threads in blocks this big
+#define WELD_BLOCK_SIZE 16384
+
+// Grid coordinates are clamped to this, so far away points with a tiny
+// epsilon can't overflow. They just end up sharing cells
+#define WELD_MAX_CELL 1099511627776.0
+
+struct WeldGrid
+{
+	const Vector3 *positions;
+	const float *attributes;
+	unsigned int numAttributes;
+	float epsilon;
+	float cellScale;                             // 1 / cell size, 0 when cells are exact positions
+	unsigned int bucketMask;
+	std::vector<unsigned int> bucketStarts;      // numBuckets + 1 offsets into entries
+	std::vector<unsigned int> entries;           // Vertex indices, sorted within each bucket
+};
+
+static inline uint32_t HashCell(int64_t x, int64_t y, int64_t z)
+{
+	uint64_t hash = (uint64_t)x * 0x9E3779B97F4A7C15ull;
+	hash ^= (uint64_t)y * 0xC2B2AE3D27D4EB4Full;
+	hash ^= (uint64_t)z * 0x165667B19E3779F9ull;
+	return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static inline int64_t GetCell(float value, float scale)
+{
+	double cell = floor((double)value * scale);
+	return (int64_t)std::max(-WELD_MAX_CELL, std::min(cell, WELD_MAX_CELL));
+}
+
+// Exact cells are the bit patterns of the position, with -0 turned into 0
+// so both land in the same bucket
+static inline int64_t GetExactCell(float value)
+{
+	if (value == 0.0f)
+		value = 0.0f;
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static uint32_t GetBucket(const WeldGrid &grid, const Vector3 &position)
+{
+	if (grid.cellScale == 0.0f)
+		return HashCell(GetExactCell(position.x), GetExactCell(position.y), GetExactCell(position.z)) & grid.bucketMask;
+	return HashCell(GetCell(position.x, grid.cellScale), GetCell(position.y, grid.cellScale), GetCell(position.z, grid.cellScale)) & grid.bucketMask;
+}
+
+static bool Matches(const WeldGrid &grid, unsigned int a, unsigned int b)
+{
+	const Vector3 &p = grid.positions[a];
+	const Vector3 &q = grid.positions[b];
+	if (!(fabsf(p.x - q.x) <= grid.epsilon && fabsf(p.y - q.y) <= grid.epsilon && fabsf(p.z - q.z) <= grid.epsilon))
+		return false;
+
+	if (grid.attributes != NULL)
+	{
+		const float *first = grid.attributes + (size_t)a * grid.numAttributes;
+		const float *second = grid.attributes + (size_t)b * grid.numAttributes;
+		for (unsigned int i = 0; i < grid.numAttributes; ++i)
+		{
+			if (!(fabsf(first[i] - second[i]) <= grid.epsilon))
+				return false;
+		}
+	}
+	return true;
+}
+
+// Entries are sorted, so the first match is the lowest numbered one, and
+// nothing past the best match so far needs looking at
+static void FindInBucket(const WeldGrid &grid, uint32_t bucket, unsigned int vertex, unsigned int &best)
+{
+	unsigned int end = grid.bucketStarts[bucket + 1];
+	for (unsigned int i = grid.bucketStarts[bucket]; i < end; ++i)
+	{
+		unsigned int other = grid.entries[i];
+		if (other >= best)
+			return;
+		if (Matches(grid, vertex, other))
+		{
+			best = other;
+			return;
+		}
+	}
+}
+
+static unsigned int FindFirstMatch(const WeldGrid &grid, unsigned int vertex, uint32_t bucket)
+{
+	unsigned int best = vertex;
+	if (grid.cellScale == 0.0f)
+	{
+		FindInBucket(grid, bucket, vertex, best);
+		return best;
+	}
+
+	// Cells are twice epsilon wide, so along each axis a match is either
+	// in the same cell or in the neighbour on the nearer side
+	const Vector3 &p = grid.positions[vertex];
+	int64_t cell[3];
+	int64_t side[3];
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float value = (&p.x)[axis];
+		cell[axis] = GetCell(value, grid.cellScale);
+		side[axis] = ((double)value * grid.cellScale - (double)cell[axis] < 0.5 ? -1 : 1);
+	}
+
+	for (int i = 0; i < 8; ++i)
+	{
+		int64_t x = cell[0] + ((i & 1) ? side[0] : 0);
+		int64_t y = cell[1] + ((i & 2) ? side[1] : 0);
+		int64_t z = cell[2] + ((i & 4) ? side[2] : 0);
+		FindInBucket(grid, HashCell(x, y, z) & grid.bucketMask, vertex, best);
+	}
+	return best;
+}
+
+unsigned int WeldVertices(const Vector3 *positions, unsigned int numVertices, float epsilon, const float *attributes, unsigned int numAttributes, unsigned int *remap)
+{
+	if (numVertices == 0)
+		return 0;
+
+	WeldGrid grid;
+	grid.positions = positions;
+	grid.attributes = attributes;
+	grid.numAttributes = numAttributes;
+	grid.epsilon = std::max(epsilon, 0.0f);
+	grid.cellScale = (grid.epsilon > 0.0f ? 0.5f / grid.epsilon : 0.0f);
+
+	unsigned int numBuckets = 1;
+	while (numBuckets < numVertices && numBuckets < 0x80000000u)
+		numBuckets *= 2;
+	grid.bucketMask = numBuckets - 1;
+
+	// Buckets are filled with atomic counters, which leaves each bucket in
+	// whatever order the threads got there. Sorting them afterwards makes
+	// the matching below independent of that
+	unsigned int numBlocks = (numVertices + WELD_BLOCK_SIZE - 1) / WELD_BLOCK_SIZE;
+	std::vector<uint32_t> buckets(numVertices);
+	std::vector<std::atomic<unsigned int> > counts(numBuckets);
+	for (unsigned int i = 0; i < numBuckets; ++i)
+		counts[i].store(0, std::memory_order_relaxed);
+	ParallelFor(numBlocks, [&](unsigned int block)
+	{
+		unsigned int end = std::min((block + 1) * WELD_BLOCK_SIZE, numVertices);
+		for (unsigned int i = block * WELD_BLOCK_SIZE; i < end; ++i)
+		{
+			buckets[i] = GetBucket(grid, positions[i]);
+			counts[buckets[i]].fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+
+	grid.bucketStarts.resize(numBuckets + 1);
+	unsigned int offset = 0;
+	for (unsigned int i = 0; i < numBuckets; ++i)
+	{
+		grid.bucketStarts[i] = offset;
+		offset += counts[i].load(std::memory_order_relaxed);
+		counts[i].store(grid.bucketStarts[i], std::memory_order_relaxed);
+	}
+	grid.bucketStarts[numBuckets] = offset;
+
+	grid.entries.resize(numVertices);
+	ParallelFor(numBlocks, [&](unsigned int block)
+	{
+		unsigned int end = std::min((block + 1) * WELD_BLOCK_SIZE, numVertices);
+		for (unsigned int i = block * WELD_BLOCK_SIZE; i < end; ++i)
+			grid.entries[counts[buckets[i]].fetch_add(1, std::memory_order_relaxed)] = i;
+	});
+
+	unsigned int numBucketBlocks = (numBuckets + WELD_BLOCK_SIZE - 1) / WELD_BLOCK_SIZE;
+	ParallelFor(numBucketBlocks, [&](unsigned int block)
+	{
+		unsigned int end = std::min((block + 1) * WELD_BLOCK_SIZE, numBuckets);
+		for (unsigned int i = block * WELD_BLOCK_SIZE; i < end; ++i)
+		{
+			if (grid.bucketStarts[i + 1] - grid.bucketStarts[i] > 1)
+				std::sort(grid.entries.begin() + grid.bucketStarts[i], grid.entries.begin() + grid.bucketStarts[i + 1]);
+		}
+	});
+
+	// Every vertex points at the lowest numbered vertex it matches, which
+	// may itself point further down
+	ParallelFor(numBlocks, [&](unsigned int block)
+	{
+		unsigned int end = std::min((block + 1) * WELD_BLOCK_SIZE, numVertices);
+		for (unsigned int i = block * WELD_BLOCK_SIZE; i < end; ++i)
+			remap[i] = FindFirstMatch(grid, i, buckets[i]);
+	});
+
+	// Matches only ever point down, so following them in order resolves
+	// each vertex to the start of its chain
+	unsigned int numUnique = 0;
+	for (unsigned int i = 0; i < numVertices; ++i)
+		remap[i] = (remap[i] == i ? numUnique++ : remap[remap[i]]);
+	return numUnique;
+}
+
+void GatherSeamAttributes(const unsigned int *vertices, const unsigned int *normals, const unsigned int *texCoords, unsigned int numCorners, const Vector3 *normalValues, unsigned int numNormals,
+	const Vector2 *texCoordValues, unsigned int numTexCoords, unsigned int numVertices, float epsilon, std::vector<float> &attributes)
+{
+	attributes.assign((size_t)numVertices * WELD_SEAM_ATTRIBUTES, 0.0f);
+	std::vector<bool> used(numVertices, false);
+	for (unsigned int i = 0; i < numCorners; ++i)
+	{
+		if (vertices[i] >= numVertices)
+			continue;
+
+		float corner[WELD_SEAM_ATTRIBUTES] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+		if (normals[i] < numNormals)
+		{
+			corner[0] = normalValues[normals[i]].x;
+			corner[1] = normalValues[normals[i]].y;
+			corner[2] = normalValues[normals[i]].z;
+		}
+		if (texCoords[i] < numTexCoords)
+		{
+			corner[3] = texCoordValues[texCoords[i]].x;
+			corner[4] = texCoordValues[texCoords[i]].y;
+		}
+
+		float *vertex = &attributes[(size_t)vertices[i] * WELD_SEAM_ATTRIBUTES];
+		if (!used[vertices[i]])
+		{
+			memcpy(vertex, corner, sizeof(corner));
+			used[vertices[i]] = true;
+			continue;
+		}
+		for (int j = 0; j < WELD_SEAM_ATTRIBUTES; ++j)
+		{
+			// NaN compares false, so a vertex stays marked once it is
+			if (!(fabsf(vertex[j] - corner[j]) <= epsilon))
+			{
+				for (int k = 0; k < WELD_SEAM_ATTRIBUTES; ++k)
+					vertex[k] = NAN;
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef __PROCESSING_WELD_H_INCLUDED__
+#define __PROCESSING_WELD_H_INCLUDED__
+
+#include "../geometry/vector3.h"
+#include "../geometry/vector2.h"
+
+#include <vector>
+
+// Largest distance between positions that still counts as the same point
+// when no tolerance is given. 0 only merges exact copies
+#define WELD_DEFAULT_EPSILON 0.0f
+
+// Values compared per vertex when keeping seams: a normal and a texcoord
+#define WELD_SEAM_ATTRIBUTES 5
+
+/**
+ * Merges vertices whose positions are within epsilon of each other on
+ * every axis, using a spatial hash grid with cells of twice epsilon so
+ * only 8 cells ever need looking at. Hashing, bucketing and matching are
+ * done in parallel blocks, and each vertex is merged into the lowest
+ * numbered vertex it matches, so the result doesn't depend on the number
+ * of threads. Merged vertices keep the position of the first one
+ * @param positions vertex positions
+ * @param numVertices number of vertices
+ * @param epsilon largest difference per axis between merged positions
+ * @param attributes optional numAttributes floats per vertex that also
+ *                   have to be within epsilon for vertices to merge, NULL
+ *                   to only compare positions. NaN never matches, which
+ *                   keeps a vertex apart from all others
+ * @param numAttributes number of attribute floats per vertex
+ * @param remap receives numVertices entries, the new index of each vertex.
+ *              Vertices that are kept are numbered in their original order
+ *
+ * @return unsigned int the number of vertices left
+ */
+unsigned int WeldVertices(const Vector3 *positions, unsigned int numVertices, float epsilon, const float *attributes, unsigned int numAttributes, unsigned int *remap);
+
+/**
+ * Gathers the normal and texcoord each vertex is used with, as
+ * WELD_SEAM_ATTRIBUTES floats per vertex for WeldVertices. Corners
+ * without a normal or texcoord count as zeros. A vertex used with
+ * different values by different corners already sits on a seam, so it
+ * gets NaNs and is left alone
+ * @param vertices position index of each corner
+ * @param normals normal index of each corner
+ * @param texCoords texcoord index of each corner
+ * @param numCorners number of corners, 3 per triangle
+ * @param normalValues normals the indices refer to
+ * @param numNormals number of normals
+ * @param texCoordValues texcoords the indices refer to
+ * @param numTexCoords number of texcoords
+ * @param numVertices number of vertex positions
+ * @param epsilon largest difference that still counts as the same value
+ * @param attributes receives the attributes of every vertex
+ */
+void GatherSeamAttributes(const unsigned int *vertices, const unsigned int *normals, const unsigned int *texCoords, unsigned int numCorners, const Vector3 *normalValues, unsigned int numNormals,
+	const Vector2 *texCoordValues, unsigned int numTexCoords, unsigned int numVertices, float epsilon, std::vector<float> &attributes);
+
+/**
+ * Moves the vertices kept by WeldVertices to their new indices, dropping
+ * the ones merged into them
+ * @param vertices attribute array to compact in place
+ * @param numVertices number of elements in the array before welding
+ * @param remap new index of each element, as given by WeldVertices
+ */
+template <class T>
+void CompactVertexArray(T *vertices, unsigned int numVertices, const unsigned int *remap)
+{
+	// Kept vertices are numbered in order, and never move up the array
+	unsigned int next = 0;
+	for (unsigned int i = 0; i < numVertices; ++i)
+	{
+		if (remap[i] == next)
+			vertices[next++] = vertices[i];
+	}
+}
+
+#endif
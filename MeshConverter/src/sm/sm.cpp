@@ -1,6 +1,89 @@
 #include "sm.h"
 
 #include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <chrono>
+
+#include "../processing/vertexcache.h"
+#include "../processing/vertexfetch.h"
+#include "../processing/overdraw.h"
+#include "../processing/meshlets.h"
+#include "../processing/simplify.h"
+#include "../mesh/meshwriter.h"
+#include "../util/memoryreader.h"
+#include "../util/profiler.h"
+
+// Bytes each element takes up in an SM file, a material at least its four
+// colors and the terminator of its texture name
+#define SM_MIN_MATERIAL_SIZE 17
+#define SM_POLYGON_SIZE 44
+#define SM_VECTOR3_SIZE 12
+#define SM_VECTOR2_SIZE 8
+
+static void WritePolygon(FILE *fp, const SmPolygon *triangle)
+{
+	long data;
+
+	data = triangle->vertices[0];
+	fwrite(&data, sizeof(long), 1, fp);
+	data = triangle->vertices[1];
+	fwrite(&data, sizeof(long), 1, fp);
+	data = triangle->vertices[2];
+	fwrite(&data, sizeof(long), 1, fp);
+
+	data = triangle->normals[0];
+	fwrite(&data, sizeof(long), 1, fp);
+	data = triangle->normals[1];
+	fwrite(&data, sizeof(long), 1, fp);
+	data = triangle->normals[2];
+	fwrite(&data, sizeof(long), 1, fp);
+
+	data = triangle->texcoords[0];
+	fwrite(&data, sizeof(long), 1, fp);
+	data = triangle->texcoords[1];
+	fwrite(&data, sizeof(long), 1, fp);
+	data = triangle->texcoords[2];
+	fwrite(&data, sizeof(long), 1, fp);
+
+	data = triangle->material;
+	fwrite(&data, sizeof(long), 1, fp);
+}
+
+static long GetPolygonSize(const IndexLayout *layout)
+{
+	if (layout == NULL)
+		return (sizeof(long) * 3) * 3 + sizeof(long);
+	return (layout->indexSize * 3) * 3 + sizeof(long);
+}
+
+static void WritePolygons(FILE *fp, const SmPolygon *triangles, long numTriangles, const IndexLayout *layout)
+{
+	if (layout == NULL)
+	{
+		for (long i = 0; i < numTriangles; ++i)
+			WritePolygon(fp, &triangles[i]);
+		return;
+	}
+
+	for (unsigned int i = 0; i < layout->batches.size(); ++i)
+	{
+		const IndexBatch *batch = &layout->batches[i];
+		for (unsigned int j = batch->firstTriangle; j < batch->firstTriangle + batch->numTriangles; ++j)
+		{
+			const SmPolygon *triangle = &triangles[j];
+			for (int k = 0; k < 3; ++k)
+				WriteIndex(fp, triangle->vertices[k], batch->base[0], layout->indexSize);
+			for (int k = 0; k < 3; ++k)
+				WriteIndex(fp, triangle->normals[k], batch->base[1], layout->indexSize);
+			for (int k = 0; k < 3; ++k)
+				WriteIndex(fp, triangle->texcoords[k], batch->base[2], layout->indexSize);
+
+			long data = triangle->material;
+			fwrite(&data, sizeof(long), 1, fp);
+		}
+	}
+}
 
 StaticModel::StaticModel()
 {
@@ -28,9 +111,8 @@ void StaticModel::Release()
 	delete[] m_normals;
 }
 
-bool StaticModel::Load(const std::string &file)
+bool StaticModel::Load(const void *data, size_t size)
 {
-	FILE *fp;
 	unsigned short numMaterials;
 	unsigned int numPolys, numVertices, numNormals, numTexCoords;
 	unsigned int ambient, diffuse, specular, emission;
@@ -42,20 +124,25 @@ bool StaticModel::Load(const std::string &file)
 	unsigned char c;
 	std::string texture;
 
-	fp = fopen(file.c_str(), "rb");
-	if (!fp)
-		return false;
+	MemoryReader input(data, size);
 
 	// Simple file type validation
-	fread(&header[0], 2, 1, fp);
+	input.Read(&header[0], 2, 1);
 	if (header[0] != 'S' || header[1] != 'M')
 		return false;
 
-	fread(&numMaterials, 2, 1, fp);
-	fread(&numPolys, 4, 1, fp);
-	fread(&numVertices, 4, 1, fp);
-	fread(&numNormals, 4, 1, fp);
-	fread(&numTexCoords, 4, 1, fp);
+	input.Read(&numMaterials, 2, 1);
+	input.Read(&numPolys, 4, 1);
+	input.Read(&numVertices, 4, 1);
+	input.Read(&numNormals, 4, 1);
+	input.Read(&numTexCoords, 4, 1);
+
+	// Counts the rest of the file is too short to hold are rejected before
+	// anything is allocated for them
+	unsigned long long needed = (unsigned long long)numMaterials * SM_MIN_MATERIAL_SIZE + (unsigned long long)numPolys * SM_POLYGON_SIZE
+		+ ((unsigned long long)numVertices + numNormals) * SM_VECTOR3_SIZE + (unsigned long long)numTexCoords * SM_VECTOR2_SIZE;
+	if (needed > SIZE_MAX || !input.HasRoomFor(1, (size_t)needed))
+		return false;
 
 	m_materials = new SmMaterial[numMaterials];
 	m_polygons = new SmPolygon[numPolys];
@@ -78,10 +165,10 @@ bool StaticModel::Load(const std::string &file)
 	// Read in material definitions
 	for (int i = 0; i < m_numMaterials; ++i)
 	{
-		fread(&ambient, 4, 1, fp);
-		fread(&diffuse, 4, 1, fp);
-		fread(&specular, 4, 1, fp);
-		fread(&emission, 4, 1, fp);
+		input.Read(&ambient, 4, 1);
+		input.Read(&diffuse, 4, 1);
+		input.Read(&specular, 4, 1);
+		input.Read(&emission, 4, 1);
 
 		m_materials[i].material->SetAmbient(ambient);
 		m_materials[i].material->SetDiffuse(diffuse);
@@ -93,7 +180,7 @@ bool StaticModel::Load(const std::string &file)
 		texture = "";
 		do
 		{
-			fread(&c, 1, 1, fp);
+			input.Read(&c, 1, 1);
 			if (c)
 				texture += c;
 		} while (c != '\0');
@@ -107,33 +194,35 @@ bool StaticModel::Load(const std::string &file)
 		// Vertices
 		for (int j = 0; j < 3; ++j)
 		{
-			fread(&n, 4, 1, fp);
+			input.Read(&n, 4, 1);
 			m_polygons[i].vertices[j] = n;
 		}
 
 		// Normals
 		for (int j = 0; j < 3; ++j)
 		{
-			fread(&n, 4, 1, fp);
+			input.Read(&n, 4, 1);
 			m_polygons[i].normals[j] = n;
 		}
 
 		// TexCoords
 		for (int j = 0; j < 3; ++j)
 		{
-			fread(&n, 4, 1, fp);
+			input.Read(&n, 4, 1);
 			m_polygons[i].texcoords[j] = n;
 		}
 		
 		// Vertex colors
 		for (int j = 0; j < 3; ++j)
 		{
-			fread(&n, 2, 1, fp);
+			input.Read(&n, 2, 1);
 			m_polygons[i].colors[j] = n;
 		}
 
 		// Material index
-		fread(&m_polygons[i].material, 2, 1, fp);
+		input.Read(&m_polygons[i].material, 2, 1);
+		if (m_polygons[i].material < 0 || m_polygons[i].material >= m_numMaterials)
+			return false;
 
 		// Record start/end indices for the different materials
 		// This way rendering can be done per material while still only looping
@@ -154,14 +243,15 @@ bool StaticModel::Load(const std::string &file)
 	}
 
 	// Will always include the last polygon due to the way the .SM exporter sorts
-	m_materials[currentMaterial].polyEnd = numPolys;
+	if (currentMaterial > NO_MATERIAL)
+		m_materials[currentMaterial].polyEnd = numPolys;
 
 	// Vertices
 	for (unsigned int i = 0; i < m_numVertices; ++i)
 	{
-		fread(&x, 4, 1, fp);
-		fread(&y, 4, 1, fp);
-		fread(&z, 4, 1, fp);
+		input.Read(&x, 4, 1);
+		input.Read(&y, 4, 1);
+		input.Read(&z, 4, 1);
 
 		m_vertices[i].x = x / 2;
 		m_vertices[i].y = y / 2;
@@ -171,9 +261,9 @@ bool StaticModel::Load(const std::string &file)
 	// Normals
 	for (unsigned int i = 0; i < m_numNormals; ++i)
 	{
-		fread(&x, 4, 1, fp);
-		fread(&y, 4, 1, fp);
-		fread(&z, 4, 1, fp);
+		input.Read(&x, 4, 1);
+		input.Read(&y, 4, 1);
+		input.Read(&z, 4, 1);
 		//ASSERT(!((x >= 1.0f || x <= -1.0f) ||
 		//	(y >= 1.0f || y <= -1.0f) ||
 		//	(z >= 1.0f || z <= -1.0f)));
@@ -188,8 +278,8 @@ bool StaticModel::Load(const std::string &file)
 	// Texture coordinates
 	for (unsigned int i = 0; i < m_numTexCoords; ++i)
 	{
-		fread(&x, 4, 1, fp);
-		fread(&y, 4, 1, fp);
+		input.Read(&x, 4, 1);
+		input.Read(&y, 4, 1);
 		//ASSERT(!((x >= 2048.0f || x <= -2048.0f) ||
 		//	(y >= 2048.0f || y <= -2048.0f)));
 
@@ -202,61 +292,44 @@ bool StaticModel::Load(const std::string &file)
 			m_hasTexCoords = true;
 	}
 
-	fclose(fp);
-
 	return true;
 }
 
-bool StaticModel::ConvertToMesh(const std::string &file)
+bool StaticModel::ConvertToMesh(FILE *fp, const ConvertOptions &options)
 {
-	FILE *fp = fopen(file.c_str(), "wb");
-	if (fp == NULL)
-		return false;
-
-	fputs("MESH", fp);
-	unsigned char version = 1;
-	fwrite(&version, 1, 1, fp);
-
-	// vertices chunk
-	fputs("VTX", fp);
-	long numVertices = m_numVertices;
-	long sizeofVertices = (sizeof(float) * 3) * numVertices + sizeof(long);
-	fwrite(&sizeofVertices, sizeof(long), 1, fp);
-	fwrite(&numVertices, sizeof(long), 1, fp);
-	for (long i = 0; i < numVertices; ++i)
+	if (options.weldVertices)
+		WeldVertexPositions(options.weldEpsilon, options.weldKeepSeams);
+	if (options.generateNormals)
+		GenerateSmoothNormals(options.creaseAngle, options.areaWeightedNormals);
+	if (options.optimizeVertexCache)
+		ReorderForVertexCache();
+	if (options.optimizeOverdraw)
+		ReorderForOverdraw(options.overdrawThreshold);
+	if (options.buildMeshlets)
+		SplitIntoMeshlets();
+	if (options.lodRatios.size() > 0)
+		BuildLevelsOfDetail(options.lodRatios);
+	if (options.optimizeVertexFetch)
+		ReorderForVertexFetch();
+
+	WriteMeshHeader(fp, options.compactIndices);
+
+	// bounds chunk, first so a loader can cull before reading anything else
+	if (options.computeBounds)
 	{
-		const Vector3 *vector = &m_vertices[i];
-		fwrite(&vector->x, sizeof(float), 1, fp);
-		fwrite(&vector->y, sizeof(float), 1, fp);
-		fwrite(&vector->z, sizeof(float), 1, fp);
+		MeshBounds bounds;
+		ComputeBoundingVolumes(bounds);
+		WriteBoundsChunk(fp, bounds);
 	}
 
+	// vertices chunk
+	WritePositionChunk(fp, m_vertices, m_numVertices, options.quantize);
+
 	// normals chunk
-	fputs("NRL", fp);
-	long numNormals = m_numNormals;
-	long sizeofNormals = (sizeof(float) * 3) * numNormals + sizeof(long);
-	fwrite(&sizeofNormals, sizeof(long), 1, fp);
-	fwrite(&numNormals, sizeof(long), 1, fp);
-	for (long i = 0; i < numNormals; ++i)
-	{
-		const Vector3 *normal = &m_normals[i];
-		fwrite(&normal->x, sizeof(float), 1, fp);
-		fwrite(&normal->y, sizeof(float), 1, fp);
-		fwrite(&normal->z, sizeof(float), 1, fp);
-	}
+	WriteNormalChunk(fp, m_normals, m_numNormals, options.quantize);
 
 	// texture coordinates chunk
-	fputs("TXT", fp);
-	long numTexCoords = m_numTexCoords;
-	long sizeofTexCoords = (sizeof(float) * 2) * numTexCoords + sizeof(long);
-	fwrite(&sizeofTexCoords, sizeof(long), 1, fp);
-	fwrite(&numTexCoords, sizeof(long), 1, fp);
-	for (long i = 0; i < numTexCoords; ++i)
-	{
-		const Vector2 *texCoord = &m_texCoords[i];
-		fwrite(&texCoord->x, sizeof(float), 1, fp);
-		fwrite(&texCoord->y, sizeof(float), 1, fp);
-	}
+	WriteTexCoordChunk(fp, m_texCoords, m_numTexCoords, options.quantize);
 
 	// materials chunk
 	fputs("MTL", fp);
@@ -279,41 +352,521 @@ bool StaticModel::ConvertToMesh(const std::string &file)
 	}
 
 	// triangles chunk
+	IndexLayout layout;
+	const IndexLayout *indexLayout = NULL;
+	if (options.compactIndices)
+	{
+		BuildPolygonIndexLayout(m_polygons, m_numPolygons, options.splitIndices, layout);
+		PrintIndexLayout("TRI", layout, m_numPolygons * 9, sizeof(long));
+		indexLayout = &layout;
+	}
 	fputs("TRI", fp);
 	long numPolys = m_numPolygons;
-	long sizeofPolys = ((sizeof(long) * 3) * 3 + sizeof(long)) * numPolys + sizeof(long);
+	long sizeofPolys = GetPolygonSize(indexLayout) * numPolys + GetTriangleListHeaderSize(indexLayout);
 	fwrite(&sizeofPolys, sizeof(long), 1, fp);
-	fwrite(&numPolys, sizeof(long), 1, fp);
-	for (long i = 0; i < numPolys; ++i)
-	{
-		const SmPolygon *triangle = &m_polygons[i];
-		long data;
-
-		data = triangle->vertices[0];
-		fwrite(&data, sizeof(long), 1, fp);
-		data = triangle->vertices[1];
-		fwrite(&data, sizeof(long), 1, fp);
-		data = triangle->vertices[2];
-		fwrite(&data, sizeof(long), 1, fp);
-
-		data = triangle->normals[0];
-		fwrite(&data, sizeof(long), 1, fp);
-		data = triangle->normals[1];
-		fwrite(&data, sizeof(long), 1, fp);
-		data = triangle->normals[2];
-		fwrite(&data, sizeof(long), 1, fp);
-
-		data = triangle->texcoords[0];
-		fwrite(&data, sizeof(long), 1, fp);
-		data = triangle->texcoords[1];
-		fwrite(&data, sizeof(long), 1, fp);
-		data = triangle->texcoords[2];
-		fwrite(&data, sizeof(long), 1, fp);
-
-		data = triangle->material;
-		fwrite(&data, sizeof(long), 1, fp);
-	}
-
-	fclose(fp);
-	return true;
+	WriteTriangleListHeader(fp, numPolys, indexLayout);
+	WritePolygons(fp, m_polygons, numPolys, indexLayout);
+
+	// tangents chunk, per corner of the triangles written above
+	if (options.computeTangents)
+	{
+		std::vector<CornerTangent> tangents;
+		ComputeCornerTangents(options.benchmarkTangents, tangents);
+		WriteTangentChunk(fp, tangents);
+	}
+
+	// bounding volume hierarchy chunk, over the triangles as written above
+	if (options.buildBvh)
+	{
+		BvhData bvh;
+		BuildBoundingVolumeHierarchy(options.benchmarkBvh, bvh);
+		WriteBvhChunk(fp, bvh);
+	}
+
+	if (m_meshlets.meshlets.size() > 0)
+		WriteMeshletChunk(fp, m_meshlets);
+
+	// levels of detail chunk, the triangles are laid out like TRI's
+	if (m_lodLevels.size() > 0)
+	{
+		long numLodPolys = m_lodPolygons.size();
+		IndexLayout lodLayout;
+		const IndexLayout *lodIndexLayout = NULL;
+		if (options.compactIndices)
+		{
+			BuildPolygonIndexLayout(m_lodPolygons.data(), numLodPolys, options.splitIndices, lodLayout);
+			PrintIndexLayout("LOD", lodLayout, numLodPolys * 9, sizeof(long));
+			lodIndexLayout = &lodLayout;
+		}
+		WriteLodChunkHeader(fp, m_lodLevels, numLodPolys, GetPolygonSize(lodIndexLayout), lodIndexLayout);
+		WritePolygons(fp, m_lodPolygons.data(), numLodPolys, lodIndexLayout);
+	}
+
+	return (ferror(fp) == 0);
+}
+
+void StaticModel::BuildPolygonIndexLayout(const SmPolygon *triangles, unsigned int numTriangles, bool split, IndexLayout &layout)
+{
+	std::vector<unsigned int> indices(numTriangles * 9);
+	for (unsigned int i = 0; i < numTriangles; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			indices[i * 9 + j] = triangles[i].vertices[j];
+			indices[i * 9 + 3 + j] = triangles[i].normals[j];
+			indices[i * 9 + 6 + j] = triangles[i].texcoords[j];
+		}
+	}
+
+	unsigned int streamSizes[3] = { m_numVertices, m_numNormals, m_numTexCoords };
+	BuildIndexLayout(indices.data(), numTriangles, 3, streamSizes, split, layout);
+}
+
+void StaticModel::WeldVertexPositions(float epsilon, bool keepSeams)
+{
+	ProfileScope scope(PROFILE_STAGE_WELD, m_numVertices);
+	if (m_numVertices == 0)
+		return;
+
+	std::vector<unsigned int> vertices(m_numPolygons * 3);
+	std::vector<unsigned int> normals(m_numPolygons * 3);
+	std::vector<unsigned int> texCoords(m_numPolygons * 3);
+	for (unsigned int i = 0; i < m_numPolygons; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			vertices[i * 3 + j] = m_polygons[i].vertices[j];
+			normals[i * 3 + j] = m_polygons[i].normals[j];
+			texCoords[i * 3 + j] = m_polygons[i].texcoords[j];
+		}
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::vector<float> attributes;
+	if (keepSeams)
+		GatherSeamAttributes(vertices.data(), normals.data(), texCoords.data(), vertices.size(), m_normals, m_numNormals, m_texCoords, m_numTexCoords, m_numVertices, epsilon, attributes);
+	std::vector<unsigned int> remap(m_numVertices);
+	unsigned int numWelded = WeldVertices(m_vertices, m_numVertices, epsilon, (keepSeams ? attributes.data() : NULL), WELD_SEAM_ATTRIBUTES, remap.data());
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	CompactVertexArray(m_vertices, m_numVertices, remap.data());
+	for (unsigned int i = 0; i < m_numPolygons; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			if (m_polygons[i].vertices[j] < m_numVertices)
+				m_polygons[i].vertices[j] = remap[m_polygons[i].vertices[j]];
+		}
+	}
+
+	unsigned int removed = m_numVertices - numWelded;
+	printf("Welded %u -> %u vertices (%u removed, %.1f%%) in %.2f ms (%.2f ms per million vertices)\n", m_numVertices, numWelded, removed, removed * 100.0f / m_numVertices, elapsed, elapsed * 1000000.0 / m_numVertices);
+	m_numVertices = numWelded;
+}
+
+void StaticModel::GenerateSmoothNormals(float creaseAngle, bool areaWeighted)
+{
+	ProfileScope scope(PROFILE_STAGE_NORMALS, m_numVertices);
+	if (m_hasNormals)
+	{
+		printf("Keeping the normals stored in the model\n");
+		return;
+	}
+
+	std::vector<unsigned int> vertices(m_numPolygons * 3);
+	for (unsigned int i = 0; i < m_numPolygons; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			vertices[i * 3 + j] = m_polygons[i].vertices[j];
+	}
+
+	// SM files have no smoothing groups, only the crease angle splits normals
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::vector<Vector3> normals;
+	std::vector<unsigned int> normalIndices(m_numPolygons * 3);
+	NormalStats stats = GenerateNormals(vertices.data(), m_numPolygons, m_vertices, m_numVertices, NULL, creaseAngle, (areaWeighted ? NORMALS_WEIGHT_AREA : NORMALS_WEIGHT_ANGLE), normals, normalIndices.data());
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	delete[] m_normals;
+	m_numNormals = (unsigned int)normals.size();
+	m_normals = new Vector3[m_numNormals > 0 ? m_numNormals : 1];
+	for (unsigned int i = 0; i < m_numNormals; ++i)
+		m_normals[i] = normals[i];
+	for (unsigned int i = 0; i < m_numPolygons; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			m_polygons[i].normals[j] = normalIndices[i * 3 + j];
+	}
+	m_hasNormals = (m_numNormals > 0);
+
+	printf("Generated %u normals for %u vertices (%u hard corners) in %.2f ms (%.2f Mtris/s)\n", stats.numNormals, stats.numVertices, stats.numHardCorners, elapsed, (elapsed > 0.0 ? m_numPolygons / (elapsed * 1000.0) : 0.0));
+}
+
+void StaticModel::ReorderForVertexCache()
+{
+	ProfileScope scope(PROFILE_STAGE_VERTEX_CACHE, m_numPolygons);
+	if (m_numPolygons == 0 || m_numVertices == 0)
+		return;
+
+	std::vector<unsigned int> indices(m_numPolygons * 3);
+	for (unsigned int i = 0; i < m_numPolygons; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			indices[i * 3 + j] = m_polygons[i].vertices[j];
+	}
+	VertexCacheStats before = AnalyzeVertexCache(&indices[0], m_numPolygons, m_numVertices);
+
+	// Polygons only move around within their own material's range, so the
+	// polyStart/polyEnd values recorded while loading stay valid
+	std::vector<unsigned int> order;
+	std::vector<SmPolygon> reordered;
+	for (int i = 0; i < m_numMaterials; ++i)
+	{
+		unsigned int start = m_materials[i].polyStart;
+		unsigned int end = m_materials[i].polyEnd;
+		if (end <= start || end > m_numPolygons)
+			continue;
+
+		unsigned int count = end - start;
+		order.resize(count);
+		OptimizeVertexCache(&indices[start * 3], count, &order[0]);
+
+		reordered.resize(count);
+		for (unsigned int j = 0; j < count; ++j)
+			reordered[j] = m_polygons[start + order[j]];
+		for (unsigned int j = 0; j < count; ++j)
+		{
+			m_polygons[start + j] = reordered[j];
+			for (int k = 0; k < 3; ++k)
+				indices[(start + j) * 3 + k] = reordered[j].vertices[k];
+		}
+	}
+
+	VertexCacheStats after = AnalyzeVertexCache(&indices[0], m_numPolygons, m_numVertices);
+	printf("Vertex cache ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.acmr, after.acmr, before.atvr, after.atvr);
+}
+
+void StaticModel::ReorderForVertexFetch()
+{
+	ProfileScope scope(PROFILE_STAGE_VERTEX_FETCH, m_numPolygons);
+	if (m_numPolygons == 0)
+		return;
+
+	// Positions, normals and texcoords are indexed separately, so each array
+	// is renumbered in the order its own index stream first uses it
+	std::vector<unsigned int> vertices(m_numPolygons * 3);
+	std::vector<unsigned int> normals(m_numPolygons * 3);
+	std::vector<unsigned int> texCoords(m_numPolygons * 3);
+	for (unsigned int i = 0; i < m_numPolygons; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			vertices[i * 3 + j] = m_polygons[i].vertices[j];
+			normals[i * 3 + j] = m_polygons[i].normals[j];
+			texCoords[i * 3 + j] = m_polygons[i].texcoords[j];
+		}
+	}
+	VertexFetchStats before = AnalyzeVertexFetch(&vertices[0], vertices.size(), m_numVertices, sizeof(Vector3));
+
+	std::vector<unsigned int> vertexRemap(m_numVertices);
+	std::vector<unsigned int> normalRemap(m_numNormals);
+	std::vector<unsigned int> texCoordRemap(m_numTexCoords);
+	OptimizeVertexFetch(&vertices[0], vertices.size(), m_numVertices, vertexRemap.data());
+	OptimizeVertexFetch(&normals[0], normals.size(), m_numNormals, normalRemap.data());
+	OptimizeVertexFetch(&texCoords[0], texCoords.size(), m_numTexCoords, texCoordRemap.data());
+	RemapVertexArray(m_vertices, m_numVertices, vertexRemap.data());
+	RemapVertexArray(m_normals, m_numNormals, normalRemap.data());
+	RemapVertexArray(m_texCoords, m_numTexCoords, texCoordRemap.data());
+
+	for (unsigned int i = 0; i < m_numPolygons; ++i)
+	{
+		SmPolygon *polygon = &m_polygons[i];
+		for (int j = 0; j < 3; ++j)
+		{
+			if (polygon->vertices[j] < m_numVertices)
+				polygon->vertices[j] = vertexRemap[polygon->vertices[j]];
+			if (polygon->normals[j] < m_numNormals)
+				polygon->normals[j] = normalRemap[polygon->normals[j]];
+			if (polygon->texcoords[j] < m_numTexCoords)
+				polygon->texcoords[j] = texCoordRemap[polygon->texcoords[j]];
+			vertices[i * 3 + j] = polygon->vertices[j];
+		}
+	}
+	for (unsigned int i = 0; i < m_meshlets.vertices.size(); ++i)
+		m_meshlets.vertices[i] = vertexRemap[m_meshlets.vertices[i]];
+	for (unsigned int i = 0; i < m_lodPolygons.size(); ++i)
+	{
+		SmPolygon *polygon = &m_lodPolygons[i];
+		for (int j = 0; j < 3; ++j)
+		{
+			polygon->vertices[j] = vertexRemap[polygon->vertices[j]];
+			if (polygon->normals[j] < m_numNormals)
+				polygon->normals[j] = normalRemap[polygon->normals[j]];
+			if (polygon->texcoords[j] < m_numTexCoords)
+				polygon->texcoords[j] = texCoordRemap[polygon->texcoords[j]];
+		}
+	}
+
+	VertexFetchStats after = AnalyzeVertexFetch(&vertices[0], vertices.size(), m_numVertices, sizeof(Vector3));
+	printf("Vertex fetch overfetch %.3f -> %.3f, lines per triangle %.3f -> %.3f\n", before.overfetch, after.overfetch, before.linesPerTriangle, after.linesPerTriangle);
+}
+
+void StaticModel::ReorderForOverdraw(float threshold)
+{
+	ProfileScope scope(PROFILE_STAGE_OVERDRAW, m_numPolygons);
+	if (m_numPolygons == 0 || m_numVertices == 0)
+		return;
+
+	std::vector<unsigned int> indices(m_numPolygons * 3);
+	for (unsigned int i = 0; i < m_numPolygons; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			indices[i * 3 + j] = m_polygons[i].vertices[j];
+	}
+	VertexCacheStats cacheBefore = AnalyzeVertexCache(&indices[0], m_numPolygons, m_numVertices);
+	OverdrawStats overdrawBefore = AnalyzeOverdraw(&indices[0], m_numPolygons, m_vertices, m_numVertices);
+
+	std::vector<unsigned int> order;
+	std::vector<SmPolygon> reordered;
+	for (int i = 0; i < m_numMaterials; ++i)
+	{
+		unsigned int start = m_materials[i].polyStart;
+		unsigned int end = m_materials[i].polyEnd;
+		if (end <= start || end > m_numPolygons)
+			continue;
+
+		unsigned int count = end - start;
+		order.resize(count);
+		OptimizeOverdraw(&indices[start * 3], count, m_vertices, m_numVertices, threshold, &order[0]);
+
+		reordered.resize(count);
+		for (unsigned int j = 0; j < count; ++j)
+			reordered[j] = m_polygons[start + order[j]];
+		for (unsigned int j = 0; j < count; ++j)
+		{
+			m_polygons[start + j] = reordered[j];
+			for (int k = 0; k < 3; ++k)
+				indices[(start + j) * 3 + k] = reordered[j].vertices[k];
+		}
+	}
+
+	VertexCacheStats cacheAfter = AnalyzeVertexCache(&indices[0], m_numPolygons, m_numVertices);
+	OverdrawStats overdrawAfter = AnalyzeOverdraw(&indices[0], m_numPolygons, m_vertices, m_numVertices);
+	printf("Overdraw %.3f -> %.3f, ACMR %.3f -> %.3f\n", overdrawBefore.overdraw, overdrawAfter.overdraw, cacheBefore.acmr, cacheAfter.acmr);
+}
+
+void StaticModel::SplitIntoMeshlets()
+{
+	ProfileScope scope(PROFILE_STAGE_MESHLETS, m_numPolygons);
+	if (m_numPolygons == 0 || m_numVertices == 0)
+		return;
+
+	std::vector<unsigned int> indices(m_numPolygons * 3);
+	for (unsigned int i = 0; i < m_numPolygons; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			indices[i * 3 + j] = m_polygons[i].vertices[j];
+	}
+
+	std::vector<TriangleRange> ranges;
+	for (int i = 0; i < m_numMaterials; ++i)
+	{
+		TriangleRange range;
+		range.start = m_materials[i].polyStart;
+		range.end = m_materials[i].polyEnd;
+		range.group = i;
+		if (range.end > range.start && range.end <= m_numPolygons)
+			ranges.push_back(range);
+	}
+
+	std::vector<unsigned int> order(m_numPolygons);
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	BuildMeshlets(&indices[0], m_numPolygons, ranges.data(), ranges.size(), m_vertices, m_numVertices, m_meshlets, &order[0]);
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// Triangles only move within their material's range
+	std::vector<SmPolygon> original(m_polygons, m_polygons + m_numPolygons);
+	for (unsigned int i = 0; i < m_numPolygons; ++i)
+		m_polygons[i] = original[order[i]];
+
+	MeshletStats stats = AnalyzeMeshlets(m_meshlets);
+	printf("Meshlets %u, %.1f vertices %.1f triangles average, %.0f%% with usable cones, built in %.2f ms (%.2f Mtris/s)\n", stats.numMeshlets, stats.averageVertices, stats.averageTriangles, stats.conesUsable * 100.0f, elapsed, (elapsed > 0.0 ? m_numPolygons / (elapsed * 1000.0) : 0.0));
+}
+
+void StaticModel::BuildLevelsOfDetail(const std::vector<float> &ratios)
+{
+	ProfileScope scope(PROFILE_STAGE_LOD, m_numPolygons);
+	if (m_numPolygons == 0 || m_numVertices == 0)
+		return;
+
+	// Corners with the same position, normal and texcoord values are the
+	// same wedge, even when the file indexes copies of them
+	std::vector<unsigned int> vertices(m_numPolygons * 3);
+	std::vector<Vector3> normals(m_numPolygons * 3);
+	std::vector<Vector2> texCoords(m_numPolygons * 3);
+	Vector2 none = { 0.0f, 0.0f };
+	for (unsigned int i = 0; i < m_numPolygons; ++i)
+	{
+		const SmPolygon *polygon = &m_polygons[i];
+		for (int j = 0; j < 3; ++j)
+		{
+			if (polygon->vertices[j] >= m_numVertices)
+			{
+				printf("Skipping LOD generation, triangles reference missing vertices\n");
+				return;
+			}
+			vertices[i * 3 + j] = polygon->vertices[j];
+			normals[i * 3 + j] = (polygon->normals[j] < m_numNormals ? m_normals[polygon->normals[j]] : ZERO_VECTOR);
+			texCoords[i * 3 + j] = (polygon->texcoords[j] < m_numTexCoords ? m_texCoords[polygon->texcoords[j]] : none);
+		}
+	}
+	std::vector<unsigned int> cornerWedges(m_numPolygons * 3);
+	std::vector<unsigned int> wedgeCorners;
+	std::vector<unsigned int> wedgePositions;
+	std::vector<Vector3> positions;
+	unsigned int numWedges = BuildAttributeWedges(&vertices[0], m_numPolygons * 3, m_vertices, m_numVertices, NULL, &normals[0], &texCoords[0], &cornerWedges[0], wedgeCorners, wedgePositions, positions);
+
+	std::vector<TriangleRange> ranges;
+	for (int i = 0; i < m_numMaterials; ++i)
+	{
+		TriangleRange range;
+		range.start = m_materials[i].polyStart;
+		range.end = m_materials[i].polyEnd;
+		range.group = i;
+		if (range.end > range.start && range.end <= m_numPolygons)
+			ranges.push_back(range);
+	}
+
+	LodData lods;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	BuildLodChain(&cornerWedges[0], m_numPolygons, ranges.data(), ranges.size(), &wedgePositions[0], numWedges, &positions[0], positions.size(), &ratios[0], ratios.size(), lods);
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	m_lodLevels = lods.levels;
+	m_lodPolygons.resize(lods.indices.size() / 3);
+	for (unsigned int i = 0; i < m_lodPolygons.size(); ++i)
+	{
+		SmPolygon *polygon = &m_lodPolygons[i];
+		for (int j = 0; j < 3; ++j)
+		{
+			unsigned int corner = wedgeCorners[lods.indices[i * 3 + j]];
+			const SmPolygon *original = &m_polygons[corner / 3];
+			polygon->vertices[j] = original->vertices[corner % 3];
+			polygon->normals[j] = original->normals[corner % 3];
+			polygon->texcoords[j] = original->texcoords[corner % 3];
+			polygon->colors[j] = original->colors[corner % 3];
+		}
+		polygon->material = lods.groups[i];
+	}
+
+	for (unsigned int i = 0; i < m_lodLevels.size(); ++i)
+		printf("LOD %u: %u of %u triangles (%.1f%%, asked for %.1f%%), error %.5f\n", i + 1, m_lodLevels[i].count, m_numPolygons, m_lodLevels[i].count * 100.0f / m_numPolygons, m_lodLevels[i].ratio * 100.0f, m_lodLevels[i].error);
+	for (unsigned int i = 0; i < lods.dropped.size(); ++i)
+		printf("LOD dropped: only got down to %u of %u triangles (%.1f%%, asked for %.1f%%)\n", lods.dropped[i].count, m_numPolygons, lods.dropped[i].count * 100.0f / m_numPolygons, lods.dropped[i].ratio * 100.0f);
+	printf("LOD chain built in %.2f ms (%.2f Mtris/s)\n", elapsed, (elapsed > 0.0 ? m_numPolygons / (elapsed * 1000.0) : 0.0));
+}
+
+void StaticModel::ComputeBoundingVolumes(MeshBounds &bounds)
+{
+	ProfileScope scope(PROFILE_STAGE_BOUNDS, m_numPolygons);
+	std::vector<unsigned int> indices(m_numPolygons * 3);
+	for (unsigned int i = 0; i < m_numPolygons; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			indices[i * 3 + j] = m_polygons[i].vertices[j];
+	}
+
+	std::vector<TriangleRange> ranges;
+	for (int i = 0; i < m_numMaterials; ++i)
+	{
+		TriangleRange range;
+		range.start = m_materials[i].polyStart;
+		range.end = m_materials[i].polyEnd;
+		range.group = i;
+		if (range.end > range.start && range.end <= m_numPolygons)
+			ranges.push_back(range);
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	ComputeBounds(m_vertices, m_numVertices, bounds.mesh);
+	bounds.groups.resize(m_numMaterials);
+	for (int i = 0; i < m_numMaterials; ++i)
+		ClearBounds(bounds.groups[i]);
+	ComputeRangeBounds(m_vertices, indices.data(), ranges.data(), ranges.size(), bounds.groups.data());
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	printf("Bounds for the mesh and %d materials computed in %.2f ms\n", m_numMaterials, elapsed);
+}
+
+void StaticModel::BuildBoundingVolumeHierarchy(bool benchmark, BvhData &bvh)
+{
+	ProfileScope scope(PROFILE_STAGE_BVH, m_numPolygons);
+	unsigned int numTriangles = m_numPolygons;
+	std::vector<unsigned int> indices(numTriangles * 3);
+	for (unsigned int i = 0; i < numTriangles; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			indices[i * 3 + j] = m_polygons[i].vertices[j];
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	BuildBvh(indices.data(), numTriangles, m_vertices, bvh);
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	BvhStats stats = AnalyzeBvh(bvh);
+	printf("BVH %u nodes, %u leaves, %.1f triangles per leaf, depth %u, SAH cost %.1f, built in %.2f ms (%.2f Mtris/s)\n", stats.numNodes, stats.numLeaves, stats.averageLeafTriangles, stats.maxDepth, stats.cost, elapsed, (elapsed > 0.0 ? numTriangles / (elapsed * 1000.0) : 0.0));
+	if (!benchmark)
+		return;
+
+	BvhBenchmark result = BenchmarkBvh(indices.data(), numTriangles, m_vertices, bvh, BVH_BENCHMARK_RAYS);
+	printf("BVH build times:");
+	for (unsigned int i = 0; i < result.threadCounts.size(); ++i)
+		printf(" %u thread%s %.2f ms%s", result.threadCounts[i], (result.threadCounts[i] > 1 ? "s" : ""), result.buildTimes[i], (i + 1 < result.threadCounts.size() ? "," : "\n"));
+	printf("Ray casts %u rays (%u hits) %.2f Mrays/s, brute force %.4f Mrays/s (%.0fx slower, %u mismatches in %u rays)\n", result.numRays, result.numHits, result.raysPerSecond / 1000000.0,
+		result.bruteForceRaysPerSecond / 1000000.0, (result.bruteForceRaysPerSecond > 0.0 ? result.raysPerSecond / result.bruteForceRaysPerSecond : 0.0), result.mismatches, result.numBruteForceRays);
+}
+
+void StaticModel::ComputeCornerTangents(bool benchmark, std::vector<CornerTangent> &tangents)
+{
+	ProfileScope scope(PROFILE_STAGE_TANGENTS, m_numPolygons);
+	std::vector<unsigned int> vertices(m_numPolygons * 3);
+	std::vector<unsigned int> normals(m_numPolygons * 3);
+	std::vector<unsigned int> texCoords(m_numPolygons * 3);
+	for (unsigned int i = 0; i < m_numPolygons; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			vertices[i * 3 + j] = m_polygons[i].vertices[j];
+			normals[i * 3 + j] = m_polygons[i].normals[j];
+			texCoords[i * 3 + j] = m_polygons[i].texcoords[j];
+		}
+	}
+
+	TangentMesh mesh;
+	mesh.positionIndices = vertices.data();
+	mesh.normalIndices = normals.data();
+	mesh.texCoordIndices = texCoords.data();
+	mesh.numTriangles = m_numPolygons;
+	mesh.positions = m_vertices;
+	mesh.numPositions = m_numVertices;
+	mesh.normals = m_normals;
+	mesh.numNormals = m_numNormals;
+	mesh.texCoords = m_texCoords;
+	mesh.numTexCoords = m_numTexCoords;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	TangentStats stats = ComputeTangents(mesh, tangents);
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	printf("Tangents for %u corners (%u vertices, %u mirrored, %u degenerate) computed in %.2f ms (%.2f Mtris/s)\n", (unsigned int)tangents.size(), stats.numVertices, stats.numMirrored, stats.numDegenerate, elapsed,
+		(elapsed > 0.0 ? mesh.numTriangles / (elapsed * 1000.0) : 0.0));
+	if (!benchmark)
+		return;
+
+	TangentBenchmark result = BenchmarkTangents(mesh);
+	printf("Tangent times:");
+	for (unsigned int i = 0; i < result.threadCounts.size(); ++i)
+		printf(" %u thread%s %.2f ms,", result.threadCounts[i], (result.threadCounts[i] > 1 ? "s" : ""), result.times[i]);
+	printf(" reference %.2f ms\n", result.referenceTime);
+	printf("Tangents against the reference: largest difference %.4f degrees, average %.6f degrees, %u sign mismatches\n", result.comparison.maxAngle, result.comparison.averageAngle, result.comparison.signMismatches);
 }
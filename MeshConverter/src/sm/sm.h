@@ -4,7 +4,18 @@
 #include "../assets/material.h"
 #include "../geometry/vector3.h"
 #include "../geometry/vector2.h"
+#include "../convert/options.h"
+#include "../processing/meshlets.h"
+#include "../processing/simplify.h"
+#include "../processing/indexlayout.h"
+#include "../processing/bounds.h"
+#include "../processing/bvh.h"
+#include "../processing/weld.h"
+#include "../processing/tangents.h"
+#include "../processing/normals.h"
+#include <stdio.h>
 #include <string>
+#include <vector>
 
 
 typedef struct
@@ -44,8 +55,22 @@ public:
 	virtual ~StaticModel()                                 { Release(); }
 
 	void Release();
-	bool Load(const std::string &file);
-	bool ConvertToMesh(const std::string &file);
+
+	/**
+	 * @param data contents of an SM file
+	 * @param size size of data in bytes
+	 *
+	 * @return bool false if data isn't an SM model
+	 */
+	bool Load(const void *data, size_t size);
+
+	/**
+	 * @param fp stream to write the MESH file to
+	 * @param options processing to apply
+	 *
+	 * @return bool false if writing failed
+	 */
+	bool ConvertToMesh(FILE *fp, const ConvertOptions &options = ConvertOptions());
 
 	SmMaterial* GetMaterial(unsigned short index)          { return &m_materials[index]; }
 	SmPolygon* GetPolygon(unsigned int index)              { return &m_polygons[index]; }
@@ -55,6 +80,18 @@ public:
 	unsigned int GetNumVertices()                          { return m_numVertices; }
 
 private:
+	void WeldVertexPositions(float epsilon, bool keepSeams);
+	void GenerateSmoothNormals(float creaseAngle, bool areaWeighted);
+	void ReorderForVertexCache();
+	void ReorderForOverdraw(float threshold);
+	void ReorderForVertexFetch();
+	void SplitIntoMeshlets();
+	void BuildLevelsOfDetail(const std::vector<float> &ratios);
+	void ComputeBoundingVolumes(MeshBounds &bounds);
+	void BuildBoundingVolumeHierarchy(bool benchmark, BvhData &bvh);
+	void ComputeCornerTangents(bool benchmark, std::vector<CornerTangent> &tangents);
+	void BuildPolygonIndexLayout(const SmPolygon *triangles, unsigned int numTriangles, bool split, IndexLayout &layout);
+
 	SmMaterial *m_materials;
 	SmPolygon *m_polygons;
 	Vector3 *m_vertices;
@@ -68,6 +105,9 @@ private:
 	bool m_hasNormals;
 	bool m_hasTexCoords;
 	bool m_hasColors;
+	MeshletData m_meshlets;
+	std::vector<LodLevel> m_lodLevels;
+	std::vector<SmPolygon> m_lodPolygons;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#endif
+
+static const char *s_counterNames[NUM_HARDWARE_COUNTERS] = { "cycles", "instructions", "cacheMisses", "branchMisses" };
+
+HardwareCounters::HardwareCounters()
+{
+	for (unsigned int i = 0; i < NUM_HARDWARE_COUNTERS; ++i)
+		m_counters[i] = -1;
+}
+
+bool HardwareCounters::Open(std::string &error)
+{
+	Close();
+
+#ifdef __linux__
+	static const unsigned long long events[NUM_HARDWARE_COUNTERS] =
+	{
+		PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+	};
+
+	// One group, so all of them count over the same stretch and a single
+	// read gets them together. Only this thread's user code is counted,
+	// which is also all an unprivileged process is allowed
+	for (unsigned int i = 0; i < NUM_HARDWARE_COUNTERS; ++i)
+	{
+		struct perf_event_attr attributes;
+		memset(&attributes, 0, sizeof(attributes));
+		attributes.size = sizeof(attributes);
+		attributes.type = PERF_TYPE_HARDWARE;
+		attributes.config = events[i];
+		attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+
+		int counter = (int)syscall(SYS_perf_event_open, &attributes, 0, -1, (i > 0 ? m_counters[0] : -1), 0);
+		if (counter == -1)
+		{
+			error = std::string("can't count ") + s_counterNames[i] + ": " + strerror(errno);
+			Close();
+			return false;
+		}
+		m_counters[i] = counter;
+	}
+	return true;
+#else
+	error = "not supported on this platform";
+	return false;
+#endif
+}
+
+void HardwareCounters::Close()
+{
+	// Members of the group go before its leader
+	for (int i = NUM_HARDWARE_COUNTERS - 1; i >= 0; --i)
+	{
+#ifdef __linux__
+		if (m_counters[i] != -1)
+			close(m_counters[i]);
+#endif
+		m_counters[i] = -1;
+	}
+}
+
+bool HardwareCounters::Read(unsigned long long values[NUM_HARDWARE_COUNTERS])
+{
+#ifdef __linux__
+	if (!IsOpen())
+		return false;
+
+	// Number of counters, time enabled, time running, then each count
+	unsigned long long group[3 + NUM_HARDWARE_COUNTERS];
+	if (read(m_counters[0], group, sizeof(group)) != (ssize_t)sizeof(group) || group[0] != NUM_HARDWARE_COUNTERS)
+		return false;
+
+	double scale = (group[2] > 0 ? (double)group[1] / group[2] : 0.0);
+	for (unsigned int i = 0; i < NUM_HARDWARE_COUNTERS; ++i)
+		values[i] = (group[2] == group[1] ? group[3 + i] : (unsigned long long)(group[3 + i] * scale));
+	return true;
+#else
+	return false;
+#endif
+}
+
+const char* GetHardwareCounterName(unsigned int counter)
+{
+	return (counter < NUM_HARDWARE_COUNTERS ? s_counterNames[counter] : "unknown");
+}
@@ -0,0 +1,60 @@
+#ifndef __UTIL_COUNTERS_H_INCLUDED__
+#define __UTIL_COUNTERS_H_INCLUDED__
+
+#include <string>
+
+// Events counted by HardwareCounters. Cache misses are those of the last
+// level cache, the ones that go out to memory
+#define HARDWARE_COUNTER_CYCLES 0
+#define HARDWARE_COUNTER_INSTRUCTIONS 1
+#define HARDWARE_COUNTER_CACHE_MISSES 2
+#define HARDWARE_COUNTER_BRANCH_MISSES 3
+#define NUM_HARDWARE_COUNTERS 4
+
+/**
+ * The CPU's performance counters for the thread that opens them, through
+ * perf_event_open. Only Linux has them, and only where the kernel lets
+ * them be used: containers, virtual machines without a virtual PMU or a
+ * strict perf_event_paranoid all leave Open failing
+ */
+class HardwareCounters
+{
+public:
+	HardwareCounters();
+	virtual ~HardwareCounters()                            { Close(); }
+
+	/**
+	 * @param error receives why the counters couldn't be opened
+	 *
+	 * @return bool false if any of them couldn't be
+	 */
+	bool Open(std::string &error);
+	void Close();
+
+	/**
+	 * @param values receives each counter's count since it was opened, by
+	 *               HARDWARE_COUNTER_* value. Where the kernel had to share
+	 *               the CPU's counters, the counts are scaled up from the
+	 *               time they did run
+	 *
+	 * @return bool false if the counters aren't open or couldn't be read
+	 */
+	bool Read(unsigned long long values[NUM_HARDWARE_COUNTERS]);
+
+	bool IsOpen() const                                    { return m_counters[0] != -1; }
+
+private:
+	HardwareCounters(const HardwareCounters &);
+	HardwareCounters& operator=(const HardwareCounters &);
+
+	int m_counters[NUM_HARDWARE_COUNTERS];       // File descriptors, the first leads the group
+};
+
+/**
+ * @param counter one of the HARDWARE_COUNTER_* values
+ *
+ * @return const char* name of the counter as written in reports
+ */
+const char* GetHardwareCounterName(unsigned int counter);
+
+#endif
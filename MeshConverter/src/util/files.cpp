@@ -1,5 +1,19 @@
 #include "files.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+// Files are copied through a buffer this big
+#define COPY_BUFFER_SIZE (256 * 1024)
+
 void ReadString(FILE *fp, std::string &buffer, int fixedLength)
 {
 	char c;
@@ -23,3 +37,297 @@ void ReadString(FILE *fp, std::string &buffer, int fixedLength)
 		} while (c != '\0');
 	}
 }
+
+bool IsDirectory(const std::string &path)
+{
+#ifdef _WIN32
+	DWORD attributes = GetFileAttributesA(path.c_str());
+	return (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+#else
+	struct stat info;
+	return (stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode));
+#endif
+}
+
+bool GetFileLength(const std::string &path, unsigned long long &size)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data))
+		return false;
+	size = ((unsigned long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return false;
+	size = (unsigned long long)info.st_size;
+#endif
+	return true;
+}
+
+bool GetFileModifiedTime(const std::string &path, long long &time)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data))
+		return false;
+	time = (long long)(((unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime);
+#else
+	// Whole seconds would miss a file saved twice in a row
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return false;
+#ifdef __APPLE__
+	time = (long long)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+	time = (long long)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+#endif
+	return true;
+}
+
+std::string GetAbsolutePath(const std::string &path)
+{
+#ifdef _WIN32
+	char buffer[MAX_PATH];
+	DWORD length = GetFullPathNameA(path.c_str(), MAX_PATH, buffer, NULL);
+	if (length == 0 || length >= MAX_PATH)
+		return path;
+	return buffer;
+#else
+	if (path.length() > 0 && path[0] == '/')
+		return path;
+
+	char buffer[4096];
+	if (getcwd(buffer, sizeof(buffer)) == NULL)
+		return path;
+
+	std::string absolute = buffer;
+	if (absolute.length() == 0 || absolute[absolute.length() - 1] != '/')
+		absolute += '/';
+	return absolute + path;
+#endif
+}
+
+bool ListFiles(const std::string &directory, bool recursive, std::vector<std::string> &files)
+{
+	std::string prefix = directory;
+	if (prefix.length() > 0 && prefix[prefix.length() - 1] != '/' && prefix[prefix.length() - 1] != '\\')
+		prefix += '/';
+
+	std::vector<std::string> subdirectories;
+#ifdef _WIN32
+	WIN32_FIND_DATAA entry;
+	HANDLE find = FindFirstFileA((prefix + "*").c_str(), &entry);
+	if (find == INVALID_HANDLE_VALUE)
+		return false;
+	do
+	{
+		if (entry.cFileName[0] == '.')
+			continue;
+		if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			subdirectories.push_back(prefix + entry.cFileName);
+		else
+			files.push_back(prefix + entry.cFileName);
+	} while (FindNextFileA(find, &entry));
+	FindClose(find);
+#else
+	DIR *dir = opendir(directory.c_str());
+	if (dir == NULL)
+		return false;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (entry->d_name[0] == '.')
+			continue;
+		std::string path = prefix + entry->d_name;
+		if (IsDirectory(path))
+			subdirectories.push_back(path);
+		else
+			files.push_back(path);
+	}
+	closedir(dir);
+#endif
+
+	// Directories that vanish or can't be read while listing are left out
+	// rather than failing everything found so far
+	if (recursive)
+	{
+		for (unsigned int i = 0; i < subdirectories.size(); ++i)
+			ListFiles(subdirectories[i], true, files);
+	}
+	return true;
+}
+
+bool MakeDirectory(const std::string &directory)
+{
+	if (directory.length() == 0 || IsDirectory(directory))
+		return true;
+
+	size_t slash = directory.find_last_of("/\\", directory.find_last_not_of("/\\"));
+	if (slash != std::string::npos && slash > 0 && !MakeDirectory(directory.substr(0, slash)))
+		return false;
+
+	// Another process making the same directory at the same time is fine
+#ifdef _WIN32
+	if (!CreateDirectoryA(directory.c_str(), NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+		return false;
+#else
+	if (mkdir(directory.c_str(), 0777) != 0 && errno != EEXIST)
+		return false;
+#endif
+	return IsDirectory(directory);
+}
+
+bool CopyFileContents(const std::string &source, const std::string &destination)
+{
+	FILE *input = fopen(source.c_str(), "rb");
+	if (input == NULL)
+		return false;
+	FILE *output = fopen(destination.c_str(), "wb");
+	if (output == NULL)
+	{
+		fclose(input);
+		return false;
+	}
+
+	std::vector<char> buffer(COPY_BUFFER_SIZE);
+	bool copied = true;
+	size_t size;
+	while ((size = fread(&buffer[0], 1, buffer.size(), input)) > 0)
+	{
+		if (fwrite(&buffer[0], 1, size, output) != size)
+		{
+			copied = false;
+			break;
+		}
+	}
+	if (ferror(input))
+		copied = false;
+
+	fclose(input);
+	if (fclose(output) != 0)
+		copied = false;
+	return copied;
+}
+
+bool ReadFileContents(const std::string &file, std::vector<unsigned char> &data)
+{
+	data.clear();
+	FILE *fp = fopen(file.c_str(), "rb");
+	if (fp == NULL)
+		return false;
+
+	long length = 0;
+	if (fseek(fp, 0, SEEK_END) == 0)
+		length = ftell(fp);
+	rewind(fp);
+
+	data.resize(length > 0 ? (size_t)length : 0);
+	if (data.size() > 0)
+		data.resize(fread(&data[0], 1, data.size(), fp));
+
+	// Anything past the length seen up front, from a file still being
+	// written or one that doesn't report a length, is added as it's read
+	unsigned char buffer[4096];
+	size_t size;
+	while ((size = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+		data.insert(data.end(), buffer, buffer + size);
+
+	bool read = (ferror(fp) == 0);
+	fclose(fp);
+	return read;
+}
+
+bool ReadFileHeader(const std::string &file, size_t size, std::vector<unsigned char> &data)
+{
+	data.clear();
+	FILE *fp = fopen(file.c_str(), "rb");
+	if (fp == NULL)
+		return false;
+
+	data.resize(size);
+	if (size > 0)
+		data.resize(fread(&data[0], 1, size, fp));
+
+	bool read = (ferror(fp) == 0);
+	fclose(fp);
+	return read;
+}
+
+bool ReadStreamContents(FILE *fp, std::vector<unsigned char> &data)
+{
+#ifdef _WIN32
+	_setmode(_fileno(fp), _O_BINARY);
+#endif
+
+	// Read straight into the end of the buffer, which grows as needed
+	data.clear();
+	size_t size = 0;
+	for (;;)
+	{
+		data.resize(size + COPY_BUFFER_SIZE);
+		size_t read = fread(&data[size], 1, COPY_BUFFER_SIZE, fp);
+		size += read;
+		if (read < COPY_BUFFER_SIZE)
+			break;
+	}
+	data.resize(size);
+
+	return (ferror(fp) == 0);
+}
+
+FILE* DetachStandardOutput()
+{
+	// Anything already printed has to go out before the descriptors move
+	fflush(stdout);
+
+#ifdef _WIN32
+	int fd = _dup(_fileno(stdout));
+	if (fd < 0)
+		return NULL;
+	if (_dup2(_fileno(stderr), _fileno(stdout)) != 0)
+	{
+		_close(fd);
+		return NULL;
+	}
+	_setmode(fd, _O_BINARY);
+	FILE *fp = _fdopen(fd, "wb");
+	if (fp == NULL)
+		_close(fd);
+#else
+	int fd = dup(fileno(stdout));
+	if (fd < 0)
+		return NULL;
+	if (dup2(fileno(stderr), fileno(stdout)) < 0)
+	{
+		close(fd);
+		return NULL;
+	}
+	FILE *fp = fdopen(fd, "wb");
+	if (fp == NULL)
+		close(fd);
+#endif
+	return fp;
+}
+
+bool WriteFileContents(const std::string &file, const void *data, size_t size)
+{
+	FILE *fp = fopen(file.c_str(), "wb");
+	if (fp == NULL)
+		return false;
+
+	bool written = (size == 0 || fwrite(data, 1, size, fp) == size);
+	if (fclose(fp) != 0)
+		written = false;
+	return written;
+}
+
+bool RenameFile(const std::string &source, const std::string &destination)
+{
+#ifdef _WIN32
+	return (MoveFileExA(source.c_str(), destination.c_str(), MOVEFILE_REPLACE_EXISTING) != 0);
+#else
+	return (rename(source.c_str(), destination.c_str()) == 0);
+#endif
+}
@@ -3,7 +3,129 @@
 
 #include <stdio.h>
 #include <string>
+#include <vector>
 
 void ReadString(FILE *fp, std::string &buffer, int fixedLength = 0);
 
+/**
+ * @param path file or directory
+ *
+ * @return bool true if path exists and is a directory
+ */
+bool IsDirectory(const std::string &path);
+
+/**
+ * @param path file to look at
+ * @param size receives the size of the file in bytes
+ *
+ * @return bool false if the file doesn't exist or can't be looked at
+ */
+bool GetFileLength(const std::string &path, unsigned long long &size);
+
+/**
+ * @param path file to look at
+ * @param time receives when the file was last written, in the finest
+ *             units the OS keeps, only meaningful compared to another
+ *             time from the same file system
+ *
+ * @return bool false if the file doesn't exist or can't be looked at
+ */
+bool GetFileModifiedTime(const std::string &path, long long &time);
+
+/**
+ * @param path file or directory, relative to the working directory
+ *
+ * @return std::string path starting from the root, or path itself if it
+ *                     already does or the working directory is unknown
+ */
+std::string GetAbsolutePath(const std::string &path);
+
+/**
+ * Adds the path of every file in a directory to a list, in the order the
+ * OS returns them. Hidden entries, starting with a '.', are skipped
+ * @param directory directory to list
+ * @param recursive true to also list the files in every subdirectory
+ * @param files receives the paths, each starting with directory
+ *
+ * @return bool false if directory couldn't be opened
+ */
+bool ListFiles(const std::string &directory, bool recursive, std::vector<std::string> &files);
+
+/**
+ * Creates a directory and any of its parents that don't exist yet
+ * @param directory directory to create
+ *
+ * @return bool true if the directory exists afterwards
+ */
+bool MakeDirectory(const std::string &directory);
+
+/**
+ * Copies a file's contents to another file, replacing it if it exists
+ * @param source file to copy
+ * @param destination file to write
+ *
+ * @return bool false if either file couldn't be opened or the copy was cut
+ *              short
+ */
+bool CopyFileContents(const std::string &source, const std::string &destination);
+
+/**
+ * @param file file to read
+ * @param data receives everything in the file
+ *
+ * @return bool false if the file couldn't be opened or read in full
+ */
+bool ReadFileContents(const std::string &file, std::vector<unsigned char> &data);
+
+/**
+ * Reads the start of a file without reading the rest of it
+ * @param file file to read
+ * @param size most bytes to read
+ * @param data receives the first size bytes, or the whole file if it's
+ *             shorter
+ *
+ * @return bool false if the file couldn't be opened or read
+ */
+bool ReadFileHeader(const std::string &file, size_t size, std::vector<unsigned char> &data);
+
+/**
+ * Reads a stream to its end, for input that can't be seeked such as a
+ * pipe. Standard input is switched to binary mode where that matters
+ * @param fp stream to read
+ * @param data receives everything read
+ *
+ * @return bool false if reading failed before the end
+ */
+bool ReadStreamContents(FILE *fp, std::vector<unsigned char> &data);
+
+/**
+ * Moves standard output out of the way of binary data written to it.
+ * Whatever is printed to stdout afterwards goes to stderr instead
+ *
+ * @return FILE* binary stream onto what was standard output, or NULL if
+ *               it couldn't be moved
+ */
+FILE* DetachStandardOutput();
+
+/**
+ * Writes a file, replacing it if it exists
+ * @param file file to write
+ * @param data bytes to write
+ * @param size number of bytes
+ *
+ * @return bool false if the file couldn't be opened or written in full
+ */
+bool WriteFileContents(const std::string &file, const void *data, size_t size);
+
+/**
+ * Renames a file, replacing the destination if it exists. Within one
+ * file system readers see either the old file or the new one, never a
+ * partly written one
+ * @param source file to rename
+ * @param destination new name
+ *
+ * @return bool false if the file couldn't be renamed
+ */
+bool RenameFile(const std::string &source, const std::string &destination);
+
 #endif
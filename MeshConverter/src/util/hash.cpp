@@ -0,0 +1,190 @@
+#include "hash.h"
+#include "files.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#define PRIME64_1 0x9E3779B185EBCA87ull
+#define PRIME64_2 0xC2B2AE3D27D4EB4Full
+#define PRIME64_3 0x165667B19E3779F9ull
+#define PRIME64_4 0x85EBCA77C2B2AE63ull
+#define PRIME64_5 0x27D4EB2F165667C5ull
+
+#define HASH_STRIPE_SIZE 32
+
+// Files are hashed through a buffer this big
+#define HASH_FILE_BUFFER_SIZE (256 * 1024)
+
+static inline uint64_t RotateLeft(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+// The hash is defined over little endian words, which is what every
+// platform this builds for uses, so they can be copied straight out
+static inline uint64_t Read64(const unsigned char *data)
+{
+	uint64_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static inline uint32_t Read32(const unsigned char *data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static inline uint64_t Round(uint64_t accumulator, uint64_t input)
+{
+	accumulator += input * PRIME64_2;
+	accumulator = RotateLeft(accumulator, 31);
+	return accumulator * PRIME64_1;
+}
+
+static inline uint64_t MergeRound(uint64_t hash, uint64_t accumulator)
+{
+	hash ^= Round(0, accumulator);
+	return hash * PRIME64_1 + PRIME64_4;
+}
+
+static inline void ConsumeStripe(uint64_t *accumulators, const unsigned char *data)
+{
+	accumulators[0] = Round(accumulators[0], Read64(data));
+	accumulators[1] = Round(accumulators[1], Read64(data + 8));
+	accumulators[2] = Round(accumulators[2], Read64(data + 16));
+	accumulators[3] = Round(accumulators[3], Read64(data + 24));
+}
+
+void Hasher::Reset(uint64_t seed)
+{
+	m_seed = seed;
+	m_accumulators[0] = seed + PRIME64_1 + PRIME64_2;
+	m_accumulators[1] = seed + PRIME64_2;
+	m_accumulators[2] = seed;
+	m_accumulators[3] = seed - PRIME64_1;
+	m_totalSize = 0;
+	m_bufferSize = 0;
+}
+
+void Hasher::Update(const void *data, size_t size)
+{
+	const unsigned char *input = (const unsigned char*)data;
+	m_totalSize += size;
+
+	if (m_bufferSize > 0)
+	{
+		size_t count = HASH_STRIPE_SIZE - m_bufferSize;
+		if (count > size)
+			count = size;
+		memcpy(m_buffer + m_bufferSize, input, count);
+		m_bufferSize += (unsigned int)count;
+		input += count;
+		size -= count;
+		if (m_bufferSize < HASH_STRIPE_SIZE)
+			return;
+
+		ConsumeStripe(m_accumulators, m_buffer);
+		m_bufferSize = 0;
+	}
+
+	// Local copies let the compiler keep the accumulators in registers
+	uint64_t accumulators[4] = { m_accumulators[0], m_accumulators[1], m_accumulators[2], m_accumulators[3] };
+	while (size >= HASH_STRIPE_SIZE)
+	{
+		ConsumeStripe(accumulators, input);
+		input += HASH_STRIPE_SIZE;
+		size -= HASH_STRIPE_SIZE;
+	}
+	memcpy(m_accumulators, accumulators, sizeof(accumulators));
+
+	if (size > 0)
+		memcpy(m_buffer, input, size);
+	m_bufferSize = (unsigned int)size;
+}
+
+void Hasher::Update(uint64_t value)
+{
+	Update(&value, sizeof(value));
+}
+
+uint64_t Hasher::Digest() const
+{
+	uint64_t hash;
+	if (m_totalSize >= HASH_STRIPE_SIZE)
+	{
+		hash = RotateLeft(m_accumulators[0], 1) + RotateLeft(m_accumulators[1], 7) + RotateLeft(m_accumulators[2], 12) + RotateLeft(m_accumulators[3], 18);
+		for (int i = 0; i < 4; ++i)
+			hash = MergeRound(hash, m_accumulators[i]);
+	}
+	else
+		hash = m_seed + PRIME64_5;
+	hash += m_totalSize;
+
+	const unsigned char *data = m_buffer;
+	unsigned int size = m_bufferSize;
+	while (size >= 8)
+	{
+		hash ^= Round(0, Read64(data));
+		hash = RotateLeft(hash, 27) * PRIME64_1 + PRIME64_4;
+		data += 8;
+		size -= 8;
+	}
+	if (size >= 4)
+	{
+		hash ^= (uint64_t)Read32(data) * PRIME64_1;
+		hash = RotateLeft(hash, 23) * PRIME64_2 + PRIME64_3;
+		data += 4;
+		size -= 4;
+	}
+	while (size > 0)
+	{
+		hash ^= (*data) * PRIME64_5;
+		hash = RotateLeft(hash, 11) * PRIME64_1;
+		++data;
+		--size;
+	}
+
+	hash ^= hash >> 33;
+	hash *= PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= PRIME64_3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+uint64_t HashBytes(const void *data, size_t size, uint64_t seed)
+{
+	Hasher hasher(seed);
+	hasher.Update(data, size);
+	return hasher.Digest();
+}
+
+bool HashFile(const std::string &file, uint64_t &hash)
+{
+	if (IsDirectory(file))
+		return false;
+	FILE *fp = fopen(file.c_str(), "rb");
+	if (fp == NULL)
+		return false;
+
+	Hasher hasher;
+	std::vector<unsigned char> buffer(HASH_FILE_BUFFER_SIZE);
+	size_t size;
+	while ((size = fread(&buffer[0], 1, buffer.size(), fp)) > 0)
+		hasher.Update(&buffer[0], size);
+	bool read = (ferror(fp) == 0);
+	fclose(fp);
+
+	hash = hasher.Digest();
+	return read;
+}
+
+std::string FormatHash(uint64_t hash)
+{
+	char text[17];
+	snprintf(text, sizeof(text), "%016llx", (unsigned long long)hash);
+	return text;
+}
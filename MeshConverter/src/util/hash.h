@@ -0,0 +1,59 @@
+#ifndef __UTIL_HASH_H_INCLUDED__
+#define __UTIL_HASH_H_INCLUDED__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/**
+ * 64 bit XXH64 hash of a stream of bytes, fed in pieces of any size.
+ * Fast enough to be limited by memory bandwidth rather than the hash,
+ * and well spread enough to use as the identity of file contents
+ */
+class Hasher
+{
+public:
+	Hasher(uint64_t seed = 0)                              { Reset(seed); }
+
+	void Reset(uint64_t seed = 0);
+	void Update(const void *data, size_t size);
+	void Update(const std::string &text)                   { Update(text.c_str(), text.length() + 1); }
+	void Update(uint64_t value);
+	uint64_t Digest() const;
+
+private:
+	uint64_t m_accumulators[4];
+	uint64_t m_seed;
+	uint64_t m_totalSize;
+	unsigned char m_buffer[32];                  // Bytes not yet making up a whole stripe
+	unsigned int m_bufferSize;
+};
+
+/**
+ * @param data bytes to hash
+ * @param size number of bytes
+ * @param seed changes the result without weakening it
+ *
+ * @return uint64_t XXH64 hash of the bytes
+ */
+uint64_t HashBytes(const void *data, size_t size, uint64_t seed = 0);
+
+/**
+ * Hashes the whole contents of a file. It is read through a buffer rather
+ * than mapped, since a mapping faults if another process cuts the file
+ * short while it is being hashed
+ * @param file file to hash
+ * @param hash receives the XXH64 hash of the contents
+ *
+ * @return bool false if the file couldn't be read
+ */
+bool HashFile(const std::string &file, uint64_t &hash);
+
+/**
+ * @param hash value to print
+ *
+ * @return std::string the hash as 16 lower case hex digits
+ */
+std::string FormatHash(uint64_t hash);
+
+#endif
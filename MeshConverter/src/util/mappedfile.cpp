@@ -0,0 +1,99 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile()
+{
+	m_data = NULL;
+	m_size = 0;
+#ifdef _WIN32
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = NULL;
+#else
+	m_file = -1;
+#endif
+}
+
+bool MappedFile::Open(const std::string &file)
+{
+	Close();
+
+#ifdef _WIN32
+	m_file = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_mapping == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	m_data = (const unsigned char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_data == NULL)
+	{
+		Close();
+		return false;
+	}
+	m_size = (size_t)size.QuadPart;
+#else
+	m_file = open(file.c_str(), O_RDONLY);
+	if (m_file == -1)
+		return false;
+
+	struct stat info;
+	if (fstat(m_file, &info) != 0 || info.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+
+	void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (data == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	m_data = (const unsigned char*)data;
+	m_size = (size_t)info.st_size;
+#endif
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (m_data != NULL)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != NULL)
+		CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = NULL;
+#else
+	if (m_data != NULL)
+		munmap((void*)m_data, m_size);
+	if (m_file != -1)
+		close(m_file);
+	m_file = -1;
+#endif
+	m_data = NULL;
+	m_size = 0;
+}
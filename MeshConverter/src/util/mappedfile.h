@@ -0,0 +1,38 @@
+#ifndef __UTIL_MAPPEDFILE_H_INCLUDED__
+#define __UTIL_MAPPEDFILE_H_INCLUDED__
+
+#include <string>
+
+/**
+ * Read-only memory mapping of an entire file. Pages are only
+ * brought in by the OS as they are touched, so opening even a
+ * very large file is cheap.
+ */
+class MappedFile
+{
+public:
+	MappedFile();
+	virtual ~MappedFile()                                  { Close(); }
+
+	bool Open(const std::string &file);
+	void Close();
+
+	const unsigned char* GetData() const                   { return m_data; }
+	size_t GetSize() const                                 { return m_size; }
+	bool IsOpen() const                                    { return m_data != NULL; }
+
+private:
+	MappedFile(const MappedFile &);
+	MappedFile& operator=(const MappedFile &);
+
+	const unsigned char *m_data;
+	size_t m_size;
+#ifdef _WIN32
+	void *m_file;
+	void *m_mapping;
+#else
+	int m_file;
+#endif
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include "memoryfile.h"
+
+#include <stdlib.h>
+
+MemoryFile::MemoryFile()
+{
+	m_fp = NULL;
+	m_buffer = NULL;
+	m_size = 0;
+}
+
+MemoryFile::~MemoryFile()
+{
+	Discard();
+}
+
+void MemoryFile::Discard()
+{
+	if (m_fp != NULL)
+		fclose(m_fp);
+	free(m_buffer);
+	m_fp = NULL;
+	m_buffer = NULL;
+	m_size = 0;
+}
+
+#ifdef _WIN32
+
+FILE* MemoryFile::Open()
+{
+	Discard();
+	m_fp = tmpfile();
+	return m_fp;
+}
+
+bool MemoryFile::Close(std::vector<unsigned char> &data)
+{
+	data.clear();
+	if (m_fp == NULL)
+		return false;
+
+	bool written = (fflush(m_fp) == 0 && ferror(m_fp) == 0 && fseek(m_fp, 0, SEEK_END) == 0);
+	long size = (written ? ftell(m_fp) : -1);
+	if (size > 0)
+	{
+		data.resize((size_t)size);
+		rewind(m_fp);
+		written = (fread(&data[0], 1, data.size(), m_fp) == data.size());
+	}
+	Discard();
+	return (written && size >= 0);
+}
+
+#else
+
+FILE* MemoryFile::Open()
+{
+	Discard();
+	m_fp = open_memstream(&m_buffer, &m_size);
+	return m_fp;
+}
+
+bool MemoryFile::Close(std::vector<unsigned char> &data)
+{
+	data.clear();
+	if (m_fp == NULL)
+		return false;
+
+	// The size given back is wherever the stream was left, so it's moved
+	// to the end first in case the writer seeked back
+	bool written = (ferror(m_fp) == 0 && fseek(m_fp, 0, SEEK_END) == 0);
+	if (fclose(m_fp) != 0)
+		written = false;
+	m_fp = NULL;
+
+	if (written)
+		data.assign(m_buffer, m_buffer + m_size);
+	Discard();
+	return written;
+}
+
+#endif
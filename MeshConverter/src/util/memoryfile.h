@@ -0,0 +1,44 @@
+#ifndef __UTIL_MEMORYFILE_H_INCLUDED__
+#define __UTIL_MEMORYFILE_H_INCLUDED__
+
+#include <stdio.h>
+#include <vector>
+
+/**
+ * FILE stream that writes to memory, for handing code written against
+ * fwrite a buffer instead of a file. Where the C library can't write a
+ * stream to memory a temporary file stands in, which works the same but
+ * goes through the file system
+ */
+class MemoryFile
+{
+public:
+	MemoryFile();
+	virtual ~MemoryFile();
+
+	/**
+	 * @return FILE* stream to write to, which can also be told and
+	 *               seeked, or NULL if one couldn't be created
+	 */
+	FILE* Open();
+
+	/**
+	 * Closes the stream and takes what was written to it
+	 * @param data receives everything written
+	 *
+	 * @return bool false if the stream failed along the way
+	 */
+	bool Close(std::vector<unsigned char> &data);
+
+private:
+	MemoryFile(const MemoryFile &);
+	MemoryFile& operator=(const MemoryFile &);
+
+	void Discard();
+
+	FILE *m_fp;
+	char *m_buffer;                              // Owned by the stream until it's closed
+	size_t m_size;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "memoryreader.h"
+
+#include <string.h>
+
+MemoryReader::MemoryReader(const void *data, size_t size)
+{
+	m_data = (const unsigned char*)data;
+	m_size = size;
+	m_position = 0;
+	m_end = false;
+}
+
+size_t MemoryReader::Read(void *buffer, size_t size, size_t count)
+{
+	if (size == 0 || count == 0)
+		return 0;
+
+	size_t wanted = size * count;
+	size_t available = (m_position < m_size ? m_size - m_position : 0);
+	size_t read = (wanted < available ? wanted : available);
+	memcpy(buffer, m_data + m_position, read);
+	m_position += read;
+	if (read < wanted)
+	{
+		memset((unsigned char*)buffer + read, 0, wanted - read);
+		m_end = true;
+	}
+	return read / size;
+}
+
+bool MemoryReader::HasRoomFor(size_t size, size_t count) const
+{
+	size_t available = (m_position < m_size ? m_size - m_position : 0);
+	return (size == 0 || count <= available / size);
+}
+
+bool MemoryReader::Seek(long offset, int origin)
+{
+	long long base = 0;
+	if (origin == SEEK_CUR)
+		base = (long long)m_position;
+	else if (origin == SEEK_END)
+		base = (long long)m_size;
+
+	if (base + offset < 0)
+		return false;
+	m_position = (size_t)(base + offset);
+	m_end = false;
+	return true;
+}
+
+bool MemoryReader::ReadLine(char *buffer, int size)
+{
+	if (size <= 0)
+		return false;
+	if (m_position >= m_size)
+	{
+		m_end = true;
+		return false;
+	}
+
+	int length = 0;
+	while (length < size - 1)
+	{
+		if (m_position >= m_size)
+		{
+			m_end = true;
+			break;
+		}
+		char c = (char)m_data[m_position++];
+		buffer[length++] = c;
+		if (c == '\n')
+			break;
+	}
+	buffer[length] = '\0';
+	return true;
+}
+
+void MemoryReader::ReadString(std::string &buffer, int fixedLength)
+{
+	char c;
+
+	if (fixedLength > 0)
+	{
+		for (int i = 0; i < fixedLength; ++i)
+		{
+			Read(&c, 1, 1);
+			if (c != '\0')
+				buffer += c;
+		}
+	}
+	else
+	{
+		do
+		{
+			Read(&c, 1, 1);
+			if (c != '\0')
+				buffer += c;
+		} while (c != '\0');
+	}
+}
@@ -0,0 +1,92 @@
+#ifndef __UTIL_MEMORYREADER_H_INCLUDED__
+#define __UTIL_MEMORYREADER_H_INCLUDED__
+
+#include <stdio.h>
+#include <streambuf>
+#include <string>
+
+/**
+ * Reads a block of memory the way fread, fseek and fgets read a file, so
+ * loaders can read a model that is already in memory without it being
+ * copied. Reading past the end stops there and sets the end flag, as
+ * feof would. Unlike fread, whatever a short read couldn't fill is zeroed,
+ * so a truncated model can't leave a loop waiting on a value that never
+ * changes
+ */
+class MemoryReader
+{
+public:
+	MemoryReader(const void *data, size_t size);
+
+	/**
+	 * @param buffer receives the bytes read
+	 * @param size size of each item
+	 * @param count number of items
+	 *
+	 * @return size_t number of whole items read
+	 */
+	size_t Read(void *buffer, size_t size, size_t count);
+
+	/**
+	 * @param offset where to move to
+	 * @param origin SEEK_SET, SEEK_CUR or SEEK_END, what offset is from
+	 *
+	 * @return bool false if that would be before the start
+	 */
+	bool Seek(long offset, int origin);
+
+	/**
+	 * Reads up to and including the next '\n', stopping early when the
+	 * buffer is full
+	 * @param buffer receives the line, always terminated
+	 * @param size size of buffer
+	 *
+	 * @return bool false if there was nothing left to read, buffer is left
+	 *              as it was
+	 */
+	bool ReadLine(char *buffer, int size);
+
+	/**
+	 * Reads a string the same way ReadString in files.h does
+	 * @param buffer has the characters read appended to it
+	 * @param fixedLength bytes the string takes up, or 0 for a string
+	 *                    ending at its terminator
+	 */
+	void ReadString(std::string &buffer, int fixedLength = 0);
+
+	/**
+	 * Lets a loader check the counts in a header against what the data
+	 * can hold before allocating for them
+	 * @param size size of each item
+	 * @param count number of items
+	 *
+	 * @return bool true if that many items are left to read
+	 */
+	bool HasRoomFor(size_t size, size_t count) const;
+
+	bool IsAtEnd() const                                   { return m_end; }
+	size_t GetPosition() const                             { return m_position; }
+	size_t GetSize() const                                 { return m_size; }
+
+private:
+	const unsigned char *m_data;
+	size_t m_size;
+	size_t m_position;                           // Can be past the end after a seek, as with a file
+	bool m_end;
+};
+
+/**
+ * Stream buffer over a block of memory, for reading text in memory
+ * through a std::istream without copying it
+ */
+class MemoryStreamBuffer : public std::streambuf
+{
+public:
+	MemoryStreamBuffer(const void *data, size_t size)
+	{
+		char *begin = (char*)data;
+		setg(begin, begin, begin + size);
+	}
+};
+
+#endif
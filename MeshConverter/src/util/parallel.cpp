@@ -0,0 +1,126 @@
+#include "parallel.h"
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <vector>
+
+#include "profiler.h"
+
+struct StealingQueue
+{
+	std::mutex lock;
+	std::deque<unsigned int> items;
+};
+
+static std::atomic<unsigned int> s_maxWorkerThreads(0);
+
+// Set on ParallelForStealing's threads, and others marked as a pool
+static thread_local bool s_isPoolThread = false;
+
+unsigned int GetNumWorkerThreads()
+{
+	unsigned int count = std::thread::hardware_concurrency();
+	unsigned int limit = s_maxWorkerThreads;
+	if (limit > 0 && (count == 0 || count > limit))
+		count = limit;
+	return (count > 0 ? count : 1);
+}
+
+void MarkPoolThread()
+{
+	s_isPoolThread = true;
+}
+
+void SetMaxWorkerThreads(unsigned int count)
+{
+	s_maxWorkerThreads = count;
+}
+
+void ParallelFor(unsigned int count, const std::function<void(unsigned int)> &body)
+{
+	unsigned int numThreads = (s_isPoolThread ? 1 : GetNumWorkerThreads());
+	if (numThreads > count)
+		numThreads = count;
+
+	// Not worth starting threads for a single item, or from a pool thread
+	// whose neighbours are all busy with items of their own
+	if (numThreads <= 1)
+	{
+		for (unsigned int i = 0; i < count; ++i)
+			body(i);
+		return;
+	}
+
+	// What the threads allocate is counted as the caller's
+	ProfileAllocationOwner owner = GetProfileAllocationOwner();
+	std::atomic<unsigned int> next(0);
+	std::vector<std::thread> threads;
+	for (unsigned int i = 0; i < numThreads; ++i)
+	{
+		threads.push_back(std::thread([&]()
+		{
+			ProfileAllocationScope allocations(owner);
+			unsigned int item;
+			while ((item = next++) < count)
+				body(item);
+		}));
+	}
+
+	for (unsigned int i = 0; i < threads.size(); ++i)
+		threads[i].join();
+}
+
+// A thread's own share comes first, then the next thread round that still
+// has items. Stolen items come off the front as well, which keeps the most
+// expensive of what is left being started first
+static bool TakeItem(std::vector<StealingQueue> &queues, unsigned int thread, unsigned int &item)
+{
+	for (unsigned int i = 0; i < queues.size(); ++i)
+	{
+		StealingQueue &queue = queues[(thread + i) % queues.size()];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (!queue.items.empty())
+		{
+			item = queue.items.front();
+			queue.items.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void ParallelForStealing(unsigned int count, unsigned int numThreads, const std::function<void(unsigned int)> &body)
+{
+	if (numThreads == 0)
+		numThreads = GetNumWorkerThreads();
+	if (numThreads > count)
+		numThreads = count;
+
+	if (numThreads <= 1)
+	{
+		for (unsigned int i = 0; i < count; ++i)
+			body(i);
+		return;
+	}
+
+	std::vector<StealingQueue> queues(numThreads);
+	for (unsigned int i = 0; i < count; ++i)
+		queues[i % numThreads].items.push_back(i);
+
+	std::vector<std::thread> threads;
+	for (unsigned int i = 0; i < numThreads; ++i)
+	{
+		threads.push_back(std::thread([&queues, &body, i]()
+		{
+			s_isPoolThread = true;
+			unsigned int item;
+			while (TakeItem(queues, i, item))
+				body(item);
+		}));
+	}
+
+	for (unsigned int i = 0; i < threads.size(); ++i)
+		threads[i].join();
+}
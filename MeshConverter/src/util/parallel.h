@@ -0,0 +1,51 @@
+#ifndef __UTIL_PARALLEL_H_INCLUDED__
+#define __UTIL_PARALLEL_H_INCLUDED__
+
+#include <functional>
+
+/**
+ * Runs body(i) for every i in [0, count) spread over all hardware
+ * threads. Items are handed out one at a time, so uneven amounts of
+ * work per item still balance out. Returns once every item is done
+ * @param count number of items
+ * @param body work to do for a single item, must be safe to run
+ *             concurrently with itself
+ */
+void ParallelFor(unsigned int count, const std::function<void(unsigned int)> &body);
+
+/**
+ * Runs body(i) for every i in [0, count) on a pool of threads that each
+ * start with their own share of the items, dealt out in turn, and take
+ * the next item from the other threads' shares once theirs runs out.
+ * Items are started in the order given within each share, so passing
+ * the most expensive ones first keeps them from being left to the end.
+ * Meant for a few large items like whole files: with more than one
+ * thread, ParallelFor called from inside body runs on the calling thread,
+ * since the pool already keeps every thread busy
+ * @param count number of items
+ * @param numThreads threads to use, 0 for GetNumWorkerThreads
+ * @param body work to do for a single item, must be safe to run
+ *             concurrently with itself
+ */
+void ParallelForStealing(unsigned int count, unsigned int numThreads, const std::function<void(unsigned int)> &body);
+
+/**
+ * Marks the calling thread as one of a pool of long running threads that
+ * together keep every core busy, the way ParallelForStealing's are, so
+ * ParallelFor called from it runs on the thread itself
+ */
+void MarkPoolThread();
+
+/**
+ * @return unsigned int number of threads ParallelFor spreads work over
+ */
+unsigned int GetNumWorkerThreads();
+
+/**
+ * Caps the number of threads ParallelFor uses, for measuring how work
+ * scales with the number of cores
+ * @param count most threads to use, 0 for all hardware threads
+ */
+void SetMaxWorkerThreads(unsigned int count);
+
+#endif
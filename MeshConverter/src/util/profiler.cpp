@@ -0,0 +1,509 @@
+#include "profiler.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+typedef std::chrono::high_resolution_clock ProfileClock;
+
+bool g_profiling = false;
+
+static const char *s_stageNames[NUM_PROFILE_STAGES] =
+{
+	"read", "load", "weld", "normals", "vertexCache", "overdraw", "meshlets", "lod",
+	"vertexFetch", "bounds", "tangents", "bvh", "write", "compress"
+};
+
+static const char *s_counterNames[NUM_PROFILE_COUNTERS] = { "elements", "bytesRead", "bytesWritten", "allocations" };
+
+// Room for this many events is made in a thread's trace buffer up front,
+// so growing it rarely lands in the middle of a stage
+#define TRACE_BUFFER_RESERVE 4096
+
+// Events recorded by one thread, only ever touched by that thread until
+// they're gathered
+struct TraceBuffer
+{
+	unsigned int thread;
+	std::vector<TraceEvent> events;
+};
+
+static std::mutex s_filesLock;
+static std::vector<ProfileFile> s_files;
+
+static bool s_hardwareCounters = false;
+static std::mutex s_hardwareLock;
+static std::string s_hardwareError;
+
+// Blocks are spread over this many tables by address, so threads
+// allocating at the same time rarely wait on each other
+#define PROFILE_BLOCK_TABLES 64
+
+// Memory held for one file, shared by every thread allocating for it.
+// Kept until the file is done and the last block allocated for it is
+// freed, whichever comes later
+struct ProfileMemory
+{
+	std::atomic<unsigned int> references;        // The file's scope, and each block not yet freed
+	std::atomic<long long> liveBytes;
+	std::atomic<unsigned long long> peakBytes;
+	std::atomic<unsigned long long> allocations[NUM_PROFILE_STAGES];
+	std::atomic<unsigned long long> allocatedBytes[NUM_PROFILE_STAGES];
+	std::atomic<unsigned long long> peakStageBytes[NUM_PROFILE_STAGES];
+};
+
+// What a block still allocated was counted against
+struct ProfileBlock
+{
+	ProfileMemory *memory;
+	size_t size;
+};
+
+struct ProfileBlockTable
+{
+	std::mutex lock;
+	std::unordered_map<const void*, ProfileBlock> blocks;
+};
+
+static bool s_trackAllocations = false;
+
+// Made when tracking is turned on and never freed, blocks are freed right
+// up to the end of the process
+static ProfileBlockTable *s_blockTables = NULL;
+
+static bool s_tracing = false;
+static long long s_traceStart = 0;
+static std::mutex s_traceLock;
+static std::vector<std::unique_ptr<TraceBuffer>> s_traceBuffers;
+
+// What this thread is recording, kept to plain values so they need no
+// constructing before operator new can look at them
+static thread_local ProfileFile *s_file = NULL;
+static thread_local int s_stage = -1;
+static thread_local long long s_since = 0;
+static thread_local TraceBuffer *s_trace = NULL;
+
+// What this thread's allocations are counted against while tracking,
+// either its own file or that of the thread it's working for. Set while
+// the profiler allocates for itself, so that isn't counted
+static thread_local ProfileMemory *s_memory = NULL;
+static thread_local int s_memoryStage = -1;
+static thread_local bool s_inProfiler = false;
+
+// Opened on a thread's first stage. The counts are running totals, so
+// what they were when the current stage last took over is kept to tell
+// what it's been through since
+static thread_local HardwareCounters *s_counters = NULL;
+static thread_local bool s_countersOpened = false;
+static thread_local unsigned long long s_countersSince[NUM_HARDWARE_COUNTERS];
+
+static long long GetTicks()
+{
+	return ProfileClock::now().time_since_epoch().count();
+}
+
+static double GetMilliseconds(long long ticks)
+{
+	return ticks * 1000.0 * ProfileClock::period::num / ProfileClock::period::den;
+}
+
+void EnableProfiling()
+{
+	g_profiling = true;
+}
+
+void EnableAllocationTracking()
+{
+	s_blockTables = new ProfileBlockTable[PROFILE_BLOCK_TABLES];
+	s_trackAllocations = true;
+	g_profiling = true;
+}
+
+bool IsTrackingAllocations()
+{
+	return s_trackAllocations;
+}
+
+bool GetPeakResidentBytes(unsigned long long &bytes)
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return false;
+	bytes = counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return false;
+#ifdef __APPLE__
+	bytes = (unsigned long long)usage.ru_maxrss;
+#else
+	bytes = (unsigned long long)usage.ru_maxrss * 1024;
+#endif
+#endif
+	return true;
+}
+
+static ProfileBlockTable* GetBlockTable(const void *block)
+{
+	// The low bits of an address are mostly alignment
+	return &s_blockTables[((size_t)block >> 4) % PROFILE_BLOCK_TABLES];
+}
+
+static void RaisePeak(std::atomic<unsigned long long> &peak, long long bytes)
+{
+	if (bytes <= 0)
+		return;
+	unsigned long long current = peak;
+	while ((unsigned long long)bytes > current && !peak.compare_exchange_weak(current, (unsigned long long)bytes))
+		;
+}
+
+static ProfileMemory* CreateMemory()
+{
+	s_inProfiler = true;
+	ProfileMemory *memory = new ProfileMemory;
+	s_inProfiler = false;
+
+	memory->references = 1;
+	memory->liveBytes = 0;
+	memory->peakBytes = 0;
+	for (unsigned int i = 0; i < NUM_PROFILE_STAGES; ++i)
+	{
+		memory->allocations[i] = 0;
+		memory->allocatedBytes[i] = 0;
+		memory->peakStageBytes[i] = 0;
+	}
+	return memory;
+}
+
+static void ReleaseMemory(ProfileMemory *memory)
+{
+	if (--memory->references > 0)
+		return;
+
+	bool inProfiler = s_inProfiler;
+	s_inProfiler = true;
+	delete memory;
+	s_inProfiler = inProfiler;
+}
+
+void EnableHardwareCounters()
+{
+	s_hardwareCounters = true;
+	g_profiling = true;
+}
+
+bool HasHardwareCounters(std::string &error)
+{
+	std::lock_guard<std::mutex> guard(s_hardwareLock);
+	error = s_hardwareError;
+	return (s_hardwareCounters && s_hardwareError.length() == 0);
+}
+
+static HardwareCounters* GetHardwareCounters()
+{
+	if (!s_countersOpened)
+	{
+		// Closed when the thread exits
+		static thread_local HardwareCounters counters;
+		s_countersOpened = true;
+
+		std::string error;
+		if (counters.Open(error))
+			s_counters = &counters;
+		else
+		{
+			std::lock_guard<std::mutex> guard(s_hardwareLock);
+			if (s_hardwareError.length() == 0)
+				s_hardwareError = error;
+		}
+	}
+	return s_counters;
+}
+
+// Adds the hardware events since the current stage last took over to it,
+// before another takes over
+static void CountHardwareEvents()
+{
+	HardwareCounters *counters = GetHardwareCounters();
+	unsigned long long values[NUM_HARDWARE_COUNTERS];
+	if (counters == NULL || !counters->Read(values))
+		return;
+
+	for (unsigned int i = 0; i < NUM_HARDWARE_COUNTERS; ++i)
+	{
+		// Scaled counts can come out a little behind the last ones
+		if (s_stage >= 0 && values[i] > s_countersSince[i])
+			s_file->stages[s_stage].hardware[i] += values[i] - s_countersSince[i];
+		s_countersSince[i] = values[i];
+	}
+}
+
+void EnableTracing()
+{
+	s_traceStart = GetTicks();
+	s_tracing = true;
+	g_profiling = true;
+}
+
+static TraceEvent* AddTraceEvent(int stage, bool begin, long long ticks)
+{
+	// Only a thread's first event takes the lock, to hand it a buffer that
+	// outlives the thread
+	if (s_trace == NULL)
+	{
+		std::unique_ptr<TraceBuffer> buffer(new TraceBuffer);
+		buffer->events.reserve(TRACE_BUFFER_RESERVE);
+
+		std::lock_guard<std::mutex> guard(s_traceLock);
+		buffer->thread = (unsigned int)s_traceBuffers.size() + 1;
+		s_trace = buffer.get();
+		s_traceBuffers.push_back(std::move(buffer));
+	}
+
+	s_trace->events.push_back(TraceEvent());
+	TraceEvent *event = &s_trace->events.back();
+	event->thread = s_trace->thread;
+	event->stage = stage;
+	event->begin = begin;
+	event->converted = false;
+	event->microseconds = GetMilliseconds(ticks - s_traceStart) * 1000.0;
+	return event;
+}
+
+const char* GetProfileStageName(unsigned int stage)
+{
+	return (stage < NUM_PROFILE_STAGES ? s_stageNames[stage] : "unknown");
+}
+
+const char* GetProfileCounterName(unsigned int counter)
+{
+	return (counter < NUM_PROFILE_COUNTERS ? s_counterNames[counter] : "unknown");
+}
+
+void ProfileCount(unsigned int stage, unsigned int counter, unsigned long long amount)
+{
+	if (g_profiling && s_file != NULL && stage < NUM_PROFILE_STAGES && counter < NUM_PROFILE_COUNTERS)
+		s_file->stages[stage].counters[counter] += amount;
+}
+
+void GetProfileFiles(std::vector<ProfileFile> &files)
+{
+	std::lock_guard<std::mutex> guard(s_filesLock);
+	files = s_files;
+}
+
+void GetTraceEvents(std::vector<TraceEvent> &events)
+{
+	std::lock_guard<std::mutex> guard(s_traceLock);
+	events.clear();
+	for (unsigned int i = 0; i < s_traceBuffers.size(); ++i)
+		events.insert(events.end(), s_traceBuffers[i]->events.begin(), s_traceBuffers[i]->events.end());
+}
+
+bool ProfileScope::Enter(unsigned int stage, unsigned long long elements)
+{
+	if (s_file == NULL || stage >= NUM_PROFILE_STAGES)
+		return false;
+
+	// The stage this one interrupts stops counting time until it's back
+	long long now = GetTicks();
+	if (s_stage >= 0)
+		s_file->stages[s_stage].milliseconds += GetMilliseconds(now - s_since);
+	if (s_hardwareCounters)
+		CountHardwareEvents();
+	m_parent = s_stage;
+	s_stage = (int)stage;
+	s_since = now;
+
+	ProfileStage *current = &s_file->stages[stage];
+	++current->calls;
+	current->counters[PROFILE_COUNTER_ELEMENTS] += elements;
+	if (s_memory != NULL)
+	{
+		s_memoryStage = s_stage;
+		RaisePeak(s_memory->peakStageBytes[stage], s_memory->liveBytes);
+	}
+	if (s_tracing)
+		AddTraceEvent((int)stage, true, now);
+	return true;
+}
+
+void ProfileScope::Leave()
+{
+	long long now = GetTicks();
+	if (s_file != NULL && s_stage >= 0)
+		s_file->stages[s_stage].milliseconds += GetMilliseconds(now - s_since);
+	if (s_hardwareCounters && s_file != NULL)
+		CountHardwareEvents();
+	if (s_tracing && s_stage >= 0)
+		AddTraceEvent(s_stage, false, now);
+	s_stage = m_parent;
+	s_since = now;
+	if (s_memory != NULL)
+		s_memoryStage = s_stage;
+}
+
+ProfileFileScope::ProfileFileScope(const std::string &file)
+{
+	// A file converted while converting another is counted as part of it
+	m_file = NULL;
+	m_memory = NULL;
+	m_start = 0;
+	if (!g_profiling || s_file != NULL)
+		return;
+
+	m_file = new ProfileFile;
+	m_file->file = file;
+	m_file->converted = false;
+	m_file->milliseconds = 0.0;
+	m_file->peakBytes = 0;
+	m_memory = (s_trackAllocations ? CreateMemory() : NULL);
+	memset(m_file->stages, 0, sizeof(m_file->stages));
+
+	s_file = m_file;
+	s_stage = -1;
+	s_memory = m_memory;
+	s_memoryStage = -1;
+	m_start = GetTicks();
+	if (s_tracing)
+		AddTraceEvent(-1, true, m_start)->file = file;
+}
+
+ProfileFileScope::~ProfileFileScope()
+{
+	if (m_file == NULL)
+		return;
+
+	long long now = GetTicks();
+	m_file->milliseconds = GetMilliseconds(now - m_start);
+	s_file = NULL;
+	s_stage = -1;
+	if (s_tracing)
+		AddTraceEvent(-1, false, now)->converted = m_file->converted;
+
+	// Work handed to other threads is over by now, so the counts are final
+	if (m_memory != NULL)
+	{
+		s_memory = NULL;
+		m_file->peakBytes = m_memory->peakBytes;
+		for (unsigned int i = 0; i < NUM_PROFILE_STAGES; ++i)
+		{
+			m_file->stages[i].counters[PROFILE_COUNTER_ALLOCATIONS] = m_memory->allocations[i];
+			m_file->stages[i].allocatedBytes = m_memory->allocatedBytes[i];
+			m_file->stages[i].peakBytes = m_memory->peakStageBytes[i];
+		}
+		ReleaseMemory(m_memory);
+	}
+
+	std::lock_guard<std::mutex> guard(s_filesLock);
+	s_files.push_back(*m_file);
+	delete m_file;
+}
+
+void ProfileFileScope::SetConverted(bool converted)
+{
+	if (m_file != NULL)
+		m_file->converted = converted;
+}
+
+void ProfileAllocation(void *block, size_t size)
+{
+	if (!g_profiling)
+		return;
+
+	if (!s_trackAllocations)
+	{
+		if (s_file != NULL && s_stage >= 0)
+			++s_file->stages[s_stage].counters[PROFILE_COUNTER_ALLOCATIONS];
+		return;
+	}
+
+	ProfileMemory *memory = s_memory;
+	if (memory == NULL || s_inProfiler)
+		return;
+
+	++memory->references;
+	long long live = (memory->liveBytes += (long long)size);
+	RaisePeak(memory->peakBytes, live);
+	int stage = s_memoryStage;
+	if (stage >= 0)
+	{
+		++memory->allocations[stage];
+		memory->allocatedBytes[stage] += size;
+		RaisePeak(memory->peakStageBytes[stage], live);
+	}
+
+	// Recorded so the block comes off the right file's count, whichever
+	// thread frees it and whenever
+	ProfileBlockTable *table = GetBlockTable(block);
+	ProfileBlock record = { memory, size };
+	s_inProfiler = true;
+	{
+		std::lock_guard<std::mutex> guard(table->lock);
+		table->blocks[block] = record;
+	}
+	s_inProfiler = false;
+}
+
+void ProfileDeallocation(void *block)
+{
+	if (!s_trackAllocations || s_inProfiler)
+		return;
+
+	// Blocks from before tracking started, or from outside any file,
+	// weren't recorded and aren't counted
+	ProfileBlockTable *table = GetBlockTable(block);
+	ProfileBlock record;
+	bool found = false;
+	s_inProfiler = true;
+	{
+		std::lock_guard<std::mutex> guard(table->lock);
+		std::unordered_map<const void*, ProfileBlock>::iterator entry = table->blocks.find(block);
+		if (entry != table->blocks.end())
+		{
+			record = entry->second;
+			table->blocks.erase(entry);
+			found = true;
+		}
+	}
+	s_inProfiler = false;
+
+	if (found)
+	{
+		record.memory->liveBytes -= (long long)record.size;
+		ReleaseMemory(record.memory);
+	}
+}
+
+ProfileAllocationOwner GetProfileAllocationOwner()
+{
+	ProfileAllocationOwner owner = { s_memory, s_memoryStage };
+	return owner;
+}
+
+ProfileAllocationScope::ProfileAllocationScope(const ProfileAllocationOwner &owner)
+{
+	m_memory = s_memory;
+	m_stage = s_memoryStage;
+	s_memory = owner.memory;
+	s_memoryStage = owner.stage;
+}
+
+ProfileAllocationScope::~ProfileAllocationScope()
+{
+	s_memory = m_memory;
+	s_memoryStage = m_stage;
+}
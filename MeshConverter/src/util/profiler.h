@@ -0,0 +1,277 @@
+#ifndef __UTIL_PROFILER_H_INCLUDED__
+#define __UTIL_PROFILER_H_INCLUDED__
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "counters.h"
+
+// Stages of a conversion that time and counts are kept for. Nested stages
+// are taken out of the time of the stage they run in, so every stage's
+// time is its own and the stages of a file add up to its total
+#define PROFILE_STAGE_READ 0                   // Reading the model file or stream
+#define PROFILE_STAGE_LOAD 1                   // Parsing it in the converter
+#define PROFILE_STAGE_WELD 2
+#define PROFILE_STAGE_NORMALS 3
+#define PROFILE_STAGE_VERTEX_CACHE 4
+#define PROFILE_STAGE_OVERDRAW 5
+#define PROFILE_STAGE_MESHLETS 6
+#define PROFILE_STAGE_LOD 7
+#define PROFILE_STAGE_VERTEX_FETCH 8
+#define PROFILE_STAGE_BOUNDS 9
+#define PROFILE_STAGE_TANGENTS 10
+#define PROFILE_STAGE_BVH 11
+#define PROFILE_STAGE_WRITE 12                 // ConvertToMesh, less the processing run from it
+#define PROFILE_STAGE_COMPRESS 13
+#define NUM_PROFILE_STAGES 14
+
+// Counted per stage. Elements are what the stage works through: vertices
+// for welding and normals, triangles for the rest
+#define PROFILE_COUNTER_ELEMENTS 0
+#define PROFILE_COUNTER_BYTES_READ 1
+#define PROFILE_COUNTER_BYTES_WRITTEN 2
+#define PROFILE_COUNTER_ALLOCATIONS 3
+#define NUM_PROFILE_COUNTERS 4
+
+struct ProfileStage
+{
+	unsigned long long calls;
+	double milliseconds;
+	unsigned long long counters[NUM_PROFILE_COUNTERS];
+	unsigned long long hardware[NUM_HARDWARE_COUNTERS];  // HARDWARE_COUNTER_* counts, with hardware counters on
+	unsigned long long allocatedBytes;           // Bytes asked of operator new, with allocation tracking on
+	unsigned long long peakBytes;                // Most of the file's bytes live at once while the stage ran
+};
+
+// Everything recorded while converting one file
+struct ProfileFile
+{
+	std::string file;
+	bool converted;
+	double milliseconds;
+	unsigned long long peakBytes;                // Most of its bytes live at once, with allocation tracking on
+	ProfileStage stages[NUM_PROFILE_STAGES];
+};
+
+// The start or end of a file or of a stage, as recorded for a trace
+struct TraceEvent
+{
+	unsigned int thread;                         // Numbered from 1 in the order threads first record something
+	int stage;                                   // PROFILE_STAGE_* value, -1 for a file
+	bool begin;
+	bool converted;                              // Whether the file was converted, at the end of a file
+	double microseconds;                         // Since tracing was turned on
+	std::string file;                            // File converted, at the start of a file
+};
+
+// Only read where a scope starts, so with profiling off a scope costs a
+// single test of this
+extern bool g_profiling;
+
+inline bool IsProfiling()
+{
+	return g_profiling;
+}
+
+/**
+ * Turns profiling on for the rest of the run. Call before any conversion
+ * starts, the flag isn't synchronized
+ */
+void EnableProfiling();
+
+/**
+ * Keeps track of how many bytes every allocation asks for and how many are
+ * live at once, per stage and per file. A file's live bytes are those of
+ * blocks allocated for it, on its own thread or by ParallelFor for it,
+ * and not yet freed on any thread. Blocks allocated before it started
+ * aren't counted, so freeing them doesn't take anything off. Turns
+ * profiling on too. Call before any conversion starts
+ */
+void EnableAllocationTracking();
+
+/**
+ * @return bool true if allocations are being tracked
+ */
+bool IsTrackingAllocations();
+
+/**
+ * @param bytes receives the most physical memory the process has held at
+ *              once so far
+ *
+ * @return bool false if the OS couldn't say
+ */
+bool GetPeakResidentBytes(unsigned long long &bytes);
+
+/**
+ * Records the start and end of every file and stage as well, to be laid
+ * out on a timeline per thread. Turns profiling on too. Call before any
+ * conversion starts
+ */
+void EnableTracing();
+
+/**
+ * Reads the CPU's performance counters around every stage as well, on
+ * each thread that converts a file. Turns profiling on too. Call before
+ * any conversion starts
+ */
+void EnableHardwareCounters();
+
+/**
+ * @param error receives why a thread couldn't open the counters, if one
+ *              couldn't
+ *
+ * @return bool true if hardware counters were asked for and every thread
+ *              that converted a file had them
+ */
+bool HasHardwareCounters(std::string &error);
+
+/**
+ * @param stage one of the PROFILE_STAGE_* values
+ *
+ * @return const char* name of the stage as written in reports
+ */
+const char* GetProfileStageName(unsigned int stage);
+
+/**
+ * @param counter one of the PROFILE_COUNTER_* values
+ *
+ * @return const char* name of the counter as written in reports
+ */
+const char* GetProfileCounterName(unsigned int counter);
+
+/**
+ * Adds to a counter of the file being converted on this thread. Does
+ * nothing outside a ProfileFileScope or with profiling off
+ * @param stage one of the PROFILE_STAGE_* values
+ * @param counter one of the PROFILE_COUNTER_* values
+ * @param amount amount to add
+ */
+void ProfileCount(unsigned int stage, unsigned int counter, unsigned long long amount);
+
+/**
+ * Counts an allocation against the stage running on this thread. The
+ * library leaves the global operator new alone, a program that wants its
+ * allocations profiled calls this from its own, as the command line tool
+ * does. Does nothing outside a ProfileFileScope or with profiling off
+ * @param block block just allocated
+ * @param size bytes asked for
+ */
+void ProfileAllocation(void *block, size_t size);
+
+/**
+ * @param block block about to be freed, before it is
+ */
+void ProfileDeallocation(void *block);
+
+struct ProfileMemory;
+
+// The file and stage a thread's allocations are counted against
+struct ProfileAllocationOwner
+{
+	ProfileMemory *memory;                       // NULL when they aren't
+	int stage;
+};
+
+/**
+ * @return ProfileAllocationOwner what this thread's allocations are counted
+ *                                against, to hand to threads working for it
+ */
+ProfileAllocationOwner GetProfileAllocationOwner();
+
+/**
+ * Counts this thread's allocations against another thread's file and
+ * stage for as long as it's in scope. The owner has to stay in its
+ * stage until this goes out of scope
+ */
+class ProfileAllocationScope
+{
+public:
+	ProfileAllocationScope(const ProfileAllocationOwner &owner);
+	~ProfileAllocationScope();
+
+private:
+	ProfileAllocationScope(const ProfileAllocationScope &);
+	ProfileAllocationScope& operator=(const ProfileAllocationScope &);
+
+	ProfileMemory *m_memory;
+	int m_stage;
+};
+
+/**
+ * @param files receives every file finished so far, in the order they
+ *              finished
+ */
+void GetProfileFiles(std::vector<ProfileFile> &files);
+
+/**
+ * Gathers what every thread recorded for the trace. Each thread appends to
+ * its own buffer without locking, so call this only once no conversion is
+ * running
+ * @param events receives the events thread by thread, each thread's in the
+ *               order they happened
+ */
+void GetTraceEvents(std::vector<TraceEvent> &events);
+
+/**
+ * Times a stage for as long as it's in scope, on the thread it was
+ * created on. Work a stage hands to other threads is timed, hardware
+ * events there aren't counted, and allocations there only are when
+ * they're being tracked
+ */
+class ProfileScope
+{
+public:
+	/**
+	 * @param stage one of the PROFILE_STAGE_* values
+	 * @param elements number of elements the stage works through
+	 */
+	ProfileScope(unsigned int stage, unsigned long long elements = 0)
+	{
+		m_active = (g_profiling && Enter(stage, elements));
+	}
+
+	~ProfileScope()
+	{
+		if (m_active)
+			Leave();
+	}
+
+private:
+	ProfileScope(const ProfileScope &);
+	ProfileScope& operator=(const ProfileScope &);
+
+	bool Enter(unsigned int stage, unsigned long long elements);
+	void Leave();
+
+	bool m_active;
+	int m_parent;                                // Stage this one interrupted, -1 for none
+};
+
+/**
+ * Records what happens on this thread while it's in scope as the
+ * conversion of one file, added to the files GetProfileFiles returns
+ * once it goes out of scope
+ */
+class ProfileFileScope
+{
+public:
+	ProfileFileScope(const std::string &file);
+	~ProfileFileScope();
+
+	/**
+	 * @param converted true once the file has been converted, files are
+	 *                  recorded as failed until then
+	 */
+	void SetConverted(bool converted);
+
+private:
+	ProfileFileScope(const ProfileFileScope &);
+	ProfileFileScope& operator=(const ProfileFileScope &);
+
+	ProfileFile *m_file;
+	ProfileMemory *m_memory;                     // NULL unless tracking allocations
+	long long m_start;
+};
+
+#endif
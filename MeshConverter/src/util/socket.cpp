@@ -0,0 +1,225 @@
+#include "socket.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// Bytes read from the socket at a time
+#define SOCKET_RECEIVE_SIZE 4096
+
+// Longest line ReceiveLine waits for, so a peer that never sends a '\n'
+// can't make it buffer without bound
+#define SOCKET_MAX_LINE_LENGTH (1024 * 1024)
+
+LocalSocket::LocalSocket()
+{
+	m_socket = -1;
+}
+
+#ifdef _WIN32
+
+bool LocalSocket::Listen(const std::string &path)                          { return false; }
+bool LocalSocket::Connect(const std::string &path)                         { return false; }
+bool LocalSocket::Accept(LocalSocket &client, unsigned int timeout)        { return false; }
+bool LocalSocket::CreatePair(LocalSocket &other)                           { return false; }
+bool LocalSocket::WaitForData(unsigned int timeout)                        { return true; }
+bool LocalSocket::WaitForAny(const std::vector<LocalSocket*> &sockets, unsigned int timeout, std::vector<LocalSocket*> &ready) { return false; }
+bool LocalSocket::ReceiveLine(std::string &line)                           { return false; }
+bool LocalSocket::SendLine(const std::string &line)                        { return false; }
+void LocalSocket::Close()                                                  {}
+
+#else
+
+static bool GetAddress(const std::string &path, struct sockaddr_un &address)
+{
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.length() == 0 || path.length() >= sizeof(address.sun_path))
+		return false;
+	memcpy(address.sun_path, path.c_str(), path.length());
+	return true;
+}
+
+// A signal cutting the wait short counts as nothing to read, which gives
+// the caller a chance to notice it
+static bool WaitForReadable(int socket, unsigned int timeout)
+{
+	struct pollfd entry;
+	entry.fd = socket;
+	entry.events = POLLIN;
+	entry.revents = 0;
+	return (poll(&entry, 1, (int)timeout) > 0);
+}
+
+bool LocalSocket::Listen(const std::string &path)
+{
+	Close();
+
+	struct sockaddr_un address;
+	if (!GetAddress(path, address))
+		return false;
+
+	// Something answering on the path means another process owns it
+	LocalSocket existing;
+	if (existing.Connect(path))
+		return false;
+	unlink(path.c_str());
+
+	m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (m_socket < 0)
+		return false;
+	if (bind(m_socket, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(m_socket, SOMAXCONN) != 0)
+	{
+		close(m_socket);
+		m_socket = -1;
+		return false;
+	}
+
+	m_path = path;
+	return true;
+}
+
+bool LocalSocket::Connect(const std::string &path)
+{
+	Close();
+
+	struct sockaddr_un address;
+	if (!GetAddress(path, address))
+		return false;
+
+	m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (m_socket < 0)
+		return false;
+	if (connect(m_socket, (struct sockaddr*)&address, sizeof(address)) != 0)
+	{
+		close(m_socket);
+		m_socket = -1;
+		return false;
+	}
+	return true;
+}
+
+bool LocalSocket::Accept(LocalSocket &client, unsigned int timeout)
+{
+	client.Close();
+	if (m_socket < 0 || !WaitForReadable(m_socket, timeout))
+		return false;
+
+	client.m_socket = accept(m_socket, NULL, NULL);
+	return (client.m_socket >= 0);
+}
+
+bool LocalSocket::CreatePair(LocalSocket &other)
+{
+	Close();
+	other.Close();
+
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+		return false;
+	m_socket = sockets[0];
+	other.m_socket = sockets[1];
+	return true;
+}
+
+bool LocalSocket::WaitForData(unsigned int timeout)
+{
+	if (m_received.find('\n') != std::string::npos)
+		return true;
+	return (m_socket < 0 || WaitForReadable(m_socket, timeout));
+}
+
+bool LocalSocket::WaitForAny(const std::vector<LocalSocket*> &sockets, unsigned int timeout, std::vector<LocalSocket*> &ready)
+{
+	// Lines already received, or closed sockets, are ready without waiting
+	ready.clear();
+	for (unsigned int i = 0; i < sockets.size(); ++i)
+	{
+		if (sockets[i]->m_socket < 0 || sockets[i]->m_received.find('\n') != std::string::npos)
+			ready.push_back(sockets[i]);
+	}
+
+	std::vector<struct pollfd> entries(sockets.size());
+	for (unsigned int i = 0; i < sockets.size(); ++i)
+	{
+		entries[i].fd = sockets[i]->m_socket;
+		entries[i].events = POLLIN;
+		entries[i].revents = 0;
+	}
+	if (poll(entries.data(), (nfds_t)entries.size(), (ready.size() > 0 ? 0 : (int)timeout)) <= 0)
+		return (ready.size() > 0);
+
+	ready.clear();
+	for (unsigned int i = 0; i < sockets.size(); ++i)
+	{
+		if (entries[i].revents != 0 || sockets[i]->m_socket < 0 || sockets[i]->m_received.find('\n') != std::string::npos)
+			ready.push_back(sockets[i]);
+	}
+	return true;
+}
+
+bool LocalSocket::ReceiveLine(std::string &line)
+{
+	size_t end;
+	while ((end = m_received.find('\n')) == std::string::npos)
+	{
+		if (m_socket < 0 || m_received.length() > SOCKET_MAX_LINE_LENGTH)
+			return false;
+
+		char buffer[SOCKET_RECEIVE_SIZE];
+		ssize_t size = recv(m_socket, buffer, sizeof(buffer), 0);
+		if (size < 0 && errno == EINTR)
+			continue;
+		if (size <= 0)
+			return false;
+		m_received.append(buffer, (size_t)size);
+	}
+
+	line = m_received.substr(0, end);
+	m_received.erase(0, end + 1);
+	return true;
+}
+
+bool LocalSocket::SendLine(const std::string &line)
+{
+	if (m_socket < 0)
+		return false;
+
+	// SIGPIPE would kill the process when the other side has gone, where
+	// MSG_NOSIGNAL exists it is asked for instead
+#ifdef MSG_NOSIGNAL
+	int flags = MSG_NOSIGNAL;
+#else
+	int flags = 0;
+#endif
+	std::string message = line + '\n';
+	size_t sent = 0;
+	while (sent < message.length())
+	{
+		ssize_t size = send(m_socket, message.c_str() + sent, message.length() - sent, flags);
+		if (size < 0 && errno == EINTR)
+			continue;
+		if (size <= 0)
+			return false;
+		sent += (size_t)size;
+	}
+	return true;
+}
+
+void LocalSocket::Close()
+{
+	if (m_socket >= 0)
+		close(m_socket);
+	if (m_path.length() > 0)
+		unlink(m_path.c_str());
+	m_socket = -1;
+	m_path = "";
+	m_received = "";
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef __UTIL_SOCKET_H_INCLUDED__
+#define __UTIL_SOCKET_H_INCLUDED__
+
+#include <string>
+#include <vector>
+
+/**
+ * Stream socket on a Unix domain socket path, for talking to another
+ * process on the same machine. Messages are lines of text. Builds
+ * without Unix domain sockets get a socket that never opens
+ */
+class LocalSocket
+{
+public:
+	LocalSocket();
+	virtual ~LocalSocket()                                 { Close(); }
+
+	/**
+	 * Starts accepting connections on a path. A socket file left behind
+	 * by a process that is gone is replaced, one that still has a
+	 * process behind it is not
+	 * @param path socket file to create
+	 *
+	 * @return bool false if the path is taken or the socket couldn't be
+	 *              created
+	 */
+	bool Listen(const std::string &path);
+
+	/**
+	 * @param path socket file another process is listening on
+	 *
+	 * @return bool false if nothing is listening there
+	 */
+	bool Connect(const std::string &path);
+
+	/**
+	 * Waits for a connection to a listening socket
+	 * @param client receives the connection
+	 * @param timeout most milliseconds to wait
+	 *
+	 * @return bool false if no connection came in time
+	 */
+	bool Accept(LocalSocket &client, unsigned int timeout);
+
+	/**
+	 * Connects this socket to another in the same process, for one thread
+	 * to wake another waiting in WaitForAny
+	 * @param other receives the other end
+	 *
+	 * @return bool false if the pair couldn't be created
+	 */
+	bool CreatePair(LocalSocket &other);
+
+	/**
+	 * @param timeout most milliseconds to wait
+	 *
+	 * @return bool true if a line can be received, or the other side has
+	 *              closed the connection, so ReceiveLine won't block for
+	 *              long
+	 */
+	bool WaitForData(unsigned int timeout);
+
+	/**
+	 * Waits on several sockets at once. A listening socket is ready once a
+	 * connection can be accepted, any other as for WaitForData
+	 * @param sockets sockets to wait on
+	 * @param timeout most milliseconds to wait
+	 * @param ready receives the sockets that are ready
+	 *
+	 * @return bool false if none became ready in time
+	 */
+	static bool WaitForAny(const std::vector<LocalSocket*> &sockets, unsigned int timeout, std::vector<LocalSocket*> &ready);
+
+	/**
+	 * @param line receives the next line, without its '\n'
+	 *
+	 * @return bool false once the connection is closed, or when the line
+	 *              runs past the longest allowed without ending
+	 */
+	bool ReceiveLine(std::string &line);
+
+	/**
+	 * @param line text to send, followed by a '\n'
+	 *
+	 * @return bool false if the connection is closed
+	 */
+	bool SendLine(const std::string &line);
+
+	void Close();
+	bool IsOpen() const                                    { return m_socket >= 0; }
+
+private:
+	LocalSocket(const LocalSocket &);
+	LocalSocket& operator=(const LocalSocket &);
+
+	int m_socket;
+	std::string m_path;                          // Socket file to remove on Close, when listening
+	std::string m_received;                      // Received bytes not yet returned as a line
+};
+
+#endif